@@ -35,69 +35,94 @@
  * knowledge of the CeCILL-C license and that you accept its terms.
  */
 
-#include <iostream>
-#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
 #include "AscEncoder.h"
 #include "Logger.h"
 
+AscEncoder::AscEncoder ( Image* image ) : image ( image ), line ( 0 ), nodata_value ( -99999.00 ), textSize ( 0 ), textPos ( 0 ) {
+    buffer_line = new float[image->getWidth() * image->getChannels()];
+    text = new char[ASC_HEADER_MAX_SIZE + image->getWidth() * ASC_VALUE_MAX_SIZE + 1];
+}
 
-size_t AscEncoder::read ( uint8_t *buffer, size_t size ) {
-    //size_t offset=0;
-    std::ostringstream tmp_stream;
-    std::string tmp_str;
-
-    nodata_value=-99999.00;
-
-    // Définit l'affichage des nombres dans les chaines
-    tmp_stream << std::fixed << std::setprecision(2);
-
-    if(line==0 ){
-        //On traite l'entete
-        tmp_stream << std::setprecision(8)
-                   << "ncols        " << image->getWidth() << std::endl
-                   << "nrows        " << image->getHeight() << std::endl
-                   << "xllcorner    " << image->getXmin() << std::endl
-                   << "yllcorner    " << image->getYmin() << std::endl
-                   << "cellsize     " << image->getResXmeter() << std::endl
-                   << "NODATA_value " << std::setprecision(2) << nodata_value ;
+char* AscEncoder::formatValue ( char* out, float value ) {
+    // Exact en double : 24 bits de mantisse pour la valeur, 7 pour 100
+    double scaled = std::fabs ( ( double ) value * 100. );
+    if ( ! ( scaled < 1e17 ) ) {
+        // NaN, infini ou trop grand pour un entier 64 bits : cas rares
+        return out + snprintf ( out, ASC_VALUE_MAX_SIZE, "%.2f", value );
     }
 
-    // stockage d'une ligne de donnée (1 canal)
-    float* buffer_line=new float[image->getWidth()];
+    uint64_t n = ( uint64_t ) std::nearbyint ( scaled );
+    if ( std::signbit ( value ) ) *out++ = '-';
+
+    // Partie entière, écrite à l'envers puis recopiée
+    char digits[20];
+    int nd = 0;
+    uint64_t ip = n / 100;
+    do {
+        digits[nd++] = '0' + ip % 10;
+        ip /= 10;
+    } while ( ip );
+    while ( nd ) *out++ = digits[--nd];
+
+    unsigned int fp = n % 100;
+    *out++ = '.';
+    *out++ = '0' + fp / 10;
+    *out++ = '0' + fp % 10;
+    return out;
+}
 
-    if( line < image->getHeight() ){
+void AscEncoder::formatLine() {
+    char* out = text;
 
-        image->getline(buffer_line,line++);
+    if ( line == 0 ) {
+        // En-tête, suivi de la première ligne
+        out += snprintf ( out, ASC_HEADER_MAX_SIZE,
+                          "ncols        %d\nnrows        %d\nxllcorner    %.8f\nyllcorner    %.8f\ncellsize     %.8f\nNODATA_value %.2f",
+                          image->getWidth(), image->getHeight(), image->getXmin(), image->getYmin(), image->getResXmeter(), nodata_value );
+    }
 
-        tmp_stream << std::endl;
-        for( int i=0;i<image->getWidth();i++){
-        // formattage des données
-            tmp_stream << " " << buffer_line[(i*image->getChannels())];
-        }
+    image->getline ( buffer_line, line++ );
 
-        tmp_str = tmp_stream.str();
+    int channels = image->getChannels();
+    *out++ = '\n';
+    for ( int i = 0; i < image->getWidth(); i++ ) {
+        *out++ = ' ';
+        out = formatValue ( out, buffer_line[i * channels] );
+    }
 
-        if(tmp_str.size()<=size){
-        //écriture des données texte dans le buffer flux
-            for ( int i=0; i<tmp_str.size(); i++ ) {
-                buffer[sizeof(uint8_t)*i]= (uint8_t) tmp_str.at(i);
-            }
-        }else{
-          LOGGER_ERROR ( "Too much data to write on 2^21 buffer");
-          return tmp_str.size();
-        }
+    textSize = out - text;
+    textPos = 0;
+}
 
-    }
+size_t AscEncoder::read ( uint8_t *buffer, size_t size ) {
+    size_t offset = 0;
 
-    delete[] buffer_line;
+    // Les lignes sont formatées une à une et découpées au besoin entre deux lectures
+    while ( offset < size ) {
+        if ( textPos == textSize ) {
+            if ( line >= image->getHeight() ) break;
+            formatLine();
+        }
+        size_t n = std::min ( size - offset, textSize - textPos );
+        memcpy ( buffer + offset, text + textPos, n );
+        offset += n;
+        textPos += n;
+    }
 
-    return tmp_str.size();
+    return offset;
 }
 
 AscEncoder::~AscEncoder() {
+    delete[] buffer_line;
+    delete[] text;
     delete image;
 }
 
 bool AscEncoder::eof() {
-    return line>=image->getHeight();
+    return line >= image->getHeight() && textPos == textSize;
 }
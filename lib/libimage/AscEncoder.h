@@ -41,14 +41,62 @@
 #include "Data.h"
 #include "Image.h"
 
+/**
+ * \~french \brief Taille maximale d'une valeur formatée, espace compris
+ * \~english \brief Maximal size of a formatted value, including space
+ */
+#define ASC_VALUE_MAX_SIZE 48
+
+/**
+ * \~french \brief Taille maximale de l'en-tête
+ * \~english \brief Maximal header size
+ */
+#define ASC_HEADER_MAX_SIZE 256
+
 class AscEncoder : public DataStream {
     Image* image;
     size_t line;
     float nodata_value;
 
+    /**
+     * \~french \brief Ligne de l'image, tous canaux
+     * \~english \brief Image line, all channels
+     */
+    float* buffer_line;
+    /**
+     * \~french \brief Texte de la ligne en cours (et de l'en-tête pour la première)
+     * \~english \brief Current line's text (and header's for the first one)
+     */
+    char* text;
+    size_t textSize;
+    size_t textPos;
+
+    /**
+     * \~french \brief Formate la ligne suivante dans text
+     * \~english \brief Format next line into text
+     */
+    void formatLine();
+
 public:
-    AscEncoder ( Image* image ) : image ( image ), line ( 0 ){}
+    AscEncoder ( Image* image );
     ~AscEncoder();
+
+    /**
+     * \~french
+     * \brief Écrit une valeur en virgule fixe à 2 décimales
+     * \details Même résultat que printf("%.2f"), sans passer par les flux ni la locale : la valeur multipliée par 100 est exacte en double, arrondie à l'entier pair le plus proche comme printf. Les valeurs non finies ou très grandes sont confiées à snprintf.
+     * \param[out] out destination, au moins ASC_VALUE_MAX_SIZE octets
+     * \param[in] value valeur à écrire
+     * \return pointeur après le dernier caractère écrit
+     * \~english
+     * \brief Write a value in fixed point with 2 decimals
+     * \details Same result as printf("%.2f"), without streams nor locale : value multiplied by 100 is exact as a double, rounded to the nearest even integer like printf. Non finite or very large values are handed to snprintf.
+     * \param[out] out destination, at least ASC_VALUE_MAX_SIZE bytes
+     * \param[in] value value to write
+     * \return pointer after the last written character
+     */
+    static char* formatValue ( char* out, float value );
+
     size_t read ( uint8_t *buffer, size_t size );
     int getHttpStatus() {
         return 200;
@@ -66,5 +114,3 @@ public:
 
 };
 #endif
-
-
@@ -38,6 +38,7 @@
 #include "AspectImage.h"
 
 #include "Logger.h"
+#include "RequestTrace.h"
 
 #include "Utils.h"
 #include <cstring>
@@ -123,6 +124,7 @@ int AspectImage::getOrigLine ( float* buffer, int line ) {
 
 
 void AspectImage::generate() {
+    TraceScope scope ( TraceStage::STYLE );
     aspect = new float[width * height];
     bufferTmp = new float[origImage->getWidth() * 3];
     float* lineBuffer[3];
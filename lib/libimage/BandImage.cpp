@@ -0,0 +1,294 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file BandImage.cpp
+ ** \~french
+ * \brief Implémentation des classes ConcurrentBands, BandImage et BandImageFactory
+ ** \~english
+ * \brief Implement classes ConcurrentBands, BandImage and BandImageFactory
+ */
+
+#include "BandImage.h"
+#include "Logger.h"
+#include <cstring>
+
+/**
+ * \~french
+ * \brief Calcul d'une bande pour toutes les images
+ * \details Partagé entre le thread demandeur et les tâches soumises au pool, il est détruit par le dernier qui le lâche : une tâche exécutée après la fin du calcul ne trouve plus d'image à prendre et ne touche pas au ConcurrentBands.
+ * \~english
+ * \brief A band's computing for all images
+ * \details Shared between the asking thread and tasks submitted to the pool, it is deleted by the last one to release it : a task run after the computing's end finds no image to take and doesn't touch the ConcurrentBands.
+ */
+struct BandJob {
+    ConcurrentBands* bands;
+    int first;
+    int last;
+    int count;
+    /** Images prises (1) ou non (0) */
+    int* claimed;
+    /** Images prises dont le calcul n'est pas terminé */
+    int remaining;
+    int refs;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    BandJob ( ConcurrentBands* bands, int first, int last, int count ) : bands ( bands ), first ( first ), last ( last ), count ( count ), remaining ( 0 ), refs ( 1 ) {
+        claimed = new int[count];
+        memset ( claimed, 0, count * sizeof ( int ) );
+        pthread_mutex_init ( &mutex, NULL );
+        pthread_cond_init ( &cond, NULL );
+    }
+
+    ~BandJob() {
+        delete[] claimed;
+        pthread_mutex_destroy ( &mutex );
+        pthread_cond_destroy ( &cond );
+    }
+
+    /** Prend et calcule l'image index si personne ne l'a encore prise */
+    void process ( int index ) {
+        if ( __atomic_exchange_n ( &claimed[index], 1, __ATOMIC_ACQ_REL ) != 0 ) return;
+
+        pthread_mutex_lock ( &mutex );
+        remaining++;
+        pthread_mutex_unlock ( &mutex );
+
+        bands->computeImage ( index, first, last );
+
+        pthread_mutex_lock ( &mutex );
+        remaining--;
+        if ( remaining == 0 ) pthread_cond_broadcast ( &cond );
+        pthread_mutex_unlock ( &mutex );
+    }
+
+    /** Attend la fin des calculs en cours, toutes les images ayant été prises */
+    void wait() {
+        pthread_mutex_lock ( &mutex );
+        while ( remaining > 0 ) pthread_cond_wait ( &cond, &mutex );
+        pthread_mutex_unlock ( &mutex );
+    }
+
+    static void release ( BandJob* job ) {
+        if ( __atomic_sub_fetch ( &job->refs, 1, __ATOMIC_ACQ_REL ) == 0 ) delete job;
+    }
+};
+
+/**
+ * \~french \brief Tâche calculant une image d'une bande
+ * \~english \brief Task computing an image of a band
+ */
+class BandTask : public Task {
+private:
+    BandJob* job;
+    int index;
+public:
+    BandTask ( BandJob* job, int index ) : job ( job ), index ( index ) {
+        __atomic_add_fetch ( &job->refs, 1, __ATOMIC_ACQ_REL );
+    }
+    void run() {
+        job->process ( index );
+    }
+    ~BandTask() {
+        BandJob::release ( job );
+    }
+};
+
+template<typename T>
+static ConcurrentBands::BandType bandType();
+template<>
+ConcurrentBands::BandType bandType<uint8_t>() {
+    return ConcurrentBands::UINT8_TYPE;
+}
+template<>
+ConcurrentBands::BandType bandType<uint16_t>() {
+    return ConcurrentBands::UINT16_TYPE;
+}
+template<>
+ConcurrentBands::BandType bandType<float>() {
+    return ConcurrentBands::FLOAT_TYPE;
+}
+
+template<typename T>
+static void computeLines ( Image* image, uint8_t* buffer, int first, int last ) {
+    int rowSize = image->getWidth() * image->getChannels();
+    for ( int l = first; l < last; l++ ) {
+        image->getline ( ( ( T* ) buffer ) + ( l - first ) * rowSize, l );
+    }
+}
+
+ConcurrentBands::ConcurrentBands ( std::vector<Image*>& images, ThreadPool* pool ) : images ( images ), pool ( pool ), band ( -1 ), users ( 0 ) {
+    int height = images.at ( 0 )->getHeight();
+    bandHeight = ( height < BAND_HEIGHT ) ? height : BAND_HEIGHT;
+
+    for ( unsigned int i = 0; i < images.size(); i++ ) {
+        // Tampons dimensionnés pour le plus grand type
+        imageBuffers.push_back ( new uint8_t[bandHeight * images.at ( i )->getWidth() * images.at ( i )->getChannels() * sizeof ( float )] );
+        if ( images.at ( i )->getMask() ) {
+            maskBuffers.push_back ( new uint8_t[bandHeight * images.at ( i )->getWidth()] );
+        } else {
+            maskBuffers.push_back ( NULL );
+        }
+        types.push_back ( UNKNOWN_TYPE );
+    }
+}
+
+ConcurrentBands::~ConcurrentBands() {
+    for ( unsigned int i = 0; i < images.size(); i++ ) {
+        delete[] imageBuffers.at ( i );
+        if ( maskBuffers.at ( i ) ) delete[] maskBuffers.at ( i );
+        delete images.at ( i );
+    }
+}
+
+void ConcurrentBands::computeImage ( int index, int first, int last ) {
+    Image* image = images.at ( index );
+    switch ( types.at ( index ) ) {
+    case UINT8_TYPE :
+        computeLines<uint8_t> ( image, imageBuffers.at ( index ), first, last );
+        break;
+    case UINT16_TYPE :
+        computeLines<uint16_t> ( image, imageBuffers.at ( index ), first, last );
+        break;
+    default :
+        computeLines<float> ( image, imageBuffers.at ( index ), first, last );
+        break;
+    }
+    if ( maskBuffers.at ( index ) ) {
+        computeLines<uint8_t> ( image->getMask(), maskBuffers.at ( index ), first, last );
+    }
+}
+
+void ConcurrentBands::computeBand ( int b, BandType type ) {
+    int first = b * bandHeight;
+    int last = first + bandHeight;
+    if ( last > images.at ( 0 )->getHeight() ) last = images.at ( 0 )->getHeight();
+
+    for ( unsigned int i = 0; i < types.size(); i++ ) {
+        if ( types.at ( i ) == UNKNOWN_TYPE ) types.at ( i ) = type;
+    }
+
+    BandJob* job = new BandJob ( this, first, last, images.size() );
+
+    // Le thread demandeur commence par la première image, les autres sont proposées au pool
+    for ( int i = 1; i < job->count; i++ ) {
+        pool->submit ( new BandTask ( job, i ) );
+    }
+    for ( int i = 0; i < job->count; i++ ) {
+        job->process ( i );
+    }
+    job->wait();
+    BandJob::release ( job );
+
+    band = b;
+}
+
+template<typename T>
+int ConcurrentBands::getline ( int index, bool isMask, T* buffer, int line ) {
+    Image* image = images.at ( index );
+    if ( isMask ) image = image->getMask();
+    int rowSize = image->getWidth() * image->getChannels();
+
+    if ( line / bandHeight != band ) computeBand ( line / bandHeight, bandType<T>() );
+
+    int offset = ( line - band * bandHeight ) * rowSize;
+    if ( isMask ) {
+        if ( bandType<T>() == UINT8_TYPE ) {
+            memcpy ( buffer, maskBuffers.at ( index ) + offset, rowSize );
+            return rowSize;
+        }
+    } else if ( bandType<T>() == types.at ( index ) ) {
+        memcpy ( buffer, ( ( T* ) imageBuffers.at ( index ) ) + offset, rowSize * sizeof ( T ) );
+        return rowSize;
+    } else {
+        // Les prochaines bandes seront calculées dans le type demandé
+        types.at ( index ) = bandType<T>();
+    }
+
+    return image->getline ( buffer, line );
+}
+
+BandImage::BandImage ( ConcurrentBands* bands, int index, bool sourceMask ) :
+    Image ( bands->images.at ( index )->getWidth(), bands->images.at ( index )->getHeight(),
+            sourceMask ? 1 : bands->images.at ( index )->getChannels(),
+            bands->images.at ( index )->getResX(), bands->images.at ( index )->getResY(), bands->images.at ( index )->getBbox() ),
+    bands ( bands ), index ( index ), sourceMask ( sourceMask ) {
+
+    bands->users++;
+    setCRS ( bands->images.at ( index )->getCRS() );
+}
+
+BandImage::~BandImage() {
+    bands->users--;
+    if ( bands->users == 0 ) delete bands;
+}
+
+int BandImage::getline ( uint8_t* buffer, int line ) {
+    return bands->getline ( index, sourceMask, buffer, line );
+}
+
+int BandImage::getline ( uint16_t* buffer, int line ) {
+    return bands->getline ( index, sourceMask, buffer, line );
+}
+
+int BandImage::getline ( float* buffer, int line ) {
+    return bands->getline ( index, sourceMask, buffer, line );
+}
+
+bool BandImageFactory::createBandImages ( std::vector<Image*>& images, ThreadPool* pool ) {
+    if ( images.size() < 2 || pool == NULL ) return false;
+
+    for ( unsigned int i = 1; i < images.size(); i++ ) {
+        if ( images.at ( i )->getWidth() != images.at ( 0 )->getWidth() || images.at ( i )->getHeight() != images.at ( 0 )->getHeight() ) {
+            LOGGER_DEBUG ( "Images with different dimensions cannot be computed concurrently" );
+            return false;
+        }
+    }
+
+    ConcurrentBands* bands = new ConcurrentBands ( images, pool );
+
+    for ( unsigned int i = 0; i < images.size(); i++ ) {
+        BandImage* image = new BandImage ( bands, i, false );
+        if ( bands->images.at ( i )->getMask() ) {
+            image->setMask ( new BandImage ( bands, i, true ) );
+        }
+        images.at ( i ) = image;
+    }
+
+    return true;
+}
@@ -0,0 +1,272 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file BandImage.h
+ ** \~french
+ * \brief Définition des classes ConcurrentBands, BandImage et BandImageFactory
+ * \details
+ * \li ConcurrentBands : calcul simultané, par bandes de lignes, de plusieurs images
+ * \li BandImage : image lue dans les bandes calculées
+ * \li BandImageFactory : usine de création d'objets BandImage
+ ** \~english
+ * \brief Define classes ConcurrentBands, BandImage and BandImageFactory
+ * \details
+ * \li ConcurrentBands : concurrent computing, by bands of lines, of several images
+ * \li BandImage : image read from computed bands
+ * \li BandImageFactory : factory to create BandImage objects
+ */
+
+#ifndef BAND_IMAGE_H
+#define BAND_IMAGE_H
+
+#include "Image.h"
+#include "ThreadPool.h"
+#include <vector>
+
+/**
+ * \~french \brief Nombre de lignes d'une bande
+ * \~english \brief Number of lines in a band
+ */
+#define BAND_HEIGHT 64
+
+class BandImage;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Calcul simultané de plusieurs images par bandes de lignes
+ * \details Lorsqu'une ligne hors de la bande courante est demandée, la bande qui la contient est calculée pour toutes les images en même temps : une tâche par image est soumise au pool, le thread demandeur traitant lui-même les images qu'aucun thread du pool n'a encore prises. Il n'attend donc jamais une tâche encore en file, et un pool saturé ramène au calcul séquentiel.
+ *
+ * Chaque image est calculée par un seul thread à la fois, avec son masque : les chaînes de traitement d'une image n'ont pas à être réentrantes, seules des images différentes sont calculées en parallèle.
+ *
+ * Les lignes sont conservées dans le type de la demande (les images stylées ne se lisent pas de la même façon en entier et en flottant). Une demande dans un autre type que celui de la bande calculée est servie directement par l'image source.
+ * \~english
+ * \brief Concurrent computing of several images by bands of lines
+ * \details When a line out of the current band is asked, the band containing it is computed for all images at the same time : one task per image is submitted to the pool, the asking thread processing itself images no pool thread took yet. It never waits for a still queued task, and a saturated pool falls back to sequential computing.
+ *
+ * Each image is computed by a single thread at a time, with its mask : an image's processing chain has not to be reentrant, only different images are computed in parallel.
+ *
+ * Lines are kept in the asked type (styled images are not read the same way as integers and floats). A request in another type than the computed band's one is served directly by the source image.
+ */
+class ConcurrentBands {
+
+    friend class BandImage;
+    friend class BandImageFactory;
+
+public:
+
+    /**
+     * \~french \brief Type des valeurs d'une bande
+     * \~english \brief Band's values type
+     */
+    enum BandType {
+        UNKNOWN_TYPE,
+        UINT8_TYPE,
+        UINT16_TYPE,
+        FLOAT_TYPE
+    };
+
+    /**
+     * \~french \brief Calcule les lignes d'une bande pour une image et son masque
+     * \param[in] index indice de l'image
+     * \param[in] first première ligne de la bande
+     * \param[in] last dernière ligne de la bande (exclue)
+     * \~english \brief Compute lines of a band for an image and its mask
+     * \param[in] index image's index
+     * \param[in] first band's first line
+     * \param[in] last band's last line (excluded)
+     */
+    void computeImage ( int index, int first, int last );
+
+private:
+
+    /**
+     * \~french \brief Images sources, détruites avec l'objet
+     * \~english \brief Source images, deleted with the object
+     */
+    std::vector<Image*> images;
+
+    /**
+     * \~french \brief Pool de threads exécutant les calculs, partagé
+     * \~english \brief Threads pool running computations, shared
+     */
+    ThreadPool* pool;
+
+    /**
+     * \~french \brief Hauteur des bandes
+     * \~english \brief Bands' height
+     */
+    int bandHeight;
+
+    /**
+     * \~french \brief Indice de la bande calculée, -1 si aucune
+     * \~english \brief Computed band's index, -1 if none
+     */
+    int band;
+
+    /**
+     * \~french \brief Lignes de la bande calculée, par image
+     * \~english \brief Computed band's lines, by image
+     */
+    std::vector<uint8_t*> imageBuffers;
+
+    /**
+     * \~french \brief Lignes de masque de la bande calculée, par image (NULL si l'image n'a pas de masque)
+     * \~english \brief Computed band's mask lines, by image (NULL if image has no mask)
+     */
+    std::vector<uint8_t*> maskBuffers;
+
+    /**
+     * \~french \brief Type des lignes conservées, par image
+     * \~english \brief Kept lines' type, by image
+     */
+    std::vector<BandType> types;
+
+    /**
+     * \~french \brief Nombre de BandImage utilisant l'objet, qui est détruit par la dernière
+     * \~english \brief Number of BandImage using the object, which is deleted by the last one
+     */
+    int users;
+
+    /**
+     * \~french \brief Calcule une bande pour toutes les images
+     * \param[in] b indice de la bande
+     * \param[in] type type de la demande, utilisé pour les images dont le type n'est pas encore connu
+     * \~english \brief Compute a band for all images
+     * \param[in] b band's index
+     * \param[in] type request's type, used for images whose type is not known yet
+     */
+    void computeBand ( int b, BandType type );
+
+    /**
+     * \~french \brief Retourne une ligne d'une image ou de son masque, depuis la bande calculée
+     * \~english \brief Return a line of an image or of its mask, from computed band
+     */
+    template<typename T>
+    int getline ( int index, bool isMask, T* buffer, int line );
+
+    /**
+     * \~french \brief Crée l'objet, qui prend possession des images
+     * \~english \brief Create the object, which takes images' ownership
+     */
+    ConcurrentBands ( std::vector<Image*>& images, ThreadPool* pool );
+
+    /**
+     * \~french \brief Détruit les images sources et les bandes
+     * \~english \brief Delete source images and bands
+     */
+    ~ConcurrentBands();
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Image lue dans les bandes calculées simultanément
+ * \details Reprend les dimensions, le géoréférencement et le masque de son image source, dont les lignes sont calculées par un ConcurrentBands partagé avec les autres images. Elle est destinée à être l'entrée d'une MergeImage, qui lit la même ligne de toutes ses images.
+ * \~english
+ * \brief Image read from concurrently computed bands
+ * \details Copy dimensions, georeferencing and mask of its source image, whose lines are computed by a ConcurrentBands shared with other images. It is designed to be a MergeImage's input, which reads the same line of all its images.
+ */
+class BandImage : public Image {
+
+    friend class BandImageFactory;
+
+private:
+
+    /**
+     * \~french \brief Calcul partagé des bandes
+     * \~english \brief Shared bands computing
+     */
+    ConcurrentBands* bands;
+
+    /**
+     * \~french \brief Indice de l'image source dans bands
+     * \~english \brief Source image's index in bands
+     */
+    int index;
+
+    /**
+     * \~french \brief Lit-on le masque de l'image source
+     * \~english \brief Do we read source image's mask
+     */
+    bool sourceMask;
+
+    /**
+     * \~french \brief Crée une image lisant l'image (ou le masque) source d'indice index
+     * \~english \brief Create an image reading source image (or mask) with index index
+     */
+    BandImage ( ConcurrentBands* bands, int index, bool sourceMask );
+
+public:
+
+    virtual int getline ( uint8_t* buffer, int line );
+    virtual int getline ( uint16_t* buffer, int line );
+    virtual int getline ( float* buffer, int line );
+
+    /**
+     * \~french \brief Destructeur, le dernier utilisateur détruit le calcul partagé et les images sources
+     * \~english \brief Destructor, the last user deletes the shared computing and source images
+     */
+    virtual ~BandImage();
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french \brief Usine de création d'objets BandImage
+ * \~english \brief Factory to create BandImage objects
+ */
+class BandImageFactory {
+public:
+    /**
+     * \~french
+     * \brief Remplace des images par des BandImage calculées simultanément
+     * \details Les images doivent avoir les mêmes dimensions. Elles deviennent la propriété des BandImage, qui les remplacent dans le vecteur.
+     * \param[in,out] images images à calculer simultanément
+     * \param[in] pool pool de threads exécutant les calculs
+     * \return faux si les images ne peuvent pas être calculées ensemble (le vecteur est alors inchangé)
+     * \~english
+     * \brief Replace images by concurrently computed BandImage
+     * \details Images have to own the same dimensions. They become BandImage's property, which replace them in the vector.
+     * \param[in,out] images images to concurrently compute
+     * \param[in] pool threads pool running computations
+     * \return false if images cannot be computed together (vector is then unchanged)
+     */
+    bool createBandImages ( std::vector<Image*>& images, ThreadPool* pool );
+};
+
+#endif
@@ -35,43 +35,67 @@
  * knowledge of the CeCILL-C license and that you accept its terms.
  */
 
-#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
 
 #include "BilEncoder.h"
 #include "Logger.h"
 
+void BilEncoder::bufferLine() {
+    int width = image->getWidth();
+    int channels = image->getChannels();
+    if ( ! buffer_line ) buffer_line = new float[width * channels];
+
+    image->getline ( buffer_line, line++ );
+
+    // Seul le premier canal est diffusé
+    if ( channels > 1 ) {
+        for ( int i = 1; i < width; i++ ) buffer_line[i] = buffer_line[i * channels];
+    }
+    pending = width * sizeof ( float );
+}
+
 size_t BilEncoder::read ( uint8_t *buffer, size_t size ) {
     size_t offset = 0;
 
-    // Hypothese 1 : tous les bil produits sont en float
-    int linesize = image->getWidth() * image->getChannels() * sizeof ( float );
-
-    // Hypothese 2 : le pixel de l'image source est de type float
-    float* buf_f=new float[image->getWidth() *image->getChannels()];
-    for ( ; line < image->getHeight() && offset + linesize <= size; line++ ) {
+    // Hypothese : le pixel de l'image source est de type float
+    size_t linesize = image->getWidth() * sizeof ( float );
 
-        //	image->getline(buffer + offset, line);
-        image->getline ( buf_f,line );
+    // Fin d'une ligne entamée lors de la lecture précédente
+    if ( pending ) {
+        size_t n = std::min ( size, pending );
+        memcpy ( buffer, ( uint8_t* ) buffer_line + linesize - pending, n );
+        pending -= n;
+        offset += n;
+    }
 
-        // Hypothese 3 : image->getChannels()=1
-        // On n'utilise pas la fonction convert qui caste un float en uint8_t
-        // On copie simplement les octets des floats dans des uint8_t
-        for ( int i=0; i<image->getWidth(); i++ ) {
-            for ( int j=0; j<sizeof ( float ); j++ )
-                buffer[offset+sizeof ( float ) *i+j]=* ( ( uint8_t* ) ( &buf_f[i] ) +j );
+    // Les lignes entières sont lues directement dans le tampon du lecteur, sans copie,
+    // si l'écriture reste alignée sur des floats
+    if ( image->getChannels() == 1 && ( ( uintptr_t ) ( buffer + offset ) ) % sizeof ( float ) == 0 ) {
+        for ( ; line < image->getHeight() && offset + linesize <= size; line++ ) {
+            image->getline ( ( float* ) ( buffer + offset ), line );
+            offset += linesize;
         }
-        offset += linesize;
     }
 
-    delete[] buf_f;
+    // Ligne ne tenant pas entière dans la place restante (ou image multi-canaux)
+    while ( offset < size && line < image->getHeight() ) {
+        bufferLine();
+        size_t n = std::min ( size - offset, pending );
+        memcpy ( buffer + offset, buffer_line, n );
+        pending -= n;
+        offset += n;
+    }
 
     return offset;
 }
 
 BilEncoder::~BilEncoder() {
+    delete[] buffer_line;
     delete image;
 }
 
 bool BilEncoder::eof() {
-    return line >= image->getHeight();
+    return line >= image->getHeight() && pending == 0;
 }
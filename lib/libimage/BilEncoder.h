@@ -45,8 +45,25 @@ class BilEncoder : public DataStream {
     Image* image;
     int line;
 
+    /**
+     * \~french \brief Ligne en cours, lorsqu'elle ne tient pas entière dans le tampon du lecteur ou que l'image a plusieurs canaux
+     * \~english \brief Current line, when it does not fit in the reader's buffer or the image has several channels
+     */
+    float* buffer_line;
+    /**
+     * \~french \brief Nombre d'octets de buffer_line restant à écrire
+     * \~english \brief Bytes count of buffer_line still to write
+     */
+    size_t pending;
+
+    /**
+     * \~french \brief Lit la ligne suivante dans buffer_line, premier canal seulement
+     * \~english \brief Read next line into buffer_line, first channel only
+     */
+    void bufferLine();
+
 public:
-    BilEncoder ( Image* image ) : image ( image ), line ( 0 ) {}
+    BilEncoder ( Image* image ) : image ( image ), line ( 0 ), buffer_line ( NULL ), pending ( 0 ) {}
     ~BilEncoder();
     size_t read ( uint8_t *buffer, size_t size );
     int getHttpStatus() {
@@ -65,5 +82,3 @@ public:
 
 };
 #endif
-
-
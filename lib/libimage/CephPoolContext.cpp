@@ -49,6 +49,9 @@
 
 #include "CephPoolContext.h"
 #include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include "RequestTrace.h"
 
 CephPoolContext::CephPoolContext (std::string cluster, std::string user, std::string conf, std::string pool) : Context(), cluster_name(cluster), user_name(user), conf_file(conf), pool_name(pool) {
 }
@@ -122,7 +125,7 @@ bool CephPoolContext::connection() {
 
 int CephPoolContext::read(uint8_t* data, int offset, int size, std::string name) {
    
-    LOGGER_DEBUG("Ceph read : " << size << " bytes (from the " << offset << " one) in the object " << name);
+    LOGGER_DEBUG("Ceph read : " << size << " bytes (from the " << offset << " one) in the object " << name << " (request " << RequestTrace::getId() << ")");
 
     if (! connected) {
         LOGGER_ERROR("Try to read using the unconnected ceph pool context " << pool_name);
@@ -155,29 +158,223 @@ int CephPoolContext::read(uint8_t* data, int offset, int size, std::string name)
     }
 
     if (error) {
-        LOGGER_ERROR ( "Unable to read " << size << " bytes (from the " << offset << " one) in the object " << name  << " after " << attempt << " tries" );
+        LOGGER_ERROR ( "Unable to read " << size << " bytes (from the " << offset << " one) in the object " << name  << " after " << attempt << " tries (request " << RequestTrace::getId() << ")" );
     }
 
     return readSize;
 }
 
 
+/**
+ * \~french \brief Lot de lectures asynchrones, dont on attend la fin de toutes
+ * \~english \brief Batch of asynchronous readings, whose all ends are waited for
+ */
+struct CephReadBatch {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int remaining;
+};
+
+/**
+ * \~french \brief Fin d'une opération de lecture, appelée par un thread de librados
+ * \~english \brief Reading operation's end, called by a librados thread
+ */
+static void ceph_read_complete ( rados_completion_t c, void* arg ) {
+    CephReadBatch* batch = ( CephReadBatch* ) arg;
+    pthread_mutex_lock ( &batch->mutex );
+    batch->remaining--;
+    if ( batch->remaining == 0 ) pthread_cond_signal ( &batch->cond );
+    pthread_mutex_unlock ( &batch->mutex );
+}
+
+void CephPoolContext::readMulti(std::vector<ContextRead>& reads) {
+
+    if (! connected) {
+        LOGGER_ERROR("Try to read using the unconnected ceph pool context " << pool_name);
+        for (unsigned int i = 0; i < reads.size(); i++) reads.at(i).result = -1;
+        return;
+    }
+
+    // Regroupement des lectures par objet : une seule opération par objet, pour toutes ses lectures
+    std::map<std::string, std::vector<int> > readsByObject;
+    for (unsigned int i = 0; i < reads.size(); i++) {
+        readsByObject[reads.at(i).name].push_back(i);
+    }
+
+    int opsNumber = readsByObject.size();
+    LOGGER_DEBUG("Ceph grouped read : " << reads.size() << " readings in " << opsNumber << " objects (request " << RequestTrace::getId() << ")");
+
+    std::vector<rados_read_op_t> ops (opsNumber, (rados_read_op_t) NULL);
+    std::vector<rados_completion_t> completions (opsNumber, (rados_completion_t) NULL);
+    std::vector<size_t> bytesRead (reads.size(), 0);
+    std::vector<int> prvals (reads.size(), 0);
+
+    CephReadBatch batch;
+    pthread_mutex_init(&batch.mutex, NULL);
+    pthread_cond_init(&batch.cond, NULL);
+    batch.remaining = 0;
+
+    // Soumission de toutes les opérations, sans attendre
+    int op = 0;
+    std::map<std::string, std::vector<int> >::iterator it;
+    for (it = readsByObject.begin(); it != readsByObject.end(); ++it, ++op) {
+        ops[op] = rados_create_read_op();
+        for (unsigned int k = 0; k < it->second.size(); k++) {
+            int i = it->second.at(k);
+            rados_read_op_read(ops[op], reads.at(i).offset, reads.at(i).size, (char*) reads.at(i).data, &(bytesRead[i]), &(prvals[i]));
+        }
+
+        pthread_mutex_lock(&batch.mutex);
+        batch.remaining++;
+        pthread_mutex_unlock(&batch.mutex);
+
+        int err = rados_aio_create_completion((void*) &batch, ceph_read_complete, NULL, &(completions[op]));
+        if (err >= 0) {
+            err = rados_aio_read_op_operate(ops[op], io_ctx, completions[op], it->first.c_str(), 0);
+        }
+        if (err < 0) {
+            LOGGER_ERROR ( "Unable to submit the reading operation on the object " << it->first );
+            LOGGER_ERROR (strerror(-err));
+            pthread_mutex_lock(&batch.mutex);
+            batch.remaining--;
+            pthread_mutex_unlock(&batch.mutex);
+            for (unsigned int k = 0; k < it->second.size(); k++) prvals[it->second.at(k)] = err;
+            if (completions[op] != NULL) {
+                rados_aio_release(completions[op]);
+                completions[op] = NULL;
+            }
+        }
+    }
+
+    // Attente de la fin de toutes les opérations
+    pthread_mutex_lock(&batch.mutex);
+    while (batch.remaining > 0) {
+        pthread_cond_wait(&batch.cond, &batch.mutex);
+    }
+    pthread_mutex_unlock(&batch.mutex);
+
+    std::vector<int> retries;
+
+    op = 0;
+    for (it = readsByObject.begin(); it != readsByObject.end(); ++it, ++op) {
+        int ret = 0;
+        if (completions[op] != NULL) {
+            // La fonction de rappel doit être terminée avant de libérer le lot
+            rados_aio_wait_for_complete_and_cb(completions[op]);
+            ret = rados_aio_get_return_value(completions[op]);
+            rados_aio_release(completions[op]);
+        }
+        rados_release_read_op(ops[op]);
+
+        for (unsigned int k = 0; k < it->second.size(); k++) {
+            int i = it->second.at(k);
+            int result = (ret < 0) ? ret : ((prvals[i] < 0) ? prvals[i] : (int) bytesRead[i]);
+
+            if (result == -ETIMEDOUT && attempts > 1) {
+                // Le timeout donne lieu à de nouvelles tentatives, en lecture unitaire
+                LOGGER_WARN ( "Grouped reading timed out in the object " << it->first );
+                retries.push_back(i);
+            } else if (result < 0) {
+                LOGGER_ERROR ( "Unable to read " << reads.at(i).size << " bytes (from the " << reads.at(i).offset << " one) in the object " << it->first << " (request " << RequestTrace::getId() << ")" );
+                LOGGER_ERROR ("Error code: " << result );
+                LOGGER_ERROR (strerror(-result));
+            }
+
+            reads.at(i).result = result;
+        }
+    }
+
+    pthread_mutex_destroy(&batch.mutex);
+    pthread_cond_destroy(&batch.cond);
+
+    for (unsigned int r = 0; r < retries.size(); r++) {
+        ContextRead& cr = reads.at(retries.at(r));
+        cr.result = read(cr.data, cr.offset, cr.size, cr.name);
+    }
+}
+
+void CephPoolContext::removePartialObject(std::string name) {
+    LOGGER_DEBUG("Remove the partially written ceph object " << name);
+    int err = rados_remove(io_ctx, name.c_str());
+    if (err < 0 && err != -ENOENT) {
+        LOGGER_ERROR("Unable to remove the partially written ceph object " << name);
+        LOGGER_ERROR(strerror(-err));
+    }
+}
+
+bool CephPoolContext::writePart(std::string name, std::vector<char>* part, int64_t offset, bool full) {
+
+    LOGGER_DEBUG("Write " << part->size() << " bytes (from the " << offset << " one) in the ceph object " << name);
+
+    int tentative = 1;
+    while(tentative <= 10) {
+        int err;
+        if (full) {
+            err = rados_write_full(io_ctx,name.c_str(), part->empty() ? NULL : &((*part)[0]), part->size());
+        } else {
+            err = rados_write(io_ctx,name.c_str(), &((*part)[0]), part->size(), offset);
+        }
+        if (err < 0) {
+            LOGGER_WARN ( "Try " << tentative );
+            LOGGER_WARN ( "Unable to flush " << part->size() << " bytes (from the " << offset << " one) in the object " << name );
+            LOGGER_WARN (strerror(-err));
+        } else {
+            break;
+        }
+
+        tentative++;
+        sleep(60);
+    }
+
+    delete part;
+
+    if (tentative == 11) {
+        LOGGER_ERROR ( "Unable to write after 10 tries" );
+        return false;
+    }
+
+    return true;
+}
+
 bool CephPoolContext::write(uint8_t* data, int offset, int size, std::string name) {
     LOGGER_DEBUG("Ceph write : " << size << " bytes (from the " << offset << " one) in the writing buffer " << name);
 
-    std::map<std::string, std::vector<char>*>::iterator it1 = writingBuffers.find ( name );
-    if ( it1 == writingBuffers.end() ) {
+    std::map<std::string, PartedBuffer*>::iterator it1 = partedBuffers.find ( name );
+    if ( it1 == partedBuffers.end() ) {
         // pas de buffer pour ce nom d'objet
         LOGGER_ERROR("No writing buffer for the name " << name);
         return false;
     }
-   
-    // Calcul de la taille finale et redimensionnement éventuel du vector
-    if (it1->second->size() < size + offset) {
-        it1->second->resize(size + offset);
+
+    if (! it1->second->write(data, offset, size)) {
+        LOGGER_ERROR("Cannot write in the Ceph writing buffer " << name);
+        return false;
     }
 
-    memcpy(&((*(it1->second))[0]) + offset, data, size);
+    // Les parties complètes d'un nouvel objet sont écrites à leur place sans attendre sa fermeture
+    int index;
+    while ((index = it1->second->getCompletePart()) >= 0) {
+        std::map<std::string, bool>::iterator it2 = streamedObjects.find(name);
+        if (it2 == streamedObjects.end()) {
+            // Un objet existant n'est remplacé qu'à la fermeture, pour que ses lecteurs ne voient pas un objet partiel
+            uint64_t psize;
+            time_t pmtime;
+            int err = rados_stat(io_ctx, name.c_str(), &psize, &pmtime);
+            if (err < 0 && err != -ENOENT) {
+                LOGGER_ERROR("Unable to stat the ceph object " << name);
+                LOGGER_ERROR(strerror(-err));
+                return false;
+            }
+            it2 = streamedObjects.insert(std::pair<std::string, bool>(name, err == -ENOENT)).first;
+        }
+        if (! it2->second) {
+            break;
+        }
+        if (! writePart(name, it1->second->takePart(index), (int64_t) index * PARTED_BUFFER_PART_SIZE, false)) {
+            removePartialObject(name);
+            return false;
+        }
+    }
 
     return true;
 }
@@ -185,19 +382,18 @@ bool CephPoolContext::write(uint8_t* data, int offset, int size, std::string nam
 bool CephPoolContext::writeFull(uint8_t* data, int size, std::string name) {
     LOGGER_DEBUG("Ceph write : " << size << " bytes (one shot) in the writing buffer " << name);
 
-    std::map<std::string, std::vector<char>*>::iterator it1 = writingBuffers.find ( name );
-    if ( it1 == writingBuffers.end() ) {
+    std::map<std::string, PartedBuffer*>::iterator it1 = partedBuffers.find ( name );
+    if ( it1 == partedBuffers.end() ) {
         // pas de buffer pour ce nom d'objet
         LOGGER_ERROR("No Ceph writing buffer for the name " << name);
         return false;
     }
 
-    it1->second->clear();
-
-    it1->second->resize(size);
-    memcpy(&((*(it1->second))[0]), data, size);
+    if (! it1->second->reset()) {
+        return false;
+    }
 
-    return true;
+    return write(data, 0, size, name);
 }
 
 eContextType CephPoolContext::getType() {
@@ -214,13 +410,13 @@ std::string CephPoolContext::getTray() {
 
 bool CephPoolContext::openToWrite(std::string name) {
 
-    std::map<std::string, std::vector<char>*>::iterator it1 = writingBuffers.find ( name );
-    if ( it1 != writingBuffers.end() ) {
+    std::map<std::string, PartedBuffer*>::iterator it1 = partedBuffers.find ( name );
+    if ( it1 != partedBuffers.end() ) {
         LOGGER_ERROR("A Ceph writing buffer already exists for the name " << name);
         return false;
 
     } else {
-        writingBuffers.insert ( std::pair<std::string,std::vector<char>*>(name, new std::vector<char>()) );
+        partedBuffers.insert ( std::pair<std::string,PartedBuffer*>(name, new PartedBuffer()) );
     }
 
     return true;
@@ -229,39 +425,44 @@ bool CephPoolContext::openToWrite(std::string name) {
 
 bool CephPoolContext::closeToWrite(std::string name) {
 
-
-    std::map<std::string, std::vector<char>*>::iterator it1 = writingBuffers.find ( name );
-    if ( it1 == writingBuffers.end() ) {
+    std::map<std::string, PartedBuffer*>::iterator it1 = partedBuffers.find ( name );
+    if ( it1 == partedBuffers.end() ) {
         LOGGER_ERROR("The Ceph writing buffer with name " << name << "does not exist, cannot flush it");
         return false;
     }
 
+    PartedBuffer* buffer = it1->second;
+    partedBuffers.erase(it1);
+    streamedObjects.erase(name);
 
-    LOGGER_DEBUG("Write buffered " << it1->second->size() << " bytes in the ceph object " << name);
+    bool ok = true;
 
-    int tentative = 1;
-    while(tentative <= 10) {
-        int err = rados_write_full(io_ctx,name.c_str(), &((*(it1->second))[0]), it1->second->size());
-        if (err < 0) {
-            LOGGER_WARN ( "Try " << tentative );
-            LOGGER_WARN ( "Unable to flush " << it1->second->size() << " bytes in the object " << name );
-            LOGGER_WARN (strerror(-err));
+    if (! buffer->isStreamed() && buffer->getPartsNumber() <= 1) {
+        // Objet tenant dans une seule partie : écriture complète en une fois
+        LOGGER_DEBUG("Write buffered " << buffer->getLength() << " bytes in the ceph object " << name);
+        ok = writePart(name, (buffer->getPartsNumber() == 0) ? new std::vector<char>() : buffer->takePart(0), 0, true);
+
+    } else {
+        // Parties restantes : la première, où sont les en-têtes, et les dernières
+        LOGGER_DEBUG("Write the last parts of the ceph object " << name << " (" << buffer->getLength() << " bytes)");
+
+        if (! buffer->isStreamed()) {
+            ok = writePart(name, buffer->takePart(0), 0, true);
         } else {
-            break;
+            ok = writePart(name, buffer->takePart(0), 0, false);
+        }
+        while (ok && buffer->getNextPart() < buffer->getPartsNumber()) {
+            int index = buffer->getNextPart();
+            ok = writePart(name, buffer->takePart(index), (int64_t) index * PARTED_BUFFER_PART_SIZE, false);
         }
 
-        tentative++;
-        sleep(60);
+        if (! ok) {
+            removePartialObject(name);
+        }
     }
 
-    if (tentative == 11) {
-        LOGGER_ERROR ( "Unable to write after 10 tries" );
-        return false;
-    } else {
-        LOGGER_DEBUG("Erase the flushed buffer");
-        delete it1->second;
-        writingBuffers.erase(it1);
+    LOGGER_DEBUG("Erase the flushed buffer");
+    delete buffer;
 
-        return true;
-    }
+    return ok;
 }
@@ -53,6 +53,7 @@
 #include <rados/librados.h>
 #include "Logger.h"
 #include "Context.h"
+#include "PartedBuffer.h"
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -98,6 +99,42 @@ private:
      */
     rados_ioctx_t io_ctx;
 
+    /**
+     * \~french \brief Buffers d'écriture, selon le nom de l'objet
+     * \~english \brief Writing buffers, by object's name
+     */
+    std::map<std::string, PartedBuffer*> partedBuffers;
+
+    /**
+     * \~french \brief Les parties complètes sont-elles écrites sans attendre la fermeture, selon le nom de l'objet
+     * \details Décidé à la première partie complète : seul un objet qui n'existe pas encore est écrit au fil de l'eau. Un objet existant reste intact jusqu'à #closeToWrite.
+     * \~english \brief Are complete parts written without waiting for closing, by object's name
+     * \details Decided at the first complete part : only an object which does not exist yet is written on the fly. An existing object stays intact until #closeToWrite.
+     */
+    std::map<std::string, bool> streamedObjects;
+
+    /**
+     * \~french \brief Supprime un objet partiellement écrit, après un échec ou un abandon de l'écriture
+     * \~english \brief Remove a partially written object, after a writing failure or abandon
+     */
+    void removePartialObject(std::string name);
+
+    /**
+     * \~french
+     * \brief Écrit une partie dans un objet Ceph, puis la libère
+     * \param[in] name nom de l'objet
+     * \param[in] part partie à écrire
+     * \param[in] offset position de la partie dans l'objet
+     * \param[in] full la partie remplace-t-elle tout l'objet
+     * \~english
+     * \brief Write a part in a Ceph object, then release it
+     * \param[in] name object's name
+     * \param[in] part part to write
+     * \param[in] offset part's position in the object
+     * \param[in] full does the part replace the whole object
+     */
+    bool writePart(std::string name, std::vector<char>* part, int64_t offset, bool full);
+
 public:
 
     /**
@@ -196,17 +233,33 @@ public:
     
     int read(uint8_t* data, int offset, int size, std::string name);
 
+    /**
+     * \~french
+     * \brief Effectue un ensemble de lectures de manière asynchrone
+     * \details Les lectures d'un même objet sont regroupées dans une seule opération librados (rados_read_op), et les opérations de tous les objets sont soumises sans attendre (rados_aio_read_op_operate). On attend ensuite la fin de toutes les opérations, signalée par leurs fonctions de rappel. Les lectures ayant expiré sont retentées une à une avec #read.
+     * \~english
+     * \brief Process a set of readings asynchronously
+     * \details Readings in the same object are grouped in a single librados operation (rados_read_op), and operations for all objects are submitted without waiting (rados_aio_read_op_operate). Then we wait for all operations' end, signaled by their callbacks. Timed out readings are tried again one by one with #read.
+     */
+    void readMulti(std::vector<ContextRead>& reads);
+
     /**
      * \~french
      * \brief Écrit de la donnée dans un objet Ceph
-     * \details Les données sont en réalité écrites dans #writingBuffer et seront envoyées dans Ceph lors de l'appel à #closeToWrite
+     * \details Les données sont écrites dans un PartedBuffer. Si l'objet n'existe pas encore, dès qu'une partie est complète, elle est écrite à sa place dans l'objet Ceph. La première partie, où sont écrits les en-têtes, et la dernière sont écrites lors de l'appel à #closeToWrite. Un objet existant n'est pas remplacé au fil de l'eau : ses lecteurs le voient intact jusqu'à #closeToWrite, qui écrit alors toutes les parties (le remplacement n'est pas atomique au-delà d'une partie). Un objet tenant dans une seule partie est écrit en une fois, par #closeToWrite. En cas d'échec, l'objet partiellement écrit est supprimé.
+     * \~english
+     * \brief Write data in a Ceph object
+     * \details Data is written in a PartedBuffer. If the object does not exist yet, as soon as a part is complete, it is written at its place in the Ceph object. First part, where headers are written, and last one are written by #closeToWrite. An existing object is not replaced on the fly : its readers see it intact until #closeToWrite, which then writes all parts (replacement is not atomic beyond one part). An object fitting in a single part is written at once, by #closeToWrite. On failure, the partially written object is removed.
      */
     bool write(uint8_t* data, int offset, int size, std::string name);
 
     /**
      * \~french
      * \brief Écrit un objet Ceph
-     * \details Les données sont en réalité écrites dans #writingBuffer et seront envoyées dans Ceph lors de l'appel à #closeToWrite
+     * \details Le contenu précédent du buffer d'écriture est remplacé, puis écrit comme avec #write
+     * \~english
+     * \brief Write a Ceph object
+     * \details Previous writing buffer's content is replaced, then written like with #write
      */
     bool writeFull(uint8_t* data, int size, std::string name);
 
@@ -238,7 +291,18 @@ public:
         return oss.str() ;
     }
     
+    /**
+     * \~french \brief Destructeur
+     * \details Les écritures non terminées sont abandonnées : les objets déjà partiellement écrits sont supprimés
+     * \~english \brief Destructor
+     * \details Unfinished writings are abandoned : already partially written objects are removed
+     */
     virtual ~CephPoolContext() {
+        std::map<std::string, PartedBuffer*>::iterator it;
+        for (it = partedBuffers.begin(); it != partedBuffers.end(); ++it) {
+            if (it->second->isStreamed()) removePartialObject(it->first);
+            delete it->second;
+        }
         closeConnection();
     }
 };
@@ -49,6 +49,7 @@
 #define CONTEXT_H
 
 #include <map>
+#include <vector>
 #include <stdint.h>// pour uint8_t
 #include "Logger.h"
 #include <string.h>
@@ -65,6 +66,40 @@ enum eContextType {
     S3CONTEXT
 };
 
+/**
+ * \~french \brief Lecture élémentaire d'une lecture groupée
+ * \~english \brief Elementary read of a grouped reading
+ */
+struct ContextRead {
+    /**
+     * \~french \brief Buffer où stocker la donnée lue, d'au moins #size octets
+     * \~english \brief Buffer where to store read data, at least #size bytes
+     */
+    uint8_t* data;
+    /**
+     * \~french \brief À partir d'où on veut lire
+     * \~english \brief From where we want to read
+     */
+    int offset;
+    /**
+     * \~french \brief Nombre d'octet que l'on veut lire
+     * \~english \brief Number of bytes we want to read
+     */
+    int size;
+    /**
+     * \~french \brief Nom de l'objet que l'on veut lire
+     * \~english \brief Object's name we want to read
+     */
+    std::string name;
+    /**
+     * \~french \brief Taille effectivement lue, un nombre négatif en cas d'erreur
+     * \~english \brief Real size of read data, negative integer if an error occured
+     */
+    int result;
+
+    ContextRead ( uint8_t* d, int o, int s, std::string n ) : data ( d ), offset ( o ), size ( s ), name ( n ), result ( -1 ) {}
+};
+
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french
@@ -151,6 +186,20 @@ public:
      */
     virtual int read(uint8_t* data, int offset, int size, std::string name) = 0;
 
+    /**
+     * \~french \brief Effectue un ensemble de lectures
+     * \details Par défaut, les lectures sont faites une à une avec #read. Un contexte peut les soumettre simultanément au système de stockage.
+     * \param[in,out] reads Lectures à faire, dont le résultat est renseigné
+     * \~english \brief Process a set of readings
+     * \details By default, readings are done one by one with #read. A context can submit them simultaneously to the storage system.
+     * \param[in,out] reads Readings to do, whose result is filled
+     */
+    virtual void readMulti(std::vector<ContextRead>& reads) {
+        for (unsigned int i = 0; i < reads.size(); i++) {
+            reads.at(i).result = read(reads.at(i).data, reads.at(i).offset, reads.at(i).size, reads.at(i).name);
+        }
+    }
+
     /**
      * \~french \brief Écrit de la donnée dans l'objet
      * \param[in] data Buffer contenant la donnée à écrire
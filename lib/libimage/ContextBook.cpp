@@ -51,6 +51,7 @@
 
 ContextBook::ContextBook(eContextType type, std::string s1, std::string s2, std::string s3)
 {
+    pthread_mutex_init(&mutex, NULL);
     switch(type) {
         case CEPHCONTEXT : 
             contextType = CEPHCONTEXT;
@@ -82,10 +83,13 @@ ContextBook::ContextBook(eContextType type, std::string s1, std::string s2, std:
 Context * ContextBook::addContext(std::string tray, bool keystone)
 {
     Context* ctx;
+    pthread_mutex_lock(&mutex);
     std::map<std::string, Context*>::iterator it = book.find ( tray );
     if ( it != book.end() ) {
         //le contenant est déjà existant et donc connecté
-        return it->second;
+        ctx = it->second;
+        pthread_mutex_unlock(&mutex);
+        return ctx;
 
     } else {
         //ce contenant n'est pas encore connecté, on va créer la connexion
@@ -101,11 +105,13 @@ Context * ContextBook::addContext(std::string tray, bool keystone)
                 ctx = new SwiftContext(swift_auth, swift_user, swift_passwd, tray, keystone);
                 break;
             default :
+                pthread_mutex_unlock(&mutex);
                 return NULL;
         }
 
         //on ajoute au book
         book.insert ( std::pair<std::string,Context*>(tray,ctx) );
+        pthread_mutex_unlock(&mutex);
 
         return ctx;
     }
@@ -114,13 +120,17 @@ Context * ContextBook::addContext(std::string tray, bool keystone)
 
 Context * ContextBook::getContext(std::string tray)
 {
+    pthread_mutex_lock(&mutex);
     std::map<std::string, Context*>::iterator it = book.find ( tray );
     if ( it == book.end() ) {
+        pthread_mutex_unlock(&mutex);
         LOGGER_ERROR("Le contenant demandé n'a pas été trouvé dans l'annuaire.");
         return NULL;
     } else {
         //le contenant est déjà existant et donc connecté
-        return it->second;
+        Context* ctx = it->second;
+        pthread_mutex_unlock(&mutex);
+        return ctx;
     }
 
 }
@@ -132,6 +142,7 @@ ContextBook::~ContextBook()
         delete it->second;
         it->second = NULL;
     }
+    pthread_mutex_destroy(&mutex);
 }
 
 bool ContextBook::connectAllContext()
@@ -145,18 +156,6 @@ bool ContextBook::connectAllContext()
     return true;
 }
 
-bool ContextBook::reconnectAllContext()
-{
-    std::map<std::string,Context*>::iterator it;
-    for (it=book.begin(); it!=book.end(); ++it) {
-        it->second->closeConnection();
-        if (!(it->second->connection())) {
-            LOGGER_ERROR("Impossible de reconnecter un contexte");
-        }
-    }
-    return true;
-}
-
 void ContextBook::disconnectAllContext()
 {
     std::map<std::string,Context*>::iterator it;
@@ -51,6 +51,7 @@
 #define CONTEXTBOOK_H
 
 #include <map>
+#include <pthread.h>
 #include "Logger.h"
 #include "Context.h"
 #include "CephPoolContext.h"
@@ -69,6 +70,12 @@ private:
      */
     std::map<std::string, Context*> book;
 
+    /**
+     * \~french \brief Verrou protégeant l'annuaire, les pyramides pouvant être chargées en parallèle
+     * \~english \brief Book's lock, pyramids can be loaded in parallel
+     */
+    pthread_mutex_t mutex;
+
     /**
      * \~french \brief Précise le type des contextes de l'annuaire
      * \~english \brief Précise book type
@@ -196,14 +203,6 @@ public:
      */
     bool connectAllContext();
 
-    /**
-     * \~french
-     * \brief Reconnecte l'ensemble des contextes de l'annuaire
-     * \~english
-     * \brief Reconnect all contexts
-     */
-    bool reconnectAllContext();
-
     /**
      * \~french
      * \brief Deconnecte l'ensemble des contextes de l'annuaire
@@ -31,7 +31,7 @@ int ConvertedChannelsImage::getline ( uint8_t *buffer, int line ) {
 
     //on considère que channelsIn et channelsOut sont différents
     //Sinon cette classe n'a aucun intérêt
-    uint8_t *bufferIn = new uint8_t[channelsIn*width];
+    ArenaBuffer<uint8_t> bufferIn ( channelsIn*width );
 
     //on récupère les données sources
     int sizeIn = sourceImage->getline(bufferIn,line);
@@ -53,8 +53,6 @@ int ConvertedChannelsImage::getline ( uint8_t *buffer, int line ) {
                 k = k+2;
             }
 
-            //on nettoie
-            delete [] bufferIn;
             return channelsOut*width;
 
         }
@@ -72,8 +70,6 @@ int ConvertedChannelsImage::getline ( uint8_t *buffer, int line ) {
                 k = k+3;
             }
 
-            //on nettoie
-            delete [] bufferIn;
             return channelsOut*width;
 
         }
@@ -92,8 +88,6 @@ int ConvertedChannelsImage::getline ( uint8_t *buffer, int line ) {
                 k = k+4;
             }
 
-            //on nettoie
-            delete [] bufferIn;
             return channelsOut*width;
 
         }
@@ -114,8 +108,6 @@ int ConvertedChannelsImage::getline ( uint8_t *buffer, int line ) {
                 k++;
             }
 
-            //on nettoie
-            delete [] bufferIn;
             return channelsOut*width;
 
         }
@@ -133,8 +125,6 @@ int ConvertedChannelsImage::getline ( uint8_t *buffer, int line ) {
                 k=k+3;
             }
 
-            //on nettoie
-            delete [] bufferIn;
             return channelsOut*width;
 
         }
@@ -153,8 +143,6 @@ int ConvertedChannelsImage::getline ( uint8_t *buffer, int line ) {
                 k=k+4;
             }
 
-            //on nettoie
-            delete [] bufferIn;
             return channelsOut*width;
 
         }
@@ -174,8 +162,6 @@ int ConvertedChannelsImage::getline ( uint8_t *buffer, int line ) {
                 k++;
             }
 
-            //on nettoie
-            delete [] bufferIn;
             return channelsOut*width;
 
         }
@@ -192,8 +178,6 @@ int ConvertedChannelsImage::getline ( uint8_t *buffer, int line ) {
                 k = k+2;
             }
 
-            //on nettoie
-            delete [] bufferIn;
             return channelsOut*width;
 
         }
@@ -212,8 +196,6 @@ int ConvertedChannelsImage::getline ( uint8_t *buffer, int line ) {
                 k = k+4;
             }
 
-            //on nettoie
-            delete [] bufferIn;
             return channelsOut*width;
 
         }
@@ -234,8 +216,6 @@ int ConvertedChannelsImage::getline ( uint8_t *buffer, int line ) {
                 k++;
             }
 
-            //on nettoie
-            delete [] bufferIn;
             return channelsOut*width;
 
         }
@@ -252,8 +232,6 @@ int ConvertedChannelsImage::getline ( uint8_t *buffer, int line ) {
                 k = k+2;
             }
 
-            //on nettoie
-            delete [] bufferIn;
             return channelsOut*width;
 
 
@@ -273,8 +251,6 @@ int ConvertedChannelsImage::getline ( uint8_t *buffer, int line ) {
                 k++;
             }
 
-            //on nettoie
-            delete [] bufferIn;
             return channelsOut*width;
         }
     }
@@ -46,3 +46,5 @@
 #include "CurlPool.h"
 
 std::map<pthread_t, CURL*> CurlPool::pool;
+std::vector<CURL*> CurlPool::idle;
+pthread_mutex_t CurlPool::idleMutex = PTHREAD_MUTEX_INITIALIZER;
@@ -51,6 +51,8 @@
 #include <map>
 #include <string.h>
 #include <sstream>
+#include <vector>
+#include <pthread.h>
 #include <curl/curl.h>
 
 
@@ -72,6 +74,20 @@ private:
      */
     static std::map<pthread_t, CURL*> pool;
 
+    /**
+     * \~french \brief Objets curl libres, prêtés aux threads éphémères
+     * \details Un objet rendu garde ses connexions ouvertes : le prochain emprunteur vers le même serveur évite une nouvelle connexion TCP/TLS
+     * \~english \brief Free curl objects, lent to short-lived threads
+     * \details A returned object keeps its connections open : the next borrower to the same server avoids a new TCP/TLS connection
+     */
+    static std::vector<CURL*> idle;
+
+    /**
+     * \~french \brief Protège #idle
+     * \~english \brief Protect #idle
+     */
+    static pthread_mutex_t idleMutex;
+
     /**
      * \~french
      * \brief Constructeur
@@ -109,6 +125,34 @@ public:
         }
     }
 
+    /**
+     * \~french \brief Emprunte un objet curl libre, ou en crée un
+     * \details Pour les threads éphémères (envois de parties), qui ne peuvent pas garder un objet propre au thread
+     * \~english \brief Borrow a free curl object, or create one
+     * \details For short-lived threads (parts' uploads), which cannot keep an object specific to the thread
+     */
+    static CURL* borrowCurl() {
+        CURL* c = NULL;
+        pthread_mutex_lock ( &idleMutex );
+        if ( ! idle.empty() ) {
+            c = idle.back();
+            idle.pop_back();
+        }
+        pthread_mutex_unlock ( &idleMutex );
+        return ( c == NULL ) ? curl_easy_init() : c;
+    }
+
+    /**
+     * \~french \brief Rend un objet curl emprunté, remis à ses options par défaut
+     * \~english \brief Give back a borrowed curl object, reset to its default options
+     */
+    static void giveBackCurl ( CURL* c ) {
+        curl_easy_reset ( c );
+        pthread_mutex_lock ( &idleMutex );
+        idle.push_back ( c );
+        pthread_mutex_unlock ( &idleMutex );
+    }
+
     /**
      * \~french \brief Affiche le nombre d'objet curl dans l'annuaire
      * \~english \brief Print the number of curl objects in the book
@@ -118,8 +162,8 @@ public:
     }
 
     /**
-     * \~french \brief Nettoie tous les objets curl dans l'annuaire et le vide
-     * \~english \brief Clean all curl objects in the book and empty it
+     * \~french \brief Nettoie tous les objets curl dans l'annuaire et le vide, ainsi que les objets libres
+     * \~english \brief Clean all curl objects in the book and empty it, and free objects too
      */
     static void cleanCurlPool () {
         std::map<pthread_t, CURL*>::iterator it;
@@ -127,6 +171,13 @@ public:
             curl_easy_cleanup(it->second);
         }
         pool.clear();
+
+        pthread_mutex_lock ( &idleMutex );
+        for (unsigned int i = 0; i < idle.size(); i++) {
+            curl_easy_cleanup(idle.at(i));
+        }
+        idle.clear();
+        pthread_mutex_unlock ( &idleMutex );
     }
 
 };
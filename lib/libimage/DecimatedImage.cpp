@@ -81,10 +81,10 @@ int DecimatedImage::_getline ( T* buffer, int line ) {
         return width*channels;
     }
     
-    T* buffer_t = new T[sourceImage->getWidth() * sourceImage->getChannels()];
-    sourceImage->getline ( buffer_t, src_ligne );
+    ArenaBuffer<T> buffer_t ( sourceImage->getWidth() * sourceImage->getChannels() );
+    sourceImage->getline ( buffer_t.get(), src_ligne );
     
-    T* pix_src = buffer_t + sourceOffsetX * sourceImage->getChannels();
+    T* pix_src = buffer_t.get() + sourceOffsetX * sourceImage->getChannels();
     T* pix_dst = buffer + imageOffsetX * channels;
     
     if ( sourceImage->getMask() == NULL ) {
@@ -95,10 +95,10 @@ int DecimatedImage::_getline ( T* buffer, int line ) {
         }
     } else {
 
-        uint8_t* buffer_m = new uint8_t[sourceImage->getMask()->getWidth()];
-        sourceImage->getMask()->getline ( buffer_m, src_ligne );
+        ArenaBuffer<uint8_t> buffer_m ( sourceImage->getMask()->getWidth() );
+        sourceImage->getMask()->getline ( buffer_m.get(), src_ligne );
         
-        uint8_t* pix_src_mask = buffer_m + sourceOffsetX;
+        uint8_t* pix_src_mask = buffer_m.get() + sourceOffsetX;
         for (int i = 0; i < numberX; i++) {
             if (*pix_src_mask) {
                 memcpy(pix_dst, pix_src, channels*sizeof ( T ));
@@ -107,12 +107,8 @@ int DecimatedImage::_getline ( T* buffer, int line ) {
             pix_src_mask += ratioX;
             pix_dst += channels;
         }
-
-        delete [] buffer_m;
     }
     
-    delete [] buffer_t;
-    
     return width*channels;
 }
 
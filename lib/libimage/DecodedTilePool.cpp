@@ -0,0 +1,233 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+/**
+ * \file DecodedTilePool.cpp
+ ** \~french
+ * \brief Implémentation des classes DecodedTilePool et DecodedTileDataSource
+ ** \~english
+ * \brief Implements classes DecodedTilePool and DecodedTileDataSource
+ */
+
+#include "DecodedTilePool.h"
+#include "Logger.h"
+
+/**
+ * \~french \brief Durée de conservation d'une tuile en cache, en secondes
+ * \~english \brief Tile's caching duration, in seconds
+ */
+#define DECODED_TILE_TTL 60
+
+std::map<std::string, DecodedTilePool::DecodedTile*> DecodedTilePool::tiles;
+std::list<std::string> DecodedTilePool::lruList;
+size_t DecodedTilePool::maxSize = 0;
+size_t DecodedTilePool::currentSize = 0;
+uint64_t DecodedTilePool::hits = 0;
+uint64_t DecodedTilePool::misses = 0;
+pthread_mutex_t DecodedTilePool::mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void DecodedTilePool::destroy ( DecodedTile* dt ) {
+    delete dt->source;
+    delete dt;
+}
+
+void DecodedTilePool::detach ( std::map<std::string, DecodedTile*>::iterator it ) {
+    DecodedTile* dt = it->second;
+    lruList.erase ( dt->lru );
+    tiles.erase ( it );
+    currentSize -= dt->size;
+
+    if ( dt->users == 0 ) {
+        destroy ( dt );
+    } else {
+        // La dernière source libérera la tuile
+        dt->stale = true;
+    }
+}
+
+void DecodedTilePool::setMaxSize ( int megaBytes ) {
+    pthread_mutex_lock ( &mutex );
+    maxSize = ( megaBytes > 0 ) ? ( size_t ) megaBytes * 1024 * 1024 : 0;
+    while ( currentSize > maxSize ) {
+        detach ( tiles.find ( lruList.back() ) );
+    }
+    pthread_mutex_unlock ( &mutex );
+}
+
+DataSource* DecodedTilePool::get ( std::string key ) {
+
+    pthread_mutex_lock ( &mutex );
+
+    if ( maxSize == 0 ) {
+        pthread_mutex_unlock ( &mutex );
+        return NULL;
+    }
+
+    std::map<std::string, DecodedTile*>::iterator it = tiles.find ( key );
+    if ( it != tiles.end() && time ( NULL ) - it->second->creation > DECODED_TILE_TTL ) {
+        // La dalle a pu être réécrite depuis la mise en cache
+        detach ( it );
+        it = tiles.end();
+    }
+
+    if ( it == tiles.end() ) {
+        misses++;
+        pthread_mutex_unlock ( &mutex );
+        return NULL;
+    }
+
+    DecodedTile* dt = it->second;
+    dt->users++;
+    lruList.splice ( lruList.begin(), lruList, dt->lru );
+    hits++;
+    pthread_mutex_unlock ( &mutex );
+
+    return new DecodedTileDataSource ( key, dt );
+}
+
+DataSource* DecodedTilePool::wrap ( std::string key, DataSource* decoded ) {
+    if ( decoded == NULL || ! isEnabled() ) return decoded;
+    return new DecodedTileDataSource ( key, decoded );
+}
+
+DecodedTilePool::DecodedTile* DecodedTilePool::insert ( std::string key, DataSource* source, const uint8_t* data, size_t size ) {
+
+    pthread_mutex_lock ( &mutex );
+
+    if ( size > maxSize || tiles.find ( key ) != tiles.end() ) {
+        // Cache désactivé entre temps, tuile trop grande ou décodée en parallèle par un autre thread
+        pthread_mutex_unlock ( &mutex );
+        return NULL;
+    }
+
+    DecodedTile* dt = new DecodedTile();
+    dt->source = source;
+    dt->data = data;
+    dt->size = size;
+    dt->creation = time ( NULL );
+    dt->users = 1;
+    dt->stale = false;
+
+    lruList.push_front ( key );
+    dt->lru = lruList.begin();
+    tiles.insert ( std::pair<std::string, DecodedTile*> ( key, dt ) );
+    currentSize += size;
+
+    while ( currentSize > maxSize ) {
+        detach ( tiles.find ( lruList.back() ) );
+    }
+
+    pthread_mutex_unlock ( &mutex );
+
+    return dt;
+}
+
+void DecodedTilePool::release ( DecodedTile* dt ) {
+    pthread_mutex_lock ( &mutex );
+    dt->users--;
+    if ( dt->stale && dt->users == 0 ) {
+        destroy ( dt );
+    }
+    pthread_mutex_unlock ( &mutex );
+}
+
+uint64_t DecodedTilePool::getHits() {
+    pthread_mutex_lock ( &mutex );
+    uint64_t nb = hits;
+    pthread_mutex_unlock ( &mutex );
+    return nb;
+}
+
+uint64_t DecodedTilePool::getMisses() {
+    pthread_mutex_lock ( &mutex );
+    uint64_t nb = misses;
+    pthread_mutex_unlock ( &mutex );
+    return nb;
+}
+
+size_t DecodedTilePool::getSize() {
+    pthread_mutex_lock ( &mutex );
+    size_t size = currentSize;
+    pthread_mutex_unlock ( &mutex );
+    return size;
+}
+
+int DecodedTilePool::getNbTiles() {
+    pthread_mutex_lock ( &mutex );
+    int nb = tiles.size();
+    pthread_mutex_unlock ( &mutex );
+    return nb;
+}
+
+void DecodedTilePool::cleanDecodedTilePool () {
+    pthread_mutex_lock ( &mutex );
+    if ( hits + misses > 0 ) {
+        LOGGER_INFO ( "Cache des tuiles décodées : " << hits << " succès, " << misses << " échecs" );
+    }
+    while ( ! tiles.empty() ) {
+        detach ( tiles.begin() );
+    }
+    pthread_mutex_unlock ( &mutex );
+}
+
+const uint8_t* DecodedTileDataSource::getData ( size_t &size ) {
+    if ( tile ) {
+        size = tile->size;
+        return tile->data;
+    }
+
+    if ( source == NULL ) {
+        size = 0;
+        return NULL;
+    }
+
+    const uint8_t* data = source->getData ( size );
+    if ( data == NULL ) return NULL;
+    this->size = size;
+
+    tile = DecodedTilePool::insert ( key, source, data, size );
+    if ( tile ) {
+        // La donnée appartient désormais au cache
+        source = NULL;
+    }
+
+    return data;
+}
+
+DecodedTileDataSource::~DecodedTileDataSource() {
+    if ( tile ) DecodedTilePool::release ( tile );
+    if ( source ) delete source;
+}
@@ -0,0 +1,374 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+/**
+ * \file DecodedTilePool.h
+ ** \~french
+ * \brief Définition des classes DecodedTilePool et DecodedTileDataSource
+ ** \~english
+ * \brief Define classes DecodedTilePool and DecodedTileDataSource
+ */
+
+#ifndef DECODEDTILEPOOL_H
+#define DECODEDTILEPOOL_H
+
+#include <stdint.h>// pour uint8_t
+#include <pthread.h>
+#include <time.h>
+#include <map>
+#include <list>
+#include <string>
+#include "Data.h"
+
+class DecodedTileDataSource;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Cache des tuiles décodées
+ * \details Cette classe est prévue pour être utilisée sans instance. Elle est partagée par tous les threads du serveur, et conserve au plus #maxSize octets de tuiles décodées, les moins récemment utilisées étant libérées en premier. Une tuile est identifiée par une clé construite par le niveau (stockage, dalle et indice de la tuile dans la dalle).
+ *
+ * Les tuiles sont fournies sous forme de DecodedTileDataSource, qui lisent directement la donnée du cache, sans copie. Une tuile n'est libérée que lorsque plus aucune source ne la référence. Une tuile en cache depuis plus de #DECODED_TILE_TTL secondes est abandonnée, pour prendre en compte les dalles réécrites.
+ * \~english
+ * \brief Decoded tiles cache
+ * \details This class is designed to be used without instance. It is shared by all server's threads, and keeps at most #maxSize bytes of decoded tiles, least recently used being released first. A tile is identified by a key built by the level (storage, slab and tile's index in the slab).
+ *
+ * Tiles are provided as DecodedTileDataSource, reading cached data directly, without copy. A tile is released only when no source references it anymore. A tile cached for more than #DECODED_TILE_TTL seconds is dropped, to take rewritten slabs into account.
+ */
+class DecodedTilePool {
+
+    friend class DecodedTileDataSource;
+
+private:
+
+    /**
+     * \~french \brief Tuile décodée en cache
+     * \~english \brief Cached decoded tile
+     */
+    struct DecodedTile {
+        /**
+         * \~french \brief Source ayant décodé la tuile, propriétaire de la donnée
+         * \~english \brief Source which decoded the tile, data's owner
+         */
+        DataSource* source;
+        /**
+         * \~french \brief Donnée décodée
+         * \~english \brief Decoded data
+         */
+        const uint8_t* data;
+        /**
+         * \~french \brief Taille de la donnée décodée
+         * \~english \brief Decoded data's size
+         */
+        size_t size;
+        /**
+         * \~french \brief Date de mise en cache
+         * \~english \brief Caching date
+         */
+        time_t creation;
+        /**
+         * \~french \brief Nombre de sources référençant la tuile
+         * \~english \brief Number of sources referencing the tile
+         */
+        int users;
+        /**
+         * \~french \brief La tuile a été retirée du cache et doit être libérée par la dernière source
+         * \~english \brief Tile has been removed from the cache and have to be released by the last source
+         */
+        bool stale;
+        /**
+         * \~french \brief Position dans la liste LRU
+         * \~english \brief Position in the LRU list
+         */
+        std::list<std::string>::iterator lru;
+    };
+
+    /**
+     * \~french \brief Tuiles en cache, selon leur clé
+     * \~english \brief Cached tiles, by key
+     */
+    static std::map<std::string, DecodedTile*> tiles;
+
+    /**
+     * \~french \brief Clés des tuiles en cache, de la plus récemment utilisée à la plus ancienne
+     * \~english \brief Cached tiles' keys, from the most recently used to the oldest
+     */
+    static std::list<std::string> lruList;
+
+    /**
+     * \~french \brief Taille maximale du cache, en octets
+     * \details 0 : cache désactivé
+     * \~english \brief Cache's maximal size, in bytes
+     * \details 0 : cache disabled
+     */
+    static size_t maxSize;
+
+    /**
+     * \~french \brief Taille des tuiles en cache, en octets
+     * \~english \brief Cached tiles' size, in bytes
+     */
+    static size_t currentSize;
+
+    /**
+     * \~french \brief Nombre de tuiles trouvées dans le cache
+     * \~english \brief Number of tiles found in the cache
+     */
+    static uint64_t hits;
+
+    /**
+     * \~french \brief Nombre de tuiles absentes du cache
+     * \~english \brief Number of tiles missing from the cache
+     */
+    static uint64_t misses;
+
+    /**
+     * \~french \brief Verrou protégeant le cache
+     * \~english \brief Mutex protecting the cache
+     */
+    static pthread_mutex_t mutex;
+
+    /**
+     * \~french \brief Retire une tuile du cache
+     * \details La tuile est libérée immédiatement si elle n'est pas référencée, sinon par la dernière source. Le verrou doit être détenu.
+     * \~english \brief Remove a tile from the cache
+     * \details Tile is released immediately if it's not referenced, otherwise by the last source. Mutex have to be held.
+     */
+    static void detach ( std::map<std::string, DecodedTile*>::iterator it );
+
+    /**
+     * \~french \brief Libère une tuile et la source propriétaire de sa donnée
+     * \~english \brief Release a tile and the source owning its data
+     */
+    static void destroy ( DecodedTile* dt );
+
+    /**
+     * \~french \brief Met en cache une tuile qui vient d'être décodée
+     * \details En cas de succès, le cache devient propriétaire de la source et la tuile est référencée une fois.
+     * \param[in] key clé de la tuile
+     * \param[in] source source ayant décodé la tuile
+     * \param[in] data donnée décodée, appartenant à la source
+     * \param[in] size taille de la donnée décodée
+     * \return la tuile en cache, NULL si elle n'a pas été mise en cache (cache désactivé, tuile trop grande ou déjà présente)
+     * \~english \brief Cache a freshly decoded tile
+     * \details If success, cache becomes the source's owner and tile is referenced once.
+     * \param[in] key tile's key
+     * \param[in] source source which decoded the tile
+     * \param[in] data decoded data, owned by the source
+     * \param[in] size decoded data's size
+     * \return cached tile, NULL if not cached (disabled cache, too big or already present tile)
+     */
+    static DecodedTile* insert ( std::string key, DataSource* source, const uint8_t* data, size_t size );
+
+    /**
+     * \~french \brief Déréférence une tuile
+     * \~english \brief Dereference a tile
+     */
+    static void release ( DecodedTile* dt );
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \~english
+     * \brief Constructeur
+     */
+    DecodedTilePool(){};
+
+public:
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \~english
+     * \brief Destructor
+     */
+    ~DecodedTilePool(){};
+
+    /**
+     * \~french \brief Précise la taille maximale du cache, en mégaoctets
+     * \details 0 désactive le cache et libère les tuiles déjà en cache
+     * \~english \brief Set the cache's maximal size, in megabytes
+     * \details 0 disables the cache and releases already cached tiles
+     */
+    static void setMaxSize ( int megaBytes );
+
+    /**
+     * \~french \brief Le cache est-il activé
+     * \~english \brief Is cache enabled
+     */
+    static bool isEnabled() {
+        return ( maxSize > 0 );
+    }
+
+    /**
+     * \~french \brief Récupère une tuile dans le cache
+     * \param[in] key clé de la tuile
+     * \return une source lisant la tuile en cache, NULL si la tuile n'est pas en cache
+     * \~english \brief Get a tile from the cache
+     * \param[in] key tile's key
+     * \return a source reading the cached tile, NULL if tile is not cached
+     */
+    static DataSource* get ( std::string key );
+
+    /**
+     * \~french \brief Encapsule une source décodant une tuile absente du cache
+     * \details La tuile sera mise en cache lors de son décodage. Si le cache est désactivé, la source est retournée telle quelle.
+     * \param[in] key clé de la tuile
+     * \param[in] decoded source décodant la tuile, dont on prend la propriété
+     * \~english \brief Wrap a source decoding a tile missing from the cache
+     * \details Tile will be cached when decoded. If cache is disabled, source is returned as is.
+     * \param[in] key tile's key
+     * \param[in] decoded source decoding the tile, we take ownership
+     */
+    static DataSource* wrap ( std::string key, DataSource* decoded );
+
+    /**
+     * \~french \brief Retourne le nombre de tuiles trouvées dans le cache depuis le démarrage
+     * \~english \brief Return the number of tiles found in the cache since startup
+     */
+    static uint64_t getHits();
+
+    /**
+     * \~french \brief Retourne le nombre de tuiles absentes du cache depuis le démarrage
+     * \~english \brief Return the number of tiles missing from the cache since startup
+     */
+    static uint64_t getMisses();
+
+    /**
+     * \~french \brief Retourne la taille des tuiles en cache, en octets
+     * \~english \brief Return cached tiles' size, in bytes
+     */
+    static size_t getSize();
+
+    /**
+     * \~french \brief Retourne le nombre de tuiles en cache
+     * \~english \brief Return the number of cached tiles
+     */
+    static int getNbTiles();
+
+    /**
+     * \~french \brief Libère toutes les tuiles et vide le cache
+     * \~english \brief Release all tiles and empty the cache
+     */
+    static void cleanDecodedTilePool ();
+
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Source de données d'une tuile décodée, partagée via le cache
+ * \details La source lit soit une tuile déjà en cache, soit décode la tuile avec la source encapsulée et la met en cache à la première lecture.
+ * \~english
+ * \brief Decoded tile data source, shared through the cache
+ * \details Source reads either an already cached tile, or decodes the tile with the wrapped source and caches it at first reading.
+ */
+class DecodedTileDataSource : public DataSource {
+
+    friend class DecodedTilePool;
+
+private:
+
+    /**
+     * \~french \brief Clé de la tuile
+     * \~english \brief Tile's key
+     */
+    std::string key;
+
+    /**
+     * \~french \brief Source décodant la tuile, tant qu'elle n'est pas confiée au cache
+     * \~english \brief Source decoding the tile, as long as it's not given to the cache
+     */
+    DataSource* source;
+
+    /**
+     * \~french \brief Tuile en cache référencée
+     * \~english \brief Referenced cached tile
+     */
+    DecodedTilePool::DecodedTile* tile;
+
+    /**
+     * \~french \brief Taille de la donnée décodée
+     * \~english \brief Decoded data's size
+     */
+    size_t size;
+
+    /**
+     * \~french \brief Constructeur pour une tuile en cache, déjà référencée
+     * \~english \brief Constructor for a cached tile, already referenced
+     */
+    DecodedTileDataSource ( std::string key, DecodedTilePool::DecodedTile* tile ) : key ( key ), source ( NULL ), tile ( tile ), size ( tile->size ) {}
+
+    /**
+     * \~french \brief Constructeur pour une tuile à décoder
+     * \~english \brief Constructor for a tile to decode
+     */
+    DecodedTileDataSource ( std::string key, DataSource* source ) : key ( key ), source ( source ), tile ( NULL ), size ( 0 ) {}
+
+public:
+
+    const uint8_t* getData ( size_t &size );
+
+    bool releaseData() {
+        // Une tuile en cache n'est libérée qu'à la destruction de la source
+        if ( source ) source->releaseData();
+        return true;
+    }
+
+    std::string getType() {
+        return "image/bil";
+    }
+    int getHttpStatus() {
+        return 200;
+    }
+    std::string getEncoding() {
+        return "";
+    }
+    unsigned int getLength() {
+        return size;
+    }
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \details La tuile en cache est déréférencée
+     * \~english
+     * \brief Destructor
+     * \details Cached tile is dereferenced
+     */
+    ~DecodedTileDataSource();
+};
+
+#endif
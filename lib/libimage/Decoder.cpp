@@ -312,9 +312,9 @@ const uint8_t* LzwDecoder::decode ( DataSource* source, size_t& size ) {
 
 
 /**
- * Decodage de donnee DEFLATE
+ * Decompression zlib (windowBits = MAX_WBITS) ou gzip (windowBits = MAX_WBITS + 16)
  */
-const uint8_t* DeflateDecoder::decode ( DataSource* source, size_t &size ) {
+static const uint8_t* inflateSource ( DataSource* source, size_t &size, int windowBits ) {
 
     size = 0;
     if ( !source ) return 0;
@@ -331,7 +331,7 @@ const uint8_t* DeflateDecoder::decode ( DataSource* source, size_t &size ) {
     zstream.opaque = Z_NULL;
     zstream.data_type = Z_BINARY;
     int zinit;
-    if ( ( zinit=inflateInit ( &zstream ) ) != Z_OK ) {
+    if ( ( zinit=inflateInit2 ( &zstream, windowBits ) ) != Z_OK ) {
         if ( zinit==Z_MEM_ERROR )
             LOGGER_ERROR ( "Decompression DEFLATE : pas assez de memoire" );
         else if ( zinit==Z_VERSION_ERROR )
@@ -384,33 +384,47 @@ const uint8_t* DeflateDecoder::decode ( DataSource* source, size_t &size ) {
     return raw_data;
 }
 
+/**
+ * Decodage de donnee DEFLATE
+ */
+const uint8_t* DeflateDecoder::decode ( DataSource* source, size_t &size ) {
+    return inflateSource ( source, size, MAX_WBITS );
+}
+
+/**
+ * Decodage de donnee GZIP
+ */
+const uint8_t* GzipDecoder::decode ( DataSource* source, size_t &size ) {
+    return inflateSource ( source, size, MAX_WBITS + 16 );
+}
+
 
-int ImageDecoder::getDataline ( uint8_t* buffer, int line ) {
-    convert ( buffer, rawData + ( ( margin_top + line ) * source_width + margin_left ) * channels, width * channels );
-    return width * channels;
+int ImageDecoder::getDataline ( uint8_t* buffer, int line, int x, int w ) {
+    convert ( buffer, rawData + ( ( margin_top + line ) * source_width + margin_left + x ) * channels, w * channels );
+    return w * channels;
 }
 
-int ImageDecoder::getDataline ( uint16_t* buffer, int line ) {
+int ImageDecoder::getDataline ( uint16_t* buffer, int line, int x, int w ) {
     if ( channel_size==1 )
         // Conversion uint8 -> uintt16
-        convert ( buffer, rawData + ( ( margin_top + line ) * source_width + margin_left ) * channels, width * channels );
+        convert ( buffer, rawData + ( ( margin_top + line ) * source_width + margin_left + x ) * channels, w * channels );
     else if ( channel_size==2 )
         // Donnée demandée dans le format d'origine
-        memcpy ( buffer,rawData + ( ( margin_top + line ) * source_width + margin_left ) * channels*sizeof ( uint16_t ),width * channels*sizeof ( uint16_t ) );
+        memcpy ( buffer,rawData + ( ( margin_top + line ) * source_width + margin_left + x ) * channels*sizeof ( uint16_t ),w * channels*sizeof ( uint16_t ) );
 
-    return width * channels;
+    return w * channels;
 }
 
-int ImageDecoder::getDataline ( float* buffer, int line ) {
+int ImageDecoder::getDataline ( float* buffer, int line, int x, int w ) {
     if ( channel_size==1 )
         // Conversion uint8 -> float
-        convert ( buffer, rawData + ( ( margin_top + line ) * source_width + margin_left ) * channels, width * channels );
+        convert ( buffer, rawData + ( ( margin_top + line ) * source_width + margin_left + x ) * channels, w * channels );
     else if ( channel_size==2 )
         // Conversion uint16 -> float
-        convert ( buffer, rawData + ( ( margin_top + line ) * source_width + margin_left ) * channels*sizeof ( uint16_t ), width * channels );
+        convert ( buffer, rawData + ( ( margin_top + line ) * source_width + margin_left + x ) * channels*sizeof ( uint16_t ), w * channels );
     else if ( channel_size==4 )
         // Donnée demandée dans le format d'origine
-        memcpy ( buffer,rawData + ( ( margin_top + line ) * source_width + margin_left ) * channels*sizeof ( float ),width * channels*sizeof ( float ) );
+        memcpy ( buffer,rawData + ( ( margin_top + line ) * source_width + margin_left + x ) * channels*sizeof ( float ),w * channels*sizeof ( float ) );
 
-    return width * channels;
+    return w * channels;
 }
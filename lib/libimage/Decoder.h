@@ -45,25 +45,49 @@
 #include "Data.h"
 #include "Image.h"
 #include "Utils.h"
+#include "Metrics.h"
+#include "RequestTrace.h"
 
 struct JpegDecoder {
     static const uint8_t* decode ( DataSource* encData, size_t &size );
+    static const char* getName() {
+        return "jpeg";
+    }
 };
 
 struct PngDecoder {
     static const uint8_t* decode ( DataSource* encData, size_t &size );
+    static const char* getName() {
+        return "png";
+    }
 };
 
 struct LzwDecoder {
     static const uint8_t* decode ( DataSource* encData, size_t &size );
+    static const char* getName() {
+        return "lzw";
+    }
 };
 
 struct DeflateDecoder {
     static const uint8_t* decode ( DataSource* encData, size_t &size );
+    static const char* getName() {
+        return "deflate";
+    }
+};
+
+struct GzipDecoder {
+    static const uint8_t* decode ( DataSource* encData, size_t &size );
+    static const char* getName() {
+        return "gzip";
+    }
 };
 
 struct PackBitsDecoder {
     static const uint8_t* decode ( DataSource* encData, size_t &size );
+    static const char* getName() {
+        return "packbits";
+    }
 };
 
 struct InvalidDecoder {
@@ -71,6 +95,9 @@ struct InvalidDecoder {
         size = 0;
         return 0;
     }
+    static const char* getName() {
+        return "invalid";
+    }
 };
 
 
@@ -85,8 +112,11 @@ private:
     DataSource* encData;
     const uint8_t* decData;
     size_t decSize;
+    // Type des données décodées : les tuiles d'image sont décodées en pixels bruts, les données
+    // simplement compressées (PBF en gzip...) gardent leur type
+    std::string type;
 public:
-    DataSourceDecoder ( DataSource* encData ) : encData ( encData ), decData ( 0 ), decSize ( 0 ) {}
+    DataSourceDecoder ( DataSource* encData, std::string type = "image/bil" ) : encData ( encData ), decData ( 0 ), decSize ( 0 ), type ( type ) {}
 
     ~DataSourceDecoder() {
         if ( decData )
@@ -96,7 +126,11 @@ public:
 
     const uint8_t* getData ( size_t &size ) {
         if ( !decData && encData ) {
+            static MetricHistogram* decodeTime = Metrics::getHistogram ( "rok4_decode_seconds", "Durée de décodage des tuiles", Metrics::label ( "format", Decoder::getName() ) );
+            TraceScope scope ( TraceStage::DECODE );
+            double start = Metrics::now();
             decData = Decoder::decode ( encData, decSize );
+            decodeTime->observe ( Metrics::now() - start );
             if ( !decData ) {
                 delete encData;
                 encData = 0;
@@ -114,7 +148,7 @@ public:
     }
 
     std::string getType() {
-        return "image/bil";
+        return type;
     }
     int getHttpStatus() {
         return 200;
@@ -145,35 +179,55 @@ private:
     // La donnee brute (source) est de type uint8_t
     const uint8_t* rawData;
 
-    int getDataline ( uint8_t* buffer, int line );
+    int getDataline ( uint8_t* buffer, int line, int x, int w );
 
-    int getDataline ( uint16_t* buffer, int line );
+    int getDataline ( uint16_t* buffer, int line, int x, int w );
 
-    int getDataline ( float* buffer, int line );
+    int getDataline ( float* buffer, int line, int x, int w );
 
-    template<typename T> inline int getNoDataline ( T* buffer, int line ) {
-        memset ( buffer, 0, width * channels * sizeof ( T ) );
-        return width * channels;
+    template<typename T> inline int getNoDataline ( T* buffer, int w ) {
+        memset ( buffer, 0, w * channels * sizeof ( T ) );
+        return w * channels;
     }
 
-    // TODO : a deplacer dans le cpp (je n'y suis pas arrive a cause d un probleme de compilation lie au template)
-    template<typename T>
-    inline int _getline ( T* buffer, int line ) {
-
-        if ( rawData ) { // Est ce que l'on a de la donnee
-            return getDataline ( buffer, line );
-            // TODO: libérer le dataSource lorsque l'on lit la dernière ligne de l'image...
-        } else if ( dataSource ) { // Non alors on essaye de la l'initialiser depuis dataSource
+    /* Initialise la donnee brute depuis dataSource si ce n'est pas deja fait. Retourne faux si on n'a pas de donnee */
+    inline bool loadData() {
+        if ( rawData ) return true;
+        if ( dataSource ) {
             size_t size;
             if ( rawData = dataSource->getData ( size ) ) {
-                return getDataline ( buffer, line );
+                return true;
             } else {
                 delete dataSource;
                 dataSource = 0;
             }
         }
         //LOGGER_DEBUG("Decoding error, fill with black");
-        return getNoDataline ( buffer, line );
+        return false;
+    }
+
+    // TODO : a deplacer dans le cpp (je n'y suis pas arrive a cause d un probleme de compilation lie au template)
+    template<typename T>
+    inline int _getline ( T* buffer, int line ) {
+
+        if ( loadData() ) { // Est ce que l'on a de la donnee
+            return getDataline ( buffer, line, 0, width );
+            // TODO: libérer le dataSource lorsque l'on lit la dernière ligne de l'image...
+        }
+        return getNoDataline ( buffer, width );
+    }
+
+    /* Le bloc est lu directement dans la donnee brute, sans passer par des lignes entieres */
+    template<typename T>
+    inline int _getDecodedBlock ( T* buffer, int x, int y, int w, int h ) {
+        if ( ! blockIsValid ( x, y, w, h ) ) return 0;
+
+        bool data = loadData();
+        for ( int l = 0; l < h; l++ ) {
+            if ( data ) getDataline ( buffer + l * w * channels, y + l, x, w );
+            else getNoDataline ( buffer + l * w * channels, w );
+        }
+        return w * h * channels * sizeof ( T );
     }
 
 public:
@@ -200,6 +254,16 @@ public:
         return _getline ( buffer, line );
     }
 
+    inline int getBlock ( uint8_t* buffer, int x, int y, int w, int h ) {
+        return _getDecodedBlock ( buffer, x, y, w, h );
+    }
+    inline int getBlock ( uint16_t* buffer, int x, int y, int w, int h ) {
+        return _getDecodedBlock ( buffer, x, y, w, h );
+    }
+    inline int getBlock ( float* buffer, int x, int y, int w, int h ) {
+        return _getDecodedBlock ( buffer, x, y, w, h );
+    }
+
     ~ImageDecoder() {
         if ( dataSource ) {
             dataSource->releaseData();
@@ -38,6 +38,7 @@
 #include "EstompageImage.h"
 
 #include "Logger.h"
+#include "RequestTrace.h"
 
 #include "Utils.h"
 #include <cstring>
@@ -111,6 +112,7 @@ int EstompageImage::getOrigLine ( float* buffer, int line ) {
 
 
 void EstompageImage::generate() {
+    TraceScope scope ( TraceStage::STYLE );
     estompage = new uint8_t[width * height];
     bufferTmp = new float[origImage->getWidth() * 3];
     float* lineBuffer[3];
@@ -55,6 +55,7 @@
 #include "Logger.h"
 #include "Utils.h"
 #include "EmptyImage.h"
+#include <algorithm>
 
 /********************************************** ExtendedCompoundImage ************************************************/
 
@@ -67,7 +68,12 @@ int ExtendedCompoundImage::_getline ( T* buffer, int line ) {
         buffer[i]= ( T ) nodata[i%channels];
     }
 
-    for ( i = 0; i < ( int ) sourceImages.size(); i++ ) {
+    // On ne parcourt que les images sources de la bande de lignes concernée
+    std::vector<int>& lineSources = getLineSources ( line );
+
+    for ( unsigned int k = 0; k < lineSources.size(); k++ ) {
+
+        i = lineSources[k];
         
         int lineInSource = line - rowsOffsets[i];
         
@@ -90,7 +96,13 @@ int ExtendedCompoundImage::_getline ( T* buffer, int line ) {
         // c2 : indice de de la 1ere colonne de l'ExtendedCompoundImage dans l'image courante
         int c2 = c2s[i];
 
-        T* buffer_t = new T[sourceImages[i]->getWidth() * sourceImages[i]->getChannels()];
+        if ( getMask ( i ) == NULL && c2 == 0 && sourceImages[i]->getWidth() == c1 + 1 - c0 ) {
+            // L'image source tient entièrement dans la ligne : on la lit directement à sa place
+            sourceImages[i]->getline ( &buffer[c0*channels], lineInSource );
+            continue;
+        }
+
+        T* buffer_t = ( T* ) sourceLine;
 
         sourceImages[i]->getline ( buffer_t,lineInSource );
 
@@ -98,7 +110,7 @@ int ExtendedCompoundImage::_getline ( T* buffer, int line ) {
             memcpy ( &buffer[c0*channels], &buffer_t[c2*channels], ( c1 + 1 - c0) *channels*sizeof ( T ) );
         } else {
 
-            uint8_t* buffer_m = new uint8_t[getMask ( i )->getWidth()];
+            uint8_t* buffer_m = sourceMaskLine;
             getMask ( i )->getline ( buffer_m,lineInSource );
 
             for ( int j=0; j < c1 - c0 + 1; j++ ) {
@@ -106,10 +118,7 @@ int ExtendedCompoundImage::_getline ( T* buffer, int line ) {
                     memcpy ( &buffer[ ( c0 + j ) *channels],&buffer_t[ ( c2+j ) *channels],sizeof ( T ) *channels );
                 }
             }
-
-            delete [] buffer_m;
         }
-        delete [] buffer_t;
     }
     return width*channels*sizeof ( T );
 }
@@ -130,6 +139,97 @@ int ExtendedCompoundImage::getline ( float* buffer, int line ) {
     return _getline ( buffer, line );
 }
 
+template <typename T>
+int ExtendedCompoundImage::_getCompoundBlock ( T* buffer, int x, int y, int w, int h ) {
+
+    if ( ! blockIsValid ( x, y, w, h ) ) return 0;
+
+    // Initialisation de tous les pixels du bloc avec la valeur de nodata
+    for ( int i = 0; i < w*h*channels; i++ ) {
+        buffer[i]= ( T ) nodata[i%channels];
+    }
+
+    // Images sources des bandes de lignes concernées, dans l'ordre de superposition
+    std::vector<int> blockSources;
+    for ( int l = y; l < y + h; l = ( l / ECI_INDEX_ROWS + 1 ) * ECI_INDEX_ROWS ) {
+        std::vector<int>& lineSources = getLineSources ( l );
+        blockSources.insert ( blockSources.end(), lineSources.begin(), lineSources.end() );
+    }
+    std::sort ( blockSources.begin(), blockSources.end() );
+    blockSources.erase ( std::unique ( blockSources.begin(), blockSources.end() ), blockSources.end() );
+
+    T* buffer_t = NULL;
+    uint8_t* buffer_m = NULL;
+
+    for ( unsigned int k = 0; k < blockSources.size(); k++ ) {
+        int i = blockSources[k];
+
+        if ( sourceImages[i]->getXmin() >= getXmax() || sourceImages[i]->getXmax() <= getXmin() ) {
+            continue;
+        }
+
+        // Partie commune du bloc et de l'image source, dans l'image composée
+        int l0 = __max ( y, rowsOffsets[i] );
+        int l1 = __min ( y + h, rowsOffsets[i] + sourceImages[i]->getHeight() );
+        int c0 = __max ( x, c0s[i] );
+        int c1 = __min ( x + w - 1, c1s[i] );
+        if ( l0 >= l1 || c0 > c1 ) continue;
+
+        // Même partie, dans l'image source
+        int sx = c2s[i] + c0 - c0s[i];
+        int sy = l0 - rowsOffsets[i];
+        int bw = c1 - c0 + 1;
+        int bh = l1 - l0;
+
+        if ( getMask ( i ) == NULL && c0 == x && bw == w ) {
+            // Toute la largeur du bloc : on lit directement à sa place
+            sourceImages[i]->getBlock ( &buffer[( l0 - y ) * w * channels], sx, sy, bw, bh );
+            continue;
+        }
+
+        if ( buffer_t == NULL ) buffer_t = new T[w*h*channels];
+        sourceImages[i]->getBlock ( buffer_t, sx, sy, bw, bh );
+
+        if ( getMask ( i ) == NULL ) {
+            for ( int l = 0; l < bh; l++ ) {
+                memcpy ( &buffer[ ( ( l0 - y + l ) * w + c0 - x ) * channels], &buffer_t[l * bw * channels], bw * channels * sizeof ( T ) );
+            }
+        } else {
+            if ( buffer_m == NULL ) buffer_m = new uint8_t[w*h];
+            getMask ( i )->getBlock ( buffer_m, sx, sy, bw, bh );
+
+            for ( int l = 0; l < bh; l++ ) {
+                T* dst = &buffer[ ( ( l0 - y + l ) * w + c0 - x ) * channels];
+                for ( int j = 0; j < bw; j++ ) {
+                    if ( buffer_m[l * bw + j] ) {
+                        memcpy ( &dst[j * channels], &buffer_t[ ( l * bw + j ) * channels], sizeof ( T ) * channels );
+                    }
+                }
+            }
+        }
+    }
+
+    delete [] buffer_t;
+    delete [] buffer_m;
+
+    return w*h*channels*sizeof ( T );
+}
+
+/* Implementation de getBlock pour les uint8_t */
+int ExtendedCompoundImage::getBlock ( uint8_t* buffer, int x, int y, int w, int h ) {
+    return _getCompoundBlock ( buffer, x, y, w, h );
+}
+
+/* Implementation de getBlock pour les uint16_t */
+int ExtendedCompoundImage::getBlock ( uint16_t* buffer, int x, int y, int w, int h ) {
+    return _getCompoundBlock ( buffer, x, y, w, h );
+}
+
+/* Implementation de getBlock pour les float */
+int ExtendedCompoundImage::getBlock ( float* buffer, int x, int y, int w, int h ) {
+    return _getCompoundBlock ( buffer, x, y, w, h );
+}
+
 bool ExtendedCompoundImage::addMirrors ( int mirrorSize ) {
     MirrorImageFactory MIF;
     std::vector< Image*>  mirrorImages;
@@ -358,7 +458,13 @@ int ExtendedCompoundMask::_getline ( uint8_t* buffer, int line ) {
 
     memset ( buffer,0,width );
 
-    for ( uint i = ECI->getMirrorsNumber(); i < ECI->getImages()->size(); i++ ) {
+    // On ne parcourt que les images sources de la bande de lignes concernée
+    std::vector<int>& lineSources = ECI->getLineSources ( line );
+
+    for ( unsigned int k = 0; k < lineSources.size(); k++ ) {
+
+        uint i = lineSources[k];
+        if ( i < ECI->getMirrorsNumber() ) continue;
         
         int ol, c0, c1, c2;
         
@@ -381,7 +487,7 @@ int ExtendedCompoundMask::_getline ( uint8_t* buffer, int line ) {
             memset ( &buffer[c0], 255, c1 - c0 + 1 );
         } else {
             // Récupération du masque de l'image courante de l'ECI.
-            uint8_t* buffer_m = new uint8_t[ECI->getMask ( i )->getWidth()];
+            uint8_t* buffer_m = sourceMaskLine;
             ECI->getMask ( i )->getline ( buffer_m,lineInSource );
             // On ajoute au masque actuel (on écrase si la valeur est différente de 0)
             for ( int j = 0; j < c1 - c0 + 1; j++ ) {
@@ -389,7 +495,6 @@ int ExtendedCompoundMask::_getline ( uint8_t* buffer, int line ) {
                     memcpy ( &buffer[c0+j],&buffer_m[c2+j],1 );
                 }
             }
-            delete [] buffer_m;
         }
     }
 
@@ -403,18 +508,16 @@ int ExtendedCompoundMask::getline ( uint8_t* buffer, int line ) {
 
 /* Implementation de getline pour les float */
 int ExtendedCompoundMask::getline ( uint16_t* buffer, int line ) {
-    uint8_t* buffer_t = new uint8_t[width*channels];
-    getline ( buffer_t,line );
-    convert ( buffer,buffer_t,width*channels );
-    delete [] buffer_t;
+    ArenaBuffer<uint8_t> buffer_t ( width*channels );
+    getline ( buffer_t.get(),line );
+    convert ( buffer,buffer_t.get(),width*channels );
     return width*channels;
 }
 
 /* Implementation de getline pour les float */
 int ExtendedCompoundMask::getline ( float* buffer, int line ) {
-    uint8_t* buffer_t = new uint8_t[width*channels];
-    getline ( buffer_t,line );
-    convert ( buffer,buffer_t,width*channels );
-    delete [] buffer_t;
+    ArenaBuffer<uint8_t> buffer_t ( width*channels );
+    getline ( buffer_t.get(),line );
+    convert ( buffer,buffer_t.get(),width*channels );
     return width*channels;
 }
@@ -65,6 +65,12 @@
 #include "Image.h"
 #include "MirrorImage.h"
 
+/**
+ * \~french \brief Hauteur en pixel d'une bande de l'index des images sources
+ * \~english \brief Pixel height of a source images index's band
+ */
+#define ECI_INDEX_ROWS 64
+
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french
@@ -124,6 +130,34 @@ private:
      */
     std::vector<int> c2s;
 
+    /**
+     * \~french \brief Index des images sources par bande de lignes
+     * \details Pour chaque bande de #ECI_INDEX_ROWS lignes de l'image composée, indices (croissants) des images sources qui l'intersectent. L'ordre de superposition est donc conservé.
+     * \~english \brief Source images index, by lines' band
+     * \details For each band of #ECI_INDEX_ROWS lines of the compounded image, (increasing) indices of intersecting source images. Superimposition order is kept.
+     */
+    std::vector< std::vector<int> > rowsIndex;
+
+    /**
+     * \~french \brief Indices de toutes les images sources
+     * \details Utilisé pour les lignes hors de l'index (dimensions modifiées depuis sa construction)
+     * \~english \brief All source images' indices
+     * \details Used for lines out of index (dimensions modified since its construction)
+     */
+    std::vector<int> allSources;
+
+    /**
+     * \~french \brief Ligne de travail, assez grande pour une ligne de n'importe quelle image source, en flottant
+     * \~english \brief Work line, big enough for any source image's line, as float
+     */
+    uint8_t* sourceLine;
+
+    /**
+     * \~french \brief Ligne de masque de travail, assez grande pour une ligne de n'importe quel masque source
+     * \~english \brief Work mask line, big enough for any source mask's line
+     */
+    uint8_t* sourceMaskLine;
+
     /**
      * \~french \brief Nombre de miroirs dans les images sources
      * \details Certaines images sources peuvent etre des miroirs (MirrorImage). Lors de la composition de l'image, on ne veut pas que les données des vraies images soient écrasées par des données "miroirs". C'est pourquoi on veut connaître le nombre d'images miroirs dans le tableau et on sait qu'elles sont placées au début.
@@ -152,6 +186,16 @@ private:
      */
     template<typename T>
     int _getline ( T* buffer, int line );
+
+    /** \~french
+     * \brief Retourne un bloc de pixels, flottant ou entier
+     * \details Chaque image source intersectant le bloc n'est sollicitée qu'une fois, pour la partie commune, via sa propre méthode getBlock.
+     * \param[in] buffer Tableau contenant au moins w*h*channels valeurs
+     * \param[in] x,y,w,h bloc à retourner
+     * \return taille utile du buffer, 0 si erreur
+     */
+    template<typename T>
+    int _getCompoundBlock ( T* buffer, int x, int y, int w, int h );
     
     /** \~french
      * \brief Calcule les offsets pour chaque image source
@@ -166,6 +210,10 @@ private:
         c0s.clear();
         c1s.clear();
         c2s.clear();
+        allSources.clear();
+        rowsIndex.assign ( height / ECI_INDEX_ROWS + 1, std::vector<int>() );
+
+        int lineSize = 0, maskSize = 0;
         
         for ( int i = 0; i < ( int ) sourceImages.size(); i++ ) {
             
@@ -175,7 +223,24 @@ private:
             c0s.push_back(__max ( 0,x2c ( sourceImages[i]->getXmin() + 0.5*sourceImages[i]->getResX() ) ));
             c1s.push_back(__min ( width - 1,x2c ( sourceImages[i]->getXmax() - 0.5*sourceImages[i]->getResX() ) ));
             c2s.push_back(__max ( 0, sourceImages[i]->x2c ( bbox.xmin + 0.5*resx ) ) );
+
+            allSources.push_back ( i );
+
+            // Bandes intersectées par l'image source
+            int firstLine = __max ( 0, rowsOffsets[i] );
+            int lastLine = __min ( height - 1, rowsOffsets[i] + sourceImages[i]->getHeight() - 1 );
+            for ( int b = firstLine / ECI_INDEX_ROWS; firstLine <= lastLine && b <= lastLine / ECI_INDEX_ROWS; b++ ) {
+                rowsIndex[b].push_back ( i );
+            }
+
+            lineSize = __max ( lineSize, sourceImages[i]->getWidth() * sourceImages[i]->getChannels() );
+            if ( getMask ( i ) ) maskSize = __max ( maskSize, getMask ( i )->getWidth() );
         }
+
+        delete [] sourceLine;
+        delete [] sourceMaskLine;
+        sourceLine = new uint8_t[lineSize * sizeof ( float )];
+        sourceMaskLine = new uint8_t[maskSize];
     }
 
 protected:
@@ -208,6 +273,7 @@ protected:
                             std::vector<Image*>& images, int* nd, uint mirrors ) :
         Image ( width, height, channels, resx, resy, bbox ),
         sourceImages ( images ),
+        sourceLine ( NULL ), sourceMaskLine ( NULL ),
         mirrorsNumber ( mirrors ) {
 
         nodata = new int[channels];
@@ -244,6 +310,25 @@ public:
         *c2 = c2s[i];
     }
 
+    /**
+     * \~french
+     * \brief Retourne les indices des images sources pouvant intersecter une ligne
+     * \details Les indices sont croissants. Toutes les images sources sont retournées pour une ligne hors de l'index.
+     * \param[in] line indice de la ligne dans l'image composée
+     * \return indices des images sources candidates
+     * \~english
+     * \brief Return indices of source images which can intersect a line
+     * \details Indices are increasing. All source images are returned for a line out of the index.
+     * \param[in] line line's indice in the compounded image
+     * \return candidate source images' indices
+     */
+    std::vector<int>& getLineSources ( int line ) {
+        if ( line < 0 || line / ECI_INDEX_ROWS >= ( int ) rowsIndex.size() ) {
+            return allSources;
+        }
+        return rowsIndex[line / ECI_INDEX_ROWS];
+    }
+
     /**
      * \~french
      * \brief Précise si au moins une image source possède un masque de donnée
@@ -345,6 +430,10 @@ public:
     int getline ( float* buffer, int line );
     int getline ( uint16_t* buffer, int line );
 
+    int getBlock ( uint8_t* buffer, int x, int y, int w, int h );
+    int getBlock ( float* buffer, int x, int y, int w, int h );
+    int getBlock ( uint16_t* buffer, int x, int y, int w, int h );
+
     /**
      * \~french
      * \brief Destructeur par défaut
@@ -354,6 +443,8 @@ public:
      */
     virtual ~ExtendedCompoundImage() {
         delete[] nodata;
+        delete[] sourceLine;
+        delete[] sourceMaskLine;
         if ( ! isMask ) {
             for ( uint i=0; i < sourceImages.size(); i++ ) {
                 delete sourceImages[i];
@@ -453,6 +544,12 @@ private:
      */
     ExtendedCompoundImage* ECI;
 
+    /**
+     * \~french \brief Ligne de masque de travail, assez grande pour une ligne de n'importe quel masque source
+     * \~english \brief Work mask line, big enough for any source mask's line
+     */
+    uint8_t* sourceMaskLine;
+
     /** \~french
      * \brief Retourne une ligne entière
      * \details Lors ce que l'on veut récupérer une ligne d'un masque composé, on va se reporter sur tous les masques des images source de l'image composée associée. Si une des images sources n'a pas de masque, on considère que celle-ci est pleine (ne contient pas de non-donnée).
@@ -474,7 +571,14 @@ public:
      */
     ExtendedCompoundMask ( ExtendedCompoundImage* ECI ) :
         Image ( ECI->getWidth(), ECI->getHeight(), 1, ECI->getResX(), ECI->getResY(),ECI->getBbox() ),
-        ECI ( ECI ) {}
+        ECI ( ECI ) {
+
+        int maskSize = width;
+        for ( uint i = 0; i < ECI->getImages()->size(); i++ ) {
+            if ( ECI->getMask ( i ) ) maskSize = __max ( maskSize, ECI->getMask ( i )->getWidth() );
+        }
+        sourceMaskLine = new uint8_t[maskSize];
+    }
 
     int getline ( uint8_t* buffer, int line );
     int getline ( float* buffer, int line );
@@ -486,7 +590,9 @@ public:
      * \~english
      * \brief Default destructor
      */
-    virtual ~ExtendedCompoundMask() {}
+    virtual ~ExtendedCompoundMask() {
+        delete[] sourceMaskLine;
+    }
 
     /** \~french
      * \brief Sortie des informations sur le masque composé
@@ -66,6 +66,11 @@ int FileContext::read(uint8_t* data, int offset, int size, std::string name) {
     std::string fullName = root_dir + name;
     LOGGER_DEBUG("File read : " << size << " bytes (from the " << offset << " one) in the file " << fullName);
 
+    // Lecture depuis la projection mémoire de la dalle, si activée
+    if ( MappedFilePool::isEnabled() ) {
+        return MappedFilePool::read ( data, offset, size, fullName );
+    }
+
     // Ouverture du fichier
     int fildes = open( fullName.c_str(), O_RDONLY );
     if ( fildes < 0 ) {
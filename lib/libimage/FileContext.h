@@ -52,6 +52,7 @@
 
 #include "Logger.h"
 #include "Context.h"
+#include "MappedFilePool.h"
 #include <iostream>
 #include <sys/stat.h>
 
@@ -110,10 +111,13 @@ public:
 
     /**
      * \~french \brief Ouvre le flux #output
+     * \details Une éventuelle projection mémoire du fichier est abandonnée avant sa troncature
      * \~english \brief Open stream #output
+     * \details A possible memory mapping of the file is dropped before truncating it
      */
     virtual bool openToWrite(std::string name) {
         std::string fullName = root_dir + name;
+        MappedFilePool::invalidate ( fullName );
         output.open ( fullName.c_str(), std::ios_base::trunc | std::ios::binary );
         if (output.fail()) {
             return false;
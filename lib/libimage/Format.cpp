@@ -179,7 +179,8 @@ const char *eformat_name[] = {
     "TIFF_ZIP_FLOAT32",
     "TIFF_PKB_FLOAT32",
 
-    "TIFF_PBF_MVT"
+    "TIFF_PBF_MVT",
+    "TIFF_PBF_GZIP_MVT"
 };
 
 const bool eformat_israster[] = {
@@ -197,6 +198,7 @@ const bool eformat_israster[] = {
     true,
     true,
 
+    false,
     false
 };
 
@@ -215,6 +217,7 @@ const int eformat_channelsize[] = {
     4,
     4,
 
+    -1,
     -1
 };
 
@@ -233,6 +236,7 @@ const char *eformat_mime[] = {
     "image/x-bil;bits=32",
     "image/tiff",
 
+    "application/x-protobuf",
     "application/x-protobuf"
 };
 
@@ -251,6 +255,7 @@ const char *eformat_extension[] = {
     "tif",
     "tif",
 
+    "pbf",
     "pbf"
 };
 
@@ -269,7 +274,8 @@ const char *eformat_encoding[] = {
     "deflate",
     "",
 
-    ""
+    "",
+    "gzip"
 };
 
 
@@ -288,6 +294,7 @@ const Compression::eCompression eformat_compression[] = {
     Compression::DEFLATE,
     Compression::PACKBITS,
 
+    Compression::UNKNOWN,
     Compression::UNKNOWN
 };
 
@@ -307,6 +314,7 @@ const SampleFormat::eSampleFormat eformat_sampleformat[] = {
     SampleFormat::FLOAT,
     SampleFormat::FLOAT,
 
+    SampleFormat::UNKNOWN,
     SampleFormat::UNKNOWN
 };
 
@@ -326,12 +334,13 @@ const int eformat_bitspersample[] = {
     32,
     32,
 
+    -1,
     -1
 };
 
 eformat_data fromString ( std::string strFormat ) {
     int i;
-    for ( i=eformat_size; i ; --i ) {
+    for ( i=eformat_size-1; i ; --i ) {
         if ( strFormat.compare ( eformat_name[i] ) ==0 )
             break;
     }
@@ -368,7 +377,7 @@ std::string toExtension ( eformat_data format ) {
 
 eformat_data fromMimeType ( std::string mime ) {
     int i;
-    for ( i=eformat_size; i ; --i ) {
+    for ( i=eformat_size-1; i ; --i ) {
         if ( mime.compare ( eformat_mime[i] ) == 0 )
             break;
     }
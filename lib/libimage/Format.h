@@ -285,14 +285,15 @@ enum eformat_data {
     TIFF_ZIP_FLOAT32 = 9,
     TIFF_PKB_FLOAT32 = 10,
 
-    TIFF_PBF_MVT = 11
+    TIFF_PBF_MVT = 11,
+    TIFF_PBF_GZIP_MVT = 12
 };
 
 /**
  * \~french \brief Nombre de formats disponibles
  * \~english \brief Number of available formats
  */
-const int eformat_size = 12;
+const int eformat_size = 13;
 
 /**
  * \~french \brief Conversion d'une chaîne de caractère vers un format
@@ -377,6 +378,14 @@ std::string toExtension ( eformat_data format );
  */
 eformat_data fromMimeType ( std::string mime );
 
+/**
+ * \~french \brief Donne l'encodage HTTP (Content-Encoding) des tuiles stockées dans ce format
+ * \param[in] format format à connaître
+ * \return encodage, vide si les tuiles sont servies telles quelles
+ * \~english \brief Precise HTTP encoding (Content-Encoding) of tiles stored in this format
+ * \param[in] format format to know
+ * \return encoding, empty if tiles are served as is
+ */
 std::string toEncoding ( eformat_data format );
 
 int getChannelSize ( eformat_data format );
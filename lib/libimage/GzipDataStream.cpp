@@ -0,0 +1,92 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file GzipDataStream.cpp
+ ** \~french
+ * \brief Implémentation de la classe GzipDataStream
+ ** \~english
+ * \brief Implement class GzipDataStream
+ */
+
+#include "GzipDataStream.h"
+#include "Logger.h"
+#include <cstring>
+
+GzipDataStream::GzipDataStream ( DataStream* stream, int level ) : stream ( stream ), inputEnd ( false ), finished ( false ) {
+    inBuffer = new uint8_t[GZIP_BUFFER_SIZE];
+    memset ( &zstream, 0, sizeof ( zstream ) );
+    // windowBits + 16 : en-tête et fin gzip plutôt que zlib
+    if ( deflateInit2 ( &zstream, level, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY ) != Z_OK ) {
+        LOGGER_ERROR ( "Impossible d'initialiser la compression gzip du flux" );
+        finished = true;
+    }
+}
+
+GzipDataStream::~GzipDataStream() {
+    deflateEnd ( &zstream );
+    delete[] inBuffer;
+    delete stream;
+}
+
+size_t GzipDataStream::read ( uint8_t *buffer, size_t size ) {
+    if ( finished ) return 0;
+
+    zstream.next_out = buffer;
+    zstream.avail_out = size;
+
+    while ( zstream.avail_out > 0 && ! finished ) {
+        if ( zstream.avail_in == 0 && ! inputEnd ) {
+            size_t readSize = stream->read ( inBuffer, GZIP_BUFFER_SIZE );
+            if ( readSize == 0 ) {
+                inputEnd = true;
+            }
+            zstream.next_in = inBuffer;
+            zstream.avail_in = readSize;
+        }
+
+        int ret = deflate ( &zstream, inputEnd ? Z_FINISH : Z_NO_FLUSH );
+        if ( ret == Z_STREAM_END ) {
+            finished = true;
+        } else if ( ret != Z_OK && ret != Z_BUF_ERROR ) {
+            LOGGER_ERROR ( "Erreur de compression gzip du flux : " << ret );
+            finished = true;
+        }
+    }
+
+    return size - zstream.avail_out;
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file GzipDataStream.h
+ ** \~french
+ * \brief Définition de la classe GzipDataStream
+ * \details Compression gzip à la volée d'un flux de données
+ ** \~english
+ * \brief Define class GzipDataStream
+ * \details On the fly gzip compression of a data stream
+ */
+
+#ifndef _GZIPDATASTREAM_
+#define _GZIPDATASTREAM_
+
+#include "Data.h"
+#include <zlib.h>
+
+/**
+ * \~french \brief Taille du tampon de lecture du flux source
+ * \~english \brief Size of the source stream reading buffer
+ */
+#define GZIP_BUFFER_SIZE 262144
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Flux de données compressé en gzip au fil de la lecture
+ * \details Le flux source est lu par morceaux de GZIP_BUFFER_SIZE octets, compressés directement dans le tampon du lecteur. La taille finale n'étant pas connue à l'avance, getLength renvoie 0 (pas de Content-Length). Destiné aux formats non compressés (BIL, ASC), servis en Content-Encoding gzip aux clients qui l'acceptent.
+ * \~english
+ * \brief Data stream gzip compressed while read
+ * \details The source stream is read by GZIP_BUFFER_SIZE bytes chunks, compressed directly into the reader's buffer. Final size being unknown, getLength returns 0 (no Content-Length). Intended for uncompressed formats (BIL, ASC), served with a gzip Content-Encoding to accepting clients.
+ */
+class GzipDataStream : public DataStream {
+private:
+    /**
+     * \~french \brief Flux source, détruit avec l'objet
+     * \~english \brief Source stream, deleted with the object
+     */
+    DataStream* stream;
+    /**
+     * \~french \brief Flux de compression zlib
+     * \~english \brief zlib compression stream
+     */
+    z_stream zstream;
+    /**
+     * \~french \brief Tampon de lecture du flux source
+     * \~english \brief Source stream reading buffer
+     */
+    uint8_t* inBuffer;
+    /**
+     * \~french \brief Le flux source est entièrement lu
+     * \~english \brief Source stream is completely read
+     */
+    bool inputEnd;
+    /**
+     * \~french \brief Le flux compressé est terminé
+     * \~english \brief Compressed stream is ended
+     */
+    bool finished;
+
+public:
+    /**
+     * \~french
+     * \brief Crée un flux compressant le flux source
+     * \param[in] stream flux source, dont l'objet prend possession
+     * \param[in] level niveau de compression zlib
+     * \~english
+     * \brief Create a stream compressing the source stream
+     * \param[in] stream source stream, owned by the object
+     * \param[in] level zlib compression level
+     */
+    GzipDataStream ( DataStream* stream, int level = Z_BEST_SPEED );
+    ~GzipDataStream();
+
+    size_t read ( uint8_t *buffer, size_t size );
+    bool eof() {
+        return finished;
+    }
+    std::string getType() {
+        return stream->getType();
+    }
+    int getHttpStatus() {
+        return stream->getHttpStatus();
+    }
+    std::string getEncoding() {
+        return "gzip";
+    }
+    unsigned int getLength() {
+        return 0;
+    }
+};
+
+#endif
@@ -55,6 +55,7 @@
 #include <typeinfo>
 #include "BoundingBox.h"
 #include "CRS.h"
+#include "RequestArena.h"
 #include <cmath>
 
 #define METER_PER_DEG 111319.492
@@ -146,6 +147,48 @@ protected:
         resy= ( bbox.ymax - bbox.ymin ) /double ( height );
     }
 
+    /**
+     * \~french
+     * \brief Contrôle qu'un bloc est inclus dans l'image
+     * \~english
+     * \brief Check that a block is included in the image
+     */
+    bool blockIsValid ( int x, int y, int w, int h ) {
+        if ( x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > width || y + h > height ) {
+            LOGGER_ERROR ( "Invalid block (" << x << ", " << y << ", " << w << ", " << h << ") for image " << width << "x" << height );
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * \~french
+     * \brief Retourne un bloc de pixels, ligne par ligne
+     * \details Implémentation par défaut de #getBlock, s'appuyant sur #getline. Si le bloc fait toute la largeur de l'image, les lignes sont lues directement dans le buffer.
+     * \~english
+     * \brief Return a pixels' block, line by line
+     * \details Default #getBlock implementation, using #getline. If the block is as wide as the image, lines are read directly into the buffer.
+     */
+    template<typename T>
+    int _getBlock ( T* buffer, int x, int y, int w, int h ) {
+        if ( ! blockIsValid ( x, y, w, h ) ) return 0;
+
+        if ( x == 0 && w == width ) {
+            for ( int l = 0; l < h; l++ ) {
+                if ( getline ( buffer + l * w * channels, y + l ) == 0 ) return 0;
+            }
+        } else {
+            // Marge pour les images retournant leurs données natives sans conversion (jusqu'à 32 bits par canal)
+            ArenaBuffer<T> line ( width * channels * sizeof ( float ) / sizeof ( T ) );
+            for ( int l = 0; l < h; l++ ) {
+                if ( getline ( line.get(), y + l ) == 0 ) return 0;
+                memcpy ( buffer + l * w * channels, line.get() + x * channels, w * channels * sizeof ( T ) );
+            }
+        }
+
+        return w * h * channels * sizeof ( T );
+    }
+
 public:
     
     /**
@@ -700,6 +743,54 @@ public:
      */
     virtual int getline ( float *buffer, int line ) = 0;
 
+    /**
+     * \~french
+     * \brief Retourne un bloc de pixels en entier 8 bits
+     * \details Les lignes du bloc sont contiguës et les canaux entrelacés. Par défaut, le bloc est constitué à partir de #getline : les images pouvant fournir directement un bloc (tuilées, composées) surchargent cette méthode.
+     * \param[in,out] buffer Tableau contenant au moins 'w * h * channels' entiers sur 8 bits
+     * \param[in] x Indice de la première colonne du bloc
+     * \param[in] y Indice de la première ligne du bloc
+     * \param[in] w Largeur du bloc, en pixel
+     * \param[in] h Hauteur du bloc, en pixel
+     * \return taille utile du buffer, 0 si erreur
+     * \~english
+     * \brief Return a pixels' block as 8-bit integers
+     * \details Block's lines are contiguous and samples are interleaved. By default, block is built with #getline : images which can provide a block directly (tiled, compounded) override this method.
+     * \param[in,out] buffer Array with at least 'w * h * channels' 8-bit integers
+     * \param[in] x Block's first column
+     * \param[in] y Block's first line
+     * \param[in] w Block's width, in pixel
+     * \param[in] h Block's height, in pixel
+     * \return buffer's useful size, 0 if error
+     */
+    virtual int getBlock ( uint8_t *buffer, int x, int y, int w, int h ) {
+        return _getBlock ( buffer, x, y, w, h );
+    }
+
+    /**
+     * \~french
+     * \brief Retourne un bloc de pixels en entier 16 bits
+     * \details Voir la version 8 bits.
+     * \~english
+     * \brief Return a pixels' block as 16-bit integers
+     * \details See 8-bit version.
+     */
+    virtual int getBlock ( uint16_t *buffer, int x, int y, int w, int h ) {
+        return _getBlock ( buffer, x, y, w, h );
+    }
+
+    /**
+     * \~french
+     * \brief Retourne un bloc de pixels en flottant 32 bits
+     * \details Voir la version 8 bits.
+     * \~english
+     * \brief Return a pixels' block as 32-bit floats
+     * \details See 8-bit version.
+     */
+    virtual int getBlock ( float *buffer, int x, int y, int w, int h ) {
+        return _getBlock ( buffer, x, y, w, h );
+    }
+
     /**
      * \~french
      * \brief Destructeur par défaut
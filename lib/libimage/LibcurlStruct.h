@@ -51,11 +51,13 @@
 struct HeaderStruct {
     char* url;
     char* token;
+    int expires;
 
     HeaderStruct()
     {
         url = 0;
         token = 0;
+        expires = -1;
     }
 
     ~HeaderStruct()
@@ -94,6 +96,10 @@ static size_t header_callback(char *buffer, size_t nitems, size_t size, void *us
         hdr->token[realsize - 2] = '\0';
     }
 
+    else if (! strncmp ( buffer,"X-Auth-Token-Expires: ", 22)) {
+        hdr->expires = atoi(buffer + 22);
+    }
+
     else if (! strncmp ( buffer,"X-Subject-Token: ", 17)) {
         hdr->token = (char*) malloc(realsize - 17 + 14);
         strncpy(hdr->token, "X-Auth-Token: ", 14);
@@ -56,6 +56,7 @@
 #include "LibopenjpegImage.h"
 #include "Logger.h"
 #include "Utils.h"
+#include "RequestArena.h"
 
 /* ------------------------------------------------------------------------------------------------ */
 /* ------------------------------------------ CONVERSIONS ----------------------------------------- */
@@ -298,16 +299,16 @@ int LibopenjpegImage::getline ( uint8_t* buffer, int line ) {
     } else if ( bitspersample == 16 && sampleformat == SampleFormat::UINT ) { // uint16
         /* On ne convertit pas les entiers 16 bits en entier sur 8 bits (aucun intérêt)
          * On va copier le buffer entier 16 bits sur le buffer entier, de même taille en octet (2 fois plus grand en "nombre de cases")*/
-        uint16_t int16line[width * getChannels()];
-        _getline ( int16line, line );
-        memcpy ( buffer, int16line, width * getPixelSize() );
+        ArenaBuffer<uint16_t> int16line ( width * getChannels() );
+        _getline ( int16line.get(), line );
+        memcpy ( buffer, int16line.get(), width * getPixelSize() );
         return width * getPixelSize();
     } else if ( bitspersample == 32 && sampleformat == SampleFormat::FLOAT ) { // float
         /* On ne convertit pas les nombres flottants en entier sur 8 bits (aucun intérêt)
          * On va copier le buffer flottant sur le buffer entier, de même taille en octet (4 fois plus grand en "nombre de cases")*/
-        float floatline[width * getChannels()];
-        _getline ( floatline, line );
-        memcpy ( buffer, floatline, width * getPixelSize() );
+        ArenaBuffer<float> floatline ( width * getChannels() );
+        _getline ( floatline.get(), line );
+        memcpy ( buffer, floatline.get(), width * getPixelSize() );
         return width * getPixelSize();
     }
 }
@@ -316,19 +317,18 @@ int LibopenjpegImage::getline ( uint16_t* buffer, int line ) {
     
     if ( bitspersample == 8 && sampleformat == SampleFormat::UINT ) {
         // On veut la ligne en entier 16 bits mais l'image lue est sur 8 bits : on convertit
-        uint8_t* buffer_t = new uint8_t[width * getChannels()];
-        _getline ( buffer_t,line );
-        convert ( buffer, buffer_t, width * getChannels() );
-        delete [] buffer_t;
+        ArenaBuffer<uint8_t> buffer_t ( width * getChannels() );
+        _getline ( buffer_t.get(),line );
+        convert ( buffer, buffer_t.get(), width * getChannels() );
         return width * getChannels();
     } else if ( bitspersample == 16 && sampleformat == SampleFormat::UINT ) { // uint16
         return _getline ( buffer,line );        
     } else if ( bitspersample == 32 && sampleformat == SampleFormat::FLOAT ) { // float
         /* On ne convertit pas les nombres flottants en entier sur 16 bits (aucun intérêt)
         * On va copier le buffer flottant sur le buffer entier 16 bits, de même taille en octet (2 fois plus grand en "nombre de cases")*/
-        float floatline[width * channels];
-        _getline ( floatline, line );
-        memcpy ( buffer, floatline, width*pixelSize );
+        ArenaBuffer<float> floatline ( width * channels );
+        _getline ( floatline.get(), line );
+        memcpy ( buffer, floatline.get(), width*pixelSize );
         return width*pixelSize;
     }
 }
@@ -336,17 +336,15 @@ int LibopenjpegImage::getline ( uint16_t* buffer, int line ) {
 int LibopenjpegImage::getline ( float* buffer, int line ) {
     if ( bitspersample == 8 && sampleformat == SampleFormat::UINT ) {
         // On veut la ligne en flottant pour un réechantillonnage par exemple mais l'image lue est sur des entiers
-        uint8_t* buffer_t = new uint8_t[width * getChannels()];
-        _getline ( buffer_t,line );
-        convert ( buffer, buffer_t, width * getChannels() );
-        delete [] buffer_t;
+        ArenaBuffer<uint8_t> buffer_t ( width * getChannels() );
+        _getline ( buffer_t.get(),line );
+        convert ( buffer, buffer_t.get(), width * getChannels() );
         return width * getChannels();
     } else if ( bitspersample == 16 && sampleformat == SampleFormat::UINT ) { // uint16
         // On veut la ligne en flottant pour un réechantillonnage par exemple mais l'image lue est sur des entiers
-        uint16_t* buffer_t = new uint16_t[width * getChannels()];
-        _getline ( buffer_t,line );
-        convert ( buffer, buffer_t, width * getChannels() );
-        delete [] buffer_t;
+        ArenaBuffer<uint16_t> buffer_t ( width * getChannels() );
+        _getline ( buffer_t.get(),line );
+        convert ( buffer, buffer_t.get(), width * getChannels() );
         return width * getChannels();   
     } else if ( bitspersample == 32 && sampleformat == SampleFormat::FLOAT ) { // float
         return _getline ( buffer, line );
@@ -0,0 +1,275 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+/**
+ * \file MappedFilePool.cpp
+ ** \~french
+ * \brief Implémentation de la classe MappedFilePool
+ ** \~english
+ * \brief Implements class MappedFilePool
+ */
+
+#include "MappedFilePool.h"
+#include "Logger.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+/**
+ * \~french \brief Taille de l'en-tête des dalles (en-tête TIFF et index des tuiles) à précharger
+ * \~english \brief Size of slab's header (TIFF header and tiles' index) to preload
+ */
+#define MAPPED_HEADER_SIZE 65536
+
+std::map<std::string, MappedFilePool::MappedFile*> MappedFilePool::files;
+std::list<std::string> MappedFilePool::lruList;
+int MappedFilePool::maxFiles = 0;
+pthread_mutex_t MappedFilePool::mutex = PTHREAD_MUTEX_INITIALIZER;
+
+MappedFilePool::MappedFile* MappedFilePool::map ( std::string fullName ) {
+
+    int fildes = open ( fullName.c_str(), O_RDONLY );
+    if ( fildes < 0 ) {
+        LOGGER_DEBUG ( "Can't open file " << fullName );
+        return NULL;
+    }
+
+    struct stat st;
+    if ( fstat ( fildes, &st ) != 0 || st.st_size == 0 ) {
+        LOGGER_ERROR ( "Impossible de projeter le fichier vide ou illisible " << fullName );
+        close ( fildes );
+        return NULL;
+    }
+
+    void* addr = mmap ( NULL, st.st_size, PROT_READ, MAP_SHARED, fildes, 0 );
+    // La projection reste valide après la fermeture du descripteur
+    close ( fildes );
+
+    if ( addr == MAP_FAILED ) {
+        LOGGER_ERROR ( "Impossible de projeter le fichier " << fullName << ", code erreur=" << errno );
+        return NULL;
+    }
+
+    // Les tuiles sont lues de manière aléatoire, seuls l'en-tête et l'index sont à précharger
+    madvise ( addr, st.st_size, MADV_RANDOM );
+    madvise ( addr, ( st.st_size < MAPPED_HEADER_SIZE ) ? st.st_size : MAPPED_HEADER_SIZE, MADV_WILLNEED );
+
+    MappedFile* mf = new MappedFile();
+    mf->data = ( uint8_t* ) addr;
+    mf->size = st.st_size;
+    mf->ino = st.st_ino;
+    mf->mtime = st.st_mtime;
+    mf->lastCheck = time ( NULL );
+    mf->users = 0;
+    mf->stale = false;
+
+    return mf;
+}
+
+void MappedFilePool::unmap ( MappedFile* mf ) {
+    munmap ( mf->data, mf->size );
+    delete mf;
+}
+
+MappedFilePool::MappedFile* MappedFilePool::detach ( std::map<std::string, MappedFile*>::iterator it ) {
+    MappedFile* mf = it->second;
+    lruList.erase ( mf->lru );
+    files.erase ( it );
+
+    if ( mf->users == 0 ) {
+        return mf;
+    }
+
+    // Le dernier lecteur libérera la projection
+    mf->stale = true;
+    return NULL;
+}
+
+void MappedFilePool::release ( MappedFile* mf ) {
+    pthread_mutex_lock ( &mutex );
+    mf->users--;
+    bool last = ( mf->stale && mf->users == 0 );
+    pthread_mutex_unlock ( &mutex );
+
+    if ( last ) unmap ( mf );
+}
+
+void MappedFilePool::setMaxFiles ( int max ) {
+    std::vector<MappedFile*> released;
+
+    pthread_mutex_lock ( &mutex );
+    maxFiles = ( max > 0 ) ? max : 0;
+    while ( files.size() > ( size_t ) maxFiles ) {
+        MappedFile* mf = detach ( files.find ( lruList.back() ) );
+        if ( mf ) released.push_back ( mf );
+    }
+    pthread_mutex_unlock ( &mutex );
+
+    for ( int i = 0; i < released.size(); i++ ) unmap ( released.at ( i ) );
+}
+
+int MappedFilePool::read ( uint8_t* data, int offset, int size, std::string fullName ) {
+
+    MappedFile* mf = NULL;
+    bool check = false;
+    time_t now = time ( NULL );
+
+    // Recherche de la projection, qui est réservée (users) avant de relâcher le verrou
+    pthread_mutex_lock ( &mutex );
+
+    if ( maxFiles == 0 ) {
+        pthread_mutex_unlock ( &mutex );
+        return -1;
+    }
+
+    std::map<std::string, MappedFile*>::iterator it = files.find ( fullName );
+    if ( it != files.end() ) {
+        mf = it->second;
+        mf->users++;
+        lruList.splice ( lruList.begin(), lruList, mf->lru );
+        if ( mf->lastCheck != now ) {
+            // Un seul lecteur par seconde se charge de la vérification
+            mf->lastCheck = now;
+            check = true;
+        }
+    }
+
+    pthread_mutex_unlock ( &mutex );
+
+    if ( check ) {
+        // La dalle a pu être remplacée depuis sa projection : vérification hors verrou
+        struct stat st;
+        if ( stat ( fullName.c_str(), &st ) != 0 || st.st_ino != mf->ino || st.st_mtime != mf->mtime || ( size_t ) st.st_size != mf->size ) {
+            LOGGER_DEBUG ( "Le fichier projeté " << fullName << " a été modifié" );
+            pthread_mutex_lock ( &mutex );
+            it = files.find ( fullName );
+            if ( it != files.end() && it->second == mf ) {
+                // Le lecteur courant est toujours enregistré : la projection ne peut pas être libérée ici
+                detach ( it );
+            }
+            pthread_mutex_unlock ( &mutex );
+
+            release ( mf );
+            mf = NULL;
+        }
+    }
+
+    if ( mf == NULL ) {
+        // Ouverture et projection hors verrou : les lectures des autres dalles ne sont pas bloquées
+        MappedFile* newMf = map ( fullName );
+        if ( newMf == NULL ) {
+            return -1;
+        }
+        newMf->users = 1;
+
+        std::vector<MappedFile*> released;
+
+        pthread_mutex_lock ( &mutex );
+        it = files.find ( fullName );
+        if ( maxFiles == 0 ) {
+            // Projection désactivée entre temps : la nouvelle projection n'est utilisée que pour cette lecture
+            newMf->stale = true;
+            mf = newMf;
+        } else if ( it != files.end() ) {
+            // Un autre thread a projeté la dalle en même temps : on utilise la sienne
+            mf = it->second;
+            mf->users++;
+            lruList.splice ( lruList.begin(), lruList, mf->lru );
+            released.push_back ( newMf );
+        } else {
+            mf = newMf;
+            lruList.push_front ( fullName );
+            mf->lru = lruList.begin();
+            files.insert ( std::pair<std::string, MappedFile*> ( fullName, mf ) );
+
+            while ( files.size() > ( size_t ) maxFiles ) {
+                MappedFile* old = detach ( files.find ( lruList.back() ) );
+                if ( old ) released.push_back ( old );
+            }
+        }
+        pthread_mutex_unlock ( &mutex );
+
+        for ( int i = 0; i < released.size(); i++ ) unmap ( released.at ( i ) );
+    }
+
+    if ( offset < 0 || size < 0 || ( size_t ) offset + ( size_t ) size > mf->size ) {
+        LOGGER_ERROR ( "Impossible de lire " << size << " octets à partir de " << offset << " dans le fichier " << fullName << " de taille " << mf->size );
+        release ( mf );
+        return -1;
+    }
+
+    memcpy ( data, mf->data + offset, size );
+
+    release ( mf );
+
+    return size;
+}
+
+void MappedFilePool::invalidate ( std::string fullName ) {
+    MappedFile* mf = NULL;
+
+    pthread_mutex_lock ( &mutex );
+    std::map<std::string, MappedFile*>::iterator it = files.find ( fullName );
+    if ( it != files.end() ) {
+        mf = detach ( it );
+    }
+    pthread_mutex_unlock ( &mutex );
+
+    if ( mf ) unmap ( mf );
+}
+
+int MappedFilePool::getNbFiles() {
+    pthread_mutex_lock ( &mutex );
+    int nb = files.size();
+    pthread_mutex_unlock ( &mutex );
+    return nb;
+}
+
+void MappedFilePool::cleanMappedFilePool () {
+    std::vector<MappedFile*> released;
+
+    pthread_mutex_lock ( &mutex );
+    while ( ! files.empty() ) {
+        MappedFile* mf = detach ( files.begin() );
+        if ( mf ) released.push_back ( mf );
+    }
+    pthread_mutex_unlock ( &mutex );
+
+    for ( int i = 0; i < released.size(); i++ ) unmap ( released.at ( i ) );
+}
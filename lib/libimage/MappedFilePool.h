@@ -0,0 +1,265 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+/**
+ * \file MappedFilePool.h
+ ** \~french
+ * \brief Définition de la classe MappedFilePool
+ ** \~english
+ * \brief Define class MappedFilePool
+ */
+
+#ifndef MAPPEDFILEPOOL_H
+#define MAPPEDFILEPOOL_H
+
+#include <stdint.h>// pour uint8_t
+#include <pthread.h>
+#include <sys/types.h>
+#include <time.h>
+#include <map>
+#include <list>
+#include <vector>
+#include <string>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Annuaire des dalles projetées en mémoire
+ * \details Cette classe est prévue pour être utilisée sans instance. Elle est partagée par tous les threads du serveur, et conserve au plus #maxFiles fichiers projetés (mmap), les moins récemment utilisés étant libérés en premier.
+ *
+ * Une dalle projetée est revalidée (inode, taille et date de modification) au plus une fois par seconde : si elle a été remplacée sur disque (par renommage), la projection est abandonnée et la nouvelle dalle est projetée. Une projection n'est libérée que lorsque plus aucun thread ne lit dedans.
+ *
+ * Le verrou de l'annuaire ne protège que les structures (annuaire, liste LRU, compteurs de lecteurs) : les vérifications (stat), projections (mmap), libérations (munmap) et copies se font hors verrou, et les lectures de dalles différentes ne se bloquent pas mutuellement.
+ *
+ * \warning Une dalle tronquée ou réécrite sur place pendant qu'elle est projetée provoque un SIGBUS lors d'une lecture dans la zone disparue. C'est le cas de FileContext::openToWrite, qui tronque le fichier. Une réécriture par le processus lui-même invalide la projection (#invalidate) ; en revanche, une réécriture sur place par un autre processus (outil de génération écrivant dans une pyramide diffusée) n'est détectée qu'à la vérification suivante, au plus une seconde plus tard. La projection ne doit donc être activée que pour des pyramides dont les dalles sont remplacées par renommage, ou qui ne sont pas modifiées pendant leur diffusion.
+ * \~english
+ * \brief Book of memory mapped slabs
+ * \details This class is designed to be used without instance. It is shared by all server's threads, and keeps at most #maxFiles mapped files, least recently used being released first.
+ *
+ * A mapped slab is checked (inode, size and modification time) at most once per second : if it has been replaced on disk (by renaming), mapping is dropped and the new slab is mapped. A mapping is released only when no thread reads in it anymore.
+ *
+ * The book's mutex only protects structures (book, LRU list, readers counters) : checks (stat), mappings (mmap), releases (munmap) and copies are done without lock, so reads of different slabs do not block each other.
+ *
+ * \warning A slab truncated or rewritten in place while mapped raises a SIGBUS when reading in the removed area. FileContext::openToWrite truncates the file. A rewrite by the process itself invalidates the mapping (#invalidate), but a rewrite in place by another process (generation tool writing in a broadcast pyramid) is only detected by the next check, at most one second later. Mapping should only be enabled for pyramids whose slabs are replaced by renaming, or which are not modified while broadcast.
+ */
+class MappedFilePool {
+
+private:
+
+    /**
+     * \~french \brief Fichier projeté en mémoire
+     * \~english \brief Memory mapped file
+     */
+    struct MappedFile {
+        /**
+         * \~french \brief Début de la projection
+         * \~english \brief Mapping's start
+         */
+        uint8_t* data;
+        /**
+         * \~french \brief Taille du fichier projeté
+         * \~english \brief Mapped file's size
+         */
+        size_t size;
+        /**
+         * \~french \brief Inode du fichier au moment de la projection
+         * \~english \brief File's inode when mapped
+         */
+        ino_t ino;
+        /**
+         * \~french \brief Date de modification du fichier au moment de la projection
+         * \~english \brief File's modification time when mapped
+         */
+        time_t mtime;
+        /**
+         * \~french \brief Date de la dernière vérification du fichier
+         * \~english \brief Last file's check date
+         */
+        time_t lastCheck;
+        /**
+         * \~french \brief Nombre de lectures en cours dans la projection
+         * \~english \brief Number of reading in progress in the mapping
+         */
+        int users;
+        /**
+         * \~french \brief La projection a été retirée de l'annuaire et doit être libérée par le dernier lecteur
+         * \~english \brief Mapping has been removed from the book and have to be released by the last reader
+         */
+        bool stale;
+        /**
+         * \~french \brief Position dans la liste LRU
+         * \~english \brief Position in the LRU list
+         */
+        std::list<std::string>::iterator lru;
+    };
+
+    /**
+     * \~french \brief Annuaire des fichiers projetés
+     * \details La clé est le chemin complet du fichier
+     * \~english \brief Mapped files book
+     * \details Key is the file's full path
+     */
+    static std::map<std::string, MappedFile*> files;
+
+    /**
+     * \~french \brief Chemins des fichiers projetés, du plus récemment utilisé au plus ancien
+     * \~english \brief Mapped files' paths, from the most recently used to the oldest
+     */
+    static std::list<std::string> lruList;
+
+    /**
+     * \~french \brief Nombre maximal de fichiers projetés simultanément
+     * \details 0 : projection désactivée
+     * \~english \brief Maximal number of simultaneously mapped files
+     * \details 0 : mapping disabled
+     */
+    static int maxFiles;
+
+    /**
+     * \~french \brief Verrou protégeant l'annuaire
+     * \details Aucun appel système n'est fait en le détenant
+     * \~english \brief Mutex protecting the book
+     * \details No system call is made while holding it
+     */
+    static pthread_mutex_t mutex;
+
+    /**
+     * \~french \brief Projette un fichier
+     * \return NULL en cas d'échec
+     * \~english \brief Map a file
+     * \return NULL if failure
+     */
+    static MappedFile* map ( std::string fullName );
+
+    /**
+     * \~french \brief Retire un fichier de l'annuaire
+     * \details Le verrou doit être détenu. La projection est à libérer par l'appelant, une fois le verrou relâché, si elle n'est pas en cours de lecture. Sinon, elle le sera par le dernier lecteur.
+     * \return la projection à libérer, NULL si elle est en cours de lecture
+     * \~english \brief Remove a file from the book
+     * \details Mutex have to be held. Mapping have to be released by the caller, once the mutex is unlocked, if it's not being read. Otherwise, the last reader will release it.
+     * \return mapping to release, NULL if it is being read
+     */
+    static MappedFile* detach ( std::map<std::string, MappedFile*>::iterator it );
+
+    /**
+     * \~french \brief Termine une lecture dans une projection
+     * \details Libère la projection s'il s'agissait du dernier lecteur d'une projection retirée de l'annuaire. Le verrou ne doit pas être détenu.
+     * \~english \brief End a reading in a mapping
+     * \details Release the mapping if it was the last reader of a mapping removed from the book. Mutex must not be held.
+     */
+    static void release ( MappedFile* mf );
+
+    /**
+     * \~french \brief Libère une projection
+     * \~english \brief Release a mapping
+     */
+    static void unmap ( MappedFile* mf );
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \~english
+     * \brief Constructeur
+     */
+    MappedFilePool(){};
+
+public:
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \~english
+     * \brief Destructor
+     */
+    ~MappedFilePool(){};
+
+    /**
+     * \~french \brief Précise le nombre maximal de fichiers projetés
+     * \details 0 désactive la projection et libère les fichiers déjà projetés
+     * \~english \brief Set the maximal number of mapped files
+     * \details 0 disables mapping and releases already mapped files
+     */
+    static void setMaxFiles ( int max );
+
+    /**
+     * \~french \brief La projection est-elle activée
+     * \~english \brief Is mapping enabled
+     */
+    static bool isEnabled() {
+        return ( maxFiles > 0 );
+    }
+
+    /**
+     * \~french \brief Lit une portion de fichier depuis sa projection
+     * \details Le fichier est projeté s'il ne l'est pas encore
+     * \param[out] data buffer de réception, d'au moins size octets
+     * \param[in] offset position du premier octet à lire
+     * \param[in] size nombre d'octets à lire
+     * \param[in] fullName chemin complet du fichier
+     * \return nombre d'octets lus, -1 en cas d'erreur (fichier absent ou portion hors du fichier)
+     * \~english \brief Read a file's part from its mapping
+     * \details File is mapped if it's not already done
+     * \param[out] data buffer, at least size bytes
+     * \param[in] offset first byte to read position
+     * \param[in] size number of bytes to read
+     * \param[in] fullName file's full path
+     * \return number of read bytes, -1 if error (missing file or part outside the file)
+     */
+    static int read ( uint8_t* data, int offset, int size, std::string fullName );
+
+    /**
+     * \~french \brief Abandonne la projection d'un fichier
+     * \details À appeler avant de réécrire un fichier sur place
+     * \~english \brief Drop a file's mapping
+     * \details Have to be called before rewriting a file in place
+     */
+    static void invalidate ( std::string fullName );
+
+    /**
+     * \~french \brief Retourne le nombre de fichiers projetés
+     * \~english \brief Return the number of mapped files
+     */
+    static int getNbFiles();
+
+    /**
+     * \~french \brief Libère toutes les projections et vide l'annuaire
+     * \~english \brief Release all mappings and empty the book
+     */
+    static void cleanMappedFilePool ();
+
+};
+
+#endif
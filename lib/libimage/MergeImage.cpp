@@ -62,20 +62,27 @@
 
 template <typename tBuf>
 int MergeImage::_getline ( tBuf* buffer, int line ) {
-    Line aboveLine ( width, sizeof(tBuf) );
-    tBuf* imageLine = new tBuf[width*4];
-    uint8_t* maskLine = new uint8_t[width];
-    memset ( maskLine, 0, width );
 
-    tBuf bg[channels*width];
-    for ( int i = 0; i < channels*width; i++ ) {
-        bg[i] = ( tBuf ) bgValue[i%channels];
+    // Les lignes de travail sont allouées une fois par image, on ne réinitialise que la ligne de fond
+    memset ( maskLine, 0, width );
+    if ( backgroundSampleSize != sizeof ( tBuf ) ) {
+        tBuf* bg = ( tBuf* ) background;
+        for ( int i = 0; i < channels*width; i++ ) {
+            bg[i] = ( tBuf ) bgValue[i%channels];
+        }
+        delete workLine;
+        delete aboveLine;
+        workLine = new Line ( bg, maskLine, channels, width );
+        aboveLine = new Line ( bg, maskLine, channels, width );
+        backgroundSampleSize = sizeof ( tBuf );
+    } else {
+        workLine->store ( ( tBuf* ) background, maskLine, channels );
     }
-    Line workLine ( bg, maskLine, channels, width );
 
-    tBuf* transparent;
+    tBuf* srcLine = ( tBuf* ) imageLine;
+
+    tBuf transparent[3];
     if ( transparentValue != NULL ) {
-        transparent = new tBuf[3];
         for ( int i = 0; i < 3; i++ ) {
             transparent[i] = ( tBuf ) transparentValue[i];
         }
@@ -84,7 +91,7 @@ int MergeImage::_getline ( tBuf* buffer, int line ) {
     for ( int i = 0; i < images.size(); i++ ) {
 
         int srcSpp = images[i]->getChannels();
-        images[i]->getline ( imageLine,line );
+        images[i]->getline ( srcLine,line );
 
         if ( images[i]->getMask() == NULL ) {
             memset ( maskLine, 255, width );
@@ -93,41 +100,35 @@ int MergeImage::_getline ( tBuf* buffer, int line ) {
         }
 
         if ( transparentValue == NULL ) {
-            aboveLine.store ( imageLine, maskLine, srcSpp );
+            aboveLine->store ( srcLine, maskLine, srcSpp );
         } else {
-            aboveLine.store ( imageLine, maskLine, srcSpp, transparent );
+            aboveLine->store ( srcLine, maskLine, srcSpp, transparent );
         }
 
         switch ( composition ) {
         case Merge::NORMAL:
-            workLine.useMask ( &aboveLine );
+            workLine->useMask ( aboveLine );
             break;
         case Merge::TOP:
-            workLine.useMask ( &aboveLine );
+            workLine->useMask ( aboveLine );
             break;
         case Merge::MULTIPLY:
-            workLine.multiply ( &aboveLine );
+            workLine->multiply ( aboveLine );
             break;
         case Merge::ALPHATOP:
-            workLine.alphaBlending ( &aboveLine );
+            workLine->alphaBlending ( aboveLine );
             break;
             //case Merge::LIGHTEN:
             //case Merge::DARKEN:
         default:
-            workLine.useMask ( &aboveLine );
+            workLine->useMask ( aboveLine );
             break;
         }
 
     }
 
     // On repasse la ligne sur le nombre de canaux voulu
-    workLine.write ( buffer, channels );
-
-    if ( transparentValue != NULL ) {
-        delete [] transparent;
-    }
-    delete [] imageLine;
-    delete [] maskLine;
+    workLine->write ( buffer, channels );
 
     return width*channels*sizeof( tBuf );
 }
@@ -178,7 +179,7 @@ MergeImage* MergeImageFactory::createMergeImage ( std::vector< Image* >& images,
 int MergeMask::getline ( uint8_t* buffer, int line ) {
     memset ( buffer,0,width );
 
-    uint8_t* buffer_m = new uint8_t[width];
+    uint8_t* buffer_m = maskLine;
 
     for ( uint i = 0; i < MI->getImages()->size(); i++ ) {
 
@@ -186,7 +187,6 @@ int MergeMask::getline ( uint8_t* buffer, int line ) {
             /* L'image n'a pas de masque, on la considère comme pleine. Ca ne sert à rien d'aller voir plus loin,
              * cette ligne du masque est déjà pleine */
             memset ( buffer, 255, width );
-            delete [] buffer_m;
             return width;
         } else {
             // Récupération du masque de l'image courante de l'MI.
@@ -200,25 +200,22 @@ int MergeMask::getline ( uint8_t* buffer, int line ) {
         }
     }
 
-    delete [] buffer_m;
     return width;
 }
 
 /* Implementation de getline pour les uint16 */
 int MergeMask::getline ( uint16_t* buffer, int line ) {
-    uint8_t* buffer_t = new uint8_t[width*channels];
-    int retour = getline ( buffer_t,line );
-    convert ( buffer,buffer_t,width*channels );
-    delete [] buffer_t;
+    ArenaBuffer<uint8_t> buffer_t ( width*channels );
+    int retour = getline ( buffer_t.get(),line );
+    convert ( buffer,buffer_t.get(),width*channels );
     return retour;
 }
 
 /* Implementation de getline pour les float */
 int MergeMask::getline ( float* buffer, int line ) {
-    uint8_t* buffer_t = new uint8_t[width*channels];
-    int retour = getline ( buffer_t,line );
-    convert ( buffer,buffer_t,width*channels );
-    delete [] buffer_t;
+    ArenaBuffer<uint8_t> buffer_t ( width*channels );
+    int retour = getline ( buffer_t.get(),line );
+    convert ( buffer,buffer_t.get(),width*channels );
     return retour;
 }
 
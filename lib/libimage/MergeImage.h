@@ -59,6 +59,7 @@
 #include "Image.h"
 #include <string.h>
 #include "Format.h"
+#include "Line.h"
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -155,6 +156,41 @@ private:
      */
     int* transparentValue;
 
+    /**
+     * \~french \brief Ligne de travail pour lire les images sources, jusqu'à 4 canaux flottants
+     * \~english \brief Work line to read source images, up to 4 float samples
+     */
+    uint8_t* imageLine;
+
+    /**
+     * \~french \brief Ligne de masque de travail
+     * \~english \brief Work mask line
+     */
+    uint8_t* maskLine;
+
+    /**
+     * \~french \brief Ligne de fond, jusqu'à 4 canaux flottants
+     * \details Remplie pour le type de la dernière lecture, dont la taille est #backgroundSampleSize
+     * \~english \brief Background line, up to 4 float samples
+     * \details Filled for the last reading's type, whose size is #backgroundSampleSize
+     */
+    uint8_t* background;
+
+    /**
+     * \~french \brief Taille d'un canal dans #background, 0 si non remplie
+     * \~english \brief Sample size in #background, 0 if not filled
+     */
+    int backgroundSampleSize;
+
+    /**
+     * \~french \brief Lignes de fusion, créées à la première lecture d'un type donné
+     * \details Leur taille de canal est #backgroundSampleSize
+     * \~english \brief Merge lines, created at the first reading of a given type
+     * \details Their sample size is #backgroundSampleSize
+     */
+    Line* workLine;
+    Line* aboveLine;
+
     /** \~french
      * \brief Retourne une ligne, flottante ou entière
      * \param[in] buffer Tableau contenant au moins width*channels valeurs
@@ -185,7 +221,8 @@ protected:
     MergeImage ( std::vector< Image* >& images, int channels,
                  int* bg, int* transparent, Merge::eMergeType composition = Merge::NORMAL ) :
         Image ( images.at ( 0 )->getWidth(),images.at ( 0 )->getHeight(), channels, images.at ( 0 )->getResX(),images.at ( 0 )->getResY(), images.at ( 0 )->getBbox() ),
-        images ( images ), composition ( composition ), bgValue ( bg ), transparentValue ( transparent ) {
+        images ( images ), composition ( composition ), bgValue ( bg ), transparentValue ( transparent ),
+        backgroundSampleSize ( 0 ), workLine ( NULL ), aboveLine ( NULL ) {
 
         if ( transparentValue != NULL ) {
             transparentValue = new int[3];
@@ -194,6 +231,10 @@ protected:
 
         bgValue = new int[channels];
         memcpy ( bgValue, bg, channels*sizeof ( int ) );
+
+        imageLine = new uint8_t[width * 4 * sizeof ( float )];
+        maskLine = new uint8_t[width];
+        background = new uint8_t[width * channels * sizeof ( float )];
     }
 
 
@@ -244,6 +285,11 @@ public:
         }
         delete [] bgValue;
         if ( transparentValue != NULL ) delete [] transparentValue;
+        delete [] imageLine;
+        delete [] maskLine;
+        delete [] background;
+        delete workLine;
+        delete aboveLine;
     }
 
     /** \~french
@@ -307,6 +353,12 @@ private:
      */
     MergeImage* MI;
 
+    /**
+     * \~french \brief Ligne de masque de travail
+     * \~english \brief Work mask line
+     */
+    uint8_t* maskLine;
+
 public:
     /** \~french
      * \brief Crée un MergeMask
@@ -319,7 +371,9 @@ public:
      */
     MergeMask ( MergeImage*& MI ) :
         Image ( MI->getWidth(), MI->getHeight(), 1,MI->getResX(), MI->getResY(),MI->getBbox() ),
-        MI ( MI ) {}
+        MI ( MI ) {
+        maskLine = new uint8_t[width];
+    }
 
     int getline ( uint8_t* buffer, int line );
     int getline ( uint16_t* buffer, int line );
@@ -331,7 +385,9 @@ public:
      * \~english
      * \brief Default destructor
      */
-    virtual ~MergeMask() {}
+    virtual ~MergeMask() {
+        delete [] maskLine;
+    }
 
     /** \~french
      * \brief Sortie des informations sur le masque fusionné
@@ -0,0 +1,171 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+/**
+ * \file Metrics.cpp
+ ** \~french
+ * \brief Implémentation des classes Metrics et MetricHistogram
+ ** \~english
+ * \brief Implements classes Metrics and MetricHistogram
+ */
+
+#include "Metrics.h"
+#include <time.h>
+#include <stdio.h>
+
+const double MetricHistogram::bounds[METRICS_NB_BUCKETS] = {
+    0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+
+std::map<std::string, Metrics::Family> Metrics::families;
+pthread_rwlock_t Metrics::lock = PTHREAD_RWLOCK_INITIALIZER;
+
+MetricHistogram::MetricHistogram() : sum ( 0 ) {
+    for ( int i = 0; i <= METRICS_NB_BUCKETS; i++ ) buckets[i] = 0;
+}
+
+void MetricHistogram::observe ( double seconds ) {
+    int i = 0;
+    while ( i < METRICS_NB_BUCKETS && seconds > bounds[i] ) i++;
+    __atomic_fetch_add ( &buckets[i], 1, __ATOMIC_RELAXED );
+    if ( seconds > 0 ) __atomic_fetch_add ( &sum, ( uint64_t ) ( seconds * 1000000 ), __ATOMIC_RELAXED );
+}
+
+void MetricHistogram::print ( std::string& out, std::string name, std::string labels ) {
+    char line[64];
+    std::string sep = labels.empty() ? "" : ",";
+    uint64_t cumul = 0;
+    for ( int i = 0; i <= METRICS_NB_BUCKETS; i++ ) {
+        cumul += __atomic_load_n ( &buckets[i], __ATOMIC_RELAXED );
+        if ( i < METRICS_NB_BUCKETS ) snprintf ( line, sizeof ( line ), "%g", bounds[i] );
+        else snprintf ( line, sizeof ( line ), "+Inf" );
+        out += name + "_bucket{" + labels + sep + "le=\"" + line + "\"} ";
+        snprintf ( line, sizeof ( line ), "%llu\n", ( unsigned long long ) cumul );
+        out += line;
+    }
+    std::string braces = labels.empty() ? "" : "{" + labels + "}";
+    snprintf ( line, sizeof ( line ), " %.6f\n", __atomic_load_n ( &sum, __ATOMIC_RELAXED ) / 1000000. );
+    out += name + "_sum" + braces + line;
+    snprintf ( line, sizeof ( line ), " %llu\n", ( unsigned long long ) cumul );
+    out += name + "_count" + braces + line;
+}
+
+template <typename T>
+T* Metrics::get ( std::map<std::string, T*> Family::* series, std::string type, std::string name, std::string help, std::string labels ) {
+
+    pthread_rwlock_rdlock ( &lock );
+    std::map<std::string, Family>::iterator f = families.find ( name );
+    if ( f != families.end() ) {
+        typename std::map<std::string, T*>::iterator s = ( f->second.*series ).find ( labels );
+        if ( s != ( f->second.*series ).end() ) {
+            T* metric = s->second;
+            pthread_rwlock_unlock ( &lock );
+            return metric;
+        }
+    }
+    pthread_rwlock_unlock ( &lock );
+
+    pthread_rwlock_wrlock ( &lock );
+    Family& family = families[name];
+    if ( family.type.empty() ) {
+        family.type = type;
+        family.help = help;
+    }
+    T*& metric = ( family.*series ) [labels];
+    if ( metric == NULL ) metric = new T();
+    T* result = metric;
+    pthread_rwlock_unlock ( &lock );
+
+    return result;
+}
+
+MetricCounter* Metrics::getCounter ( std::string name, std::string help, std::string labels ) {
+    return get ( &Family::counters, "counter", name, help, labels );
+}
+
+MetricGauge* Metrics::getGauge ( std::string name, std::string help, std::string labels ) {
+    return get ( &Family::gauges, "gauge", name, help, labels );
+}
+
+MetricHistogram* Metrics::getHistogram ( std::string name, std::string help, std::string labels ) {
+    return get ( &Family::histograms, "histogram", name, help, labels );
+}
+
+std::string Metrics::label ( std::string key, std::string value ) {
+    std::string escaped;
+    for ( unsigned int i = 0; i < value.size(); i++ ) {
+        if ( value[i] == '\\' || value[i] == '"' ) escaped += '\\';
+        if ( value[i] == '\n' ) {
+            escaped += "\\n";
+            continue;
+        }
+        escaped += value[i];
+    }
+    return key + "=\"" + escaped + "\"";
+}
+
+double Metrics::now() {
+    struct timespec ts;
+    clock_gettime ( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1000000000.;
+}
+
+std::string Metrics::toPrometheus() {
+    std::string out;
+    char value[32];
+
+    pthread_rwlock_rdlock ( &lock );
+    for ( std::map<std::string, Family>::iterator f = families.begin(); f != families.end(); f++ ) {
+        Family& family = f->second;
+        out += "# HELP " + f->first + " " + family.help + "\n";
+        out += "# TYPE " + f->first + " " + family.type + "\n";
+
+        for ( std::map<std::string, MetricCounter*>::iterator s = family.counters.begin(); s != family.counters.end(); s++ ) {
+            snprintf ( value, sizeof ( value ), " %llu\n", ( unsigned long long ) s->second->get() );
+            out += f->first + ( s->first.empty() ? "" : "{" + s->first + "}" ) + value;
+        }
+        for ( std::map<std::string, MetricGauge*>::iterator s = family.gauges.begin(); s != family.gauges.end(); s++ ) {
+            snprintf ( value, sizeof ( value ), " %lld\n", ( long long ) s->second->get() );
+            out += f->first + ( s->first.empty() ? "" : "{" + s->first + "}" ) + value;
+        }
+        for ( std::map<std::string, MetricHistogram*>::iterator s = family.histograms.begin(); s != family.histograms.end(); s++ ) {
+            s->second->print ( out, f->first, s->first );
+        }
+    }
+    pthread_rwlock_unlock ( &lock );
+
+    return out;
+}
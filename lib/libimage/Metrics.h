@@ -0,0 +1,236 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+/**
+ * \file Metrics.h
+ ** \~french
+ * \brief Définition des classes Metrics, MetricCounter, MetricGauge et MetricHistogram
+ ** \~english
+ * \brief Define classes Metrics, MetricCounter, MetricGauge and MetricHistogram
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <map>
+#include <string>
+
+/**
+ * \~french \brief Nombre de seuils des histogrammes de durée
+ * \~english \brief Number of duration histograms' bounds
+ */
+#define METRICS_NB_BUCKETS 14
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french \brief Compteur monotone, mis à jour sans verrou
+ * \~english \brief Monotonic counter, updated without lock
+ */
+class MetricCounter {
+private:
+    uint64_t value;
+public:
+    MetricCounter() : value ( 0 ) {}
+    void add ( uint64_t n = 1 ) {
+        __atomic_fetch_add ( &value, n, __ATOMIC_RELAXED );
+    }
+    /**
+     * \~french \brief Recopie un compteur tenu ailleurs (au moment de l'export)
+     * \~english \brief Copy a counter held elsewhere (when exporting)
+     */
+    void set ( uint64_t n ) {
+        __atomic_store_n ( &value, n, __ATOMIC_RELAXED );
+    }
+    uint64_t get() {
+        return __atomic_load_n ( &value, __ATOMIC_RELAXED );
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french \brief Jauge, mise à jour sans verrou
+ * \~english \brief Gauge, updated without lock
+ */
+class MetricGauge {
+private:
+    int64_t value;
+public:
+    MetricGauge() : value ( 0 ) {}
+    void add ( int64_t n ) {
+        __atomic_fetch_add ( &value, n, __ATOMIC_RELAXED );
+    }
+    void set ( int64_t n ) {
+        __atomic_store_n ( &value, n, __ATOMIC_RELAXED );
+    }
+    int64_t get() {
+        return __atomic_load_n ( &value, __ATOMIC_RELAXED );
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french \brief Histogramme de durées, mis à jour sans verrou
+ * \details Les seuils vont de 0.5 ms à 10 s, et sont communs à tous les histogrammes
+ * \~english \brief Durations histogram, updated without lock
+ * \details Bounds go from 0.5 ms to 10 s, and are shared by all histograms
+ */
+class MetricHistogram {
+private:
+    /**
+     * \~french \brief Nombre d'observations par intervalle, le dernier étant au delà du dernier seuil
+     * \~english \brief Number of observations per interval, the last one being beyond the last bound
+     */
+    uint64_t buckets[METRICS_NB_BUCKETS + 1];
+    /**
+     * \~french \brief Somme des durées observées, en microsecondes
+     * \~english \brief Observed durations' sum, in microseconds
+     */
+    uint64_t sum;
+
+public:
+    /**
+     * \~french \brief Seuils des intervalles, en secondes
+     * \~english \brief Intervals' bounds, in seconds
+     */
+    static const double bounds[METRICS_NB_BUCKETS];
+
+    MetricHistogram();
+
+    /**
+     * \~french \brief Ajoute une durée observée, en secondes
+     * \~english \brief Add an observed duration, in seconds
+     */
+    void observe ( double seconds );
+
+    /**
+     * \~french \brief Écrit l'histogramme au format texte Prometheus
+     * \~english \brief Write histogram with Prometheus text format
+     */
+    void print ( std::string& out, std::string name, std::string labels );
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Annuaire des métriques du processus
+ * \details Cette classe est prévue pour être utilisée sans instance. Une métrique est identifiée par son nom et ses étiquettes (déjà formatées, par exemple <tt>storage="S3",op="read"</tt>). Elle est créée lors de sa première demande et n'est jamais détruite : le pointeur retourné peut être conservé par l'appelant, et les mises à jour se font ensuite sans verrou. La recherche dans l'annuaire prend un verrou en lecture.
+ *
+ * L'ensemble des métriques est exporté au format texte de Prometheus par #toPrometheus.
+ * \~english
+ * \brief Book of process' metrics
+ * \details This class is designed to be used without instance. A metric is identified by its name and its labels (already formatted, for example <tt>storage="S3",op="read"</tt>). It is created when first requested and never destroyed : returned pointer can be kept by the caller, and updates are then done without lock. Book lookup takes a read lock.
+ *
+ * All metrics are exported with Prometheus text format by #toPrometheus.
+ */
+class Metrics {
+
+private:
+
+    /**
+     * \~french \brief Famille de métriques de même nom
+     * \~english \brief Metrics family with the same name
+     */
+    struct Family {
+        std::string help;
+        std::string type;
+        std::map<std::string, MetricCounter*> counters;
+        std::map<std::string, MetricGauge*> gauges;
+        std::map<std::string, MetricHistogram*> histograms;
+    };
+
+    /**
+     * \~french \brief Familles de métriques, selon leur nom
+     * \~english \brief Metrics families, by name
+     */
+    static std::map<std::string, Family> families;
+
+    /**
+     * \~french \brief Verrou protégeant l'annuaire
+     * \~english \brief Lock protecting the book
+     */
+    static pthread_rwlock_t lock;
+
+    /**
+     * \~french \brief Récupère ou crée une métrique
+     * \~english \brief Get or create a metric
+     */
+    template <typename T>
+    static T* get ( std::map<std::string, T*> Family::* series, std::string type, std::string name, std::string help, std::string labels );
+
+    Metrics() {};
+
+public:
+
+    /**
+     * \~french \brief Récupère ou crée un compteur
+     * \~english \brief Get or create a counter
+     */
+    static MetricCounter* getCounter ( std::string name, std::string help, std::string labels = "" );
+
+    /**
+     * \~french \brief Récupère ou crée une jauge
+     * \~english \brief Get or create a gauge
+     */
+    static MetricGauge* getGauge ( std::string name, std::string help, std::string labels = "" );
+
+    /**
+     * \~french \brief Récupère ou crée un histogramme de durées
+     * \~english \brief Get or create a durations histogram
+     */
+    static MetricHistogram* getHistogram ( std::string name, std::string help, std::string labels = "" );
+
+    /**
+     * \~french \brief Formate une étiquette, en échappant sa valeur
+     * \~english \brief Format a label, escaping its value
+     */
+    static std::string label ( std::string key, std::string value );
+
+    /**
+     * \~french \brief Temps monotone, en secondes, pour mesurer des durées
+     * \~english \brief Monotonic time, in seconds, to measure durations
+     */
+    static double now();
+
+    /**
+     * \~french \brief Exporte toutes les métriques au format texte de Prometheus
+     * \~english \brief Export all metrics with Prometheus text format
+     */
+    static std::string toPrometheus();
+};
+
+#endif
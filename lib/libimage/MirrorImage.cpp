@@ -120,7 +120,8 @@ MirrorImage* MirrorImageFactory::createMirrorImage ( Image* pImageSrc, int posit
 template <typename T>
 int MirrorImage::_getline ( T* buffer, int line ) {
     uint32_t line_size=width*channels;
-    T* buf0=new T[sourceImage->getWidth() *channels];
+    ArenaBuffer<T> line0 ( sourceImage->getWidth() *channels );
+    T* buf0 = line0.get();
 
 
     if ( position == 0 ) {
@@ -163,8 +164,6 @@ int MirrorImage::_getline ( T* buffer, int line ) {
 
     }
 
-    delete [] buf0;
-
     return width*channels;
 }
 
@@ -0,0 +1,189 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file PartUploader.cpp
+ ** \~french
+ * \brief Implémentation de la classe PartUploader
+ ** \~english
+ * \brief Implement class PartUploader
+ */
+
+#include "PartUploader.h"
+#include "Logger.h"
+#include "CurlPool.h"
+#include <strings.h>
+
+/**
+ * \~french \brief Récupère l'ETag dans les en-têtes de la réponse
+ * \~english \brief Get ETag in response's headers
+ */
+static size_t etag_callback ( char *buffer, size_t nitems, size_t size, void *userp ) {
+    size_t realsize = size * nitems;
+    if ( realsize > 5 && ! strncasecmp ( buffer, "ETag:", 5 ) ) {
+        std::string* etag = ( std::string* ) userp;
+        etag->assign ( buffer + 5, realsize - 5 );
+        size_t first = etag->find_first_not_of ( " \t" );
+        size_t last = etag->find_last_not_of ( " \t\r\n" );
+        if ( first == std::string::npos ) {
+            etag->clear();
+        } else {
+            *etag = etag->substr ( first, last - first + 1 );
+        }
+    }
+    return realsize;
+}
+
+/**
+ * \~french \brief Ignore le corps de la réponse
+ * \~english \brief Ignore response's body
+ */
+static size_t ignore_callback ( void *contents, size_t size, size_t nmemb, void *userp ) {
+    return size * nmemb;
+}
+
+PartUploader::PartUploader ( int max ) : maxRunning ( max ), failed ( false ) {
+    if ( maxRunning < 1 ) maxRunning = 1;
+}
+
+void* PartUploader::run ( void* arg ) {
+    PartUpload* pu = ( PartUpload* ) arg;
+
+    // Objet curl emprunté : les connexions ouvertes par les envois précédents sont réutilisées
+    CURL* curl = CurlPool::borrowCurl();
+    if ( curl == NULL ) {
+        LOGGER_ERROR ( "Cannot create a curl object to upload the part " << pu->index );
+        return NULL;
+    }
+
+    for ( int attempt = 1; attempt <= PART_UPLOADER_ATTEMPTS && ! pu->success; attempt++ ) {
+        pu->etag.clear();
+
+        curl_easy_setopt ( curl, CURLOPT_HTTPHEADER, pu->headers );
+        curl_easy_setopt ( curl, CURLOPT_URL, pu->url.c_str() );
+        curl_easy_setopt ( curl, CURLOPT_SSL_VERIFYPEER, 0L );
+        curl_easy_setopt ( curl, CURLOPT_CUSTOMREQUEST, "PUT" );
+        curl_easy_setopt ( curl, CURLOPT_POSTFIELDS, pu->data->empty() ? "" : & ( ( * ( pu->data ) ) [0] ) );
+        curl_easy_setopt ( curl, CURLOPT_POSTFIELDSIZE, ( long ) pu->data->size() );
+        curl_easy_setopt ( curl, CURLOPT_HEADERFUNCTION, etag_callback );
+        curl_easy_setopt ( curl, CURLOPT_HEADERDATA, ( void* ) & ( pu->etag ) );
+        curl_easy_setopt ( curl, CURLOPT_WRITEFUNCTION, ignore_callback );
+
+        CURLcode res = curl_easy_perform ( curl );
+        if ( CURLE_OK != res ) {
+            LOGGER_WARN ( "Try " << attempt << " : unable to upload the part " << pu->index << " (" << pu->data->size() << " bytes) to " << pu->url );
+            LOGGER_WARN ( curl_easy_strerror ( res ) );
+            continue;
+        }
+
+        long http_code = 0;
+        curl_easy_getinfo ( curl, CURLINFO_RESPONSE_CODE, &http_code );
+        if ( http_code < 200 || http_code > 299 ) {
+            LOGGER_WARN ( "Try " << attempt << " : unable to upload the part " << pu->index << " (" << pu->data->size() << " bytes) to " << pu->url );
+            LOGGER_WARN ( "Response HTTP code : " << http_code );
+            continue;
+        }
+
+        pu->success = true;
+    }
+
+    CurlPool::giveBackCurl ( curl );
+
+    return NULL;
+}
+
+void PartUploader::join() {
+    PartUpload* pu = running.front();
+    running.pop_front();
+
+    pthread_join ( pu->thread, NULL );
+
+    if ( pu->success ) {
+        LOGGER_DEBUG ( "Part " << pu->index << " uploaded, ETag " << pu->etag );
+        etags[pu->index] = pu->etag;
+    } else {
+        LOGGER_ERROR ( "Unable to upload the part " << pu->index << " to " << pu->url );
+        failed = true;
+    }
+
+    curl_slist_free_all ( pu->headers );
+    delete pu->data;
+    delete pu;
+}
+
+bool PartUploader::upload ( int index, std::vector<char>* data, std::string url, struct curl_slist* headers ) {
+    while ( running.size() >= maxRunning ) {
+        join();
+    }
+
+    if ( failed ) {
+        curl_slist_free_all ( headers );
+        delete data;
+        return false;
+    }
+
+    PartUpload* pu = new PartUpload();
+    pu->index = index;
+    pu->data = data;
+    pu->url = url;
+    pu->headers = headers;
+    pu->success = false;
+
+    if ( pthread_create ( & ( pu->thread ), NULL, PartUploader::run, ( void* ) pu ) != 0 ) {
+        LOGGER_ERROR ( "Cannot create the thread to upload the part " << index );
+        curl_slist_free_all ( headers );
+        delete data;
+        delete pu;
+        failed = true;
+        return false;
+    }
+
+    running.push_back ( pu );
+
+    return true;
+}
+
+bool PartUploader::wait() {
+    while ( ! running.empty() ) {
+        join();
+    }
+    return ! failed;
+}
+
+PartUploader::~PartUploader() {
+    wait();
+}
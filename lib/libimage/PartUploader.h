@@ -0,0 +1,228 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file PartUploader.h
+ ** \~french
+ * \brief Définition de la classe PartUploader
+ ** \~english
+ * \brief Define class PartUploader
+ */
+
+#ifndef PART_UPLOADER_H
+#define PART_UPLOADER_H
+
+#include <pthread.h>
+#include <curl/curl.h>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * \~french \brief Nombre maximal d'envois simultanés de parties, pour un objet
+ * \~english \brief Maximal number of simultaneous parts' uploads, for one object
+ */
+#define PART_UPLOADER_MAX_RUNNING 4
+
+/**
+ * \~french \brief Nombre de tentatives pour l'envoi d'une partie
+ * \~english \brief Attempts number to upload a part
+ */
+#define PART_UPLOADER_ATTEMPTS 3
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Envoi en parallèle des parties d'un objet, par requêtes HTTP PUT
+ * \details Chaque partie est envoyée dans son propre thread, avec un objet curl emprunté à CurlPool pour la durée de l'envoi (les objets propres aux threads ne pouvant être partagés), dont les connexions restent ouvertes pour les envois suivants. Le nombre d'envois simultanés est borné : au delà, #upload attend la fin de l'envoi le plus ancien, ce qui borne aussi la mémoire occupée par les parties en attente.
+ *
+ * L'ETag renvoyé pour chaque partie est conservé, pour constituer le manifeste ou la requête de fin d'envoi.
+ * \~english
+ * \brief Parallel upload of an object's parts, with HTTP PUT requests
+ * \details Each part is uploaded in its own thread, with a curl object borrowed from CurlPool for the upload's duration (objects specific to threads cannot be shared), whose connections stay open for following uploads. Simultaneous uploads' number is bounded : beyond, #upload waits for the oldest upload's end, which also bounds memory used by pending parts.
+ *
+ * ETag returned for each part is kept, to build the manifest or the upload completion request.
+ */
+class PartUploader {
+
+private:
+
+    /**
+     * \~french \brief Envoi d'une partie
+     * \~english \brief Part's upload
+     */
+    struct PartUpload {
+        /**
+         * \~french \brief Indice de la partie
+         * \~english \brief Part's index
+         */
+        int index;
+        /**
+         * \~french \brief Contenu de la partie, libéré à la fin de l'envoi
+         * \~english \brief Part's content, released at the upload's end
+         */
+        std::vector<char>* data;
+        /**
+         * \~french \brief URL de destination
+         * \~english \brief Destination URL
+         */
+        std::string url;
+        /**
+         * \~french \brief En-têtes de la requête, libérés à la fin de l'envoi
+         * \~english \brief Request's headers, released at the upload's end
+         */
+        struct curl_slist* headers;
+        /**
+         * \~french \brief ETag renvoyé
+         * \~english \brief Returned ETag
+         */
+        std::string etag;
+        /**
+         * \~french \brief L'envoi a-t-il réussi
+         * \~english \brief Was upload successful
+         */
+        bool success;
+        /**
+         * \~french \brief Thread d'envoi
+         * \~english \brief Upload thread
+         */
+        pthread_t thread;
+    };
+
+    /**
+     * \~french \brief Envois en cours, du plus ancien au plus récent
+     * \~english \brief Uploads in progress, from the oldest to the newest
+     */
+    std::list<PartUpload*> running;
+
+    /**
+     * \~french \brief ETags des parties envoyées, selon leur indice
+     * \~english \brief Uploaded parts' ETags, by index
+     */
+    std::map<int, std::string> etags;
+
+    /**
+     * \~french \brief Nombre maximal d'envois simultanés
+     * \~english \brief Maximal number of simultaneous uploads
+     */
+    int maxRunning;
+
+    /**
+     * \~french \brief Un des envois a-t-il échoué
+     * \~english \brief Has one of the uploads failed
+     */
+    bool failed;
+
+    /**
+     * \~french \brief Attend la fin de l'envoi le plus ancien
+     * \~english \brief Wait for the oldest upload's end
+     */
+    void join();
+
+    /**
+     * \~french \brief Envoi d'une partie, exécuté dans son propre thread
+     * \~english \brief Part's upload, run in its own thread
+     */
+    static void* run ( void* arg );
+
+public:
+
+    /**
+     * \~french \brief Identifiant de l'envoi en plusieurs parties auprès du système de stockage, s'il en a un
+     * \~english \brief Multipart upload identifier with the storage system, if it has one
+     */
+    std::string uploadId;
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \param[in] max nombre maximal d'envois simultanés
+     * \~english
+     * \brief Constructor
+     * \param[in] max maximal number of simultaneous uploads
+     */
+    PartUploader ( int max = PART_UPLOADER_MAX_RUNNING );
+
+    /**
+     * \~french
+     * \brief Lance l'envoi d'une partie
+     * \details La partie et les en-têtes appartiennent désormais à l'envoyeur.
+     * \param[in] index indice de la partie
+     * \param[in] data contenu de la partie
+     * \param[in] url URL de destination
+     * \param[in] headers en-têtes de la requête PUT
+     * \return faux si un envoi précédent a échoué
+     * \~english
+     * \brief Start a part's upload
+     * \details Part and headers now belong to the uploader.
+     * \param[in] index part's index
+     * \param[in] data part's content
+     * \param[in] url destination URL
+     * \param[in] headers PUT request's headers
+     * \return false if a previous upload failed
+     */
+    bool upload ( int index, std::vector<char>* data, std::string url, struct curl_slist* headers );
+
+    /**
+     * \~french
+     * \brief Attend la fin de tous les envois
+     * \return faux si un des envois a échoué
+     * \~english
+     * \brief Wait for all uploads' end
+     * \return false if one of uploads failed
+     */
+    bool wait();
+
+    /**
+     * \~french \brief ETags des parties envoyées, selon leur indice
+     * \~english \brief Uploaded parts' ETags, by index
+     */
+    std::map<int, std::string>& getEtags() {
+        return etags;
+    }
+
+    /**
+     * \~french \brief Destructeur
+     * \details Attend la fin des envois en cours
+     * \~english \brief Destructor
+     * \details Wait for uploads in progress
+     */
+    ~PartUploader();
+};
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file PartedBuffer.cpp
+ ** \~french
+ * \brief Implémentation de la classe PartedBuffer
+ ** \~english
+ * \brief Implement class PartedBuffer
+ */
+
+#include "PartedBuffer.h"
+#include "Logger.h"
+#include <string.h>
+
+PartedBuffer::PartedBuffer ( int ps ) : partSize ( ps ), length ( 0 ), headTaken ( false ), nextPart ( 1 ) {
+    if ( partSize < 1 ) partSize = PARTED_BUFFER_PART_SIZE;
+}
+
+bool PartedBuffer::write ( const uint8_t* data, int64_t offset, int size ) {
+    if ( offset < 0 || size < 0 ) {
+        LOGGER_ERROR ( "Invalid writing in parted buffer : " << size << " bytes from " << offset );
+        return false;
+    }
+
+    int64_t end = offset + size;
+
+    while ( size > 0 ) {
+        int index = offset / partSize;
+        int inPart = offset - ( int64_t ) index * partSize;
+        int n = partSize - inPart;
+        if ( n > size ) n = size;
+
+        if ( ( index == 0 && headTaken ) || ( index > 0 && index < nextPart ) ) {
+            LOGGER_ERROR ( "Cannot write " << size << " bytes from " << offset << " : part " << index << " has already been sent" );
+            return false;
+        }
+
+        std::vector<char>* part;
+        std::map<int, std::vector<char>*>::iterator it = parts.find ( index );
+        if ( it == parts.end() ) {
+            part = new std::vector<char>();
+            part->reserve ( partSize );
+            parts.insert ( std::pair<int, std::vector<char>*> ( index, part ) );
+        } else {
+            part = it->second;
+        }
+
+        if ( part->size() < inPart + n ) {
+            part->resize ( inPart + n );
+        }
+        memcpy ( & ( ( *part ) [inPart] ), data, n );
+
+        data += n;
+        offset += n;
+        size -= n;
+    }
+
+    if ( end > length ) length = end;
+
+    return true;
+}
+
+bool PartedBuffer::reset() {
+    if ( isStreamed() ) {
+        LOGGER_ERROR ( "Cannot reset a parted buffer whose parts have already been sent" );
+        return false;
+    }
+
+    std::map<int, std::vector<char>*>::iterator it;
+    for ( it = parts.begin(); it != parts.end(); ++it ) {
+        delete it->second;
+    }
+    parts.clear();
+    length = 0;
+
+    return true;
+}
+
+int PartedBuffer::getCompletePart() {
+    if ( nextPart < getPartsNumber() - 1 ) {
+        return nextPart;
+    }
+    return -1;
+}
+
+std::vector<char>* PartedBuffer::takePart ( int index ) {
+    int partsNumber = getPartsNumber();
+    if ( index >= partsNumber || ( index == 0 && headTaken ) || ( index > 0 && index != nextPart ) ) {
+        LOGGER_ERROR ( "Cannot take the part " << index << " out of the parted buffer" );
+        return NULL;
+    }
+
+    std::vector<char>* part;
+    std::map<int, std::vector<char>*>::iterator it = parts.find ( index );
+    if ( it == parts.end() ) {
+        part = new std::vector<char>();
+    } else {
+        part = it->second;
+        parts.erase ( it );
+    }
+
+    // Partie complétée par des zéros jusqu'à sa fin, ou celle de l'objet
+    if ( index == partsNumber - 1 ) {
+        part->resize ( length - ( int64_t ) index * partSize );
+    } else {
+        part->resize ( partSize );
+    }
+
+    if ( index == 0 ) {
+        headTaken = true;
+    } else {
+        nextPart++;
+    }
+
+    return part;
+}
+
+PartedBuffer::~PartedBuffer() {
+    std::map<int, std::vector<char>*>::iterator it;
+    for ( it = parts.begin(); it != parts.end(); ++it ) {
+        delete it->second;
+    }
+}
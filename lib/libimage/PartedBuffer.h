@@ -0,0 +1,211 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file PartedBuffer.h
+ ** \~french
+ * \brief Définition de la classe PartedBuffer
+ ** \~english
+ * \brief Define class PartedBuffer
+ */
+
+#ifndef PARTED_BUFFER_H
+#define PARTED_BUFFER_H
+
+#include <stdint.h>// pour uint8_t
+#include <map>
+#include <vector>
+
+/**
+ * \~french \brief Taille par défaut d'une partie, en octets
+ * \details Doit rester supérieure à la taille minimale d'une partie d'un envoi S3 en plusieurs parties (5 Mo)
+ * \~english \brief Default part's size, in bytes
+ * \details Has to stay greater than the minimal part's size of a S3 multipart upload (5 MB)
+ */
+#define PARTED_BUFFER_PART_SIZE 8388608
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Buffer d'écriture d'un objet, découpé en parties de taille fixe
+ * \details Les écritures peuvent se faire à n'importe quelle position. Une partie est considérée comme complète dès qu'une écriture a lieu au delà de sa fin : elle peut alors être retirée du buffer (#takePart) pour être envoyée au système de stockage, et n'est plus modifiable. La première partie fait exception : elle reste dans le buffer jusqu'à ce qu'on la retire explicitement, puisque les en-têtes (celui des dalles ROK4 et leur index) y sont écrits en dernier.
+ *
+ * La mémoire utilisée est ainsi bornée par la première partie et la partie en cours de remplissage, dès lors que les écritures après la première partie se font dans l'ordre.
+ * \~english
+ * \brief Object's writing buffer, split into fixed size parts
+ * \details Writings can be done at any position. A part is considered complete as soon as a writing occurs beyond its end : it can then be taken out of the buffer (#takePart) to be sent to the storage system, and cannot be modified anymore. The first part is an exception : it stays in the buffer until it is explicitly taken, because headers (ROK4 slab's one and its index) are written last into it.
+ *
+ * Used memory is thus bounded by the first part and the part being filled, as long as writings after the first part are done in order.
+ */
+class PartedBuffer {
+
+private:
+
+    /**
+     * \~french \brief Taille d'une partie, en octets
+     * \~english \brief Part's size, in bytes
+     */
+    int partSize;
+
+    /**
+     * \~french \brief Taille de l'objet, fin de l'écriture la plus lointaine
+     * \~english \brief Object's size, end of the farthest writing
+     */
+    int64_t length;
+
+    /**
+     * \~french \brief Parties présentes dans le buffer, selon leur indice
+     * \details Une partie absente et non retirée n'a encore reçu aucune écriture : elle est nulle
+     * \~english \brief Parts in the buffer, by index
+     * \details A missing and not taken part has not received any writing yet : it is null
+     */
+    std::map<int, std::vector<char>*> parts;
+
+    /**
+     * \~french \brief La première partie a-t-elle été retirée
+     * \~english \brief Has the first part been taken
+     */
+    bool headTaken;
+
+    /**
+     * \~french \brief Indice de la prochaine partie à retirer, hors première partie
+     * \details Les parties sont retirées dans l'ordre : toutes celles d'indice compris entre 1 et #nextPart exclu l'ont été
+     * \~english \brief Index of the next part to take, first part excepted
+     * \details Parts are taken in order : all those whose index is between 1 and #nextPart excluded have been
+     */
+    int nextPart;
+
+public:
+
+    /**
+     * \~french
+     * \brief Crée un buffer vide
+     * \param[in] ps taille d'une partie, en octets
+     * \~english
+     * \brief Create an empty buffer
+     * \param[in] ps part's size, in bytes
+     */
+    PartedBuffer ( int ps = PARTED_BUFFER_PART_SIZE );
+
+    /**
+     * \~french
+     * \brief Écrit de la donnée dans le buffer
+     * \return faux si l'écriture touche une partie déjà retirée
+     * \~english
+     * \brief Write data into the buffer
+     * \return false if writing touches an already taken part
+     */
+    bool write ( const uint8_t* data, int64_t offset, int size );
+
+    /**
+     * \~french
+     * \brief Vide le buffer, pour une réécriture complète de l'objet
+     * \return faux si une partie a déjà été retirée
+     * \~english
+     * \brief Empty the buffer, for a full object's writing
+     * \return false if a part has already been taken
+     */
+    bool reset();
+
+    /**
+     * \~french
+     * \brief Indice de la prochaine partie complète à retirer
+     * \details Ni la première partie, ni la dernière ne sont jamais complètes
+     * \return l'indice de la partie, -1 s'il n'y en a pas
+     * \~english
+     * \brief Index of the next complete part to take
+     * \details Neither first part nor last one are ever complete
+     * \return part's index, -1 if there is none
+     */
+    int getCompletePart();
+
+    /**
+     * \~french
+     * \brief Retire une partie du buffer
+     * \details La partie retournée appartient à l'appelant. Elle fait exactement la taille d'une partie, sauf la dernière qui s'arrête à la fin de l'objet. Hors première partie, les parties doivent être retirées dans l'ordre.
+     * \param[in] index indice de la partie, 0 ou #nextPart
+     * \return la partie, NULL si l'indice n'est pas valide
+     * \~english
+     * \brief Take a part out of the buffer
+     * \details Returned part belongs to the caller. Its size is exactly part's size, except the last one, which stops at the object's end. First part excepted, parts have to be taken in order.
+     * \param[in] index part's index, 0 or #nextPart
+     * \return the part, NULL if index is not valid
+     */
+    std::vector<char>* takePart ( int index );
+
+    /**
+     * \~french \brief Nombre de parties de l'objet
+     * \~english \brief Object's parts number
+     */
+    int getPartsNumber() {
+        return ( length + partSize - 1 ) / partSize;
+    }
+
+    /**
+     * \~french \brief Indice de la prochaine partie à retirer, hors première partie
+     * \~english \brief Index of the next part to take, first part excepted
+     */
+    int getNextPart() {
+        return nextPart;
+    }
+
+    /**
+     * \~french \brief Taille de l'objet
+     * \~english \brief Object's size
+     */
+    int64_t getLength() {
+        return length;
+    }
+
+    /**
+     * \~french \brief Une partie a-t-elle déjà été retirée
+     * \~english \brief Has a part already been taken
+     */
+    bool isStreamed() {
+        return headTaken || nextPart > 1;
+    }
+
+    /**
+     * \~french \brief Destructeur
+     * \details Les parties encore présentes sont libérées
+     * \~english \brief Destructor
+     * \details Parts still present are released
+     */
+    ~PartedBuffer();
+};
+
+#endif
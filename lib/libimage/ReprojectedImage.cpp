@@ -49,6 +49,7 @@
 #include "Image.h"
 #include "Grid.h"
 #include "Logger.h"
+#include "RequestTrace.h"
 #include "Kernel.h"
 
 #include "Utils.h"
@@ -215,6 +216,8 @@ float* ReprojectedImage::computeDestLine ( int line ) {
     if ( line/4 == dst_line_index ) {
         return dst_image_buffer[line%4];
     }
+
+    TraceScope scope ( TraceStage::RESAMPLE );
     dst_line_index = line/4;
 
     for ( int i = 0; i < 4; i++ ) {
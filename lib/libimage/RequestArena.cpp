@@ -0,0 +1,173 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+/**
+ * \file RequestArena.cpp
+ ** \~french
+ * \brief Implémentation de la classe RequestArena
+ ** \~english
+ * \brief Implements class RequestArena
+ */
+
+#include "RequestArena.h"
+
+/**
+ * \~french \brief Taille minimale d'un bloc de l'arène
+ * \~english \brief Arena chunk's minimal size
+ */
+#define ARENA_CHUNK_SIZE 1048576
+
+/**
+ * \~french \brief Nombre de blocs conservés d'une requête à l'autre
+ * \~english \brief Number of chunks kept from a request to the next
+ */
+#define ARENA_KEPT_CHUNKS 4
+
+/**
+ * \~french \brief Alignement des allocations
+ * \~english \brief Allocations' alignment
+ */
+#define ARENA_ALIGNMENT 16
+
+pthread_key_t RequestArena::arenaKey;
+pthread_once_t RequestArena::arenaOnce = PTHREAD_ONCE_INIT;
+
+static void deleteArena ( void* arena ) {
+    if ( arena ) delete ( RequestArena* ) arena;
+}
+
+void RequestArena::createArenaKey() {
+    pthread_key_create ( &arenaKey, deleteArena );
+}
+
+RequestArena::RequestArena() : current ( 0 ), active ( false ), allocations ( 0 ), peak ( 0 ), used ( 0 ) {}
+
+RequestArena::~RequestArena() {
+    for ( unsigned int i = 0; i < chunks.size(); i++ ) {
+        delete[] chunks[i].data;
+    }
+}
+
+RequestArena* RequestArena::getThreadArena() {
+    pthread_once ( &arenaOnce, createArenaKey );
+    RequestArena* arena = ( RequestArena* ) pthread_getspecific ( arenaKey );
+    if ( arena == NULL ) {
+        arena = new RequestArena();
+        pthread_setspecific ( arenaKey, arena );
+    }
+    return arena;
+}
+
+void RequestArena::begin() {
+    RequestArena* arena = getThreadArena();
+    arena->active = true;
+    arena->allocations = 0;
+    arena->peak = 0;
+}
+
+void RequestArena::end() {
+    RequestArena* arena = getThreadArena();
+    arena->active = false;
+    arena->current = 0;
+    arena->used = 0;
+    for ( unsigned int i = 0; i < arena->chunks.size(); i++ ) {
+        arena->chunks[i].used = 0;
+    }
+    // Les blocs supplémentaires d'une grosse requête ne sont pas conservés
+    while ( arena->chunks.size() > ARENA_KEPT_CHUNKS ) {
+        delete[] arena->chunks.back().data;
+        arena->chunks.pop_back();
+    }
+}
+
+size_t RequestArena::getCapacity() {
+    size_t capacity = 0;
+    for ( unsigned int i = 0; i < chunks.size(); i++ ) {
+        capacity += chunks[i].size;
+    }
+    return capacity;
+}
+
+void* RequestArena::allocate ( size_t size ) {
+    if ( ! active ) return NULL;
+
+    size = ( size + ARENA_ALIGNMENT - 1 ) & ~ ( ( size_t ) ARENA_ALIGNMENT - 1 );
+    if ( size == 0 ) size = ARENA_ALIGNMENT;
+
+    // On avance jusqu'au premier bloc pouvant contenir l'allocation
+    while ( current < chunks.size() && chunks[current].size - chunks[current].used < size ) {
+        if ( chunks[current].used == 0 ) {
+            // Bloc conservé mais trop petit : on le remplace
+            delete[] chunks[current].data;
+            chunks.erase ( chunks.begin() + current );
+        } else {
+            current++;
+        }
+    }
+
+    if ( current == chunks.size() ) {
+        Chunk c;
+        c.size = ( size > ARENA_CHUNK_SIZE ) ? size : ARENA_CHUNK_SIZE;
+        c.data = new uint8_t[c.size];
+        c.used = 0;
+        chunks.push_back ( c );
+    }
+
+    Chunk& c = chunks[current];
+    void* ptr = c.data + c.used;
+    c.used += size;
+
+    allocations++;
+    used += size;
+    if ( used > peak ) peak = used;
+
+    return ptr;
+}
+
+void RequestArena::release ( void* ptr, size_t size ) {
+    if ( ! active || current >= chunks.size() ) return;
+
+    size = ( size + ARENA_ALIGNMENT - 1 ) & ~ ( ( size_t ) ARENA_ALIGNMENT - 1 );
+    if ( size == 0 ) size = ARENA_ALIGNMENT;
+
+    Chunk& c = chunks[current];
+    if ( c.used >= size && ( uint8_t* ) ptr == c.data + c.used - size ) {
+        // Dernière allocation : la place est récupérée
+        c.used -= size;
+        used -= size;
+        if ( c.used == 0 && current > 0 ) current--;
+    }
+}
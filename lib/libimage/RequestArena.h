@@ -0,0 +1,276 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+/**
+ * \file RequestArena.h
+ ** \~french
+ * \brief Définition des classes RequestArena et ArenaBuffer
+ ** \~english
+ * \brief Define classes RequestArena and ArenaBuffer
+ */
+
+#ifndef REQUESTARENA_H
+#define REQUESTARENA_H
+
+#include <stdint.h>// pour uint8_t
+#include <stddef.h>
+#include <pthread.h>
+#include <vector>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Arène mémoire d'une requête
+ * \details Chaque thread possède sa propre arène, conservée d'une requête à l'autre. Entre #begin et #end, les tampons de travail de la chaîne de traitement (lignes temporaires des getline) sont pris dans l'arène par simple incrément d'un pointeur, au lieu d'un new[] / delete[] par ligne et par image. Un tampon libéré dans l'ordre inverse de son allocation (cas des variables locales) rend immédiatement sa place. #end remet l'arène à zéro en une fois, en ne conservant que les premiers blocs pour la requête suivante.
+ *
+ * En dehors d'une requête (outils de génération, tests), l'arène est inactive et les ArenaBuffer utilisent le tas.
+ * \~english
+ * \brief Request memory arena
+ * \details Each thread owns its arena, kept from a request to the next. Between #begin and #end, processing chain's work buffers (getline temporary lines) are taken from the arena by a simple pointer increment, instead of one new[] / delete[] per line and per image. A buffer released in reverse allocation order (local variables case) gives back its place immediately. #end resets the arena at once, keeping only the first chunks for the next request.
+ *
+ * Outside a request (generation tools, tests), arena is inactive and ArenaBuffer use the heap.
+ */
+class RequestArena {
+
+private:
+
+    /**
+     * \~french \brief Bloc mémoire de l'arène
+     * \~english \brief Arena's memory chunk
+     */
+    struct Chunk {
+        uint8_t* data;
+        size_t size;
+        size_t used;
+    };
+
+    /**
+     * \~french \brief Blocs de l'arène
+     * \~english \brief Arena's chunks
+     */
+    std::vector<Chunk> chunks;
+
+    /**
+     * \~french \brief Indice du bloc courant
+     * \~english \brief Current chunk's index
+     */
+    unsigned int current;
+
+    /**
+     * \~french \brief Une requête est-elle en cours
+     * \~english \brief Is a request in progress
+     */
+    bool active;
+
+    /**
+     * \~french \brief Nombre d'allocations dans l'arène depuis le dernier #begin
+     * \~english \brief Number of allocations in the arena since the last #begin
+     */
+    uint64_t allocations;
+
+    /**
+     * \~french \brief Occupation maximale de l'arène depuis le dernier #begin, en octets
+     * \~english \brief Arena's peak usage since the last #begin, in bytes
+     */
+    size_t peak;
+
+    /**
+     * \~french \brief Occupation courante de l'arène, en octets
+     * \details Tenue à jour à chaque allocation et libération, pour ne pas parcourir les blocs
+     * \~english \brief Arena's current usage, in bytes
+     * \details Kept up to date on each allocation and release, so that chunks are not walked
+     */
+    size_t used;
+
+    /**
+     * \~french \brief Clé de l'arène propre à chaque thread
+     * \~english \brief Key of each thread's own arena
+     */
+    static pthread_key_t arenaKey;
+
+    /**
+     * \~french \brief Création unique de #arenaKey
+     * \~english \brief Single creation of #arenaKey
+     */
+    static pthread_once_t arenaOnce;
+
+    /**
+     * \~french \brief Crée #arenaKey
+     * \~english \brief Create #arenaKey
+     */
+    static void createArenaKey();
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \~english
+     * \brief Constructeur
+     */
+    RequestArena();
+
+public:
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \details Appelé à la fin du thread
+     * \~english
+     * \brief Destructor
+     * \details Called at thread's end
+     */
+    ~RequestArena();
+
+    /**
+     * \~french \brief Retourne l'arène du thread courant, créée si besoin
+     * \~english \brief Return the current thread's arena, created if needed
+     */
+    static RequestArena* getThreadArena();
+
+    /**
+     * \~french \brief Active l'arène du thread courant pour une nouvelle requête
+     * \~english \brief Enable the current thread's arena for a new request
+     */
+    static void begin();
+
+    /**
+     * \~french \brief Remet à zéro l'arène du thread courant à la fin d'une requête
+     * \details Tous les tampons pris dans l'arène deviennent invalides
+     * \~english \brief Reset the current thread's arena at a request's end
+     * \details All buffers taken in the arena become invalid
+     */
+    static void end();
+
+    /**
+     * \~french \brief Une requête est-elle en cours
+     * \~english \brief Is a request in progress
+     */
+    bool isActive() {
+        return active;
+    }
+
+    /**
+     * \~french \brief Alloue size octets dans l'arène
+     * \return NULL si l'arène est inactive
+     * \~english \brief Allocate size bytes in the arena
+     * \return NULL if arena is inactive
+     */
+    void* allocate ( size_t size );
+
+    /**
+     * \~french \brief Rend une allocation à l'arène
+     * \details La place n'est récupérée que s'il s'agit de la dernière allocation, sinon à la fin de la requête
+     * \~english \brief Give an allocation back to the arena
+     * \details Place is recovered only if it's the last allocation, otherwise at the request's end
+     */
+    void release ( void* ptr, size_t size );
+
+    /**
+     * \~french \brief Nombre d'allocations dans l'arène depuis le début de la requête
+     * \~english \brief Number of allocations in the arena since the request's beginning
+     */
+    uint64_t getAllocations() {
+        return allocations;
+    }
+
+    /**
+     * \~french \brief Occupation maximale de l'arène depuis le début de la requête, en octets
+     * \~english \brief Arena's peak usage since the request's beginning, in bytes
+     */
+    size_t getPeak() {
+        return peak;
+    }
+
+    /**
+     * \~french \brief Taille totale des blocs de l'arène, en octets
+     * \~english \brief Arena's chunks total size, in bytes
+     */
+    size_t getCapacity();
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Tampon de travail pris dans l'arène de la requête
+ * \details Le tampon est pris dans l'arène du thread courant si une requête est en cours, dans le tas sinon. Il est rendu à sa destruction. Il est destiné à être utilisé comme variable locale, pour que les libérations se fassent dans l'ordre inverse des allocations.
+ * \~english
+ * \brief Work buffer taken from the request's arena
+ * \details Buffer is taken in the current thread's arena if a request is in progress, in the heap otherwise. It is given back when destroyed. It is designed to be used as a local variable, for releases to be done in the reverse order of allocations.
+ */
+template <typename T>
+class ArenaBuffer {
+
+private:
+
+    T* data;
+    size_t size;
+    RequestArena* arena;
+
+    ArenaBuffer ( const ArenaBuffer& );
+    ArenaBuffer& operator= ( const ArenaBuffer& );
+
+public:
+
+    /**
+     * \~french \brief Crée un tampon de n éléments
+     * \~english \brief Create a buffer of n elements
+     */
+    ArenaBuffer ( size_t n ) : size ( n * sizeof ( T ) ), arena ( RequestArena::getThreadArena() ) {
+        data = ( T* ) arena->allocate ( size );
+        if ( data == NULL ) {
+            arena = NULL;
+            data = new T[n];
+        }
+    }
+
+    ~ArenaBuffer() {
+        if ( arena ) arena->release ( data, size );
+        else delete[] data;
+    }
+
+    /**
+     * \~french \brief Accès au tampon
+     * \~english \brief Buffer access
+     */
+    T* get() {
+        return data;
+    }
+
+    operator T* () {
+        return data;
+    }
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+/**
+ * \file RequestTileSet.cpp
+ ** \~french
+ * \brief Implémentation des classes RequestTileSet et SharedTileDataSource
+ ** \~english
+ * \brief Implements classes RequestTileSet and SharedTileDataSource
+ */
+
+#include "RequestTileSet.h"
+
+pthread_key_t RequestTileSet::setKey;
+pthread_once_t RequestTileSet::setOnce = PTHREAD_ONCE_INIT;
+
+static void deleteSet ( void* set ) {
+    if ( set ) delete ( RequestTileSet* ) set;
+}
+
+void RequestTileSet::createSetKey() {
+    pthread_key_create ( &setKey, deleteSet );
+}
+
+RequestTileSet::~RequestTileSet() {
+    std::map<std::string, SharedTile*>::iterator it;
+    for ( it = tiles.begin(); it != tiles.end(); it++ ) {
+        if ( it->second ) release ( it->second );
+    }
+}
+
+RequestTileSet* RequestTileSet::getThreadSet() {
+    pthread_once ( &setOnce, createSetKey );
+    RequestTileSet* set = ( RequestTileSet* ) pthread_getspecific ( setKey );
+    if ( set == NULL ) {
+        set = new RequestTileSet();
+        pthread_setspecific ( setKey, set );
+    }
+    return set;
+}
+
+void RequestTileSet::release ( SharedTile* tile ) {
+    if ( __atomic_sub_fetch ( &tile->users, 1, __ATOMIC_ACQ_REL ) > 0 ) return;
+    delete tile->source;
+    pthread_mutex_destroy ( &tile->mutex );
+    delete tile;
+}
+
+void RequestTileSet::begin() {
+    getThreadSet()->active = true;
+}
+
+void RequestTileSet::end() {
+    RequestTileSet* set = getThreadSet();
+    set->active = false;
+    std::map<std::string, SharedTile*>::iterator it;
+    for ( it = set->tiles.begin(); it != set->tiles.end(); it++ ) {
+        if ( it->second ) release ( it->second );
+    }
+    set->tiles.clear();
+}
+
+bool RequestTileSet::isActive() {
+    return getThreadSet()->active;
+}
+
+bool RequestTileSet::get ( std::string key, DataSource*& source ) {
+    source = NULL;
+    RequestTileSet* set = getThreadSet();
+    if ( ! set->active ) return false;
+
+    std::map<std::string, SharedTile*>::iterator it = set->tiles.find ( key );
+    if ( it == set->tiles.end() ) return false;
+
+    if ( it->second ) {
+        __atomic_add_fetch ( &it->second->users, 1, __ATOMIC_ACQ_REL );
+        source = new SharedTileDataSource ( it->second );
+    }
+    return true;
+}
+
+DataSource* RequestTileSet::add ( std::string key, DataSource* source ) {
+    RequestTileSet* set = getThreadSet();
+    if ( ! set->active || set->tiles.find ( key ) != set->tiles.end() ) return source;
+
+    if ( source == NULL ) {
+        set->tiles.insert ( std::pair<std::string, SharedTile*> ( key, NULL ) );
+        return NULL;
+    }
+
+    // Une référence pour l'ensemble, une pour la source rendue
+    SharedTile* tile = new SharedTile();
+    tile->source = source;
+    tile->data = NULL;
+    tile->size = 0;
+    tile->loaded = false;
+    tile->users = 2;
+    pthread_mutex_init ( &tile->mutex, NULL );
+    set->tiles.insert ( std::pair<std::string, SharedTile*> ( key, tile ) );
+
+    return new SharedTileDataSource ( tile );
+}
+
+const uint8_t* SharedTileDataSource::getData ( size_t &size ) {
+    pthread_mutex_lock ( &tile->mutex );
+    if ( ! tile->loaded ) {
+        tile->data = tile->source->getData ( tile->size );
+        if ( tile->data == NULL ) tile->size = 0;
+        tile->loaded = true;
+    }
+    size = tile->size;
+    const uint8_t* data = tile->data;
+    pthread_mutex_unlock ( &tile->mutex );
+    return data;
+}
+
+unsigned int SharedTileDataSource::getLength() {
+    pthread_mutex_lock ( &tile->mutex );
+    unsigned int length = tile->loaded ? tile->size : tile->source->getLength();
+    pthread_mutex_unlock ( &tile->mutex );
+    return length;
+}
@@ -0,0 +1,270 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+/**
+ * \file RequestTileSet.h
+ ** \~french
+ * \brief Définition des classes RequestTileSet et SharedTileDataSource
+ ** \~english
+ * \brief Define classes RequestTileSet and SharedTileDataSource
+ */
+
+#ifndef REQUESTTILESET_H
+#define REQUESTTILESET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <map>
+#include <string>
+#include "Data.h"
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Ensemble des tuiles lues pour une requête
+ * \details Une requête calculée par bandes construit plusieurs chaînes de traitement identiques (cf StripImage), qui lisent les mêmes tuiles. Entre #begin et #end, le niveau enregistre dans l'ensemble du thread courant chaque tuile qu'il lit : les chaînes suivantes reçoivent une nouvelle référence sur la même source au lieu de relire et décoder la tuile. La tuile n'est ainsi lue qu'une fois dans le stockage et présente une seule fois en mémoire, quel que soit le nombre de chaînes.
+ *
+ * Les sources partagées restent valides après #end, jusqu'à la destruction de leur dernière référence.
+ * \~english
+ * \brief Set of the tiles read for a request
+ * \details A request computed by strips builds several identical processing chains (see StripImage), reading the same tiles. Between #begin and #end, the level records each tile it reads in the current thread's set : following chains get a new reference on the same source instead of reading and decoding the tile again. The tile is thus read once from the storage and present once in memory, whatever the chains' count.
+ *
+ * Shared sources stay valid after #end, until their last reference is destroyed.
+ */
+class RequestTileSet {
+
+    friend class SharedTileDataSource;
+
+private:
+
+    /**
+     * \~french \brief Tuile partagée entre plusieurs sources
+     * \~english \brief Tile shared between several sources
+     */
+    struct SharedTile {
+        /**
+         * \~french \brief Source décodant la tuile
+         * \~english \brief Source decoding the tile
+         */
+        DataSource* source;
+        /**
+         * \~french \brief Donnée décodée, lue une seule fois
+         * \~english \brief Decoded data, read only once
+         */
+        const uint8_t* data;
+        size_t size;
+        bool loaded;
+        /**
+         * \~french \brief Nombre de références (sources et ensemble)
+         * \~english \brief References' count (sources and set)
+         */
+        int users;
+        /**
+         * \~french \brief Protège la première lecture, les chaînes étant calculées en parallèle
+         * \~english \brief Protect the first reading, chains being computed in parallel
+         */
+        pthread_mutex_t mutex;
+    };
+
+    /**
+     * \~french \brief Tuiles lues depuis le dernier #begin, par clé (cf Level::getTileKey). Une tuile absente du stockage est enregistrée avec un pointeur nul.
+     * \~english \brief Tiles read since the last #begin, by key (see Level::getTileKey). A tile missing from the storage is recorded with a null pointer.
+     */
+    std::map<std::string, SharedTile*> tiles;
+
+    /**
+     * \~french \brief L'ensemble enregistre-t-il les tuiles lues
+     * \~english \brief Does the set record read tiles
+     */
+    bool active;
+
+    /**
+     * \~french \brief Clé de l'ensemble propre à chaque thread
+     * \~english \brief Key of each thread's own set
+     */
+    static pthread_key_t setKey;
+
+    /**
+     * \~french \brief Création unique de #setKey
+     * \~english \brief Single creation of #setKey
+     */
+    static pthread_once_t setOnce;
+
+    /**
+     * \~french \brief Crée #setKey
+     * \~english \brief Create #setKey
+     */
+    static void createSetKey();
+
+    /**
+     * \~french \brief Retourne l'ensemble du thread courant, créé si besoin
+     * \~english \brief Return the current thread's set, created if needed
+     */
+    static RequestTileSet* getThreadSet();
+
+    /**
+     * \~french \brief Lâche une référence sur la tuile, libérée avec la dernière
+     * \~english \brief Drop a reference on the tile, released with the last one
+     */
+    static void release ( SharedTile* tile );
+
+    /**
+     * \~french \brief Constructeur
+     * \~english \brief Constructor
+     */
+    RequestTileSet() : active ( false ) {}
+
+public:
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \details Appelé à la fin du thread
+     * \~english
+     * \brief Destructor
+     * \details Called at thread's end
+     */
+    ~RequestTileSet();
+
+    /**
+     * \~french \brief Commence l'enregistrement des tuiles lues par le thread courant
+     * \~english \brief Start recording tiles read by the current thread
+     */
+    static void begin();
+
+    /**
+     * \~french \brief Arrête l'enregistrement et lâche les références de l'ensemble
+     * \~english \brief Stop recording and drop the set's references
+     */
+    static void end();
+
+    /**
+     * \~french \brief L'ensemble du thread courant enregistre-t-il les tuiles lues
+     * \~english \brief Does the current thread's set record read tiles
+     */
+    static bool isActive();
+
+    /**
+     * \~french
+     * \brief Recherche une tuile déjà lue
+     * \param[in] key clé de la tuile
+     * \param[out] source nouvelle référence sur la tuile, NULL si la tuile est absente du stockage
+     * \return vrai si la tuile a déjà été lue depuis #begin
+     * \~english
+     * \brief Look for an already read tile
+     * \param[in] key tile's key
+     * \param[out] source new reference on the tile, NULL if tile is missing from the storage
+     * \return true if tile has already been read since #begin
+     */
+    static bool get ( std::string key, DataSource*& source );
+
+    /**
+     * \~french
+     * \brief Enregistre une tuile lue
+     * \param[in] key clé de la tuile
+     * \param[in] source source décodant la tuile, confiée à l'ensemble, NULL si la tuile est absente du stockage
+     * \return une référence sur la tuile à utiliser à la place de source, NULL si source est NULL
+     * \~english
+     * \brief Record a read tile
+     * \param[in] key tile's key
+     * \param[in] source source decoding the tile, given to the set, NULL if tile is missing from the storage
+     * \return a reference on the tile to use instead of source, NULL if source is NULL
+     */
+    static DataSource* add ( std::string key, DataSource* source );
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Référence sur une tuile partagée entre les chaînes de traitement d'une requête
+ * \details La tuile est lue et décodée à la première lecture de l'une de ses références, puis conservée jusqu'à la destruction de la dernière.
+ * \~english
+ * \brief Reference on a tile shared between a request's processing chains
+ * \details Tile is read and decoded at the first reading of one of its references, then kept until the last one is destroyed.
+ */
+class SharedTileDataSource : public DataSource {
+
+    friend class RequestTileSet;
+
+private:
+
+    /**
+     * \~french \brief Tuile partagée référencée
+     * \~english \brief Referenced shared tile
+     */
+    RequestTileSet::SharedTile* tile;
+
+    /**
+     * \~french \brief Constructeur, la tuile étant déjà référencée
+     * \~english \brief Constructor, tile being already referenced
+     */
+    SharedTileDataSource ( RequestTileSet::SharedTile* tile ) : tile ( tile ) {}
+
+public:
+
+    const uint8_t* getData ( size_t &size );
+
+    bool releaseData() {
+        // Les autres références utilisent peut-être encore la donnée : elle n'est libérée qu'avec la dernière
+        return true;
+    }
+
+    std::string getType() {
+        return tile->source->getType();
+    }
+    int getHttpStatus() {
+        return tile->source->getHttpStatus();
+    }
+    std::string getEncoding() {
+        return tile->source->getEncoding();
+    }
+    unsigned int getLength();
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \details La tuile partagée est déréférencée
+     * \~english
+     * \brief Destructor
+     * \details Shared tile is dereferenced
+     */
+    ~SharedTileDataSource() {
+        RequestTileSet::release ( tile );
+    }
+};
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file RequestTrace.cpp
+ ** \~french
+ * \brief Implémentation des classes RequestTrace et TraceScope et du namespace TraceStage
+ ** \~english
+ * \brief Implements classes RequestTrace and TraceScope and the namespace TraceStage
+ */
+
+#include "RequestTrace.h"
+#include "Metrics.h"
+#include "Logger.h"
+#include <cstdio>
+#include <unistd.h>
+#include <sstream>
+
+namespace TraceStage {
+
+const char *traceStageName[] = {
+    "parse",
+    "level",
+    "read",
+    "decode",
+    "resample",
+    "style",
+    "encode",
+    "send"
+};
+
+const char* toString ( eTraceStage stage ) {
+    return traceStageName[stage];
+}
+}
+
+pthread_key_t RequestTrace::traceKey;
+pthread_once_t RequestTrace::traceOnce = PTHREAD_ONCE_INIT;
+uint64_t RequestTrace::idCount = 0;
+
+static void deleteTrace ( void* trace ) {
+    if ( trace ) delete ( RequestTrace* ) trace;
+}
+
+void RequestTrace::createTraceKey() {
+    pthread_key_create ( &traceKey, deleteTrace );
+}
+
+RequestTrace::RequestTrace() : id ( "" ), active ( false ), serverTiming ( false ), logged ( false ), start ( 0 ), current ( NULL ) {
+    for ( int i = 0; i < TraceStage::nbTraceStages; i++ ) {
+        durations[i] = 0;
+        counts[i] = 0;
+    }
+}
+
+RequestTrace* RequestTrace::getThreadTrace() {
+    pthread_once ( &traceOnce, createTraceKey );
+    RequestTrace* trace = ( RequestTrace* ) pthread_getspecific ( traceKey );
+    if ( trace == NULL ) {
+        trace = new RequestTrace();
+        pthread_setspecific ( traceKey, trace );
+    }
+    return trace;
+}
+
+std::string RequestTrace::newId() {
+    std::ostringstream oss;
+    oss << getpid() << "-" << __atomic_add_fetch ( &idCount, 1, __ATOMIC_RELAXED );
+    return oss.str();
+}
+
+bool RequestTrace::isValidId ( const char* id ) {
+    if ( id == NULL || id[0] == '\0' ) return false;
+    for ( int i = 0; id[i] != '\0'; i++ ) {
+        if ( i >= REQUEST_ID_MAX_LENGTH ) return false;
+        char c = id[i];
+        if ( ! ( ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' ) || c == '.' || c == '_' || c == '-' ) ) return false;
+    }
+    return true;
+}
+
+void RequestTrace::begin ( std::string id, bool serverTiming, bool logged ) {
+    RequestTrace* trace = getThreadTrace();
+    trace->id = id;
+    trace->serverTiming = serverTiming;
+    trace->logged = logged;
+    trace->active = serverTiming || logged;
+    trace->current = NULL;
+    for ( int i = 0; i < TraceStage::nbTraceStages; i++ ) {
+        trace->durations[i] = 0;
+        trace->counts[i] = 0;
+    }
+    if ( trace->active ) trace->start = Metrics::now();
+}
+
+void RequestTrace::end() {
+    RequestTrace* trace = getThreadTrace();
+
+    if ( trace->logged ) {
+        char value[32];
+        std::ostringstream oss;
+        snprintf ( value, 32, "%.3f", ( Metrics::now() - trace->start ) * 1000 );
+        oss << "Trace " << trace->id << " : total=" << value << "ms";
+        for ( int i = 0; i < TraceStage::nbTraceStages; i++ ) {
+            if ( trace->counts[i] == 0 ) continue;
+            snprintf ( value, 32, "%.3f", trace->durations[i] * 1000 );
+            oss << " " << TraceStage::toString ( ( TraceStage::eTraceStage ) i ) << "=" << value << "ms(" << trace->counts[i] << ")";
+        }
+        LOGGER_INFO ( oss.str() );
+    }
+
+    trace->id = "";
+    trace->active = false;
+    trace->serverTiming = false;
+    trace->logged = false;
+    trace->current = NULL;
+}
+
+void RequestTrace::add ( TraceStage::eTraceStage stage, double duration ) {
+    RequestTrace* trace = getThreadTrace();
+    if ( ! trace->active ) return;
+    trace->durations[stage] += duration;
+    trace->counts[stage]++;
+}
+
+std::string RequestTrace::getId() {
+    return getThreadTrace()->id;
+}
+
+std::string RequestTrace::getServerTiming() {
+    RequestTrace* trace = getThreadTrace();
+    if ( ! trace->serverTiming ) return "";
+
+    char value[32];
+    std::ostringstream oss;
+    for ( int i = 0; i < TraceStage::nbTraceStages; i++ ) {
+        if ( trace->counts[i] == 0 ) continue;
+        snprintf ( value, 32, "%.3f", trace->durations[i] * 1000 );
+        oss << TraceStage::toString ( ( TraceStage::eTraceStage ) i ) << ";dur=" << value << ";desc=\"" << trace->counts[i] << "\", ";
+    }
+    snprintf ( value, 32, "%.3f", ( Metrics::now() - trace->start ) * 1000 );
+    oss << "total;dur=" << value << ", request;desc=\"" << trace->id << "\"";
+    return oss.str();
+}
+
+TraceScope::TraceScope ( TraceStage::eTraceStage stage ) : trace ( RequestTrace::getThreadTrace() ), stage ( stage ), parent ( NULL ), start ( 0 ), children ( 0 ) {
+    if ( ! trace->active ) {
+        trace = NULL;
+        return;
+    }
+    parent = trace->current;
+    trace->current = this;
+    start = Metrics::now();
+}
+
+TraceScope::~TraceScope() {
+    if ( trace == NULL ) return;
+    double elapsed = Metrics::now() - start;
+    trace->durations[stage] += elapsed - children;
+    trace->counts[stage]++;
+    if ( parent ) parent->children += elapsed;
+    trace->current = parent;
+}
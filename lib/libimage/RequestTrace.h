@@ -0,0 +1,327 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file RequestTrace.h
+ ** \~french
+ * \brief Définition des classes RequestTrace et TraceScope et du namespace TraceStage
+ ** \~english
+ * \brief Define classes RequestTrace and TraceScope and the namespace TraceStage
+ */
+
+#ifndef REQUESTTRACE_H
+#define REQUESTTRACE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+
+/**
+ * \~french \brief Longueur maximale d'un identifiant de requête fourni par le client
+ * \~english \brief Maximal length of a request identifier provided by the client
+ */
+#define REQUEST_ID_MAX_LENGTH 64
+
+/**
+ * \~french \brief Gestion des étapes de traitement d'une requête
+ * \~english \brief Manage request processing stages
+ */
+namespace TraceStage {
+/**
+ * \~french \brief Énumération des étapes
+ * \~english \brief Available stages
+ */
+enum eTraceStage {
+    PARSE,
+    LEVEL,
+    READ,
+    DECODE,
+    RESAMPLE,
+    STYLE,
+    ENCODE,
+    SEND
+};
+
+/**
+ * \~french \brief Nombre d'étapes
+ * \~english \brief Number of stages
+ */
+const int nbTraceStages = 8;
+
+/**
+ * \~french \brief Conversion d'une étape vers une chaîne de caractères
+ * \param[in] stage étape à convertir
+ * \return la chaîne de caractère nommant l'étape
+ * \~english \brief Convert a stage to a string
+ * \param[in] stage stage to convert
+ * \return string namming the stage
+ */
+const char* toString ( eTraceStage stage );
+}
+
+class TraceScope;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Suivi des durées des étapes d'une requête
+ * \details Chaque thread possède sa propre trace. Entre #begin et #end, les TraceScope placés dans la chaîne de traitement cumulent le temps passé dans chaque étape (lecture du stockage, décodage, rééchantillonnage...). Les étapes s'imbriquent, la chaîne de traitement étant paresseuse (l'encodeur tire les lignes de l'image reprojetée qui lit les tuiles) : le temps d'une étape exclut celui des étapes qu'elle englobe, la somme des étapes donne donc le temps total mesuré.
+ *
+ * Le suivi peut être renvoyé au client dans l'en-tête Server-Timing, qui ne contient que les étapes terminées à l'envoi des en-têtes, et/ou écrit dans les logs pour une requête sur N. En dehors d'une requête suivie, un TraceScope ne coûte qu'une lecture de la trace du thread.
+ *
+ * L'identifiant de la requête est conservé même sans suivi, pour être repris dans les logs des lectures sur le stockage.
+ * \~english
+ * \brief Request stages' durations tracking
+ * \details Each thread owns its trace. Between #begin and #end, TraceScope placed in the processing chain sum up time spent in each stage (storage read, decoding, resampling...). Stages are nested, processing chain being lazy (encoder pulls lines from the reprojected image which reads tiles) : a stage's time excludes the time of stages it contains, so the stages' sum is the measured total time.
+ *
+ * Tracking can be sent back to the client in the Server-Timing header, which only contains stages done when headers are sent, and/or written in logs for one request out of N. Outside a tracked request, a TraceScope only costs a read of the thread's trace.
+ *
+ * Request's identifier is kept even without tracking, to be written in storage reads' logs.
+ */
+class RequestTrace {
+
+    friend class TraceScope;
+
+private:
+
+    /**
+     * \~french \brief Identifiant de la requête en cours
+     * \~english \brief Current request's identifier
+     */
+    std::string id;
+
+    /**
+     * \~french \brief Les durées sont-elles suivies
+     * \~english \brief Are durations tracked
+     */
+    bool active;
+
+    /**
+     * \~french \brief Le suivi est-il renvoyé dans l'en-tête Server-Timing
+     * \~english \brief Is tracking sent back in the Server-Timing header
+     */
+    bool serverTiming;
+
+    /**
+     * \~french \brief Le suivi est-il écrit dans les logs à la fin de la requête
+     * \~english \brief Is tracking written in logs at the request's end
+     */
+    bool logged;
+
+    /**
+     * \~french \brief Début de la requête, en secondes (horloge monotone)
+     * \~english \brief Request's beginning, in seconds (monotonic clock)
+     */
+    double start;
+
+    /**
+     * \~french \brief Temps passé dans chaque étape, en secondes
+     * \~english \brief Time spent in each stage, in seconds
+     */
+    double durations[TraceStage::nbTraceStages];
+
+    /**
+     * \~french \brief Nombre de passages dans chaque étape
+     * \~english \brief Number of passes in each stage
+     */
+    unsigned int counts[TraceStage::nbTraceStages];
+
+    /**
+     * \~french \brief Étape en cours la plus imbriquée
+     * \~english \brief Innermost current stage
+     */
+    TraceScope* current;
+
+    /**
+     * \~french \brief Clé de la trace propre à chaque thread
+     * \~english \brief Key of each thread's own trace
+     */
+    static pthread_key_t traceKey;
+
+    /**
+     * \~french \brief Création unique de #traceKey
+     * \~english \brief Single creation of #traceKey
+     */
+    static pthread_once_t traceOnce;
+
+    /**
+     * \~french \brief Crée #traceKey
+     * \~english \brief Create #traceKey
+     */
+    static void createTraceKey();
+
+    /**
+     * \~french \brief Compteur des identifiants générés
+     * \~english \brief Generated identifiers' counter
+     */
+    static uint64_t idCount;
+
+    /**
+     * \~french
+     * \brief Constructeur
+     * \~english
+     * \brief Constructeur
+     */
+    RequestTrace();
+
+public:
+
+    /**
+     * \~french \brief Retourne la trace du thread courant, créée si besoin
+     * \~english \brief Return the current thread's trace, created if needed
+     */
+    static RequestTrace* getThreadTrace();
+
+    /**
+     * \~french \brief Génère un identifiant de requête unique, de la forme <pid>-<numéro>
+     * \~english \brief Generate a unique request identifier, like <pid>-<number>
+     */
+    static std::string newId();
+
+    /**
+     * \~french \brief Contrôle un identifiant de requête fourni par le client (en-tête X-Request-Id)
+     * \details Repris dans les logs et l'en-tête Server-Timing, il ne doit contenir que des lettres, chiffres, '.', '_' ou '-', dans la limite de #REQUEST_ID_MAX_LENGTH caractères
+     * \return vrai si l'identifiant peut être utilisé tel quel
+     * \~english \brief Check a request identifier provided by the client (X-Request-Id header)
+     * \details Written in logs and the Server-Timing header, it must only contain letters, digits, '.', '_' or '-', with at most #REQUEST_ID_MAX_LENGTH characters
+     * \return true if the identifier can be used as is
+     */
+    static bool isValidId ( const char* id );
+
+    /**
+     * \~french \brief Commence le suivi d'une nouvelle requête sur le thread courant
+     * \param[in] id identifiant de la requête
+     * \param[in] serverTiming le suivi doit-il être renvoyé dans l'en-tête Server-Timing
+     * \param[in] logged le suivi doit-il être écrit dans les logs
+     * \~english \brief Start tracking a new request on the current thread
+     * \param[in] id request's identifier
+     * \param[in] serverTiming have tracking to be sent back in the Server-Timing header
+     * \param[in] logged have tracking to be written in logs
+     */
+    static void begin ( std::string id, bool serverTiming, bool logged );
+
+    /**
+     * \~french \brief Termine la requête du thread courant, en écrivant le suivi dans les logs si demandé
+     * \~english \brief End the current thread's request, writing tracking in logs if asked
+     */
+    static void end();
+
+    /**
+     * \~french \brief Ajoute une durée à une étape de la requête du thread courant, hors de tout TraceScope
+     * \~english \brief Add a duration to a stage of the current thread's request, outside any TraceScope
+     */
+    static void add ( TraceStage::eTraceStage stage, double duration );
+
+    /**
+     * \~french \brief Identifiant de la requête du thread courant, vide hors requête
+     * \~english \brief Current thread's request's identifier, empty outside a request
+     */
+    static std::string getId();
+
+    /**
+     * \~french \brief Valeur de l'en-tête Server-Timing pour la requête du thread courant
+     * \return les durées des étapes déjà passées en millisecondes, vide si l'en-tête n'est pas demandé
+     * \~english \brief Server-Timing header value for the current thread's request
+     * \return durations of stages already done in milliseconds, empty if header is not asked
+     */
+    static std::string getServerTiming();
+
+    /**
+     * \~french \brief Durée cumulée d'une étape, en secondes
+     * \~english \brief Cumulated duration of a stage, in seconds
+     */
+    double getDuration ( TraceStage::eTraceStage stage ) {
+        return durations[stage];
+    }
+
+    /**
+     * \~french \brief Nombre de passages dans une étape
+     * \~english \brief Number of passes in a stage
+     */
+    unsigned int getCount ( TraceStage::eTraceStage stage ) {
+        return counts[stage];
+    }
+
+    /**
+     * \~french \brief Les durées sont-elles suivies
+     * \~english \brief Are durations tracked
+     */
+    bool isActive() {
+        return active;
+    }
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Mesure d'une étape de la requête
+ * \details Le temps écoulé entre la construction et la destruction est ajouté à l'étape, diminué du temps des TraceScope imbriqués. Destiné à être utilisé comme variable locale.
+ * \~english
+ * \brief Request stage's measure
+ * \details Time elapsed between construction and destruction is added to the stage, minus the time of nested TraceScope. Designed to be used as a local variable.
+ */
+class TraceScope {
+
+    friend class RequestTrace;
+
+private:
+
+    RequestTrace* trace;
+    TraceStage::eTraceStage stage;
+    TraceScope* parent;
+    double start;
+    double children;
+
+    TraceScope ( const TraceScope& );
+    TraceScope& operator= ( const TraceScope& );
+
+public:
+
+    /**
+     * \~french \brief Commence la mesure d'une étape
+     * \~english \brief Start a stage's measure
+     */
+    TraceScope ( TraceStage::eTraceStage stage );
+
+    /**
+     * \~french \brief Termine la mesure de l'étape
+     * \~english \brief End the stage's measure
+     */
+    ~TraceScope();
+};
+
+#endif
@@ -45,6 +45,7 @@
 
 #include "ResampledImage.h"
 #include "Logger.h"
+#include "RequestTrace.h"
 #include "Utils.h"
 #include <tiff.h>
 #include <cmath>
@@ -269,6 +270,7 @@ int ResampledImage::resampleSourceLine ( int line ) {
 
 int ResampledImage::getline ( float* buffer, int line ) {
 
+    TraceScope scope ( TraceStage::RESAMPLE );
     float weights[Ky];
 
     // On calcule les coefficient d'interpolation
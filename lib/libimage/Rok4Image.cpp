@@ -58,6 +58,9 @@
 #include "Logger.h"
 #include "Utils.h"
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
 #include <iostream>
 #include <string>
 #include <algorithm>
@@ -495,12 +498,13 @@ Rok4Image::Rok4Image ( std::string n, int tpw, int tph, Context* c ) :
 /* ------------------------------------------- LECTURE -------------------------------------------- */
 /* ------------------------------------------------------------------------------------------------ */
 
-uint8_t* Rok4Image::memorizeRawTile ( size_t& size, int tile )
+uint8_t* Rok4Image::memorizeRawTile ( size_t& size, int tile, StoreDataSource* encData )
 {    
 
     if ( tile < 0 || tile >= tilesNumber ) {
         LOGGER_ERROR ( "Unvalid tile's indice (" << tile << "). Have to be between 0 and " << tilesNumber-1 );
         size = 0;
+        if ( encData ) delete encData;
         return NULL;
     }
 
@@ -512,7 +516,9 @@ uint8_t* Rok4Image::memorizeRawTile ( size_t& size, int tile )
         /* la tuile n'est pas mémorisée, on doit la récupérer et la stocker dans memorizedTiles */
         LOGGER_DEBUG ( "Not memorized tile (" << tile << "). We read, decompress, and memorize it");
 
-        StoreDataSource* encData = new StoreDataSource (name.c_str(), tilesOffset[tile], tilesByteCounts[tile], "", context);
+        if ( encData == NULL ) {
+            encData = new StoreDataSource (name.c_str(), tilesOffset[tile], tilesByteCounts[tile], "", context);
+        }
 
         DataSource* decData;
         size_t tmpSize;
@@ -565,6 +571,8 @@ uint8_t* Rok4Image::memorizeRawTile ( size_t& size, int tile )
         memorizedIndex[index] = tile;
 
         delete decData;
+    } else if ( encData ) {
+        delete encData;
     }
 
     return memorizedTiles[index];
@@ -613,6 +621,25 @@ int Rok4Image::getRawTile ( uint8_t* buf, int tile )
     return tileSize;
 }
 
+std::vector<StoreDataSource*> Rok4Image::prefetchTiles ( int tileRow, int firstTileCol, int lastTileCol ) {
+    std::vector<StoreDataSource*> sources ( lastTileCol - firstTileCol + 1, ( StoreDataSource* ) NULL );
+    std::vector<StoreDataSource*> toRead;
+
+    for ( int tileCol = firstTileCol; tileCol <= lastTileCol; tileCol++ ) {
+        int tile = tileRow * tileWidthwise + tileCol;
+        if ( memorizedIndex[tile % memorySize] != tile ) {
+            sources[tileCol - firstTileCol] = new StoreDataSource ( name.c_str(), tilesOffset[tile], tilesByteCounts[tile], "", context );
+            toRead.push_back ( sources[tileCol - firstTileCol] );
+        }
+    }
+
+    if ( toRead.size() > 1 ) {
+        StoreDataSource::prefetch ( toRead );
+    }
+
+    return sources;
+}
+
 template <typename T>
 int Rok4Image::_getline ( T* buffer, int line ) {
     int tileRow = line / tileHeight;
@@ -624,9 +651,11 @@ int Rok4Image::_getline ( T* buffer, int line ) {
     // Taille d'une ligne de tuile en nombre de case de type T
     int typetTileLineSize = tileWidth * pixelSize / sizeof(T);
 
+    std::vector<StoreDataSource*> sources = prefetchTiles ( tileRow, 0, tileWidthwise - 1 );
+
     // On mémorise toutes les tuiles qui seront nécessaires pour constituer la ligne
     for ( int tileCol = 0; tileCol < tileWidthwise; tileCol++ ) {
-        uint8_t* mem = memorizeRawTile ( tileSize, tileRow * tileWidthwise + tileCol);
+        uint8_t* mem = memorizeRawTile ( tileSize, tileRow * tileWidthwise + tileCol, sources[tileCol] );
         memcpy ( buffer + tileCol * typetTileLineSize, mem + tileLine * rawTileLineSize, rawTileLineSize );
     }
 
@@ -683,6 +712,92 @@ int Rok4Image::getline ( float* buffer, int line ) {
     return width * channels;
 }
 
+template <typename T>
+int Rok4Image::_getTiledBlock ( T* buffer, int x, int y, int w, int h ) {
+    size_t tileSize;
+
+    // Taille d'un pixel et d'une ligne du bloc en nombre de case de type T
+    int typetPixelSize = pixelSize / sizeof(T);
+    int typetBlockLineSize = w * typetPixelSize;
+
+    // On ne parcourt que les tuiles intersectant le bloc, et on n'en copie que la partie utile
+    for ( int tileRow = y / tileHeight; tileRow <= ( y + h - 1 ) / tileHeight; tileRow++ ) {
+        int firstLine = std::max ( y, tileRow * tileHeight );
+        int lastLine = std::min ( y + h, ( tileRow + 1 ) * tileHeight );
+
+        int firstTileCol = x / tileWidth;
+        int lastTileCol = ( x + w - 1 ) / tileWidth;
+        std::vector<StoreDataSource*> sources = prefetchTiles ( tileRow, firstTileCol, lastTileCol );
+
+        for ( int tileCol = firstTileCol; tileCol <= lastTileCol; tileCol++ ) {
+            int firstCol = std::max ( x, tileCol * tileWidth );
+            int lastCol = std::min ( x + w, ( tileCol + 1 ) * tileWidth );
+
+            uint8_t* mem = memorizeRawTile ( tileSize, tileRow * tileWidthwise + tileCol, sources[tileCol - firstTileCol] );
+            if ( mem == NULL ) {
+                LOGGER_ERROR ( "Cannot read raw tile " << tileRow * tileWidthwise + tileCol << " for block" );
+                for ( int c = tileCol + 1; c <= lastTileCol; c++ ) {
+                    if ( sources[c - firstTileCol] ) delete sources[c - firstTileCol];
+                }
+                return 0;
+            }
+
+            for ( int l = firstLine; l < lastLine; l++ ) {
+                memcpy (
+                    buffer + ( l - y ) * typetBlockLineSize + ( firstCol - x ) * typetPixelSize,
+                    mem + ( l - tileRow * tileHeight ) * rawTileLineSize + ( firstCol - tileCol * tileWidth ) * pixelSize,
+                    ( lastCol - firstCol ) * pixelSize
+                );
+            }
+        }
+    }
+
+    return h * typetBlockLineSize * sizeof(T);
+}
+
+int Rok4Image::getBlock ( uint8_t* buffer, int x, int y, int w, int h ) {
+    if ( ! blockIsValid ( x, y, w, h ) ) return 0;
+    return _getTiledBlock ( buffer, x, y, w, h );
+}
+
+int Rok4Image::getBlock ( uint16_t* buffer, int x, int y, int w, int h ) {
+    if ( ! blockIsValid ( x, y, w, h ) ) return 0;
+
+    if ( bitspersample == 8 && sampleformat == SampleFormat::UINT ) {
+        // On convertit depuis les entiers 8 bits
+        uint8_t* buffer_t = new uint8_t[w*h*channels];
+        int ret = _getTiledBlock ( buffer_t, x, y, w, h );
+        convert ( buffer, buffer_t, w*h*channels );
+        delete [] buffer_t;
+        return ret ? w*h*channels*sizeof(uint16_t) : 0;
+    } else {
+        // Entiers 16 bits, ou flottant sur deux entiers 16 bits
+        return _getTiledBlock ( buffer, x, y, w, h );
+    }
+}
+
+int Rok4Image::getBlock ( float* buffer, int x, int y, int w, int h ) {
+    if ( ! blockIsValid ( x, y, w, h ) ) return 0;
+
+    if ( bitspersample == 8 && sampleformat == SampleFormat::UINT ) {
+        // On convertit depuis les entiers 8 bits
+        uint8_t* buffer_t = new uint8_t[w*h*channels];
+        int ret = _getTiledBlock ( buffer_t, x, y, w, h );
+        convert ( buffer, buffer_t, w*h*channels );
+        delete [] buffer_t;
+        return ret ? w*h*channels*sizeof(float) : 0;
+    } else if ( bitspersample == 16 && sampleformat == SampleFormat::UINT ) {
+        // On convertit depuis les entiers 16 bits
+        uint16_t* buffer_t = new uint16_t[w*h*channels];
+        int ret = _getTiledBlock ( buffer_t, x, y, w, h );
+        convert ( buffer, buffer_t, w*h*channels );
+        delete [] buffer_t;
+        return ret ? w*h*channels*sizeof(float) : 0;
+    } else { // float
+        return _getTiledBlock ( buffer, x, y, w, h );
+    }
+}
+
 bool Rok4Image::loadIndex()
 {
 
@@ -712,6 +827,55 @@ bool Rok4Image::loadIndex()
 /* ------------------------------------------- ECRITURE ------------------------------------------- */
 /* ------------------------------------------------------------------------------------------------ */
 
+/**
+ * \~french
+ * \brief Image dont les données sont dans un buffer mémoire, au format de l'image ROK4 à écrire
+ * \details Permet l'écriture d'une image ROK4 depuis un buffer, via #Rok4Image::writeImage(Image*, bool). Le buffer n'est ni copié ni détruit.
+ * \~english
+ * \brief Image whose data is in a memory buffer, in the written ROK4 image format
+ */
+class BufferImage : public Image {
+private:
+    /** \~french Données de l'image, ligne par ligne */
+    uint8_t* data;
+    /** \~french Taille en octet d'une ligne */
+    int lineSize;
+
+    int _getline ( void* buffer, int line ) {
+        memcpy ( buffer, data + ( size_t ) line * lineSize, lineSize );
+        return width * channels;
+    }
+
+public:
+    BufferImage ( int width, int height, int channels, int pixelSize, uint8_t* data ) :
+        Image ( width, height, channels ), data ( data ), lineSize ( width * pixelSize ) {}
+
+    int getline ( uint8_t* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+    int getline ( uint16_t* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+    int getline ( float* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+};
+
+int Rok4Image::writeImage ( uint8_t* buffer, bool crop ) {
+    BufferImage bufferImage ( width, height, channels, pixelSize, buffer );
+    return writeImage ( &bufferImage, crop );
+}
+
+int Rok4Image::writeImage ( uint16_t* buffer ) {
+    BufferImage bufferImage ( width, height, channels, pixelSize, ( uint8_t* ) buffer );
+    return writeImage ( &bufferImage, false );
+}
+
+int Rok4Image::writeImage ( float* buffer ) {
+    BufferImage bufferImage ( width, height, channels, pixelSize, ( uint8_t* ) buffer );
+    return writeImage ( &bufferImage, false );
+}
+
 /** \todo Écriture d'images ROK4 en JPEG gris */
 int Rok4Image::writeImage ( Image* pIn, bool crop )
 {
@@ -744,12 +908,10 @@ int Rok4Image::writeImage ( Image* pIn, bool crop )
         uint8_t* lines = new uint8_t[tileHeight*imageLineSize];
 
         for ( int y = 0; y < tileHeightwise; y++ ) {
-            // On récupère toutes les lignes pour cette ligne de tuiles
-            for (int lig = 0; lig < tileHeight; lig++) {
-                if (pIn->getline(lines + lig*imageLineSize, y*tileHeight + lig) == 0) {
-                    LOGGER_ERROR("Error reading the source image's line " << y*tileHeight + lig);
-                    return -1;                    
-                }
+            // On récupère toutes les lignes pour cette ligne de tuiles, en un bloc
+            if (pIn->getBlock(lines, 0, y*tileHeight, width, tileHeight) == 0) {
+                LOGGER_ERROR("Error reading the source image's lines " << y*tileHeight << " to " << (y+1)*tileHeight - 1);
+                return -1;
             }
             for ( int x = 0; x < tileWidthwise; x++ ) {
                 // On constitue la tuile
@@ -770,12 +932,10 @@ int Rok4Image::writeImage ( Image* pIn, bool crop )
         uint16_t* lines = new uint16_t[tileHeight*imageLineSize];
         
         for ( int y = 0; y < tileHeightwise; y++ ) {
-            // On récupère toutes les lignes pour cette ligne de tuiles
-            for (int lig = 0; lig < tileHeight; lig++) {
-                if (pIn->getline(lines + lig*imageLineSize, y*tileHeight + lig) == 0) {
-                    LOGGER_ERROR("Error reading the source image's line " << y*tileHeight + lig);
-                    return -1;                    
-                }
+            // On récupère toutes les lignes pour cette ligne de tuiles, en un bloc
+            if (pIn->getBlock(lines, 0, y*tileHeight, width, tileHeight) == 0) {
+                LOGGER_ERROR("Error reading the source image's lines " << y*tileHeight << " to " << (y+1)*tileHeight - 1);
+                return -1;
             }
             for ( int x = 0; x < tileWidthwise; x++ ) {
                 // On constitue la tuile
@@ -796,12 +956,10 @@ int Rok4Image::writeImage ( Image* pIn, bool crop )
         float* lines = new float[tileHeight*imageLineSize];
         
         for ( int y = 0; y < tileHeightwise; y++ ) {
-            // On récupère toutes les lignes pour cette ligne de tuiles
-            for (int lig = 0; lig < tileHeight; lig++) {
-                if (pIn->getline(lines + lig*imageLineSize, y*tileHeight + lig) == 0) {
-                    LOGGER_ERROR("Error reading the source image's line " << y*tileHeight + lig);
-                    return -1;                    
-                }
+            // On récupère toutes les lignes pour cette ligne de tuiles, en un bloc
+            if (pIn->getBlock(lines, 0, y*tileHeight, width, tileHeight) == 0) {
+                LOGGER_ERROR("Error reading the source image's lines " << y*tileHeight << " to " << (y+1)*tileHeight - 1);
+                return -1;
             }
             for ( int x = 0; x < tileWidthwise; x++ ) {
                 // On constitue la tuile
@@ -835,7 +993,24 @@ int Rok4Image::writeImage ( Image* pIn, bool crop )
     return 0;
 }
 
-int Rok4Image::writePbfTiles ( int ulTileCol, int ulTileRow, char* rootDirectory )
+/**
+ * \~french \brief Lecture d'une tuile PBF, exécutée par un pool de threads
+ * \~english \brief PBF tile reading, run by a threads pool
+ */
+class PbfReadTask : public Task {
+    std::string path;
+    std::string* data;
+    int* status;
+    bool gzip;
+public:
+    PbfReadTask ( std::string path, std::string* data, int* status, bool gzip ) : path ( path ), data ( data ), status ( status ), gzip ( gzip ) {}
+    void run() {
+        *status = Rok4Image::readPbfFile ( path.c_str(), *data );
+        if ( *status == 1 && gzip && ! Rok4Image::gzipPbf ( *data ) ) *status = -1;
+    }
+};
+
+int Rok4Image::writePbfTiles ( int ulTileCol, int ulTileRow, char* rootDirectory, ThreadPool* pool, bool gzip )
 {
 
     if (! isVector) {
@@ -854,18 +1029,44 @@ int Rok4Image::writePbfTiles ( int ulTileCol, int ulTileRow, char* rootDirectory
         return -1;
     }
 
+    // Lecture de toutes les tuiles de la dalle, en parallèle si possible : c'est l'ouverture des nombreux petits fichiers qui coûte
+    std::vector<std::string> paths ( tilesNumber );
+    std::vector<std::string> tiles ( tilesNumber );
+    std::vector<int> status ( tilesNumber, 0 );
     char pbfpath [512];
     for (int row = 0; row < tileHeightwise; row++) {
         for ( int col = 0; col < tileWidthwise; col++ ) {
             // Constitution du chemin de la tuile PBF à écrire en l'état dans la dalle
             sprintf (pbfpath, "%s/%d/%d.pbf", rootDirectory, ulTileCol + col, ulTileRow + row);
-            LOGGER_DEBUG("Slabization of pbf tile " << pbfpath);
-
-            if (! writeTile(row * tileWidthwise + col, pbfpath)) {
-                LOGGER_ERROR("Error writting PBF tile " << pbfpath);
-                return -1;
+            int tileInd = row * tileWidthwise + col;
+            paths.at(tileInd) = pbfpath;
+            PbfReadTask* task = new PbfReadTask ( paths.at(tileInd), &tiles.at(tileInd), &status.at(tileInd), gzip );
+            if ( pool ) {
+                pool->submit ( task );
+            } else {
+                task->run();
+                delete task;
             }
-        }   
+        }
+    }
+    if ( pool ) pool->wait();
+
+    // Les tuiles sont accumulées puis écrites à la suite de l'index, en une seule écriture
+    bufferedWrite = true;
+
+    for ( int tileInd = 0; tileInd < tilesNumber; tileInd++ ) {
+        LOGGER_DEBUG("Slabization of pbf tile " << paths.at(tileInd));
+
+        if ( status.at(tileInd) < 0 || ( status.at(tileInd) == 1 && tiles.at(tileInd).empty() ) ) {
+            LOGGER_ERROR("Error writting PBF tile " << paths.at(tileInd));
+            return -1;
+        }
+
+        if (! writeTileData ( tileInd, (uint8_t*) tiles.at(tileInd).data(), tiles.at(tileInd).size() )) {
+            LOGGER_ERROR("Error writting PBF tile " << paths.at(tileInd));
+            return -1;
+        }
+        std::string().swap ( tiles.at(tileInd) );
     }
 
 
@@ -1013,6 +1214,10 @@ bool Rok4Image::prepareBuffers()
     memset ( tilesOffset, 0, tilesNumber*4 );
     memset ( tilesByteCounts, 0, tilesNumber*4 );
     position = ROK4_IMAGE_HEADER_SIZE + 8 * tilesNumber;
+    writtenTiles.clear();
+    writtenTilesMemory = 0;
+    bufferedWrite = false;
+    slabData.clear();
 
     if (! isVector) {
         int quality = 0;
@@ -1067,6 +1272,13 @@ bool Rok4Image::writeFinal() {
     context->write((uint8_t*) tilesOffset, ROK4_IMAGE_HEADER_SIZE, 4 * tilesNumber, std::string(name));
     context->write((uint8_t*) tilesByteCounts, ROK4_IMAGE_HEADER_SIZE + 4 * tilesNumber, 4 * tilesNumber, std::string(name));
 
+    if ( bufferedWrite && ! slabData.empty() ) {
+        if (! context->write((uint8_t*) slabData.data(), ROK4_IMAGE_HEADER_SIZE + 8 * tilesNumber, slabData.size(), std::string(name))) {
+            LOGGER_ERROR("Unable to write tiles in " << name);
+            return false;
+        }
+    }
+
     if (! context->closeToWrite(name)) {
         LOGGER_ERROR("Unable to close output " << name);
         return false;
@@ -1077,6 +1289,10 @@ bool Rok4Image::writeFinal() {
 
 bool Rok4Image::cleanBuffers() {
 
+    writtenTiles.clear();
+    writtenTilesMemory = 0;
+    std::string().swap ( slabData );
+
     if (! isVector) {
         delete[] Buffer;
         if ( compression == Compression::PNG || compression == Compression::DEFLATE ) {
@@ -1127,27 +1343,7 @@ bool Rok4Image::writeTile( int tileInd, uint8_t* data, bool crop )
 
     if ( size == 0 ) return false;
 
-    if ( tilesNumber == 1 ) {
-
-        uint8_t* uint32tab = new uint8_t[sizeof( uint32_t )];
-        *((uint32_t*) uint32tab) = ( uint32_t ) size;
-        context->write(uint32tab, 134, 4, std::string(name));
-        delete uint32tab;
-
-    }
-
-    tilesOffset[tileInd] = position;
-    tilesByteCounts[tileInd] = size;
-
-    boolean ret = context->write(Buffer, position, size, std::string(name));
-
-    if (! ret) {
-        LOGGER_ERROR("Impossible to write the tile " << tileInd);
-        return false;
-    }
-    position = ( position + size + 15 ) & ~15; // Align the next position on 16byte
-
-    return true;
+    return writeTileData ( tileInd, Buffer, size );
 }
 
 // Vector write tile in a slab
@@ -1159,56 +1355,125 @@ bool Rok4Image::writeTile( int tileInd, char* pbfpath )
         return false;
     }
 
-    std::ifstream::pos_type data_size;
-    std::vector<char> data;
-    std::ifstream ifs(pbfpath, std::ios::binary|std::ios::ate);
+    std::string data;
+    int status = readPbfFile ( pbfpath, data );
+    if ( status < 0 ) return false;
+    // Une tuile absente est référencée avec une taille nulle, une tuile vide est une erreur
+    if ( status == 1 && data.empty() ) return false;
 
-    if (! ifs.is_open()) {
-        LOGGER_DEBUG("Cannot open PBF tile " << pbfpath);
-        data_size = 0;
-    } else {
+    return writeTileData ( tileInd, (uint8_t*) data.data(), data.size() );
+}
 
-        data_size = ifs.tellg();
+bool Rok4Image::gzipPbf ( std::string& data )
+{
+    // Tuile déjà compressée en gzip (nombre magique 1f 8b) : gardée telle quelle
+    if ( data.size() >= 2 && ( uint8_t ) data[0] == 0x1f && ( uint8_t ) data[1] == 0x8b ) return true;
 
-        if (ifs.bad()) {
-            LOGGER_ERROR("Error reading size fo PBF tile " << pbfpath);
-            return false;
-        }
+    z_stream gzstream;
+    memset ( &gzstream, 0, sizeof ( gzstream ) );
+    if ( deflateInit2 ( &gzstream, Z_BEST_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY ) != Z_OK ) {
+        LOGGER_ERROR("Cannot initialize gzip compression of PBF tile");
+        return false;
+    }
 
-        data.resize(data_size);
+    std::string compressed ( deflateBound ( &gzstream, data.size() ), '\0' );
+    gzstream.next_in = ( uint8_t* ) data.data();
+    gzstream.avail_in = data.size();
+    gzstream.next_out = ( uint8_t* ) &compressed[0];
+    gzstream.avail_out = compressed.size();
+    int ret = deflate ( &gzstream, Z_FINISH );
+    deflateEnd ( &gzstream );
+    if ( ret != Z_STREAM_END ) {
+        LOGGER_ERROR("Gzip compression of PBF tile failed : " << ret);
+        return false;
+    }
 
-        ifs.seekg(0, std::ios::beg);
-        ifs.read(data.data(), data_size);
+    compressed.resize ( gzstream.total_out );
+    data.swap ( compressed );
+    return true;
+}
 
-        if (ifs.bad()) {
-            LOGGER_ERROR("Error reading PBF tile " << pbfpath);
-            return false;
-        }
+int Rok4Image::readPbfFile ( const char* pbfpath, std::string& data )
+{
+    int fd = open ( pbfpath, O_RDONLY );
+    if ( fd < 0 ) {
+        LOGGER_DEBUG("Cannot open PBF tile " << pbfpath);
+        data.clear();
+        return 0;
+    }
 
-        ifs.close();
+    struct stat st;
+    if ( fstat ( fd, &st ) < 0 ) {
+        LOGGER_ERROR("Error reading size fo PBF tile " << pbfpath);
+        close ( fd );
+        return -1;
+    }
 
-        if ( data_size == 0 ) return false;
+    data.resize ( st.st_size );
+    size_t done = 0;
+    while ( done < data.size() ) {
+        ssize_t r = read ( fd, &data[done], data.size() - done );
+        if ( r < 0 && errno == EINTR ) continue;
+        if ( r <= 0 ) {
+            LOGGER_ERROR("Error reading PBF tile " << pbfpath);
+            close ( fd );
+            return -1;
+        }
+        done += r;
     }
 
+    close ( fd );
+    return 1;
+}
+
+bool Rok4Image::writeTileData ( int tileInd, uint8_t* data, size_t size )
+{
     if ( tilesNumber == 1 ) {
 
         uint8_t* uint32tab = new uint8_t[sizeof( uint32_t )];
-        *((uint32_t*) uint32tab) = ( uint32_t ) data_size;
+        *((uint32_t*) uint32tab) = ( uint32_t ) size;
         context->write(uint32tab, 134, 4, std::string(name));
         delete uint32tab;
 
     }
 
+    // Tuile identique à une tuile déjà écrite (tout en nodata, mer uniforme, PBF vide...) : on pointe sur ses octets
+    uint32_t crc = 0;
+    if ( tilesNumber > 1 && size > 0 ) {
+        crc = crc32 ( 0, data, size );
+        std::pair<std::multimap<uint32_t, std::pair<int, std::string> >::iterator, std::multimap<uint32_t, std::pair<int, std::string> >::iterator> range = writtenTiles.equal_range ( crc );
+        for ( std::multimap<uint32_t, std::pair<int, std::string> >::iterator it = range.first; it != range.second; ++it ) {
+            const std::string& written = it->second.second;
+            if ( written.size() == size && memcmp ( written.data(), data, size ) == 0 ) {
+                tilesOffset[tileInd] = tilesOffset[it->second.first];
+                tilesByteCounts[tileInd] = size;
+                return true;
+            }
+        }
+    }
+
     tilesOffset[tileInd] = position;
-    tilesByteCounts[tileInd] = data_size;
+    tilesByteCounts[tileInd] = size;
 
-    boolean ret = context->write((uint8_t*) data.data(), position, data_size, std::string(name));
+    boolean ret = true;
+    if ( bufferedWrite ) {
+        size_t start = position - ( ROK4_IMAGE_HEADER_SIZE + 8 * tilesNumber );
+        slabData.resize ( start );
+        slabData.append ( ( char* ) data, size );
+    } else {
+        ret = context->write(data, position, size, std::string(name));
+    }
 
     if (! ret) {
         LOGGER_ERROR("Impossible to write the tile " << tileInd);
         return false;
     }
-    position = ( position + data_size + 15 ) & ~15; // Align the next position on 16byte
+    position = ( position + size + 15 ) & ~15; // Align the next position on 16byte
+
+    if ( tilesNumber > 1 && size > 0 && writtenTilesMemory + size <= ROK4_IMAGE_DEDUP_MEMORY ) {
+        writtenTiles.insert ( std::make_pair ( crc, std::make_pair ( tileInd, std::string ( ( char* ) data, size ) ) ) );
+        writtenTilesMemory += size;
+    }
 
     return true;
 }
@@ -61,11 +61,18 @@
 #include "FileImage.h"
 #include "Context.h"
 #include "StoreDataSource.h"
+#include "ThreadPool.h"
+#include <map>
 
 #define ROK4_IMAGE_HEADER_SIZE 2048
 #define ROK4_SYMLINK_SIGNATURE_SIZE 8
 #define ROK4_SYMLINK_SIGNATURE "SYMLINK#"
 #define JPEG_BLOC_SIZE 16
+/**
+ * \~french \brief Mémoire maximale conservée pour la déduplication des tuiles d'une dalle
+ * \~english \brief Maximal memory kept for a slab's tiles deduplication
+ */
+#define ROK4_IMAGE_DEDUP_MEMORY 16777216
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -87,6 +94,7 @@
 class Rok4Image : public Image {
 
     friend class Rok4ImageFactory;
+    friend class PbfReadTask;
 
 private:
 
@@ -138,6 +146,44 @@ private:
      */
     uint32_t *tilesByteCounts;
 
+    /**
+     * \~french \brief Tuiles déjà écrites, par CRC32 de leur contenu
+     * \details Une tuile identique à une tuile déjà écrite dans la dalle n'est pas réécrite : son index pointe sur les mêmes octets. Le contenu est conservé pour vérifier l'égalité, dans la limite de ROK4_IMAGE_DEDUP_MEMORY octets.
+     * \~english \brief Already written tiles, by their content's CRC32
+     * \details A tile identical to an already written one in the slab is not written again : its index points to the same bytes. Content is kept to check equality, within ROK4_IMAGE_DEDUP_MEMORY bytes.
+     */
+    std::multimap<uint32_t, std::pair<int, std::string> > writtenTiles;
+    /**
+     * \~french \brief Mémoire occupée par les contenus de writtenTiles
+     * \~english \brief Memory used by writtenTiles' contents
+     */
+    size_t writtenTilesMemory;
+
+    /**
+     * \~french \brief Écrit une tuile encodée dans la dalle, ou la référence si elle y est déjà
+     * \param[in] tileInd indice de la tuile
+     * \param[in] data tuile encodée
+     * \param[in] size taille de la tuile encodée
+     * \return VRAI en cas de succès, FAUX sinon
+     * \~english \brief Write an encoded tile in the slab, or reference it if already there
+     * \param[in] tileInd tile's indice
+     * \param[in] data encoded tile
+     * \param[in] size encoded tile's size
+     * \return TRUE if success, FALSE otherwise
+     */
+    bool writeTileData ( int tileInd, uint8_t* data, size_t size );
+
+    /**
+     * \~french \brief Les tuiles sont accumulées dans slabData et écrites en une fois par writeFinal
+     * \~english \brief Tiles are gathered in slabData and written at once by writeFinal
+     */
+    bool bufferedWrite;
+    /**
+     * \~french \brief Données des tuiles, à partir de la fin de l'index, en écriture bufferisée
+     * \~english \brief Tiles' data, from the index's end, for buffered write
+     */
+    std::string slabData;
+
 
     /**
      * \~french \brief Écrit l'en-tête TIFF de l'image ROK4
@@ -269,11 +315,29 @@ private:
     /**
      * \~french \brief Mémorise la tuile demandée au format brut (sans compression)
      * \details Si la tuile est déjà mémorisée dans memorizedTiles (et on le sait grâce à memorizedIndex), on retourne directement l'adresse mémoire.
+     * \param[in] encData source de la tuile encodée, éventuellement déjà lue (StoreDataSource::prefetch). Si NULL, elle est créée. Elle est détruite dans tous les cas.
      * \return pointeur vers le tableau contenant la tuile voulue
      * \~english \brief Buffer precising for each memorized tile's indice
+     * \param[in] encData encoded tile's source, possibly already read (StoreDataSource::prefetch). If NULL, it is created. It is destroyed in any case.
      * \return pointer to array containing the wanted tile
      */
-    uint8_t* memorizeRawTile ( size_t& size, int tile );
+    uint8_t* memorizeRawTile ( size_t& size, int tile, StoreDataSource* encData = NULL );
+
+    /**
+     * \~french \brief Lit en une seule fois les tuiles non mémorisées d'une portion de ligne de tuiles
+     * \details Les tuiles sont lues via une lecture groupée du contexte (StoreDataSource::prefetch), avant d'être décompressées une à une par #memorizeRawTile
+     * \param[in] tileRow ligne de tuiles
+     * \param[in] firstTileCol première colonne de tuile
+     * \param[in] lastTileCol dernière colonne de tuile, incluse
+     * \return les sources des tuiles, de la première à la dernière colonne, NULL pour une tuile déjà mémorisée
+     * \~english \brief Read at once non memorized tiles of a tile row's portion
+     * \details Tiles are read with a grouped context's reading (StoreDataSource::prefetch), before being decompressed one by one by #memorizeRawTile
+     * \param[in] tileRow tile row
+     * \param[in] firstTileCol first tile column
+     * \param[in] lastTileCol last tile column, included
+     * \return tiles' sources, from the first column to the last one, NULL for an already memorized tile
+     */
+    std::vector<StoreDataSource*> prefetchTiles ( int tileRow, int firstTileCol, int lastTileCol );
 
 
     /**
@@ -382,6 +446,15 @@ private:
     template<typename T>
     int _getline ( T* buffer, int line );
 
+    /**
+     * \~french \brief Retourne un bloc de pixels, copié directement depuis les tuiles brutes mémorisées
+     * \details Les données sont dans leur format natif : un canal occupe pixelSize / channels octets dans le buffer.
+     * \~english \brief Return a pixels' block, directly copied from memorized raw tiles
+     * \details Data are in their native format : a sample uses pixelSize / channels bytes in the buffer.
+     */
+    template<typename T>
+    int _getTiledBlock ( T* buffer, int x, int y, int w, int h );
+
     /******* Pour l'écriture *******/
 
     /**
@@ -451,6 +524,29 @@ private:
      */
     bool writeTile( int tileInd, char* pbfpath ) ;
 
+    /**
+     * \~french \brief Lit entièrement un fichier de tuile PBF
+     * \param[in] pbfpath chemin vers la tuile PBF
+     * \param[out] data contenu du fichier
+     * \return 1 si le fichier est lu, 0 s'il n'existe pas, -1 en cas d'erreur
+     * \~english \brief Read a whole PBF tile file
+     * \param[in] pbfpath path to PBF tile
+     * \param[out] data file's content
+     * \return 1 if file is read, 0 if it does not exist, -1 if error
+     */
+    static int readPbfFile ( const char* pbfpath, std::string& data );
+
+    /**
+     * \~french \brief Compresse une tuile PBF en gzip, si elle ne l'est pas déjà
+     * \param[in,out] data tuile PBF
+     * \return VRAI en cas de succès, FAUX sinon
+     * \~english \brief Compress a PBF tile with gzip, if not already compressed
+     * \param[in,out] data PBF tile
+     * \return TRUE if success, FALSE otherwise
+     */
+    static bool gzipPbf ( std::string& data );
+
+
     /**
      * \~french \brief Écrit une tuile indépendante en tant qu'objet Ceph
      * \details Le nom de l'objet/tuile sera #name _ col _ row
@@ -626,6 +722,26 @@ public:
         return rawTileSize;
     }
 
+    /**
+     * \~french
+     * \brief Retourne la largeur en pixel d'une tuile
+     * \~english
+     * \brief Return tile's pixel width
+     */
+    int getTileWidth() {
+        return tileWidth;
+    }
+
+    /**
+     * \~french
+     * \brief Retourne la hauteur en pixel d'une tuile
+     * \~english
+     * \brief Return tile's pixel height
+     */
+    int getTileHeight() {
+        return tileHeight;
+    }
+
     /**
      * \~french
      * \brief Destructeur par défaut
@@ -685,6 +801,10 @@ public:
     int getline ( uint16_t* buffer, int line );
     int getline ( float* buffer, int line );
 
+    int getBlock ( uint8_t* buffer, int x, int y, int w, int h );
+    int getBlock ( uint16_t* buffer, int x, int y, int w, int h );
+    int getBlock ( float* buffer, int x, int y, int w, int h );
+
     /**************************** Pour l'écriture ****************************/
 
     /**
@@ -715,45 +835,64 @@ public:
      * \param[in] ulTileCol Indice de colonne de la tuile supérieure gauche
      * \param[in] ulTileRow Indice de ligne de la tuile supérieure gauche
      * \param[in] rootDirectory Dossier contenant les tuiles PBF
+     * \param[in] pool pool de threads lisant les fichiers PBF en parallèle, NULL pour une lecture séquentielle
+     * \param[in] gzip les tuiles sont stockées compressées en gzip (format TIFF_PBF_GZIP_MVT)
      * \return 0 en cas de succes, -1 sinon
+     * \~english
+     * \brief Write a vector ROK4 slab, from PBF tiles
+     * \details Tile files are all read in memory (concurrently if a pool is provided), then the slab is written sequentially : header, index, tiles.
+     * \param[in] ulTileCol Upper left tile's column indice
+     * \param[in] ulTileRow Upper left tile's row indice
+     * \param[in] rootDirectory Directory containing PBF tiles
+     * \param[in] pool threads pool reading PBF files concurrently, NULL for a sequential read
+     * \param[in] gzip tiles are stored gzip compressed (TIFF_PBF_GZIP_MVT format)
+     * \return 0 if success, -1 otherwise
      */
-    int writePbfTiles ( int ulTileCol, int ulTileRow, char* rootDirectory );
+    int writePbfTiles ( int ulTileCol, int ulTileRow, char* rootDirectory, ThreadPool* pool = NULL, bool gzip = false );
 
     /**
      * \~french
      * \brief Ecrit une image ROK4, à partir d'un buffer d'entiers
-     * \warning Pas d'implémentation de l'écriture par buffer au format ROK4, retourne systématiquement une erreur
+     * \details Le buffer contient l'image entière, ligne par ligne, au format de l'image ROK4 (canaux entrelacés).
      * \param[in] buffer source des donnée de l'image à écrire
      * \return 0 en cas de succes, -1 sinon
      */
     int writeImage ( uint8_t* buffer ) {
-        LOGGER_ERROR ( "Cannot write ROK4 image from a buffer" );
-        return -1;
+        return writeImage ( buffer, false );
     }
 
+    /**
+     * \~french
+     * \brief Ecrit une image ROK4, à partir d'un buffer d'entiers, avec l'option de cropage
+     * \details Le buffer contient l'image entière, ligne par ligne, au format de l'image ROK4 (canaux entrelacés). Cela permet aux outils de générer une dalle ROK4 directement depuis une image calculée en mémoire, sans passer par une image de travail.
+     * \param[in] buffer source des donnée de l'image à écrire
+     * \param[in] crop option de cropage, pour le jpeg (voir #writeImage(Image*, bool))
+     * \return 0 en cas de succes, -1 sinon
+     ** \~english
+     * \brief Write a ROK4 image, from an integer buffer, with crop option
+     * \param[in] buffer whole image's data, line by line
+     * \param[in] crop JPEG crop option
+     * \return 0 if success, -1 otherwise
+     */
+    int writeImage ( uint8_t* buffer, bool crop );
+
     /**
      * \~french
      * \brief Ecrit une image ROK4, à partir d'un buffer d'entiers 16 bits
-     * \warning Pas d'implémentation de l'écriture par buffer au format ROK4, retourne systématiquement une erreur
+     * \details Le buffer contient l'image entière, ligne par ligne, au format de l'image ROK4 (canaux entrelacés).
      * \param[in] buffer source des donnée de l'image à écrire
      * \return 0 en cas de succes, -1 sinon
      */
-    int writeImage ( uint16_t* buffer ) {
-        LOGGER_ERROR ( "Cannot write ROK4 image from a buffer" );
-        return -1;
-    }
+    int writeImage ( uint16_t* buffer );
 
     /**
      * \~french
      * \brief Ecrit une image ROK4, à partir d'un buffer de flottants
-     * \warning Pas d'implémentation de l'écriture par buffer au format ROK4, retourne systématiquement une erreur
+     * \details Le buffer contient l'image entière, ligne par ligne, au format de l'image ROK4 (canaux entrelacés).
      * \param[in] buffer source des donnée de l'image à écrire
      * \return 0 en cas de succes, -1 sinon
      */
-    int writeImage ( float* buffer ) {
-        LOGGER_ERROR ( "Cannot write ROK4 image from a buffer" );
-        return -1;
-    }
+    int writeImage ( float* buffer );
 
     /**
      * \~french
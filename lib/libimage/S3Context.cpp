@@ -54,6 +54,7 @@
 #include <openssl/hmac.h>
 #include <time.h>
 #include "CurlPool.h"
+#include "RequestTrace.h"
 
 S3Context::S3Context (std::string u, std::string k, std::string sk, std::string b) :
     Context(),
@@ -227,14 +228,14 @@ int S3Context::read(uint8_t* data, int offset, int size, std::string name) {
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, data_callback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &chunk);
 
-    LOGGER_INFO("S3 READ START (" << size << ") " << pthread_self());
+    LOGGER_DEBUG("S3 READ START (" << size << ") request " << RequestTrace::getId());
     res = curl_easy_perform(curl);
-    LOGGER_INFO("S3 READ END (" << size << ") " << pthread_self());
+    LOGGER_DEBUG("S3 READ END (" << size << ") request " << RequestTrace::getId());
     
     curl_slist_free_all(list);
 
     if( CURLE_OK != res) {
-        LOGGER_ERROR("Cannot read data from S3 : " << size << " bytes (from the " << offset << " one) in the object " << name);
+        LOGGER_ERROR("Cannot read data from S3 : " << size << " bytes (from the " << offset << " one) in the object " << name << " (request " << RequestTrace::getId() << ")");
         LOGGER_ERROR(curl_easy_strerror(res));
         return -1;
     }
@@ -242,7 +243,7 @@ int S3Context::read(uint8_t* data, int offset, int size, std::string name) {
     long http_code = 0;
     curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
     if (http_code < 200 || http_code > 299) {
-        LOGGER_ERROR("Cannot read data from S3 : " << size << " bytes (from the " << offset << " one) in the object " << name);
+        LOGGER_ERROR("Cannot read data from S3 : " << size << " bytes (from the " << offset << " one) in the object " << name << " (request " << RequestTrace::getId() << ")");
         LOGGER_ERROR("Response HTTP code : " << http_code);
         LOGGER_ERROR("Response HTTP : " << chunk.data);
         return -1;
@@ -256,21 +257,29 @@ int S3Context::read(uint8_t* data, int offset, int size, std::string name) {
 bool S3Context::write(uint8_t* data, int offset, int size, std::string name) {
     LOGGER_DEBUG("S3 write : " << size << " bytes (from the " << offset << " one) in the writing buffer " << name);
 
-    std::map<std::string, std::vector<char>*>::iterator it1 = writingBuffers.find ( name );
-    if ( it1 == writingBuffers.end() ) {
+    std::map<std::string, PartedBuffer*>::iterator it1 = partedBuffers.find ( name );
+    if ( it1 == partedBuffers.end() ) {
         // pas de buffer pour ce nom d'objet
         LOGGER_ERROR("No writing buffer for the name " << name);
         return false;
     }
-    LOGGER_DEBUG("old length: " << it1->second->size());
-   
-    // Calcul de la taille finale et redimensionnement éventuel du vector
-    if (it1->second->size() < size + offset) {
-        it1->second->resize(size + offset);
+
+    if (! it1->second->write(data, offset, size)) {
+        LOGGER_ERROR("Cannot write in the S3 writing buffer " << name);
+        return false;
     }
 
-    memcpy(&((*(it1->second))[0]) + offset, data, size);
-    LOGGER_DEBUG("new length: " << it1->second->size());
+    // Les parties complètes sont envoyées sans attendre la fermeture de l'objet
+    int index;
+    while ((index = it1->second->getCompletePart()) >= 0) {
+        PartUploader* uploader = partUploaders[name];
+        if (uploader->uploadId.empty() && ! initiateMultipart(name, uploader)) {
+            return false;
+        }
+        if (! uploadPart(name, uploader, index, it1->second->takePart(index))) {
+            return false;
+        }
+    }
 
     return true;
 }
@@ -278,19 +287,18 @@ bool S3Context::write(uint8_t* data, int offset, int size, std::string name) {
 bool S3Context::writeFull(uint8_t* data, int size, std::string name) {
     LOGGER_DEBUG("S3 write : " << size << " bytes (one shot) in the writing buffer " << name);
 
-    std::map<std::string, std::vector<char>*>::iterator it1 = writingBuffers.find ( name );
-    if ( it1 == writingBuffers.end() ) {
+    std::map<std::string, PartedBuffer*>::iterator it1 = partedBuffers.find ( name );
+    if ( it1 == partedBuffers.end() ) {
         // pas de buffer pour ce nom d'objet
         LOGGER_ERROR("No S3 writing buffer for the name " << name);
         return false;
     }
 
-    it1->second->clear();
-
-    it1->second->resize(size);
-    memcpy(&((*(it1->second))[0]), data, size);
+    if (! it1->second->reset()) {
+        return false;
+    }
 
-    return true;
+    return write(data, 0, size, name);
 }
 
 eContextType S3Context::getType() {
@@ -308,36 +316,22 @@ std::string S3Context::getTray() {
 
 bool S3Context::openToWrite(std::string name) {
 
-    std::map<std::string, std::vector<char>*>::iterator it1 = writingBuffers.find ( name );
-    if ( it1 != writingBuffers.end() ) {
+    std::map<std::string, PartedBuffer*>::iterator it1 = partedBuffers.find ( name );
+    if ( it1 != partedBuffers.end() ) {
         LOGGER_ERROR("A S3 writing buffer already exists for the name " << name);
         return false;
 
     } else {
-        writingBuffers.insert ( std::pair<std::string,std::vector<char>*>(name, new std::vector<char>()) );
+        partedBuffers.insert ( std::pair<std::string,PartedBuffer*>(name, new PartedBuffer()) );
+        partUploaders.insert ( std::pair<std::string,PartUploader*>(name, new PartUploader()) );
     }
 
     return true;
 }
 
+struct curl_slist* S3Context::getHeaders(std::string method, std::string resource, std::string content_type, int64_t length) {
 
-bool S3Context::closeToWrite(std::string name) {
-
-
-    std::map<std::string, std::vector<char>*>::iterator it1 = writingBuffers.find ( name );
-    if ( it1 == writingBuffers.end() ) {
-        LOGGER_ERROR("The S3 writing buffer with name " << name << "does not exist, cannot flush it");
-        return false;
-    }
-
-
-    LOGGER_DEBUG("Write buffered " << it1->second->size() << " bytes in the S3 object " << name);
-
-    CURLcode res;
     struct curl_slist *list = NULL;
-    CURL* curl = CurlPool::getCurlEnv();
-
-    std::string fullUrl = url + "/" + bucket_name + "/" + name;
 
     time_t current;
     char gmt_time[40];
@@ -345,16 +339,12 @@ bool S3Context::closeToWrite(std::string name) {
     time(&current);
     strftime( gmt_time, sizeof(gmt_time), "%a, %d %b %Y %T %z", gmtime(&current) );
 
-    std::string content_type = "application/octet-stream";
-    std::string resource = "/" + bucket_name + "/" + name;
-    std::string stringToSign = "PUT\n\n" + content_type + "\n" + std::string(gmt_time) + "\n" + resource;
+    std::string stringToSign = method + "\n\n" + content_type + "\n" + std::string(gmt_time) + "\n" + resource;
     std::string signature = getAuthorizationHeader(stringToSign);
 
-    // Constitution du header
-
-    char host[256];
-    sprintf(host, "Host: %s", url.c_str());
-    list = curl_slist_append(list, host);
+    char hd_host[256];
+    sprintf(hd_host, "Host: %s", host.c_str());
+    list = curl_slist_append(list, hd_host);
 
     char d[100];
     sprintf(d, "Date: %s", gmt_time);
@@ -365,7 +355,7 @@ bool S3Context::closeToWrite(std::string name) {
     list = curl_slist_append(list, ct);
 
     char cl[50];
-    sprintf(cl, "Content-Length: %d", it1->second->size());
+    sprintf(cl, "Content-Length: %lld", (long long) length);
     list = curl_slist_append(list, cl);
 
     std::string ex = "Expect:";
@@ -375,34 +365,183 @@ bool S3Context::closeToWrite(std::string name) {
     sprintf(auth, "Authorization: AWS %s:%s", key.c_str(), signature.c_str());
     list = curl_slist_append(list, auth);
 
+    return list;
+}
+
+bool S3Context::sendRequest(std::string method, std::string name, std::string query, std::string content_type, const char* body, int64_t size, std::string* response) {
+
+    CURLcode res;
+    CURL* curl = CurlPool::getCurlEnv();
+
+    std::string fullUrl = url + "/" + bucket_name + "/" + name + query;
+    struct curl_slist *list = getHeaders(method, "/" + bucket_name + "/" + name + query, content_type, size);
+
+    DataStruct chunk;
+    chunk.nbPassage = 0;
+    chunk.data = (char*) malloc(1);
+    chunk.data[0] = '\0';
+    chunk.size = 0;
+
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
     curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, &((*(it1->second))[0]));
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, it1->second->size());
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, (body == NULL) ? "" : body);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long) size);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, data_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &chunk);
 
     res = curl_easy_perform(curl);
     curl_slist_free_all(list);
 
+    long http_code = 0;
+    curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+    // L'objet curl est partagé avec les lectures : on lui rend ses options par défaut (GET)
+    curl_easy_reset(curl);
 
     if( CURLE_OK != res) {
-        LOGGER_ERROR ( "Unable to flush " << it1->second->size() << " bytes in the object " << name );
+        LOGGER_ERROR ( "S3 request " << method << " " << fullUrl << " failed" );
         LOGGER_ERROR(curl_easy_strerror(res));
         return false;
     }
 
-    long http_code = 0;
-    curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
     if (http_code < 200 || http_code > 299) {
-        LOGGER_ERROR ( "Unable to flush " << it1->second->size() << " bytes in the object " << name );
+        LOGGER_ERROR ( "S3 request " << method << " " << fullUrl << " failed" );
         LOGGER_ERROR("Response HTTP code : " << http_code);
+        LOGGER_ERROR("Response HTTP : " << chunk.data);
         return false;
     }
 
-    LOGGER_DEBUG("Erase the flushed buffer");
-    delete it1->second;
-    writingBuffers.erase(it1);
+    if (response != NULL) {
+        response->assign(chunk.data, chunk.size);
+    }
 
     return true;
-}
\ No newline at end of file
+}
+
+bool S3Context::initiateMultipart(std::string name, PartUploader* uploader) {
+
+    std::string response;
+    if (! sendRequest("POST", name, "?uploads", "application/octet-stream", NULL, 0, &response)) {
+        LOGGER_ERROR("Cannot initiate the S3 multipart upload of the object " << name);
+        return false;
+    }
+
+    size_t start = response.find("<UploadId>");
+    size_t end = response.find("</UploadId>");
+    if (start == std::string::npos || end == std::string::npos || end <= start + 10) {
+        LOGGER_ERROR("No upload id in the S3 multipart upload initiation's response, for the object " << name);
+        LOGGER_ERROR("Response HTTP : " << response);
+        return false;
+    }
+
+    uploader->uploadId = response.substr(start + 10, end - start - 10);
+    LOGGER_DEBUG("S3 multipart upload " << uploader->uploadId << " initiated for the object " << name);
+
+    return true;
+}
+
+bool S3Context::uploadPart(std::string name, PartUploader* uploader, int index, std::vector<char>* data) {
+
+    if (data == NULL) {
+        return false;
+    }
+
+    LOGGER_DEBUG("Upload the part " << index << " (" << data->size() << " bytes) of the S3 object " << name);
+
+    // Les numéros de partie S3 commencent à 1
+    std::ostringstream query;
+    query << "?partNumber=" << (index + 1) << "&uploadId=" << uploader->uploadId;
+
+    struct curl_slist *list = getHeaders("PUT", "/" + bucket_name + "/" + name + query.str(), "application/octet-stream", data->size());
+
+    return uploader->upload(index, data, url + "/" + bucket_name + "/" + name + query.str(), list);
+}
+
+
+bool S3Context::closeToWrite(std::string name) {
+
+    std::map<std::string, PartedBuffer*>::iterator it1 = partedBuffers.find ( name );
+    if ( it1 == partedBuffers.end() ) {
+        LOGGER_ERROR("The S3 writing buffer with name " << name << "does not exist, cannot flush it");
+        return false;
+    }
+
+    PartedBuffer* buffer = it1->second;
+    partedBuffers.erase(it1);
+
+    std::map<std::string, PartUploader*>::iterator it2 = partUploaders.find ( name );
+    PartUploader* uploader = it2->second;
+    partUploaders.erase(it2);
+
+    bool ok = true;
+
+    if (! buffer->isStreamed() && buffer->getPartsNumber() <= 1) {
+        // Objet tenant dans une seule partie : envoi en une fois
+
+        LOGGER_DEBUG("Write buffered " << buffer->getLength() << " bytes in the S3 object " << name);
+
+        std::vector<char>* data = (buffer->getPartsNumber() == 0) ? new std::vector<char>() : buffer->takePart(0);
+        ok = sendRequest("PUT", name, "", "application/octet-stream", data->empty() ? NULL : &((*data)[0]), data->size(), NULL);
+        if (! ok) {
+            LOGGER_ERROR ( "Unable to flush " << data->size() << " bytes in the object " << name );
+        }
+        delete data;
+
+    } else {
+        // Envoi en plusieurs parties : les parties restantes, dont la première, puis la requête de fin
+
+        LOGGER_DEBUG("Write the last parts of the S3 object " << name << " (" << buffer->getLength() << " bytes)");
+
+        if (uploader->uploadId.empty()) {
+            ok = initiateMultipart(name, uploader);
+        }
+
+        if (ok) {
+            ok = uploadPart(name, uploader, 0, buffer->takePart(0));
+        }
+        while (ok && buffer->getNextPart() < buffer->getPartsNumber()) {
+            int index = buffer->getNextPart();
+            ok = uploadPart(name, uploader, index, buffer->takePart(index));
+        }
+
+        if (! uploader->wait()) {
+            ok = false;
+        }
+
+        std::string query = "?uploadId=" + uploader->uploadId;
+
+        if (ok) {
+            std::ostringstream body;
+            body << "<CompleteMultipartUpload>";
+            std::map<int, std::string>::iterator it;
+            for (it = uploader->getEtags().begin(); it != uploader->getEtags().end(); ++it) {
+                body << "<Part><PartNumber>" << (it->first + 1) << "</PartNumber><ETag>" << it->second << "</ETag></Part>";
+            }
+            body << "</CompleteMultipartUpload>";
+
+            std::string response;
+            ok = sendRequest("POST", name, query, "application/xml", body.str().c_str(), body.str().size(), &response);
+
+            // Une erreur peut être renvoyée avec le code 200
+            if (ok && response.find("<Error>") != std::string::npos) {
+                LOGGER_ERROR("Response HTTP : " << response);
+                ok = false;
+            }
+        }
+
+        if (! ok) {
+            LOGGER_ERROR ( "Unable to flush " << buffer->getLength() << " bytes in the object " << name << " with a multipart upload" );
+            if (! uploader->uploadId.empty()) {
+                sendRequest("DELETE", name, query, "application/octet-stream", NULL, 0, NULL);
+            }
+        }
+    }
+
+    LOGGER_DEBUG("Erase the flushed buffer");
+    delete buffer;
+    delete uploader;
+
+    return ok;
+}
@@ -54,6 +54,8 @@
 #include "Logger.h"
 #include "Context.h"
 #include "LibcurlStruct.h"
+#include "PartedBuffer.h"
+#include "PartUploader.h"
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -99,6 +101,70 @@ private:
      */
     std::string getAuthorizationHeader(std::string toSign);
 
+    /**
+     * \~french \brief Buffers d'écriture, selon le nom de l'objet
+     * \~english \brief Writing buffers, by object's name
+     */
+    std::map<std::string, PartedBuffer*> partedBuffers;
+
+    /**
+     * \~french \brief Envois en plusieurs parties, selon le nom de l'objet
+     * \~english \brief Multipart uploads, by object's name
+     */
+    std::map<std::string, PartUploader*> partUploaders;
+
+    /**
+     * \~french
+     * \brief Constitue les en-têtes signés d'une requête
+     * \param[in] method méthode HTTP
+     * \param[in] resource ressource signée : bucket, objet et éventuelle sous-ressource (?uploads, ?uploadId=...)
+     * \param[in] content_type type du contenu envoyé
+     * \param[in] length taille du contenu envoyé
+     * \~english
+     * \brief Build a request's signed headers
+     * \param[in] method HTTP method
+     * \param[in] resource signed resource : bucket, object and possible sub-resource (?uploads, ?uploadId=...)
+     * \param[in] content_type sent content's type
+     * \param[in] length sent content's size
+     */
+    struct curl_slist* getHeaders(std::string method, std::string resource, std::string content_type, int64_t length);
+
+    /**
+     * \~french
+     * \brief Envoie une requête sur un objet, avec l'objet curl du thread
+     * \param[in] method méthode HTTP
+     * \param[in] name nom de l'objet
+     * \param[in] query sous-ressource, éventuellement vide
+     * \param[in] content_type type du contenu envoyé
+     * \param[in] body contenu envoyé, éventuellement NULL
+     * \param[in] size taille du contenu envoyé
+     * \param[out] response corps de la réponse, si non NULL
+     * \return faux si la requête a échoué
+     * \~english
+     * \brief Send a request on an object, with thread's curl object
+     * \param[in] method HTTP method
+     * \param[in] name object's name
+     * \param[in] query sub-resource, possibly empty
+     * \param[in] content_type sent content's type
+     * \param[in] body sent content, possibly NULL
+     * \param[in] size sent content's size
+     * \param[out] response response's body, if not NULL
+     * \return false if request failed
+     */
+    bool sendRequest(std::string method, std::string name, std::string query, std::string content_type, const char* body, int64_t size, std::string* response);
+
+    /**
+     * \~french \brief Démarre l'envoi en plusieurs parties d'un objet, et en conserve l'identifiant
+     * \~english \brief Initiate an object's multipart upload, and keep its identifier
+     */
+    bool initiateMultipart(std::string name, PartUploader* uploader);
+
+    /**
+     * \~french \brief Lance l'envoi d'une partie, dans un thread de l'envoyeur
+     * \~english \brief Start a part's upload, in an uploader's thread
+     */
+    bool uploadPart(std::string name, PartUploader* uploader, int index, std::vector<char>* data);
+
 public:
 
     /**
@@ -159,13 +225,19 @@ public:
     /**
      * \~french
      * \brief Écrit de la donnée dans un objet S3
-     * \details Les données sont en réalité écrites dans #writingBuffer et seront envoyées dans S3 lors de l'appel à #closeToWrite
+     * \details Les données sont écrites dans un PartedBuffer. Dès qu'une partie est complète, un envoi S3 en plusieurs parties est démarré et la partie est envoyée en parallèle de la suite des écritures. La première partie, où sont écrits les en-têtes, et la dernière sont envoyées lors de l'appel à #closeToWrite. Un objet tenant dans une seule partie est envoyé en une fois, par #closeToWrite.
+     * \~english
+     * \brief Write data in a S3 object
+     * \details Data is written in a PartedBuffer. As soon as a part is complete, a S3 multipart upload is initiated and the part is uploaded in parallel with following writings. First part, where headers are written, and last one are uploaded by #closeToWrite. An object fitting in a single part is uploaded at once, by #closeToWrite.
      */
     bool write(uint8_t* data, int offset, int size, std::string name);
     /**
      * \~french
      * \brief Écrit un objet S3
-     * \details Les données sont en réalité écrites dans #writingBuffer et seront envoyées dans S3 lors de l'appel à #closeToWrite
+     * \details Le contenu précédent du buffer d'écriture est remplacé, puis écrit comme avec #write
+     * \~english
+     * \brief Write a S3 object
+     * \details Previous writing buffer's content is replaced, then written like with #write
      */
     bool writeFull(uint8_t* data, int size, std::string name);
 
@@ -208,7 +280,14 @@ public:
     }
     
     virtual ~S3Context() {
-
+        std::map<std::string, PartedBuffer*>::iterator it1;
+        for (it1 = partedBuffers.begin(); it1 != partedBuffers.end(); ++it1) {
+            delete it1->second;
+        }
+        std::map<std::string, PartUploader*>::iterator it2;
+        for (it2 = partUploaders.begin(); it2 != partUploaders.end(); ++it2) {
+            delete it2->second;
+        }
     }
 };
 
@@ -55,6 +55,74 @@
 #include <cstdio>
 #include <errno.h>
 #include "Rok4Image.h"
+#include <map>
+#include "Metrics.h"
+#include "RequestTrace.h"
+
+/**
+ * \~french \brief Métriques de lecture d'un type de stockage
+ * \~english \brief Reading metrics of a storage type
+ */
+struct StorageMetrics {
+    MetricCounter* reads;
+    MetricCounter* bytes;
+    MetricCounter* errors;
+    MetricHistogram* latency;
+    MetricHistogram* batchLatency;
+};
+
+/* Métriques par type de contexte (eContextType), créées à la première lecture */
+static StorageMetrics* storageMetrics[S3CONTEXT + 1];
+
+static StorageMetrics* getStorageMetrics ( Context* context ) {
+    eContextType type = context->getType();
+    StorageMetrics* sm = __atomic_load_n ( &storageMetrics[type], __ATOMIC_ACQUIRE );
+    if ( sm ) return sm;
+
+    // Plusieurs threads peuvent créer la structure en même temps : les métriques sont les mêmes, une seule est gardée
+    std::string labels = Metrics::label ( "storage", context->getTypeStr() );
+    sm = new StorageMetrics();
+    sm->reads = Metrics::getCounter ( "rok4_storage_reads_total", "Lectures dans le stockage", labels );
+    sm->bytes = Metrics::getCounter ( "rok4_storage_read_bytes_total", "Octets lus dans le stockage", labels );
+    sm->errors = Metrics::getCounter ( "rok4_storage_read_errors_total", "Lectures en erreur dans le stockage", labels );
+    sm->latency = Metrics::getHistogram ( "rok4_storage_read_seconds", "Durée des lectures unitaires dans le stockage", labels );
+    sm->batchLatency = Metrics::getHistogram ( "rok4_storage_batch_read_seconds", "Durée des lectures groupées dans le stockage", labels );
+
+    StorageMetrics* expected = NULL;
+    if ( ! __atomic_compare_exchange_n ( &storageMetrics[type], &expected, sm, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+        delete sm;
+        sm = expected;
+    }
+    return sm;
+}
+
+/* Lecture unitaire comptabilisée dans les métriques du stockage */
+static int measuredRead ( Context* context, uint8_t* data, int offset, int size, std::string name ) {
+    TraceScope scope ( TraceStage::READ );
+    StorageMetrics* sm = getStorageMetrics ( context );
+    double start = Metrics::now();
+    int result = context->read ( data, offset, size, name );
+    sm->latency->observe ( Metrics::now() - start );
+    sm->reads->add();
+    if ( result < 0 ) sm->errors->add();
+    else sm->bytes->add ( result );
+    return result;
+}
+
+/* Lecture groupée comptabilisée dans les métriques du stockage */
+static void measuredReadMulti ( Context* context, std::vector<ContextRead>& reads ) {
+    if ( reads.empty() ) return;
+    TraceScope scope ( TraceStage::READ );
+    StorageMetrics* sm = getStorageMetrics ( context );
+    double start = Metrics::now();
+    context->readMulti ( reads );
+    sm->batchLatency->observe ( Metrics::now() - start );
+    sm->reads->add ( reads.size() );
+    for ( unsigned int i = 0; i < reads.size(); i++ ) {
+        if ( reads.at(i).result < 0 ) sm->errors->add();
+        else sm->bytes->add ( reads.at(i).result );
+    }
+}
 
 // Taille maximum d'une tuile WMTS
 #define MAX_TILE_SIZE 1048576
@@ -99,7 +167,7 @@ const uint8_t* StoreDataSource::getData ( size_t &tile_size ) {
     if (! readIndex) {
         // On a directement la taille et l'offset
         data = new uint8_t[possize];
-        int tileSize = context->read(data, posoff, possize, name);
+        int tileSize = measuredRead(context, data, posoff, possize, name);
         if (tileSize < 0) {
             LOGGER_ERROR ( "Erreur lors de la lecture de la tuile dans l'objet (sans passer par l'index) " << name );
             delete[] data;
@@ -111,7 +179,7 @@ const uint8_t* StoreDataSource::getData ( size_t &tile_size ) {
     } else {
 
         uint8_t* indexheader = new uint8_t[headerIndexSize];
-        int realSize = context->read(indexheader, 0, headerIndexSize, name);
+        int realSize = measuredRead(context, indexheader, 0, headerIndexSize, name);
 
         if ( realSize < 0) {
             LOGGER_ERROR ( "Erreur lors de la lecture du header et de l'index dans l'objet/fichier " << name );
@@ -137,7 +205,7 @@ const uint8_t* StoreDataSource::getData ( size_t &tile_size ) {
 
             LOGGER_DEBUG ( "Dalle symbolique détectée : " << originalName << " référence une autre dalle symbolique " << name );
 
-            int realSize = context->read(indexheader, 0, headerIndexSize, name);
+            int realSize = measuredRead(context, indexheader, 0, headerIndexSize, name);
 
             if ( realSize < 0) {
                 LOGGER_ERROR ( "Erreur lors de la lecture du header et de l'index dans l'objet/fichier " << name );
@@ -152,29 +220,15 @@ const uint8_t* StoreDataSource::getData ( size_t &tile_size ) {
         }
 
         // On est dans le cas d'une dalle
-        uint32_t tileOffset = *((uint32_t*) (indexheader + posoff ));
-        uint32_t tileSize = *((uint32_t*) (indexheader + possize ));
-
-        // La taille de la tuile ne doit pas exceder un seuil
-        // Objectif : gerer le cas de fichiers TIFF non conformes aux specs du cache
-        // (et qui pourraient indiquer des tailles de tuiles excessives)
-
-        if ( tileSize > MAX_TILE_SIZE ) {
-            LOGGER_ERROR ( "Tuile trop volumineuse dans le fichier/objet " << name ) ;
-            delete[] indexheader;
-            return NULL;
-        }
-
-
-        if ( tileSize == 0 ) {
-            LOGGER_DEBUG ( "Tuile non présente dans la dalle (taille nulle) " << name ) ;
+        uint32_t tileOffset, tileSize;
+        if ( ! getTileLocation ( indexheader, tileOffset, tileSize ) ) {
             delete[] indexheader;
             return NULL;
         }
 
         // Lecture de la tuile
         data = new uint8_t[tileSize];
-        if (context->read(data, tileOffset, tileSize, name) < 0) {
+        if (measuredRead(context, data, tileOffset, tileSize, name) < 0) {
             delete[] data;
             data = NULL;
             LOGGER_ERROR ( "Erreur lors de la lecture de la tuile dans l'objet " << name );
@@ -190,3 +244,92 @@ const uint8_t* StoreDataSource::getData ( size_t &tile_size ) {
     return data;
 
 }
+
+bool StoreDataSource::getTileLocation ( const uint8_t* indexheader, uint32_t& tileOffset, uint32_t& tileSize ) {
+    tileOffset = *((uint32_t*) (indexheader + posoff ));
+    tileSize = *((uint32_t*) (indexheader + possize ));
+
+    // La taille de la tuile ne doit pas exceder un seuil
+    // Objectif : gerer le cas de fichiers TIFF non conformes aux specs du cache
+    // (et qui pourraient indiquer des tailles de tuiles excessives)
+
+    if ( tileSize > MAX_TILE_SIZE ) {
+        LOGGER_ERROR ( "Tuile trop volumineuse dans le fichier/objet " << name ) ;
+        return false;
+    }
+
+    if ( tileSize == 0 ) {
+        LOGGER_DEBUG ( "Tuile non présente dans la dalle (taille nulle) " << name ) ;
+        return false;
+    }
+
+    return true;
+}
+
+void StoreDataSource::prefetch ( std::vector<StoreDataSource*>& sources ) {
+    if ( sources.empty() ) return;
+
+    Context* context = sources.at(0)->context;
+    if (! context->isConnected()) return;
+
+    // Lecture groupée des en-têtes, une seule fois par dalle
+    std::map<std::string, int> headerOfSlab;
+    std::vector<ContextRead> headerReads;
+    for ( unsigned int i = 0; i < sources.size(); i++ ) {
+        StoreDataSource* sds = sources.at(i);
+        if ( sds->alreadyTried || ! sds->readIndex ) continue;
+        if ( headerOfSlab.find ( sds->name ) != headerOfSlab.end() ) continue;
+        headerOfSlab.insert ( std::pair<std::string, int> ( sds->name, headerReads.size() ) );
+        headerReads.push_back ( ContextRead ( new uint8_t[sds->headerIndexSize], 0, sds->headerIndexSize, sds->name ) );
+    }
+
+    measuredReadMulti ( context, headerReads );
+
+    // Lecture groupée des tuiles
+    std::vector<ContextRead> tileReads;
+    std::vector<StoreDataSource*> tileSources;
+    for ( unsigned int i = 0; i < sources.size(); i++ ) {
+        StoreDataSource* sds = sources.at(i);
+        if ( sds->alreadyTried ) continue;
+
+        uint32_t tileOffset, tileSize;
+        if ( sds->readIndex ) {
+            ContextRead& hr = headerReads.at ( headerOfSlab[sds->name] );
+            if ( hr.result < 0 ) {
+                LOGGER_ERROR ( "Erreur lors de la lecture du header et de l'index dans l'objet/fichier " << sds->name );
+                sds->alreadyTried = true;
+                continue;
+            }
+            if ( hr.result < ROK4_IMAGE_HEADER_SIZE ) {
+                // Dalle symbolique : lecture unitaire
+                continue;
+            }
+            sds->alreadyTried = true;
+            if ( ! sds->getTileLocation ( hr.data, tileOffset, tileSize ) ) continue;
+        } else {
+            sds->alreadyTried = true;
+            tileOffset = sds->posoff;
+            tileSize = sds->possize;
+        }
+
+        tileReads.push_back ( ContextRead ( new uint8_t[tileSize], tileOffset, tileSize, sds->name ) );
+        tileSources.push_back ( sds );
+    }
+
+    for ( unsigned int i = 0; i < headerReads.size(); i++ ) {
+        delete[] headerReads.at(i).data;
+    }
+
+    measuredReadMulti ( context, tileReads );
+
+    for ( unsigned int i = 0; i < tileReads.size(); i++ ) {
+        StoreDataSource* sds = tileSources.at(i);
+        if ( tileReads.at(i).result < 0 ) {
+            LOGGER_ERROR ( "Erreur lors de la lecture de la tuile dans l'objet " << sds->name );
+            delete[] tileReads.at(i).data;
+            continue;
+        }
+        sds->data = tileReads.at(i).data;
+        sds->size = tileReads.at(i).result;
+    }
+}
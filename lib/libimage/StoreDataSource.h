@@ -56,6 +56,7 @@
 #include "Context.h"
 #include <stdlib.h>
 #include <string>
+#include <vector>
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -133,6 +134,20 @@ protected:
 
     const uint32_t headerIndexSize;
 
+    /**
+     * \~french \brief Extrait de l'en-tête d'une dalle la position et la taille de la tuile voulue
+     * \param[in] indexheader En-tête et index de la dalle
+     * \param[out] tileOffset Position de la tuile dans la dalle
+     * \param[out] tileSize Taille de la tuile
+     * \return faux si la tuile est absente ou invalide
+     * \~english \brief Extract from slab's header the wanted tile's position and size
+     * \param[in] indexheader Slab's header and index
+     * \param[out] tileOffset Tile's position in the slab
+     * \param[out] tileSize Tile's size
+     * \return false if tile is missing or invalid
+     */
+    bool getTileLocation ( const uint8_t* indexheader, uint32_t& tileOffset, uint32_t& tileSize );
+
 public:
 
     /** \~french
@@ -214,6 +229,17 @@ public:
      */
     virtual const uint8_t* getData ( size_t &tile_size );
 
+    /** \~french
+     * \brief Lit en une fois les données de plusieurs sources partageant le même contexte
+     * \details Les en-têtes des dalles sont lus une seule fois par dalle, puis toutes les tuiles sont lues, chaque étape via une lecture groupée du contexte (Context::readMulti). Les sources ainsi lues retournent directement leur donnée avec #getData. Les dalles symboliques sont laissées à la lecture unitaire.
+     * \param[in] sources Sources à lire
+     ** \~english
+     * \brief Read at once data of several sources sharing the same context
+     * \details Slabs' headers are read only once for each slab, then all tiles are read, each step with a grouped context's reading (Context::readMulti). Sources read this way return directly their data with #getData. Symbolic slabs are left to unit reading.
+     * \param[in] sources Sources to read
+     */
+    static void prefetch ( std::vector<StoreDataSource*>& sources );
+
 
     /**
      * \~french \brief Supprime la donnée mémorisée (#data)
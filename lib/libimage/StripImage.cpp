@@ -0,0 +1,276 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file StripImage.cpp
+ ** \~french
+ * \brief Implémentation des classes StripImage et StripImageFactory
+ ** \~english
+ * \brief Implement classes StripImage and StripImageFactory
+ */
+
+#include "StripImage.h"
+#include "Logger.h"
+#include <cstring>
+
+/**
+ * \~french
+ * \brief Calcul d'une bande
+ * \details Partagé entre l'image et la tâche soumise au pool, il est détruit par le dernier qui le lâche. Le premier qui le prend calcule la bande, ou l'annule.
+ * \~english
+ * \brief A strip's computing
+ * \details Shared between the image and the task submitted to the pool, it is deleted by the last one to release it. The first one to take it computes the strip, or cancels it.
+ */
+class StripJob {
+public:
+    StripImage* image;
+    int strip;
+    int claimed;
+    bool done;
+    int refs;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    StripJob ( StripImage* image, int strip ) : image ( image ), strip ( strip ), claimed ( 0 ), done ( false ), refs ( 1 ) {
+        pthread_mutex_init ( &mutex, NULL );
+        pthread_cond_init ( &cond, NULL );
+    }
+
+    ~StripJob() {
+        pthread_mutex_destroy ( &mutex );
+        pthread_cond_destroy ( &cond );
+    }
+
+    /** Calcule la bande si personne ne l'a encore prise */
+    void process() {
+        if ( __atomic_exchange_n ( &claimed, 1, __ATOMIC_ACQ_REL ) != 0 ) return;
+        image->computeStrip ( strip );
+        end();
+    }
+
+    /** Annule la bande si personne ne l'a encore prise */
+    void cancel() {
+        if ( __atomic_exchange_n ( &claimed, 1, __ATOMIC_ACQ_REL ) != 0 ) return;
+        end();
+    }
+
+    void end() {
+        pthread_mutex_lock ( &mutex );
+        done = true;
+        pthread_cond_broadcast ( &cond );
+        pthread_mutex_unlock ( &mutex );
+    }
+
+    void wait() {
+        pthread_mutex_lock ( &mutex );
+        while ( ! done ) pthread_cond_wait ( &cond, &mutex );
+        pthread_mutex_unlock ( &mutex );
+    }
+
+    static void release ( StripJob* job ) {
+        if ( __atomic_sub_fetch ( &job->refs, 1, __ATOMIC_ACQ_REL ) == 0 ) delete job;
+    }
+};
+
+/**
+ * \~french \brief Tâche calculant une bande
+ * \~english \brief Task computing a strip
+ */
+class StripTask : public Task {
+private:
+    StripJob* job;
+public:
+    StripTask ( StripJob* job ) : job ( job ) {
+        __atomic_add_fetch ( &job->refs, 1, __ATOMIC_ACQ_REL );
+    }
+    void run() {
+        job->process();
+    }
+    ~StripTask() {
+        StripJob::release ( job );
+    }
+};
+
+template<typename T>
+static StripImage::StripType stripType();
+template<>
+StripImage::StripType stripType<uint8_t>() {
+    return StripImage::UINT8_TYPE;
+}
+template<>
+StripImage::StripType stripType<uint16_t>() {
+    return StripImage::UINT16_TYPE;
+}
+template<>
+StripImage::StripType stripType<float>() {
+    return StripImage::FLOAT_TYPE;
+}
+
+template<typename T>
+static void computeLines ( Image* image, uint8_t* buffer, int first, int last ) {
+    int rowSize = image->getWidth() * image->getChannels();
+    for ( int l = first; l < last; l++ ) {
+        image->getline ( ( ( T* ) buffer ) + ( l - first ) * rowSize, l );
+    }
+}
+
+StripImage::StripImage ( std::vector<Image*>& chains, ThreadPool* pool ) :
+    Image ( chains.at ( 0 )->getWidth(), chains.at ( 0 )->getHeight(), chains.at ( 0 )->getChannels(),
+            chains.at ( 0 )->getResX(), chains.at ( 0 )->getResY(), chains.at ( 0 )->getBbox() ),
+    chains ( chains ), pool ( pool ), current ( -1 ), type ( UNKNOWN_TYPE ) {
+
+    setCRS ( chains.at ( 0 )->getCRS() );
+    stripCount = ( height + STRIP_HEIGHT - 1 ) / STRIP_HEIGHT;
+
+    for ( unsigned int i = 0; i < chains.size(); i++ ) {
+        // Tampons dimensionnés pour le plus grand type
+        buffers.push_back ( new uint8_t[STRIP_HEIGHT * width * channels * sizeof ( float )] );
+        jobs.push_back ( NULL );
+    }
+}
+
+StripImage::~StripImage() {
+    for ( unsigned int i = 0; i < chains.size(); i++ ) {
+        finishStrip ( i, false );
+        delete[] buffers.at ( i );
+        delete chains.at ( i );
+    }
+}
+
+void StripImage::computeStrip ( int strip ) {
+    int chain = strip % chains.size();
+    int first = strip * STRIP_HEIGHT;
+    int last = first + STRIP_HEIGHT;
+    if ( last > height ) last = height;
+
+    switch ( type ) {
+    case UINT8_TYPE :
+        computeLines<uint8_t> ( chains.at ( chain ), buffers.at ( chain ), first, last );
+        break;
+    case UINT16_TYPE :
+        computeLines<uint16_t> ( chains.at ( chain ), buffers.at ( chain ), first, last );
+        break;
+    default :
+        computeLines<float> ( chains.at ( chain ), buffers.at ( chain ), first, last );
+        break;
+    }
+}
+
+void StripImage::startStrip ( int strip ) {
+    StripJob* job = new StripJob ( this, strip );
+    jobs.at ( strip % chains.size() ) = job;
+    pool->submit ( new StripTask ( job ) );
+}
+
+void StripImage::finishStrip ( int chain, bool needed ) {
+    StripJob* job = jobs.at ( chain );
+    if ( ! job ) return;
+
+    if ( needed ) {
+        job->process();
+    } else {
+        job->cancel();
+    }
+    job->wait();
+
+    if ( ! needed ) {
+        StripJob::release ( job );
+        jobs.at ( chain ) = NULL;
+    }
+}
+
+void StripImage::moveTo ( int strip ) {
+    if ( strip == current ) return;
+
+    int n = chains.size();
+    // Chaque chaîne prend en charge sa bande dans la fenêtre [strip, strip + n[
+    for ( int c = 0; c < n; c++ ) {
+        int target = strip + ( ( c - strip % n ) + n ) % n;
+        if ( jobs.at ( c ) && jobs.at ( c )->strip == target ) continue;
+        finishStrip ( c, false );
+        if ( target < stripCount ) startStrip ( target );
+    }
+
+    finishStrip ( strip % n, true );
+    current = strip;
+}
+
+template<typename T>
+int StripImage::_getline ( T* buffer, int line ) {
+    if ( type == UNKNOWN_TYPE ) type = stripType<T>();
+    int strip = line / STRIP_HEIGHT;
+    int chain = strip % chains.size();
+
+    if ( stripType<T>() != type ) {
+        // Les chaînes ne sont pas réentrantes : on attend qu'aucune ne soit utilisée
+        for ( unsigned int c = 0; c < chains.size(); c++ ) finishStrip ( c, false );
+        current = -1;
+        return chains.at ( chain )->getline ( buffer, line );
+    }
+
+    moveTo ( strip );
+
+    int rowSize = width * channels;
+    memcpy ( buffer, ( ( T* ) buffers.at ( chain ) ) + ( line - strip * STRIP_HEIGHT ) * rowSize, rowSize * sizeof ( T ) );
+    return rowSize;
+}
+
+int StripImage::getline ( uint8_t* buffer, int line ) {
+    return _getline ( buffer, line );
+}
+
+int StripImage::getline ( uint16_t* buffer, int line ) {
+    return _getline ( buffer, line );
+}
+
+int StripImage::getline ( float* buffer, int line ) {
+    return _getline ( buffer, line );
+}
+
+StripImage* StripImageFactory::createStripImage ( std::vector<Image*>& chains, ThreadPool* pool ) {
+    if ( chains.size() < 2 || pool == NULL ) return NULL;
+
+    for ( unsigned int i = 1; i < chains.size(); i++ ) {
+        if ( chains.at ( i )->getWidth() != chains.at ( 0 )->getWidth() || chains.at ( i )->getHeight() != chains.at ( 0 )->getHeight() ||
+             chains.at ( i )->getChannels() != chains.at ( 0 )->getChannels() ) {
+            LOGGER_DEBUG ( "Processing chains with different dimensions cannot compute strips of the same image" );
+            return NULL;
+        }
+    }
+
+    return new StripImage ( chains, pool );
+}
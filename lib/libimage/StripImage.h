@@ -0,0 +1,223 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file StripImage.h
+ ** \~french
+ * \brief Définition des classes StripImage et StripImageFactory
+ * \details
+ * \li StripImage : image calculée en parallèle par bandes horizontales
+ * \li StripImageFactory : usine de création d'objets StripImage
+ ** \~english
+ * \brief Define classes StripImage and StripImageFactory
+ * \details
+ * \li StripImage : image computed concurrently by horizontal strips
+ * \li StripImageFactory : factory to create StripImage objects
+ */
+
+#ifndef STRIP_IMAGE_H
+#define STRIP_IMAGE_H
+
+#include "Image.h"
+#include "ThreadPool.h"
+#include <vector>
+
+/**
+ * \~french \brief Nombre de lignes d'une bande
+ * \~english \brief Number of lines in a strip
+ */
+#define STRIP_HEIGHT 256
+
+class StripJob;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Image calculée en parallèle par bandes horizontales
+ * \details L'image est découpée en bandes de STRIP_HEIGHT lignes, calculées sur un pool de threads pendant que les lignes des bandes précédentes sont lues dans l'ordre (par un encodeur par exemple).
+ *
+ * Les chaînes de traitement (rééchantillonnage, reprojection...) conservent un état entre deux lignes et ne sont pas réentrantes : l'image est construite à partir de plusieurs chaînes identiques, indépendantes, la bande i étant calculée par la chaîne i modulo leur nombre. Ce nombre borne à la fois le parallélisme de la requête et la mémoire des bandes en cours. Les chaînes, construites entre RequestTileSet::begin et RequestTileSet::end, partagent les tuiles sources, lues et décodées une seule fois.
+ *
+ * Le thread lecteur calcule lui-même la bande dont il a besoin si aucun thread du pool ne l'a encore prise : il n'attend jamais une tâche encore en file derrière celles d'autres requêtes.
+ *
+ * Les bandes sont conservées dans le type de la première lecture. Une lecture dans un autre type attend la fin des bandes en cours et est servie directement par la chaîne concernée.
+ * \~english
+ * \brief Image computed concurrently by horizontal strips
+ * \details The image is split in strips of STRIP_HEIGHT lines, computed on a threads pool while lines of previous strips are read in order (by an encoder for example).
+ *
+ * Processing chains (resampling, reprojection...) keep a state between two lines and are not reentrant : the image is built from several identical, independent chains, strip i being computed by chain i modulo their count. This count limits both the request's parallelism and the memory of strips in progress. Chains, built between RequestTileSet::begin and RequestTileSet::end, share source tiles, read and decoded only once.
+ *
+ * The reading thread computes itself the strip it needs if no pool thread took it yet : it never waits for a task still queued behind other requests' ones.
+ *
+ * Strips are kept in the first read's type. A read in another type waits for strips in progress to end and is served directly by the concerned chain.
+ */
+class StripImage : public Image {
+
+    friend class StripImageFactory;
+
+public:
+
+    /**
+     * \~french \brief Type des valeurs des bandes
+     * \~english \brief Strips' values type
+     */
+    enum StripType {
+        UNKNOWN_TYPE,
+        UINT8_TYPE,
+        UINT16_TYPE,
+        FLOAT_TYPE
+    };
+
+    /**
+     * \~french \brief Calcule une bande, dans le tampon de sa chaîne
+     * \~english \brief Compute a strip, into its chain's buffer
+     */
+    void computeStrip ( int strip );
+
+private:
+
+    /**
+     * \~french \brief Chaînes de traitement identiques, détruites avec l'image
+     * \~english \brief Identical processing chains, deleted with the image
+     */
+    std::vector<Image*> chains;
+
+    /**
+     * \~french \brief Pool de threads exécutant les calculs, partagé
+     * \~english \brief Threads pool running computations, shared
+     */
+    ThreadPool* pool;
+
+    /**
+     * \~french \brief Nombre de bandes
+     * \~english \brief Number of strips
+     */
+    int stripCount;
+
+    /**
+     * \~french \brief Indice de la bande lue, -1 si aucune
+     * \~english \brief Read strip's index, -1 if none
+     */
+    int current;
+
+    /**
+     * \~french \brief Type des bandes
+     * \~english \brief Strips' type
+     */
+    StripType type;
+
+    /**
+     * \~french \brief Lignes de la bande en cours, par chaîne
+     * \~english \brief Lines of the strip in progress, by chain
+     */
+    std::vector<uint8_t*> buffers;
+
+    /**
+     * \~french \brief Calcul de la bande en cours, par chaîne (NULL si aucune)
+     * \~english \brief Computing of the strip in progress, by chain (NULL if none)
+     */
+    std::vector<StripJob*> jobs;
+
+    /**
+     * \~french \brief Lance le calcul d'une bande par sa chaîne, dont la bande précédente doit être terminée
+     * \~english \brief Start a strip's computing by its chain, whose previous strip have to be over
+     */
+    void startStrip ( int strip );
+
+    /**
+     * \~french \brief Termine la bande en cours d'une chaîne
+     * \param[in] chain indice de la chaîne
+     * \param[in] needed la bande doit-elle être calculée, ou seulement attendue si elle est déjà prise
+     * \~english \brief Finish a chain's strip in progress
+     * \param[in] chain chain's index
+     * \param[in] needed have the strip to be computed, or only waited if already taken
+     */
+    void finishStrip ( int chain, bool needed );
+
+    /**
+     * \~french \brief Rend la bande demandée disponible dans le tampon de sa chaîne
+     * \~english \brief Make asked strip available in its chain's buffer
+     */
+    void moveTo ( int strip );
+
+    template<typename T>
+    int _getline ( T* buffer, int line );
+
+    /**
+     * \~french \brief Crée l'image, qui prend possession des chaînes
+     * \~english \brief Create the image, which takes chains' ownership
+     */
+    StripImage ( std::vector<Image*>& chains, ThreadPool* pool );
+
+public:
+
+    virtual int getline ( uint8_t* buffer, int line );
+    virtual int getline ( uint16_t* buffer, int line );
+    virtual int getline ( float* buffer, int line );
+
+    /**
+     * \~french \brief Destructeur, attend les bandes en cours et détruit les chaînes
+     * \~english \brief Destructor, wait for strips in progress and delete chains
+     */
+    virtual ~StripImage();
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french \brief Usine de création d'objets StripImage
+ * \~english \brief Factory to create StripImage objects
+ */
+class StripImageFactory {
+public:
+    /**
+     * \~french
+     * \brief Crée une image calculée en parallèle à partir de chaînes de traitement identiques
+     * \details Les chaînes doivent avoir les mêmes dimensions. En cas de succès, elles deviennent la propriété de l'image.
+     * \param[in] chains chaînes de traitement, au moins deux
+     * \param[in] pool pool de threads exécutant les calculs
+     * \return l'image, NULL si les chaînes ne conviennent pas
+     * \~english
+     * \brief Create an image computed concurrently from identical processing chains
+     * \details Chains have to get same dimensions. On success, they become image's property.
+     * \param[in] chains processing chains, at least two
+     * \param[in] pool threads pool running computations
+     * \return the image, NULL if chains are not suitable
+     */
+    StripImage* createStripImage ( std::vector<Image*>& chains, ThreadPool* pool );
+};
+
+#endif
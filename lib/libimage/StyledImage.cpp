@@ -38,6 +38,7 @@
 #include "StyledImage.h"
 
 #include "Logger.h"
+#include "RequestTrace.h"
 
 int StyledImage::getline ( float* buffer, int line ) {
     //Styled image do not translate to float
@@ -51,6 +52,7 @@ int StyledImage::getline ( uint16_t* buffer, int line ) {
 
 int StyledImage::getline ( uint8_t* buffer, int line ) {
     if ( origImage->getChannels()==1 && palette->getColoursMap() && !palette->getColoursMap()->empty() ) {
+        TraceScope scope ( TraceStage::STYLE );
         return _getline ( buffer, line );
     }
 
@@ -53,14 +53,21 @@
 #include <sys/stat.h>
 #include "CurlPool.h"
 #include <time.h>
+#include <unistd.h>
+#include "RequestTrace.h"
+
+/** \~french \brief Compteur des envois, pour des identifiants d'envoi uniques dans le processus
+ * \~english \brief Uploads counter, for unique upload identifiers in the process
+ */
+static unsigned int uploadsCounter = 0;
 
 SwiftContext::SwiftContext (std::string auth, std::string user, std::string passwd, std::string container, bool ks) :
     Context(),
-    auth_url(auth),user_name(user), user_passwd(passwd), container_name(container), keystone_connection (ks)
+    auth_url(auth),user_name(user), user_passwd(passwd), container_name(container), keystone_connection (ks), sharedToken (NULL)
 {
 }
 
-SwiftContext::SwiftContext (std::string container, bool ks) : Context(), container_name(container), keystone_connection (ks) {
+SwiftContext::SwiftContext (std::string container, bool ks) : Context(), container_name(container), keystone_connection (ks), sharedToken (NULL) {
 
     char* auth = getenv ("ROK4_SWIFT_AUTHURL");
     if (auth == NULL) {
@@ -88,167 +95,14 @@ bool SwiftContext::connection() {
 
     if (! connected) {
 
-        if (keystone_connection) {
-            LOGGER_DEBUG("Keystone authentication");
-
-            char* domain = getenv ("ROK4_KEYSTONE_DOMAINID");
-            if (domain == NULL) {
-                LOGGER_ERROR("We need a domain id (ROK4_KEYSTONE_DOMAINID) for a keystone authentication");
-                return false;
-            } else {
-                domain_id.assign(domain);
-            }
-
-            char* project = getenv ("ROK4_KEYSTONE_PROJECTID");
-            if (project == NULL) {
-                LOGGER_ERROR("We need a project id (ROK4_KEYSTONE_PROJECTID) for a keystone authentication");
-                return false;
-            } else {
-                project_id.assign(project);
-            }
-
-            char* publicu = getenv ("ROK4_SWIFT_PUBLICURL");
-            if (publicu == NULL) {
-                LOGGER_ERROR("We need a public url (ROK4_SWIFT_PUBLICURL) for a keystone authentication");
-                return false;
-            } else {
-                public_url.assign(publicu);
-            }
-
-            CURLcode res;
-            struct curl_slist *list = NULL;
-
-            CURL* curl = curl_easy_init();
-            curl_easy_setopt(curl, CURLOPT_URL, auth_url.c_str());
-            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-
-            // On constitue le header
-
-            char* ct = "Content-Type: application/json";
-            list = curl_slist_append(list, ct);
-
-            // On constitue le body
-
-            std::string body = "{ \"auth\": {\"scope\": { \"project\": {\"id\": \""+project_id+"\"}}, ";
-            body += " \"identity\": { \"methods\": [\"password\"], \"password\": { \"user\": { \"domain\": { \"id\": \""+domain_id+"\"},";
-            body += "\"name\": \""+user_name+"\", \"password\": \""+user_passwd+"\" } } } } }";
-
-            HeaderStruct authHdr;
-            DataStruct chunk;
-            chunk.nbPassage = 0;
-            chunk.data = (char*) malloc(1);
-            chunk.size = 0;
-
-            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
-            curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void*) &authHdr);
-            curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, data_callback);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &chunk);
-
-            res = curl_easy_perform(curl);
-            if( CURLE_OK != res) {
-                LOGGER_ERROR("Cannot authenticate to Keystone");
-                LOGGER_ERROR(curl_easy_strerror(res));
-                curl_slist_free_all(list);
-                curl_easy_cleanup(curl);
-                return false;
-            }
-
-            long http_code = 0;
-            curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
-            if (http_code < 200 || http_code > 299) {
-                LOGGER_ERROR("Cannot authenticate to Keystone");
-                LOGGER_ERROR("Response HTTP code : " << http_code);
-                curl_slist_free_all(list);
-                curl_easy_cleanup(curl);
-                return false;
-            }
-
-            // On récupère le token dans le header de la réponse
-            token = std::string(authHdr.token);
-
-            curl_slist_free_all(list);
-            curl_easy_cleanup(curl);
-
-        } else {
-
-            LOGGER_DEBUG("Swift authentication");
-
-            char* account = getenv ("ROK4_SWIFT_ACCOUNT");
-            if (account == NULL) {
-                LOGGER_ERROR("We need an account (ROK4_SWIFT_ACCOUNT) for a Swift authentication");
-                return false;
-            } else {
-                user_account.assign(account);
-            }
-
-            CURLcode res;
-            struct curl_slist *list = NULL;
-
-            CURL* curl = curl_easy_init();
-            curl_easy_setopt(curl, CURLOPT_URL, auth_url.c_str());
-            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-
-            // On constitue le header et le moyen de récupération des informations (avec les structures de LibcurlStruct)
-
-            char xUser[256];
-            strcpy(xUser, "X-Storage-User: ");
-            strcat(xUser, user_account.c_str());
-            strcat(xUser, ":");
-            strcat(xUser, user_name.c_str());
-
-            char xPass[256];
-            strcpy(xPass, "X-Storage-Pass: ");
-            strcat(xPass, user_passwd.c_str());
-
-            char xAuthUser[256];
-            strcpy(xAuthUser, "X-Auth-User: ");
-            strcat(xAuthUser, user_account.c_str());
-            strcat(xAuthUser, ":");
-            strcat(xAuthUser, user_name.c_str());
-
-            char xAuthKey[256];
-            strcpy(xAuthKey, "X-Auth-Key: ");
-            strcat(xAuthKey, user_passwd.c_str());
-
-
-            list = curl_slist_append(list, xUser);
-            list = curl_slist_append(list, xPass);        
-            list = curl_slist_append(list, xAuthUser);
-            list = curl_slist_append(list, xAuthKey);
+        // Le token est partagé avec les autres contextes utilisant les mêmes identifiants
+        sharedToken = SwiftToken::get(auth_url, user_name, user_passwd, keystone_connection);
 
-            HeaderStruct authHdr;
-
-            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
-            curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void*) &authHdr);
-            curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
-
-            res = curl_easy_perform(curl);
-            if( CURLE_OK != res) {
-                LOGGER_ERROR("Cannot authenticate to Swift");
-                LOGGER_ERROR(curl_easy_strerror(res));
-                curl_slist_free_all(list);
-                curl_easy_cleanup(curl);
-                return false;
-            }
-
-            long http_code = 0;
-            curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
-            if (http_code < 200 || http_code > 299) {
-                LOGGER_ERROR("Cannot authenticate to Swift");
-                LOGGER_ERROR("Response HTTP code : " << http_code);
-                curl_slist_free_all(list);
-                curl_easy_cleanup(curl);
-                return false;
-            }
-
-            // On récupère l'URL publique et le token dans le header de la réponse
-            public_url = std::string(authHdr.url);
-            token = std::string(authHdr.token);
-
-            curl_slist_free_all(list);
-            curl_easy_cleanup(curl);
+        std::string header, url;
+        unsigned long number;
+        if (! sharedToken->getToken(header, url, number)) {
+            LOGGER_ERROR("Cannot get a token for the Swift container " << container_name);
+            return false;
         }
 
         connected = true;
@@ -267,78 +121,102 @@ int SwiftContext::read(uint8_t* data, int offset, int size, std::string name) {
 
     LOGGER_DEBUG("Swift read : " << size << " bytes (from the " << offset << " one) in the object " << name);
 
-    CURLcode res;
-    struct curl_slist *list = NULL;
-    DataStruct chunk;
-    chunk.nbPassage = 0;
-    chunk.data = (char*) malloc(1);
-    chunk.size = 0;
-
     int lastBytes = offset + size - 1;
 
     CURL* curl = CurlPool::getCurlEnv();
     //curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
 
-    // On constitue le header et le moyen de récupération des informations (avec les structures de LibcurlStruct)
+    // Un token refusé (401) est renouvelé, et la lecture retentée une fois
+    for (int tentative = 1; tentative <= 2; tentative++) {
 
-    std::string fullUrl;
-    fullUrl = public_url + "/" + container_name + "/" + name;
+        std::string token, public_url;
+        unsigned long number;
+        if (! sharedToken->getToken(token, public_url, number)) {
+            LOGGER_ERROR("Cannot read data from Swift : no valid token (request " << RequestTrace::getId() << ")");
+            return -1;
+        }
 
-    char range[50];
-    sprintf(range, "Range: bytes=%d-%d", offset, lastBytes);
+        CURLcode res;
+        struct curl_slist *list = NULL;
+        DataStruct chunk;
+        chunk.nbPassage = 0;
+        chunk.data = (char*) malloc(1);
+        chunk.size = 0;
 
-    list = curl_slist_append(list, token.c_str());
-    list = curl_slist_append(list, range);
-
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
-    curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, data_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &chunk);
-
-    LOGGER_INFO("SWIFT READ START (" << size << ") " << pthread_self());
-    res = curl_easy_perform(curl);
-    LOGGER_INFO("SWIFT READ END (" << size << ") " << pthread_self());
-    
-    curl_slist_free_all(list);
-
-    if( CURLE_OK != res) {
-        LOGGER_ERROR("Cannot read data from Swift : " << size << " bytes (from the " << offset << " one) in the object " << name);
-        LOGGER_ERROR(curl_easy_strerror(res));
-        return -1;
-    }
+        // On constitue le header et le moyen de récupération des informations (avec les structures de LibcurlStruct)
 
-    long http_code = 0;
-    curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
-    if (http_code < 200 || http_code > 299) {
-        LOGGER_ERROR("Cannot read data from Swift : " << size << " bytes (from the " << offset << " one) in the object " << name);
-        LOGGER_ERROR("Response HTTP code : " << http_code);
-        return -1;
-    }
+        std::string fullUrl;
+        fullUrl = public_url + "/" + container_name + "/" + name;
+
+        char range[50];
+        sprintf(range, "Range: bytes=%d-%d", offset, lastBytes);
+
+        list = curl_slist_append(list, token.c_str());
+        list = curl_slist_append(list, range);
+
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+        curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, data_callback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &chunk);
 
-    memcpy(data, chunk.data, chunk.size);
+        LOGGER_DEBUG("SWIFT READ START (" << size << ") request " << RequestTrace::getId());
+        res = curl_easy_perform(curl);
+        LOGGER_DEBUG("SWIFT READ END (" << size << ") request " << RequestTrace::getId());
 
-    return chunk.size;
+        curl_slist_free_all(list);
+
+        if( CURLE_OK != res) {
+            LOGGER_ERROR("Cannot read data from Swift : " << size << " bytes (from the " << offset << " one) in the object " << name << " (request " << RequestTrace::getId() << ")");
+            LOGGER_ERROR(curl_easy_strerror(res));
+            return -1;
+        }
+
+        long http_code = 0;
+        curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
+        if (http_code == 401 && tentative == 1) {
+            if (! sharedToken->invalidate(number)) {
+                LOGGER_ERROR("Cannot read data from Swift : token refused and not renewed (request " << RequestTrace::getId() << ")");
+                return -1;
+            }
+            continue;
+        }
+        if (http_code < 200 || http_code > 299) {
+            LOGGER_ERROR("Cannot read data from Swift : " << size << " bytes (from the " << offset << " one) in the object " << name << " (request " << RequestTrace::getId() << ")");
+            LOGGER_ERROR("Response HTTP code : " << http_code);
+            return -1;
+        }
+
+        memcpy(data, chunk.data, chunk.size);
+
+        return chunk.size;
+    }
+
+    return -1;
 }
 
 bool SwiftContext::write(uint8_t* data, int offset, int size, std::string name) {
     LOGGER_DEBUG("Swift write : " << size << " bytes (from the " << offset << " one) in the writing buffer " << name);
 
-    std::map<std::string, std::vector<char>*>::iterator it1 = writingBuffers.find ( name );
-    if ( it1 == writingBuffers.end() ) {
+    std::map<std::string, PartedBuffer*>::iterator it1 = partedBuffers.find ( name );
+    if ( it1 == partedBuffers.end() ) {
         // pas de buffer pour ce nom d'objet
         LOGGER_ERROR("No writing buffer for the name " << name);
         return false;
     }
-    LOGGER_DEBUG("old length: " << it1->second->size());
-   
-    // Calcul de la taille finale et redimensionnement éventuel du vector
-    if (it1->second->size() < size + offset) {
-        it1->second->resize(size + offset);
+
+    if (! it1->second->write(data, offset, size)) {
+        LOGGER_ERROR("Cannot write in the Swift writing buffer " << name);
+        return false;
     }
 
-    memcpy(&((*(it1->second))[0]) + offset, data, size);
-    LOGGER_DEBUG("new length: " << it1->second->size());
+    // Les parties complètes sont envoyées comme segments sans attendre la fermeture de l'objet
+    int index;
+    while ((index = it1->second->getCompletePart()) >= 0) {
+        if (! uploadSegment(name, partUploaders[name], index, it1->second->takePart(index))) {
+            return false;
+        }
+    }
 
     return true;
 }
@@ -346,19 +224,18 @@ bool SwiftContext::write(uint8_t* data, int offset, int size, std::string name)
 bool SwiftContext::writeFull(uint8_t* data, int size, std::string name) {
     LOGGER_DEBUG("Swift write : " << size << " bytes (one shot) in the writing buffer " << name);
 
-    std::map<std::string, std::vector<char>*>::iterator it1 = writingBuffers.find ( name );
-    if ( it1 == writingBuffers.end() ) {
+    std::map<std::string, PartedBuffer*>::iterator it1 = partedBuffers.find ( name );
+    if ( it1 == partedBuffers.end() ) {
         // pas de buffer pour ce nom d'objet
         LOGGER_ERROR("No Swift writing buffer for the name " << name);
         return false;
     }
 
-    it1->second->clear();
-
-    it1->second->resize(size);
-    memcpy(&((*(it1->second))[0]), data, size);
+    if (! it1->second->reset()) {
+        return false;
+    }
 
-    return true;
+    return write(data, 0, size, name);
 }
 
 eContextType SwiftContext::getType() {
@@ -376,78 +253,286 @@ std::string SwiftContext::getTray() {
 
 bool SwiftContext::openToWrite(std::string name) {
 
-    std::map<std::string, std::vector<char>*>::iterator it1 = writingBuffers.find ( name );
-    if ( it1 != writingBuffers.end() ) {
+    std::map<std::string, PartedBuffer*>::iterator it1 = partedBuffers.find ( name );
+    if ( it1 != partedBuffers.end() ) {
         LOGGER_ERROR("A Swift writing buffer already exists for the name " << name);
         return false;
 
     } else {
-        writingBuffers.insert ( std::pair<std::string,std::vector<char>*>(name, new std::vector<char>()) );
+        partedBuffers.insert ( std::pair<std::string,PartedBuffer*>(name, new PartedBuffer()) );
+        partUploaders.insert ( std::pair<std::string,PartUploader*>(name, new PartUploader()) );
+
+        char uploadId[64];
+        sprintf(uploadId, "%ld_%d_%u", (long) time(NULL), (int) getpid(), __atomic_add_fetch(&uploadsCounter, 1, __ATOMIC_RELAXED));
+        uploadIds[name] = std::string(uploadId);
     }
 
     return true;
 }
 
+std::string SwiftContext::getSegmentName(std::string name, std::string uploadId, int index) {
+    char segment[20];
+    sprintf(segment, "/segment%08d", index);
+    return name + "/" + uploadId + std::string(segment);
+}
 
-bool SwiftContext::closeToWrite(std::string name) {
+bool SwiftContext::uploadSegment(std::string name, PartUploader* uploader, int index, std::vector<char>* data) {
+
+    if (data == NULL) {
+        return false;
+    }
 
+    LOGGER_DEBUG("Upload the segment " << index << " (" << data->size() << " bytes) of the Swift object " << name);
 
-    std::map<std::string, std::vector<char>*>::iterator it1 = writingBuffers.find ( name );
-    if ( it1 == writingBuffers.end() ) {
-        LOGGER_ERROR("The Swift writing buffer with name " << name << "does not exist, cannot flush it");
+    std::string token, public_url;
+    unsigned long number;
+    if (! sharedToken->getToken(token, public_url, number)) {
+        LOGGER_ERROR("Cannot upload the segment " << index << " of the Swift object " << name << " : no valid token");
+        delete data;
         return false;
     }
 
+    struct curl_slist *list = NULL;
+    list = curl_slist_append(list, token.c_str());
 
-    LOGGER_DEBUG("Write buffered " << it1->second->size() << " bytes in the Swift object " << name);
+    return uploader->upload(index, data, public_url + "/" + container_name + "/" + getSegmentName(name, uploadIds[name], index), list);
+}
 
+bool SwiftContext::deleteSegments(std::string name, std::string uploadId, int partsNumber) {
 
-    CURLcode res;
-    struct curl_slist *list = NULL;
-    CURL* curl = CurlPool::getCurlEnv();
+    LOGGER_DEBUG("Delete the " << partsNumber << " segments of the abandoned upload " << uploadId << " of the Swift object " << name);
 
-    // On constitue le header
+    bool ok = true;
+    for (int index = 0; index < partsNumber; index++) {
+        if (! sendRequest("DELETE", "/" + getSegmentName(name, uploadId, index), NULL, 0)) {
+            ok = false;
+        }
+    }
 
-    std::string fullUrl;
-    fullUrl = public_url + "/" + container_name + "/" + name;
+    return ok;
+}
 
-    list = curl_slist_append(list, token.c_str());
+bool SwiftContext::deleteStaleSegments(std::string name, std::string uploadId) {
 
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
-    curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, &((*(it1->second))[0]));
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, it1->second->size());
+    std::string prefix = name + "/";
 
-    res = curl_easy_perform(curl);
+    CURL* curl = CurlPool::getCurlEnv();
+    char* escaped = curl_easy_escape(curl, prefix.c_str(), prefix.size());
+    std::string query = "?prefix=" + std::string(escaped);
+    curl_free(escaped);
 
-    if( CURLE_OK != res) {
-        LOGGER_ERROR ( "Unable to flush " << it1->second->size() << " bytes in the object " << name );
-        LOGGER_ERROR(curl_easy_strerror(res));
-        curl_slist_free_all(list);
-        curl_easy_cleanup(curl);
+    std::string listing;
+    if (! sendRequest("GET", query, NULL, 0, &listing)) {
+        LOGGER_ERROR("Cannot list the segments of the Swift object " << name);
         return false;
     }
 
-    long http_code = 0;
-    curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
-    if (http_code < 200 || http_code > 299) {
-        LOGGER_ERROR ( "Unable to flush " << it1->second->size() << " bytes in the object " << name );
-        LOGGER_ERROR("Response HTTP code : " << http_code);
+    // Un segment est "<nom>/segmentNNNNNNNN" (ancien nommage) ou "<nom>/<identifiant>/segmentNNNNNNNN"
+    std::string current = prefix + uploadId + "/";
+    bool ok = true;
+    std::istringstream lines(listing);
+    std::string object;
+    while (std::getline(lines, object)) {
+        if (object.size() < prefix.size() + 15 || object.compare(0, prefix.size(), prefix) != 0) continue;
+        if (object.compare(0, current.size(), current) == 0) continue;
+
+        size_t slash = object.rfind('/');
+        if (object.size() - slash != 16 || object.compare(slash, 8, "/segment") != 0) continue;
+        if (object.find_first_not_of("0123456789", slash + 8) != std::string::npos) continue;
+
+        LOGGER_DEBUG("Delete the stale segment " << object);
+        if (! sendRequest("DELETE", "/" + object, NULL, 0)) {
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+bool SwiftContext::sendRequest(std::string method, std::string path, const char* body, int64_t size, std::string* response) {
+
+    CURL* curl = CurlPool::getCurlEnv();
+
+    // Un token refusé (401) est renouvelé, et la requête retentée une fois
+    for (int tentative = 1; tentative <= 2; tentative++) {
+
+        std::string token, public_url;
+        unsigned long number;
+        if (! sharedToken->getToken(token, public_url, number)) {
+            LOGGER_ERROR ( "Unable to send the Swift request " << method << " " << container_name << path << " : no valid token" );
+            return false;
+        }
+
+        CURLcode res;
+        struct curl_slist *list = NULL;
+        DataStruct chunk;
+        chunk.nbPassage = 0;
+        chunk.data = (char*) malloc(1);
+        chunk.size = 0;
+
+        // On constitue le header
+
+        std::string fullUrl;
+        fullUrl = public_url + "/" + container_name + path;
+
+        list = curl_slist_append(list, token.c_str());
+
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+        curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, data_callback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &chunk);
+        if (method == "PUT") {
+            curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, (body == NULL) ? "" : body);
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long) size);
+        } else if (method == "DELETE") {
+            curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+        }
+
+        res = curl_easy_perform(curl);
         curl_slist_free_all(list);
-        curl_easy_cleanup(curl);
+
+        long http_code = 0;
+        curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+        // L'objet curl est partagé avec les lectures : on lui rend ses options par défaut (GET)
+        curl_easy_reset(curl);
+
+        if( CURLE_OK != res) {
+            LOGGER_ERROR ( "Unable to send the Swift request " << method << " " << container_name << path );
+            LOGGER_ERROR(curl_easy_strerror(res));
+            return false;
+        }
+
+        if (http_code == 401 && tentative == 1) {
+            if (! sharedToken->invalidate(number)) {
+                LOGGER_ERROR ( "Unable to send the Swift request " << method << " " << container_name << path << " : token refused and not renewed" );
+                return false;
+            }
+            continue;
+        }
+
+        if (http_code == 404 && method == "DELETE") {
+            return true;
+        }
+
+        if (http_code < 200 || http_code > 299) {
+            LOGGER_ERROR ( "Unable to send the Swift request " << method << " " << container_name << path );
+            LOGGER_ERROR("Response HTTP code : " << http_code);
+            return false;
+        }
+
+        if (response != NULL) {
+            response->assign(chunk.data, chunk.size);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+bool SwiftContext::closeToWrite(std::string name) {
+
+    std::map<std::string, PartedBuffer*>::iterator it1 = partedBuffers.find ( name );
+    if ( it1 == partedBuffers.end() ) {
+        LOGGER_ERROR("The Swift writing buffer with name " << name << "does not exist, cannot flush it");
         return false;
     }
 
-    curl_slist_free_all(list);
+    PartedBuffer* buffer = it1->second;
+    partedBuffers.erase(it1);
+
+    std::map<std::string, PartUploader*>::iterator it2 = partUploaders.find ( name );
+    PartUploader* uploader = it2->second;
+    partUploaders.erase(it2);
+
+    std::string uploadId = uploadIds[name];
+
+    bool ok = true;
+
+    if (! buffer->isStreamed() && buffer->getPartsNumber() <= 1) {
+        // Objet tenant dans un seul segment : envoi en une fois
+
+        LOGGER_DEBUG("Write buffered " << buffer->getLength() << " bytes in the Swift object " << name);
+
+        std::vector<char>* data = (buffer->getPartsNumber() == 0) ? new std::vector<char>() : buffer->takePart(0);
+        ok = sendRequest("PUT", "/" + name, data->empty() ? NULL : &((*data)[0]), data->size());
+        delete data;
+
+        if (! ok) {
+            LOGGER_ERROR ( "Unable to flush " << buffer->getLength() << " bytes in the object " << name );
+        }
+
+    } else {
+        // Objet segmenté : les segments restants, dont le premier, puis le manifeste (Static Large Object)
+
+        LOGGER_DEBUG("Write the last segments of the Swift object " << name << " (" << buffer->getLength() << " bytes)");
+
+        ok = uploadSegment(name, uploader, 0, buffer->takePart(0));
+        while (ok && buffer->getNextPart() < buffer->getPartsNumber()) {
+            int index = buffer->getNextPart();
+            ok = uploadSegment(name, uploader, index, buffer->takePart(index));
+        }
+
+        if (! uploader->wait()) {
+            ok = false;
+        }
+
+        if (ok) {
+            int partSize = PARTED_BUFFER_PART_SIZE;
+            int partsNumber = buffer->getPartsNumber();
+
+            std::ostringstream manifest;
+            manifest << "[";
+            std::map<int, std::string>::iterator it;
+            for (it = uploader->getEtags().begin(); it != uploader->getEtags().end(); ++it) {
+                int64_t size = partSize;
+                if (it->first == partsNumber - 1) size = buffer->getLength() - (int64_t) it->first * partSize;
 
+                std::string etag = it->second;
+                if (etag.size() >= 2 && etag[0] == '"') etag = etag.substr(1, etag.size() - 2);
+
+                if (it != uploader->getEtags().begin()) manifest << ",";
+                manifest << "{\"path\":\"/" << container_name << "/" << getSegmentName(name, uploadId, it->first) << "\",\"etag\":\"" << etag << "\",\"size_bytes\":" << size << "}";
+            }
+            manifest << "]";
 
+            ok = sendRequest("PUT", "/" + name + "?multipart-manifest=put", manifest.str().c_str(), manifest.str().size());
+        }
 
+        if (! ok) {
+            LOGGER_ERROR ( "Unable to flush " << buffer->getLength() << " bytes in the segmented object " << name );
+            // Les segments envoyés ne seront référencés par aucun manifeste
+            deleteSegments(name, uploadId, buffer->getNextPart());
+        } else if (! deleteStaleSegments(name, uploadId)) {
+            // Les segments d'une version précédente de l'objet ne sont plus référencés
+            LOGGER_WARN("Segments of a previous version of the Swift object " << name << " may remain");
+        }
+    }
 
     LOGGER_DEBUG("Erase the flushed buffer");
-    delete it1->second;
-    writingBuffers.erase(it1);
+    delete buffer;
+    delete uploader;
+    uploadIds.erase(name);
 
-    return true;
-}
\ No newline at end of file
+    return ok;
+}
+
+SwiftContext::~SwiftContext() {
+    std::map<std::string, PartedBuffer*>::iterator it1;
+    for (it1 = partedBuffers.begin(); it1 != partedBuffers.end(); ++it1) {
+        PartUploader* uploader = partUploaders[it1->first];
+        // Les segments d'une écriture abandonnée ne seront référencés par aucun manifeste
+        if (uploader != NULL && it1->second->isStreamed()) {
+            uploader->wait();
+            deleteSegments(it1->first, uploadIds[it1->first], it1->second->getNextPart());
+        }
+        delete it1->second;
+    }
+    std::map<std::string, PartUploader*>::iterator it2;
+    for (it2 = partUploaders.begin(); it2 != partUploaders.end(); ++it2) {
+        delete it2->second;
+    }
+}
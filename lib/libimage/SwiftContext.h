@@ -54,6 +54,9 @@
 #include "Logger.h"
 #include "Context.h"
 #include "LibcurlStruct.h"
+#include "PartedBuffer.h"
+#include "PartUploader.h"
+#include "SwiftToken.h"
 
 /**
  * \author Institut national de l'information géographique et forestière
@@ -87,45 +90,100 @@ private:
     bool keystone_connection;
 
     /**
-     * \~french \brief ID de domaine, pour une authentification Keystone
-     * \details Récupéré via la variable d'environnement ROK4_KEYSTONE_DOMAINID
-     * \~english \brief Domain ID, for keystone authentication
+     * \~french \brief Nom du conteneur Swift
+     * \~english \brief Swift container name
      */
-    std::string domain_id;
+    std::string container_name;
+
     /**
-     * \~french \brief ID de projet, pour une authentification Keystone
-     * \details Récupéré via la variable d'environnement ROK4_KEYSTONE_PROJECTID
-     * \~english \brief Project ID, for keystone authentication
+     * \~french \brief Token à utiliser pour chaque échange avec Swift
+     * \details Partagé entre tous les contextes utilisant les mêmes identifiants, et renouvelé avant son expiration. Il porte aussi l'URL de communication avec Swift.
+     * \~english \brief Token to use to communicate with Swift
+     * \details Shared between all contexts with the same credentials, and renewed before its expiration. It holds the Swift communication URL too.
      */
-    std::string project_id;
+    SwiftToken* sharedToken;
 
     /**
-     * \~french \brief Accompte Swift, pour une authentification Swift
-     * \details Récupéré via la variable d'environnement ROK4_SWIFT_ACCOUNT
-     * \~english \brief Swift account, for swift authentication
+     * \~french \brief Buffers d'écriture, selon le nom de l'objet
+     * \~english \brief Writing buffers, by object's name
      */
-    std::string user_account;
-    
+    std::map<std::string, PartedBuffer*> partedBuffers;
+
     /**
-     * \~french \brief URL de communication avec Swift
-     * \details
-     * \li Authentification keystone : récupéré via la variable d'environnement ROK4_SWIFT_PUBLICURL
-     * \li Authentification Swift : récupéré dans le header de la réponse à la requête de connexion
-     * \~english \brief Communication URL with Swift
+     * \~french \brief Envois des segments, selon le nom de l'objet
+     * \~english \brief Segments' uploads, by object's name
      */
-    std::string public_url;
+    std::map<std::string, PartUploader*> partUploaders;
 
     /**
-     * \~french \brief Nom du conteneur Swift
-     * \~english \brief Swift container name
+     * \~french \brief Identifiant de l'envoi en cours, selon le nom de l'objet
+     * \details Les segments d'un envoi sont préfixés par cet identifiant : un envoi échoué ne touche pas aux segments de la version précédente de l'objet
+     * \~english \brief Current upload's identifier, by object's name
+     * \details Upload's segments are prefixed with this identifier : a failed upload does not alter segments of the object's previous version
      */
-    std::string container_name;
+    std::map<std::string, std::string> uploadIds;
 
     /**
-     * \~french \brief Token à utiliser pour chaque échange avec Swift
-     * \~english \brief Token to use to communicate with Swift
+     * \~french \brief Nom d'un segment d'un objet segmenté : "<nom>/<identifiant de l'envoi>/segmentNNNNNNNN"
+     * \~english \brief Segment's name of a segmented object : "<name>/<upload identifier>/segmentNNNNNNNN"
+     */
+    std::string getSegmentName(std::string name, std::string uploadId, int index);
+
+    /**
+     * \~french \brief Lance l'envoi d'un segment, dans un thread de l'envoyeur
+     * \~english \brief Start a segment's upload, in an uploader's thread
+     */
+    bool uploadSegment(std::string name, PartUploader* uploader, int index, std::vector<char>* data);
+
+    /**
+     * \~french
+     * \brief Supprime les segments d'un envoi
+     * \details Utilisé quand l'envoi a échoué ou a été abandonné. Les segments absents (jamais envoyés) sont ignorés.
+     * \param[in] name nom de l'objet
+     * \param[in] uploadId identifiant de l'envoi
+     * \param[in] partsNumber nombre de segments de l'envoi
+     * \~english
+     * \brief Delete upload's segments
+     * \details Used when the upload failed or was abandoned. Missing segments (never uploaded) are ignored.
+     * \param[in] name object's name
+     * \param[in] uploadId upload's identifier
+     * \param[in] partsNumber upload's segments number
+     */
+    bool deleteSegments(std::string name, std::string uploadId, int partsNumber);
+
+    /**
+     * \~french
+     * \brief Supprime les segments des versions précédentes d'un objet
+     * \details Une fois le nouveau manifeste écrit, les segments listés sous "<nom>/" et n'appartenant pas à l'envoi courant ne sont plus référencés.
+     * \param[in] name nom de l'objet
+     * \param[in] uploadId identifiant de l'envoi courant
+     * \~english
+     * \brief Delete segments of object's previous versions
+     * \details Once the new manifest is written, segments listed under "<name>/" and not belonging to the current upload are no more referenced.
+     * \param[in] name object's name
+     * \param[in] uploadId current upload's identifier
+     */
+    bool deleteStaleSegments(std::string name, std::string uploadId);
+
+    /**
+     * \~french
+     * \brief Envoie une requête sur le conteneur, avec l'objet curl du thread
+     * \details Un token refusé est renouvelé et la requête retentée une fois. Une suppression d'objet absent (404) est considérée comme réussie.
+     * \param[in] method méthode HTTP (GET, PUT ou DELETE)
+     * \param[in] path chemin relatif au conteneur ("/<nom>" et paramètres de la requête), éventuellement vide
+     * \param[in] body contenu envoyé, éventuellement NULL
+     * \param[in] size taille du contenu envoyé
+     * \param[out] response contenu de la réponse, éventuellement NULL s'il n'est pas voulu
+     * \~english
+     * \brief Send a request on the container, with thread's curl object
+     * \details A refused token is renewed and the request tried again once. Deletion of a missing object (404) is considered successful.
+     * \param[in] method HTTP method (GET, PUT or DELETE)
+     * \param[in] path path relative to the container ("/<name>" and request's parameters), possibly empty
+     * \param[in] body sent content, possibly NULL
+     * \param[in] size sent content's size
+     * \param[out] response response's content, possibly NULL if not wanted
      */
-    std::string token;
+    bool sendRequest(std::string method, std::string path, const char* body, int64_t size, std::string* response = NULL);
 
 public:
 
@@ -182,14 +240,20 @@ public:
     /**
      * \~french
      * \brief Écrit de la donnée dans un objet Swift
-     * \details Les données sont en réalité écrites dans #writingBuffer et seront envoyées dans Swift lors de l'appel à #closeToWrite
+     * \details Les données sont écrites dans un PartedBuffer. Dès qu'une partie est complète, elle est envoyée comme segment (objet "<nom>/<identifiant de l'envoi>/segmentNNNNNNNN" du même conteneur) en parallèle de la suite des écritures. Le premier segment, où sont écrits les en-têtes, le dernier, et le manifeste (Static Large Object) sont envoyés lors de l'appel à #closeToWrite. Un objet tenant dans un seul segment est envoyé en une fois, par #closeToWrite.
+     * \~english
+     * \brief Write data in a Swift object
+     * \details Data is written in a PartedBuffer. As soon as a part is complete, it is uploaded as a segment ("<name>/<upload identifier>/segmentNNNNNNNN" object in the same container) in parallel with following writings. First segment, where headers are written, last one and the manifest (Static Large Object) are uploaded by #closeToWrite. An object fitting in a single segment is uploaded at once, by #closeToWrite.
      */
     bool write(uint8_t* data, int offset, int size, std::string name);
 
     /**
      * \~french
      * \brief Écrit un objet Swift
-     * \details Les données sont en réalité écrites dans #writingBuffer et seront envoyées dans Swift lors de l'appel à #closeToWrite
+     * \details Le contenu précédent du buffer d'écriture est remplacé, puis écrit comme avec #write
+     * \~english
+     * \brief Write a Swift object
+     * \details Previous writing buffer's content is replaced, then written like with #write
      */
     bool writeFull(uint8_t* data, int size, std::string name);
 
@@ -206,13 +270,22 @@ public:
     bool writeFromFile(std::string fileName, std::string objectName);
 
     virtual bool openToWrite(std::string name);
+
+    /**
+     * \~french
+     * \brief Termine l'écriture d'un objet Swift
+     * \details En cas d'échec, les segments déjà envoyés sont supprimés. En cas de succès d'un envoi segmenté, les segments d'une version précédente de l'objet sont supprimés. Un objet envoyé en une fois ne coûte pas cette vérification : s'il remplace un objet segmenté, les anciens segments restent.
+     * \~english
+     * \brief Finish a Swift object's writing
+     * \details On failure, already uploaded segments are deleted. On a segmented upload's success, segments of an object's previous version are deleted. An object sent at once does not pay for this check : if it replaces a segmented object, old segments remain.
+     */
     virtual bool closeToWrite(std::string name);
 
 
     virtual void print() {
         LOGGER_INFO ( "------ Swift Context -------" );
         LOGGER_INFO ( "\t- container name = " << container_name );
-        LOGGER_INFO ( "\t- token = " << token );
+        LOGGER_INFO ( "\t- user name = " << user_name );
     }
 
     virtual std::string toString() {
@@ -230,20 +303,9 @@ public:
     }
     
     /**
-     * \~french \brief Récupère le token #token
-     * \details 
-     * \li Pour une authentification keystone
-     * <TABLE>
-     * <TR><TH>Attribut</TH><TH>Variables d'environnement</TH>
-     * <TR><TD>domain_id</TD><TD>ROK4_KEYSTONE_DOMAINID</TD>
-     * <TR><TD>public_url</TD><TD>ROK4_SWIFT_PUBLICURL</TD>
-     * </TABLE>
-     * \li Pour une authentification Swift
-     * <TABLE>
-     * <TR><TH>Attribut</TH><TH>Variables d'environnement</TH>
-     * <TR><TD>user_account</TD><TD>ROK4_SWIFT_ACCOUNT</TD>
-     * </TABLE>
-     * \~english \brief Get token #token
+     * \~french \brief Récupère le token partagé #sharedToken
+     * \details Le token est obtenu auprès de SwiftToken, qui authentifie une seule fois les contextes ayant les mêmes identifiants. Les variables d'environnement utilisées pour l'authentification sont décrites dans SwiftToken::authenticate.
+     * \~english \brief Get the shared token #sharedToken
      */
     bool connection();
 
@@ -251,9 +313,13 @@ public:
         connected = false;
     }
     
-    virtual ~SwiftContext() {
-
-    }
+    /**
+     * \~french \brief Destructeur
+     * \details Les écritures non terminées sont abandonnées : leurs segments déjà envoyés sont supprimés
+     * \~english \brief Destructor
+     * \details Unfinished writings are abandoned : their already uploaded segments are deleted
+     */
+    virtual ~SwiftContext();
 };
 
 #endif
@@ -0,0 +1,331 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file SwiftToken.cpp
+ ** \~french
+ * \brief Implémentation de la classe SwiftToken
+ ** \~english
+ * \brief Implement class SwiftToken
+ */
+
+#include "SwiftToken.h"
+#include "Logger.h"
+#include <curl/curl.h>
+#include <string.h>
+#include "LibcurlStruct.h"
+
+std::map<std::string, SwiftToken*> SwiftToken::book;
+pthread_mutex_t SwiftToken::bookMutex = PTHREAD_MUTEX_INITIALIZER;
+int SwiftToken::defaultLifetime = SWIFT_TOKEN_DEFAULT_LIFETIME;
+
+SwiftToken::SwiftToken ( std::string auth, std::string user, std::string passwd, bool ks ) :
+    auth_url ( auth ), user_name ( user ), user_passwd ( passwd ), keystone ( ks ),
+    expiration ( 0 ), renewal ( 0 ), generation ( 0 ), authenticating ( false )
+{
+    pthread_mutex_init ( &mutex, NULL );
+    pthread_cond_init ( &authenticated, NULL );
+}
+
+SwiftToken* SwiftToken::get ( std::string auth, std::string user, std::string passwd, bool ks ) {
+    std::string key = ( ks ? "keystone " : "swift " ) + auth + " " + user + " " + passwd;
+
+    pthread_mutex_lock ( &bookMutex );
+    SwiftToken* st;
+    std::map<std::string, SwiftToken*>::iterator it = book.find ( key );
+    if ( it == book.end() ) {
+        st = new SwiftToken ( auth, user, passwd, ks );
+        book.insert ( std::pair<std::string, SwiftToken*> ( key, st ) );
+    } else {
+        st = it->second;
+    }
+    pthread_mutex_unlock ( &bookMutex );
+
+    return st;
+}
+
+void SwiftToken::setDefaultLifetime ( int seconds ) {
+    if ( seconds < 60 ) seconds = 60;
+    defaultLifetime = seconds;
+}
+
+/**
+ * \~french \brief Lit la date d'expiration ("expires_at") dans la réponse d'une authentification Keystone
+ * \return la durée de vie restante en secondes, -1 si absente
+ * \~english \brief Read expiration date ("expires_at") in a Keystone authentication response
+ * \return remaining lifetime in seconds, -1 if missing
+ */
+static int keystone_lifetime ( const char* body ) {
+    const char* p = strstr ( body, "\"expires_at\"" );
+    if ( p == NULL ) return -1;
+    p = strchr ( p + 12, '"' );
+    if ( p == NULL ) return -1;
+
+    struct tm tm;
+    memset ( &tm, 0, sizeof ( tm ) );
+    if ( sscanf ( p + 1, "%d-%d-%dT%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec ) != 6 ) return -1;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+
+    return ( int ) ( timegm ( &tm ) - time ( NULL ) );
+}
+
+bool SwiftToken::authenticate ( std::string& newToken, std::string& newUrl, int& lifetime ) {
+
+    CURLcode res;
+    struct curl_slist *list = NULL;
+    HeaderStruct authHdr;
+    DataStruct chunk;
+    chunk.nbPassage = 0;
+    chunk.data = ( char* ) malloc ( 1 );
+    chunk.data[0] = '\0';
+    chunk.size = 0;
+    std::string body;
+
+    CURL* curl = curl_easy_init();
+    curl_easy_setopt ( curl, CURLOPT_URL, auth_url.c_str() );
+    curl_easy_setopt ( curl, CURLOPT_SSL_VERIFYPEER, 0L );
+
+    if ( keystone ) {
+        LOGGER_DEBUG ( "Keystone authentication" );
+
+        char* domain = getenv ( "ROK4_KEYSTONE_DOMAINID" );
+        char* project = getenv ( "ROK4_KEYSTONE_PROJECTID" );
+        char* publicu = getenv ( "ROK4_SWIFT_PUBLICURL" );
+        if ( domain == NULL ) {
+            LOGGER_ERROR ( "We need a domain id (ROK4_KEYSTONE_DOMAINID) for a keystone authentication" );
+        }
+        if ( project == NULL ) {
+            LOGGER_ERROR ( "We need a project id (ROK4_KEYSTONE_PROJECTID) for a keystone authentication" );
+        }
+        if ( publicu == NULL ) {
+            LOGGER_ERROR ( "We need a public url (ROK4_SWIFT_PUBLICURL) for a keystone authentication" );
+        }
+        if ( domain == NULL || project == NULL || publicu == NULL ) {
+            curl_easy_cleanup ( curl );
+            return false;
+        }
+        newUrl.assign ( publicu );
+
+        // On constitue le header
+
+        list = curl_slist_append ( list, "Content-Type: application/json" );
+
+        // On constitue le body
+
+        body = "{ \"auth\": {\"scope\": { \"project\": {\"id\": \"" + std::string ( project ) + "\"}}, ";
+        body += " \"identity\": { \"methods\": [\"password\"], \"password\": { \"user\": { \"domain\": { \"id\": \"" + std::string ( domain ) + "\"},";
+        body += "\"name\": \"" + user_name + "\", \"password\": \"" + user_passwd + "\" } } } } }";
+
+        curl_easy_setopt ( curl, CURLOPT_POSTFIELDS, body.c_str() );
+
+    } else {
+        LOGGER_DEBUG ( "Swift authentication" );
+
+        char* account = getenv ( "ROK4_SWIFT_ACCOUNT" );
+        if ( account == NULL ) {
+            LOGGER_ERROR ( "We need an account (ROK4_SWIFT_ACCOUNT) for a Swift authentication" );
+            curl_easy_cleanup ( curl );
+            return false;
+        }
+
+        // On constitue le header
+
+        std::string accountUser = std::string ( account ) + ":" + user_name;
+        list = curl_slist_append ( list, ( "X-Storage-User: " + accountUser ).c_str() );
+        list = curl_slist_append ( list, ( "X-Storage-Pass: " + user_passwd ).c_str() );
+        list = curl_slist_append ( list, ( "X-Auth-User: " + accountUser ).c_str() );
+        list = curl_slist_append ( list, ( "X-Auth-Key: " + user_passwd ).c_str() );
+    }
+
+    curl_easy_setopt ( curl, CURLOPT_HTTPHEADER, list );
+    curl_easy_setopt ( curl, CURLOPT_HEADERDATA, ( void* ) &authHdr );
+    curl_easy_setopt ( curl, CURLOPT_HEADERFUNCTION, header_callback );
+    curl_easy_setopt ( curl, CURLOPT_WRITEFUNCTION, data_callback );
+    curl_easy_setopt ( curl, CURLOPT_WRITEDATA, ( void * ) &chunk );
+
+    res = curl_easy_perform ( curl );
+
+    long http_code = 0;
+    curl_easy_getinfo ( curl, CURLINFO_RESPONSE_CODE, &http_code );
+
+    curl_slist_free_all ( list );
+    curl_easy_cleanup ( curl );
+
+    if ( CURLE_OK != res ) {
+        LOGGER_ERROR ( "Cannot authenticate to " << ( keystone ? "Keystone" : "Swift" ) );
+        LOGGER_ERROR ( curl_easy_strerror ( res ) );
+        return false;
+    }
+
+    if ( http_code < 200 || http_code > 299 ) {
+        LOGGER_ERROR ( "Cannot authenticate to " << ( keystone ? "Keystone" : "Swift" ) );
+        LOGGER_ERROR ( "Response HTTP code : " << http_code );
+        return false;
+    }
+
+    // On récupère le token, et l'URL publique pour une authentification Swift, dans le header de la réponse
+    if ( authHdr.token == NULL || ( ! keystone && authHdr.url == NULL ) ) {
+        LOGGER_ERROR ( "No token or storage URL in the " << ( keystone ? "Keystone" : "Swift" ) << " authentication response" );
+        return false;
+    }
+    newToken.assign ( authHdr.token );
+    if ( ! keystone ) newUrl.assign ( authHdr.url );
+
+    lifetime = keystone ? keystone_lifetime ( chunk.data ) : authHdr.expires;
+    if ( lifetime <= 0 ) lifetime = defaultLifetime;
+
+    return true;
+}
+
+bool SwiftToken::renew() {
+    pthread_mutex_unlock ( &mutex );
+
+    std::string newToken, newUrl;
+    int lifetime;
+    bool ok = authenticate ( newToken, newUrl, lifetime );
+
+    pthread_mutex_lock ( &mutex );
+
+    time_t now = time ( NULL );
+    if ( ok ) {
+        int margin = lifetime / 5;
+        if ( margin > SWIFT_TOKEN_REFRESH_MARGIN ) margin = SWIFT_TOKEN_REFRESH_MARGIN;
+
+        token = newToken;
+        public_url = newUrl;
+        expiration = now + lifetime;
+        renewal = expiration - margin;
+        generation++;
+        LOGGER_DEBUG ( "New Swift token for " << user_name << ", valid " << lifetime << " seconds" );
+    } else {
+        // Le token courant, s'il est toujours valide, reste utilisé : nouvelle tentative plus tard
+        renewal = now + SWIFT_TOKEN_RETRY_DELAY;
+    }
+
+    authenticating = false;
+    pthread_cond_broadcast ( &authenticated );
+
+    return ok;
+}
+
+void* SwiftToken::renewInBackground ( void* arg ) {
+    SwiftToken* st = ( SwiftToken* ) arg;
+
+    pthread_mutex_lock ( &st->mutex );
+    if ( ! st->renew() ) {
+        LOGGER_ERROR ( "Background renewal of the Swift token for " << st->user_name << " failed" );
+    }
+    pthread_mutex_unlock ( &st->mutex );
+
+    return NULL;
+}
+
+bool SwiftToken::getToken ( std::string& header, std::string& url, unsigned long& number ) {
+    pthread_mutex_lock ( &mutex );
+
+    while ( true ) {
+        time_t now = time ( NULL );
+
+        if ( ! token.empty() && now < expiration ) {
+            if ( now >= renewal && ! authenticating ) {
+                // Renouvellement anticipé, sans attendre
+                authenticating = true;
+                pthread_t thread;
+                pthread_attr_t attr;
+                pthread_attr_init ( &attr );
+                pthread_attr_setdetachstate ( &attr, PTHREAD_CREATE_DETACHED );
+                if ( pthread_create ( &thread, &attr, SwiftToken::renewInBackground, ( void* ) this ) != 0 ) {
+                    LOGGER_ERROR ( "Cannot create the thread to renew the Swift token" );
+                    authenticating = false;
+                    renewal = now + SWIFT_TOKEN_RETRY_DELAY;
+                }
+                pthread_attr_destroy ( &attr );
+            }
+
+            header = token;
+            url = public_url;
+            number = generation;
+            pthread_mutex_unlock ( &mutex );
+            return true;
+        }
+
+        // Pas de token valide : on attend l'authentification en cours, ou on la fait
+        if ( authenticating ) {
+            pthread_cond_wait ( &authenticated, &mutex );
+            continue;
+        }
+
+        if ( now < renewal ) {
+            // La dernière authentification vient d'échouer
+            pthread_mutex_unlock ( &mutex );
+            return false;
+        }
+
+        authenticating = true;
+        if ( ! renew() ) {
+            pthread_mutex_unlock ( &mutex );
+            return false;
+        }
+    }
+}
+
+bool SwiftToken::invalidate ( unsigned long number ) {
+    pthread_mutex_lock ( &mutex );
+
+    if ( number != generation ) {
+        // Le token refusé a déjà été remplacé
+        pthread_mutex_unlock ( &mutex );
+        return true;
+    }
+
+    if ( authenticating ) {
+        while ( authenticating ) {
+            pthread_cond_wait ( &authenticated, &mutex );
+        }
+        bool ok = ( number != generation );
+        pthread_mutex_unlock ( &mutex );
+        return ok;
+    }
+
+    LOGGER_WARN ( "Swift token refused for " << user_name << ", authenticate again" );
+    authenticating = true;
+    bool ok = renew();
+
+    pthread_mutex_unlock ( &mutex );
+    return ok;
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file SwiftToken.h
+ ** \~french
+ * \brief Définition de la classe SwiftToken
+ ** \~english
+ * \brief Define class SwiftToken
+ */
+
+#ifndef SWIFT_TOKEN_H
+#define SWIFT_TOKEN_H
+
+#include <pthread.h>
+#include <time.h>
+#include <map>
+#include <string>
+
+/**
+ * \~french \brief Durée de vie par défaut d'un token, en secondes, quand le service d'authentification ne la précise pas
+ * \~english \brief Default token's lifetime, in seconds, when authentication service does not specify it
+ */
+#define SWIFT_TOKEN_DEFAULT_LIFETIME 3600
+
+/**
+ * \~french \brief Marge maximale de renouvellement, en secondes avant l'expiration du token
+ * \~english \brief Maximal renewal margin, in seconds before token's expiration
+ */
+#define SWIFT_TOKEN_REFRESH_MARGIN 300
+
+/**
+ * \~french \brief Délai avant une nouvelle tentative de renouvellement en cas d'échec, en secondes
+ * \~english \brief Delay before a new renewal attempt after a failure, in seconds
+ */
+#define SWIFT_TOKEN_RETRY_DELAY 30
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Token d'authentification Swift, partagé par tous les contextes utilisant les mêmes identifiants
+ * \details Les tokens sont conservés dans un annuaire statique, selon l'URL d'authentification, l'utilisateur et le type d'authentification (Swift ou Keystone) : tous les contextes d'un même compte utilisent le même token.
+ *
+ * Le token est renouvelé avant son expiration, sans thread dédié : le premier appel à #getToken dans la marge de renouvellement lance une authentification dans un thread détaché, et les appels suivants continuent d'utiliser le token courant, toujours valide. Le nouveau token remplace l'ancien sous verrou, une fois obtenu. Seul un appel sans token valide (premier appel ou token expiré) attend la fin d'une authentification.
+ *
+ * Un token refusé par Swift (code 401) est signalé par #invalidate : une seule authentification est alors faite, quel que soit le nombre de requêtes refusées avec ce token.
+ * \~english
+ * \brief Swift authentication token, shared by all contexts using the same credentials
+ * \details Tokens are kept in a static book, according to authentication URL, user and authentication type (Swift or Keystone) : all contexts of a same account use the same token.
+ *
+ * Token is renewed before its expiration, without dedicated thread : the first call to #getToken in the renewal margin starts an authentication in a detached thread, and following calls keep on using the current token, still valid. The new token replaces the old one under lock, once obtained. Only a call without valid token (first call or expired token) waits for an authentication's end.
+ *
+ * A token refused by Swift (401 code) is reported with #invalidate : only one authentication is then done, whatever the number of requests refused with this token.
+ */
+class SwiftToken {
+
+private:
+
+    /**
+     * \~french \brief Annuaire des tokens, selon les identifiants
+     * \~english \brief Tokens book, by credentials
+     */
+    static std::map<std::string, SwiftToken*> book;
+
+    /**
+     * \~french \brief Verrou de l'annuaire
+     * \~english \brief Book's lock
+     */
+    static pthread_mutex_t bookMutex;
+
+    /**
+     * \~french \brief Durée de vie d'un token quand le service d'authentification ne la précise pas, en secondes
+     * \~english \brief Token's lifetime when authentication service does not specify it, in seconds
+     */
+    static int defaultLifetime;
+
+    /**
+     * \~french \brief URL d'authentification
+     * \~english \brief Authentication URL
+     */
+    std::string auth_url;
+
+    /**
+     * \~french \brief Utilisateur
+     * \~english \brief User
+     */
+    std::string user_name;
+
+    /**
+     * \~french \brief Mot de passe
+     * \~english \brief Password
+     */
+    std::string user_passwd;
+
+    /**
+     * \~french \brief Authentification via Keystone
+     * \~english \brief Keystone authentication
+     */
+    bool keystone;
+
+    /**
+     * \~french \brief Verrou protégeant le token courant et son état
+     * \~english \brief Lock protecting current token and its state
+     */
+    pthread_mutex_t mutex;
+
+    /**
+     * \~french \brief Signalé à la fin de chaque authentification
+     * \~english \brief Signaled at each authentication's end
+     */
+    pthread_cond_t authenticated;
+
+    /**
+     * \~french \brief En-tête HTTP du token courant ("X-Auth-Token: ..."), vide si aucun
+     * \~english \brief Current token's HTTP header ("X-Auth-Token: ..."), empty if none
+     */
+    std::string token;
+
+    /**
+     * \~french \brief URL de communication avec Swift
+     * \~english \brief Communication URL with Swift
+     */
+    std::string public_url;
+
+    /**
+     * \~french \brief Date d'expiration du token courant
+     * \~english \brief Current token's expiration date
+     */
+    time_t expiration;
+
+    /**
+     * \~french \brief Date à partir de laquelle le token courant est renouvelé
+     * \~english \brief Date from which current token is renewed
+     */
+    time_t renewal;
+
+    /**
+     * \~french \brief Numéro du token courant, incrémenté à chaque nouveau token
+     * \~english \brief Current token's number, incremented for each new token
+     */
+    unsigned long generation;
+
+    /**
+     * \~french \brief Une authentification est-elle en cours
+     * \~english \brief Is an authentication in progress
+     */
+    bool authenticating;
+
+    /**
+     * \~french \brief Crée un token vide
+     * \~english \brief Create an empty token
+     */
+    SwiftToken ( std::string auth, std::string user, std::string passwd, bool ks );
+
+    /**
+     * \~french
+     * \brief S'authentifie auprès de Swift ou de Keystone, sans verrou
+     * \details
+     * \li Pour une authentification keystone
+     * <TABLE>
+     * <TR><TH>Information</TH><TH>Variables d'environnement</TH>
+     * <TR><TD>ID de domaine</TD><TD>ROK4_KEYSTONE_DOMAINID</TD>
+     * <TR><TD>ID de projet</TD><TD>ROK4_KEYSTONE_PROJECTID</TD>
+     * <TR><TD>URL de communication</TD><TD>ROK4_SWIFT_PUBLICURL</TD>
+     * </TABLE>
+     * \li Pour une authentification Swift
+     * <TABLE>
+     * <TR><TH>Information</TH><TH>Variables d'environnement</TH>
+     * <TR><TD>Accompte</TD><TD>ROK4_SWIFT_ACCOUNT</TD>
+     * </TABLE>
+     * \param[out] newToken en-tête HTTP du token obtenu
+     * \param[out] newUrl URL de communication avec Swift
+     * \param[out] lifetime durée de vie du token, en secondes
+     * \~english
+     * \brief Authenticate to Swift or Keystone, without lock
+     * \param[out] newToken obtained token's HTTP header
+     * \param[out] newUrl communication URL with Swift
+     * \param[out] lifetime token's lifetime, in seconds
+     */
+    bool authenticate ( std::string& newToken, std::string& newUrl, int& lifetime );
+
+    /**
+     * \~french
+     * \brief S'authentifie et remplace le token courant
+     * \details Doit être appelée avec le verrou, et #authenticating à vrai. Le verrou est relâché pendant l'authentification.
+     * \~english
+     * \brief Authenticate and replace current token
+     * \details Have to be called with the lock, and #authenticating true. Lock is released during authentication.
+     */
+    bool renew();
+
+    /**
+     * \~french \brief Renouvellement en arrière plan, exécuté dans un thread détaché
+     * \~english \brief Background renewal, run in a detached thread
+     */
+    static void* renewInBackground ( void* arg );
+
+public:
+
+    /**
+     * \~french
+     * \brief Retourne le token partagé pour ces identifiants, créé si besoin
+     * \~english
+     * \brief Return the shared token for these credentials, created if needed
+     */
+    static SwiftToken* get ( std::string auth, std::string user, std::string passwd, bool ks );
+
+    /**
+     * \~french
+     * \brief Modifie la durée de vie utilisée quand le service d'authentification ne la précise pas
+     * \param[in] seconds durée de vie, en secondes
+     * \~english
+     * \brief Change lifetime used when authentication service does not specify it
+     * \param[in] seconds lifetime, in seconds
+     */
+    static void setDefaultLifetime ( int seconds );
+
+    /**
+     * \~french
+     * \brief Fournit un token valide
+     * \details Lance un renouvellement en arrière plan si le token approche de son expiration
+     * \param[out] header en-tête HTTP du token
+     * \param[out] url URL de communication avec Swift
+     * \param[out] number numéro du token, à fournir à #invalidate
+     * \return faux si aucun token valide n'a pu être obtenu
+     * \~english
+     * \brief Provide a valid token
+     * \details Start a background renewal if token is close to its expiration
+     * \param[out] header token's HTTP header
+     * \param[out] url communication URL with Swift
+     * \param[out] number token's number, to provide to #invalidate
+     * \return false if no valid token could be obtained
+     */
+    bool getToken ( std::string& header, std::string& url, unsigned long& number );
+
+    /**
+     * \~french
+     * \brief Signale un token refusé, et en obtient un nouveau
+     * \details Si le token refusé a déjà été remplacé, rien n'est fait
+     * \param[in] number numéro du token refusé
+     * \return faux si l'authentification a échoué
+     * \~english
+     * \brief Report a refused token, and get a new one
+     * \details If the refused token has already been replaced, nothing is done
+     * \param[in] number refused token's number
+     * \return false if authentication failed
+     */
+    bool invalidate ( unsigned long number );
+};
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file ThreadPool.cpp
+ ** \~french
+ * \brief Implémentation de la classe ThreadPool
+ ** \~english
+ * \brief Implements class ThreadPool
+ */
+
+#include "ThreadPool.h"
+
+/**
+ * \~french \brief Indice du thread courant dans son pool, -1 s'il n'appartient à aucun pool
+ * \~english \brief Current thread's index in its pool, -1 if it doesn't belong to a pool
+ */
+static __thread int workerIndex = -1;
+
+/**
+ * \~french \brief Pool auquel appartient le thread courant
+ * \~english \brief Pool the current thread belongs to
+ */
+static __thread ThreadPool* workerPool = NULL;
+
+/**
+ * \~french \brief Paramètres de démarrage d'un thread du pool
+ * \~english \brief Pool's thread start parameters
+ */
+struct WorkerArg {
+    ThreadPool* pool;
+    int index;
+};
+
+ThreadPool::ThreadPool ( int nbThreads ) : queued ( 0 ), pending ( 0 ), nextQueue ( 0 ), stopping ( false ) {
+    if ( nbThreads < 1 ) nbThreads = 1;
+
+    threads.resize ( nbThreads );
+    queues.resize ( nbThreads );
+    queueMutexes = new pthread_mutex_t[nbThreads];
+    for ( int i = 0; i < nbThreads; i++ ) pthread_mutex_init ( & ( queueMutexes[i] ), NULL );
+
+    pthread_mutex_init ( &stateMutex, NULL );
+    pthread_cond_init ( &availableCond, NULL );
+    pthread_cond_init ( &doneCond, NULL );
+
+    for ( int i = 0; i < nbThreads; i++ ) {
+        WorkerArg* arg = new WorkerArg;
+        arg->pool = this;
+        arg->index = i;
+        pthread_create ( & ( threads[i] ), NULL, ThreadPool::workerLoop, ( void* ) arg );
+    }
+}
+
+void ThreadPool::submit ( Task* task ) {
+    int index;
+
+    // La tâche est comptée avant d'être visible dans une file, pour que wait ne puisse pas rendre la main trop tôt
+    pthread_mutex_lock ( &stateMutex );
+    pending++;
+    if ( workerPool == this ) {
+        index = workerIndex;
+    } else {
+        index = nextQueue;
+        nextQueue = ( nextQueue + 1 ) % threads.size();
+    }
+    pthread_mutex_unlock ( &stateMutex );
+
+    pthread_mutex_lock ( & ( queueMutexes[index] ) );
+    queues[index].push_back ( task );
+    pthread_mutex_unlock ( & ( queueMutexes[index] ) );
+
+    pthread_mutex_lock ( &stateMutex );
+    queued++;
+    pthread_cond_signal ( &availableCond );
+    pthread_mutex_unlock ( &stateMutex );
+}
+
+Task* ThreadPool::take ( int index ) {
+    int nb = threads.size();
+
+    // Une tâche a été réservée : elle est forcément dans l'une des files, on boucle jusqu'à la trouver
+    while ( true ) {
+        // Dans sa propre file, la plus récente
+        pthread_mutex_lock ( & ( queueMutexes[index] ) );
+        if ( ! queues[index].empty() ) {
+            Task* t = queues[index].back();
+            queues[index].pop_back();
+            pthread_mutex_unlock ( & ( queueMutexes[index] ) );
+            return t;
+        }
+        pthread_mutex_unlock ( & ( queueMutexes[index] ) );
+
+        // Vol dans une autre file, la plus ancienne
+        for ( int i = 1; i < nb; i++ ) {
+            int victim = ( index + i ) % nb;
+            pthread_mutex_lock ( & ( queueMutexes[victim] ) );
+            if ( ! queues[victim].empty() ) {
+                Task* t = queues[victim].front();
+                queues[victim].pop_front();
+                pthread_mutex_unlock ( & ( queueMutexes[victim] ) );
+                return t;
+            }
+            pthread_mutex_unlock ( & ( queueMutexes[victim] ) );
+        }
+    }
+}
+
+void* ThreadPool::workerLoop ( void* arg ) {
+    WorkerArg* wa = ( WorkerArg* ) arg;
+    ThreadPool* pool = wa->pool;
+    workerIndex = wa->index;
+    workerPool = pool;
+    delete wa;
+
+    while ( true ) {
+        pthread_mutex_lock ( & ( pool->stateMutex ) );
+        while ( pool->queued == 0 && ! pool->stopping ) {
+            pthread_cond_wait ( & ( pool->availableCond ), & ( pool->stateMutex ) );
+        }
+        if ( pool->queued == 0 ) {
+            // Arrêt demandé et plus rien à traiter
+            pthread_mutex_unlock ( & ( pool->stateMutex ) );
+            break;
+        }
+        pool->queued--;
+        pthread_mutex_unlock ( & ( pool->stateMutex ) );
+
+        Task* t = pool->take ( workerIndex );
+        t->run();
+        delete t;
+
+        pthread_mutex_lock ( & ( pool->stateMutex ) );
+        pool->pending--;
+        if ( pool->pending == 0 ) pthread_cond_broadcast ( & ( pool->doneCond ) );
+        pthread_mutex_unlock ( & ( pool->stateMutex ) );
+    }
+
+    return NULL;
+}
+
+void ThreadPool::wait() {
+    pthread_mutex_lock ( &stateMutex );
+    while ( pending > 0 ) {
+        pthread_cond_wait ( &doneCond, &stateMutex );
+    }
+    pthread_mutex_unlock ( &stateMutex );
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+
+    pthread_mutex_lock ( &stateMutex );
+    stopping = true;
+    pthread_cond_broadcast ( &availableCond );
+    pthread_mutex_unlock ( &stateMutex );
+
+    for ( int i = 0; i < threads.size(); i++ ) pthread_join ( threads[i], NULL );
+
+    for ( int i = 0; i < threads.size(); i++ ) pthread_mutex_destroy ( & ( queueMutexes[i] ) );
+    delete[] queueMutexes;
+
+    pthread_mutex_destroy ( &stateMutex );
+    pthread_cond_destroy ( &availableCond );
+    pthread_cond_destroy ( &doneCond );
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file ThreadPool.h
+ ** \~french
+ * \brief Définition des classes Task et ThreadPool
+ ** \~english
+ * \brief Define classes Task and ThreadPool
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <pthread.h>
+#include <deque>
+#include <vector>
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Tâche exécutable par un ThreadPool
+ * \details Une tâche soumise au pool lui appartient : elle est détruite par le pool après exécution.
+ * \~english
+ * \brief Task run by a ThreadPool
+ * \details A submitted task is owned by the pool : it is deleted after execution.
+ */
+class Task {
+public:
+    /**
+     * \~french \brief Traitement de la tâche, appelé dans un thread du pool
+     * \~english \brief Task processing, called in a pool's thread
+     */
+    virtual void run() = 0;
+
+    /**
+     * \~french \brief Destructeur
+     * \~english \brief Destructor
+     */
+    virtual ~Task() {}
+};
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Pool de threads à vol de tâches
+ * \details Chaque thread possède sa propre file de tâches. Une tâche soumise depuis un thread du pool est ajoutée à la file de ce thread, et sera traitée en priorité par lui (dernière arrivée, première traitée), ce qui favorise la localité des données dans le cas d'un graphe de dépendances. Un thread dont la file est vide vole la tâche la plus ancienne dans la file d'un autre thread.
+ *
+ * Une tâche soumise depuis l'extérieur du pool est répartie sur les files selon un tourniquet.
+ * \~english
+ * \brief Work-stealing thread pool
+ * \details Each thread owns a task queue. A task submitted from a pool's thread is pushed in this thread's queue and will be processed by it first (last in, first out), which favours data locality for dependency graphs. A thread with an empty queue steals the oldest task in another thread's queue.
+ *
+ * A task submitted from outside the pool is dispatched on queues in a round-robin way.
+ */
+class ThreadPool {
+
+private:
+
+    /**
+     * \~french \brief Threads du pool
+     * \~english \brief Pool's threads
+     */
+    std::vector<pthread_t> threads;
+
+    /**
+     * \~french \brief Files de tâches, une par thread
+     * \~english \brief Task queues, one per thread
+     */
+    std::vector<std::deque<Task*> > queues;
+
+    /**
+     * \~french \brief Verrous des files de tâches, un par thread
+     * \~english \brief Task queues' locks, one per thread
+     */
+    pthread_mutex_t* queueMutexes;
+
+    /**
+     * \~french \brief Verrou protégeant les compteurs de tâches
+     * \~english \brief Lock protecting task counters
+     */
+    pthread_mutex_t stateMutex;
+
+    /**
+     * \~french \brief Signalé quand une tâche est disponible ou que le pool s'arrête
+     * \~english \brief Signaled when a task is available or when the pool stops
+     */
+    pthread_cond_t availableCond;
+
+    /**
+     * \~french \brief Signalé quand toutes les tâches soumises ont été traitées
+     * \~english \brief Signaled when all submitted tasks are processed
+     */
+    pthread_cond_t doneCond;
+
+    /**
+     * \~french \brief Nombre de tâches en file, non encore réservées par un thread
+     * \~english \brief Number of queued tasks, not yet reserved by a thread
+     */
+    int queued;
+
+    /**
+     * \~french \brief Nombre de tâches soumises et non terminées
+     * \~english \brief Number of submitted and unfinished tasks
+     */
+    int pending;
+
+    /**
+     * \~french \brief File utilisée pour la prochaine soumission extérieure
+     * \~english \brief Queue used for the next external submission
+     */
+    int nextQueue;
+
+    /**
+     * \~french \brief Le pool est-il en cours d'arrêt
+     * \~english \brief Is the pool stopping
+     */
+    bool stopping;
+
+    /**
+     * \~french \brief Récupère une tâche réservée, dans la file propre ou par vol
+     * \param[in] index indice du thread appelant
+     * \~english \brief Get a reserved task, from its own queue or by stealing
+     * \param[in] index calling thread's index
+     */
+    Task* take ( int index );
+
+    /**
+     * \~french \brief Boucle de traitement d'un thread du pool
+     * \~english \brief Pool's thread loop
+     */
+    static void* workerLoop ( void* arg );
+
+public:
+
+    /**
+     * \~french
+     * \brief Crée le pool et démarre ses threads
+     * \param[in] nbThreads nombre de threads, au moins 1
+     * \~english
+     * \brief Create the pool and start its threads
+     * \param[in] nbThreads threads number, at least 1
+     */
+    ThreadPool ( int nbThreads );
+
+    /**
+     * \~french
+     * \brief Soumet une tâche au pool
+     * \details La tâche appartient désormais au pool. Peut être appelée depuis une tâche en cours d'exécution.
+     * \~english
+     * \brief Submit a task to the pool
+     * \details The task is now owned by the pool. Can be called from a running task.
+     */
+    void submit ( Task* task );
+
+    /**
+     * \~french
+     * \brief Attend que toutes les tâches soumises, y compris celles soumises par d'autres tâches, soient terminées
+     * \warning Ne doit pas être appelée depuis une tâche du pool
+     * \~english
+     * \brief Wait for all submitted tasks, including those submitted by other tasks, to be finished
+     * \warning Must not be called from a pool's task
+     */
+    void wait();
+
+    /**
+     * \~french \brief Nombre de threads du pool
+     * \~english \brief Pool's threads number
+     */
+    int getNbThreads() {
+        return threads.size();
+    }
+
+    /**
+     * \~french
+     * \brief Destructeur
+     * \details Attend la fin des tâches soumises puis arrête les threads
+     * \~english
+     * \brief Destructor
+     * \details Wait for submitted tasks then stop threads
+     */
+    ~ThreadPool();
+};
+
+#endif
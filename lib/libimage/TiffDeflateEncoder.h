@@ -50,69 +50,40 @@
 template <typename T>
 class TiffDeflateEncoder : public TiffEncoder {
 protected:
-    T* linebuffer;
-
+    virtual void getRawLine ( uint8_t* buffer, int line ) {
+        image->getline ( ( T* ) buffer, line );
+    }
 
-    z_stream zstream;
-    bool encode() {
-        int rawLine = 0;
-        int error = 0;
+    // Chaque bande est un flux zlib indépendant
+    virtual uint8_t* encodeStrip ( uint8_t* raw, int lines, size_t lineSize, size_t& encodedSize ) {
+        z_stream zstream;
         zstream.zalloc = Z_NULL;
         zstream.zfree = Z_NULL;
         zstream.opaque = Z_NULL;
         zstream.data_type = Z_BINARY;
-        deflateInit ( &zstream, 6 ); // taux de compression zlib
-        zstream.avail_in = 0;
-        zstream.next_out  = tmpBuffer;
-        zstream.avail_out = tmpBufferSize;
-
-        while ( rawLine >= 0 && rawLine < image->getHeight() && zstream.avail_out > 0 ) { // compresser les données dans des chunck idat
-            if ( zstream.avail_in == 0 ) {                                    // si plus de donnée en entrée de la zlib, on lit une nouvelle ligne
-                image->getline ( linebuffer, rawLine++ );
-                zstream.next_in  = ( uint8_t* ) ( linebuffer );
-                zstream.avail_in = image->getWidth() * image->getChannels() * sizeof ( T );
-            }
-            error = deflate ( &zstream, Z_NO_FLUSH );
-            switch ( error ) {
-            case Z_OK :
-                break;
-            case Z_MEM_ERROR :
-                LOGGER_DEBUG ( "MEM_ERROR" );
-                deflateEnd ( &zstream );
-                return false;              // return 0 en cas d'erreur.
-            case Z_STREAM_ERROR :
-                LOGGER_DEBUG ( "STREAM_ERROR" );
-                deflateEnd ( &zstream );
-                return false;              // return 0 en cas d'erreur.
-            case Z_VERSION_ERROR :
-                LOGGER_DEBUG ( "VERSION_ERROR" );
-                deflateEnd ( &zstream );
-                return false;              // return 0 en cas d'erreur.
-            default :
-                LOGGER_DEBUG ( "OTHER_ERROR" );
-                deflateEnd ( &zstream );
-                return false;              // return 0 en cas d'erreur.
-            }
-//             if ( error != Z_OK ) {
-//                 deflateReset ( &zstream );
-//                 return false;              // return 0 en cas d'erreur.
-//             }
+        if ( deflateInit ( &zstream, 6 ) != Z_OK ) { // taux de compression zlib
+            LOGGER_DEBUG ( "INIT_ERROR" );
+            return NULL;
         }
 
-        if ( rawLine == image->getHeight() && zstream.avail_out > 6 ) { // plus d'entrée : il faut finaliser la compression
-            int r = deflate ( &zstream, Z_FINISH );
-            if ( r == Z_STREAM_END ) rawLine++;                   // on indique que l'on a compressé fini en passant rawLine ) height+1
-            else if ( r != Z_OK ) {
-                deflateEnd ( &zstream );
-                return false;                      // une erreur
-            }
-        }
+        size_t rawSize = lines * lineSize;
+        size_t bound = deflateBound ( &zstream, rawSize );
+        uint8_t* encoded = new uint8_t[bound];
+        zstream.next_in = raw;
+        zstream.avail_in = rawSize;
+        zstream.next_out = encoded;
+        zstream.avail_out = bound;
 
-        if ( deflateEnd ( &zstream ) != Z_OK ) return false;
+        int error = deflate ( &zstream, Z_FINISH );
+        deflateEnd ( &zstream );
+        if ( error != Z_STREAM_END ) {
+            LOGGER_DEBUG ( "DEFLATE_ERROR " << error );
+            delete[] encoded;
+            return NULL;
+        }
 
-        uint32_t length = zstream.total_out;   // taille des données écritres
-        tmpBufferSize = length;
-        return true;
+        encodedSize = zstream.total_out;
+        return encoded;
     }
     
     virtual void prepareHeader(){
@@ -137,32 +108,16 @@ protected:
     
     virtual void prepareBuffer(){
 	LOGGER_DEBUG("TiffDeflateEncoder : preparation du buffer d'image");
-	tmpBufferSize = image->getWidth() * image->getChannels() * image->getHeight() * 2 * sizeof(T) ;
-	tmpBuffer = new uint8_t[tmpBufferSize];
-	while ( !encode() ) {
-	    tmpBufferSize *= 2;
-	    delete[] tmpBuffer;
-	    tmpBuffer = new uint8_t[tmpBufferSize];
-	}
+	encodeStrips ( sizeof ( T ) );
     }
 
 public:
-    TiffDeflateEncoder ( Image *image, bool isGeoTiff = false ) : TiffEncoder( image, -1, isGeoTiff ) {
-//         zstream.zalloc = Z_NULL;
-//         zstream.zfree = Z_NULL;
-//         zstream.opaque = Z_NULL;
-//         zstream.data_type = Z_BINARY;
-//         deflateInit ( &zstream, 6 ); // taux de compression zlib
-//         zstream.avail_in = 0;
-        linebuffer = new T[image->getWidth() * image->getChannels()];
-    }
-    ~TiffDeflateEncoder() {
-        if ( linebuffer ) delete[] linebuffer;
-//         deflateEnd ( &zstream );
-    }
+    TiffDeflateEncoder ( Image *image, bool isGeoTiff = false, ThreadPool* pool = NULL ) : TiffEncoder( image, -1, isGeoTiff, pool ) {}
+    ~TiffDeflateEncoder() {}
     
+    // La compression deflate est interne au TIFF : ce n'est pas un Content-Encoding HTTP
     std::string getEncoding() {
-        return "deflate";
+        return "";
     }
 
 };
@@ -42,8 +42,81 @@
 #include "TiffDeflateEncoder.h"
 #include "TiffPackBitsEncoder.h"
 
+/**
+ * \~french
+ * \brief Compression d'une bande
+ * \details Partagée entre l'encodeur et la tâche soumise au pool, elle est détruite par le dernier qui la lâche. Le premier qui la prend la compresse : l'encodeur n'attend jamais une tâche encore en file.
+ * \~english
+ * \brief A strip's compression
+ * \details Shared between the encoder and the task submitted to the pool, it is deleted by the last one to release it. The first one to take it compresses it : the encoder never waits for a still queued task.
+ */
+class TiffStrip {
+public:
+    TiffEncoder* encoder;
+    uint8_t* raw;
+    int lines;
+    size_t lineSize;
+    uint8_t* encoded;
+    size_t encodedSize;
+    int claimed;
+    bool done;
+    int refs;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    TiffStrip ( TiffEncoder* encoder, int lines, size_t lineSize ) : encoder ( encoder ), lines ( lines ), lineSize ( lineSize ), encoded ( NULL ), encodedSize ( 0 ), claimed ( 0 ), done ( false ), refs ( 1 ) {
+        raw = new uint8_t[lines * lineSize];
+        pthread_mutex_init ( &mutex, NULL );
+        pthread_cond_init ( &cond, NULL );
+    }
+
+    ~TiffStrip() {
+        if ( raw ) delete[] raw;
+        if ( encoded ) delete[] encoded;
+        pthread_mutex_destroy ( &mutex );
+        pthread_cond_destroy ( &cond );
+    }
+
+    void process() {
+        if ( __atomic_exchange_n ( &claimed, 1, __ATOMIC_ACQ_REL ) != 0 ) return;
+        encoded = encoder->encodeStrip ( raw, lines, lineSize, encodedSize );
+        delete[] raw;
+        raw = NULL;
+
+        pthread_mutex_lock ( &mutex );
+        done = true;
+        pthread_cond_broadcast ( &cond );
+        pthread_mutex_unlock ( &mutex );
+    }
+
+    void wait() {
+        pthread_mutex_lock ( &mutex );
+        while ( ! done ) pthread_cond_wait ( &cond, &mutex );
+        pthread_mutex_unlock ( &mutex );
+    }
 
-TiffEncoder::TiffEncoder(Image *image, int line, bool isGeoTiff): image(image), line(line), isGeoTiff(isGeoTiff) {
+    static void release ( TiffStrip* strip ) {
+        if ( __atomic_sub_fetch ( &strip->refs, 1, __ATOMIC_ACQ_REL ) == 0 ) delete strip;
+    }
+};
+
+class TiffStripTask : public Task {
+private:
+    TiffStrip* strip;
+public:
+    TiffStripTask ( TiffStrip* strip ) : strip ( strip ) {
+        __atomic_add_fetch ( &strip->refs, 1, __ATOMIC_ACQ_REL );
+    }
+    void run() {
+        strip->process();
+    }
+    ~TiffStripTask() {
+        TiffStrip::release ( strip );
+    }
+};
+
+
+TiffEncoder::TiffEncoder(Image *image, int line, bool isGeoTiff, ThreadPool* pool): image(image), line(line), isGeoTiff(isGeoTiff), pool(pool), failed(false) {
     tmpBuffer = NULL;
     tmpBufferPos = 0;
     tmpBufferSize = 0;
@@ -51,7 +124,7 @@ TiffEncoder::TiffEncoder(Image *image, int line, bool isGeoTiff): image(image),
     sizeHeader = 0;
 }
 
-TiffEncoder::TiffEncoder(Image *image, int line ): image(image), line(line), isGeoTiff(false) {
+TiffEncoder::TiffEncoder(Image *image, int line ): image(image), line(line), isGeoTiff(false), pool(NULL), failed(false) {
     tmpBuffer = NULL;
     tmpBufferPos = 0;
     tmpBufferSize = 0;
@@ -67,37 +140,39 @@ TiffEncoder::~TiffEncoder() {
       delete[] header;
 }
 
-DataStream* TiffEncoder::getTiffEncoder ( Image* image, Rok4Format::eformat_data format, bool isGeoTiff ) {
+DataStream* TiffEncoder::getTiffEncoder ( Image* image, Rok4Format::eformat_data format, bool isGeoTiff, ThreadPool* pool ) {
     switch ( format ) {
     case Rok4Format::TIFF_RAW_INT8 :
-        return new TiffRawEncoder<uint8_t> ( image, isGeoTiff );
+        return new TiffRawEncoder<uint8_t> ( image, isGeoTiff, pool );
     case Rok4Format::TIFF_LZW_INT8 :
-        return new TiffLZWEncoder<uint8_t> ( image, isGeoTiff );
+        return new TiffLZWEncoder<uint8_t> ( image, isGeoTiff, pool );
     case Rok4Format::TIFF_ZIP_INT8 :
-        return new TiffDeflateEncoder<uint8_t> ( image, isGeoTiff );
+        return new TiffDeflateEncoder<uint8_t> ( image, isGeoTiff, pool );
     case Rok4Format::TIFF_PKB_INT8 :
-        return new TiffPackBitsEncoder<uint8_t> ( image, isGeoTiff );
+        return new TiffPackBitsEncoder<uint8_t> ( image, isGeoTiff, pool );
     case Rok4Format::TIFF_RAW_FLOAT32 :
-        return new TiffRawEncoder<float> ( image, isGeoTiff );
+        return new TiffRawEncoder<float> ( image, isGeoTiff, pool );
     case Rok4Format::TIFF_LZW_FLOAT32 :
-        return new TiffLZWEncoder<float> ( image, isGeoTiff );
+        return new TiffLZWEncoder<float> ( image, isGeoTiff, pool );
     case Rok4Format::TIFF_ZIP_FLOAT32 :
-        return new TiffDeflateEncoder<float> ( image, isGeoTiff );
+        return new TiffDeflateEncoder<float> ( image, isGeoTiff, pool );
     case Rok4Format::TIFF_PKB_FLOAT32 :
-        return new TiffPackBitsEncoder<float> ( image, isGeoTiff );
+        return new TiffPackBitsEncoder<float> ( image, isGeoTiff, pool );
     default:
         return NULL;
     }
 }
 
+DataStream* TiffEncoder::getTiffEncoder ( Image* image, Rok4Format::eformat_data format, bool isGeoTiff ) {
+    return getTiffEncoder( image, format, isGeoTiff, NULL );
+}
+
 DataStream* TiffEncoder::getTiffEncoder ( Image* image, Rok4Format::eformat_data format ) {
     return getTiffEncoder( image, format, false );
 }
 
-size_t TiffEncoder::read(uint8_t* buffer, size_t size) {
-    size_t offset = 0, dataToCopy=0;
-    
-    if ( !tmpBuffer ) {
+void TiffEncoder::prepare() {
+    if ( !tmpBuffer && !failed ) {
         LOGGER_DEBUG("TiffEncoder : preparation du buffer d'image");
         prepareBuffer();
     }
@@ -108,7 +183,61 @@ size_t TiffEncoder::read(uint8_t* buffer, size_t size) {
         if ( isGeoTiff ){
             this->header = TiffHeader::insertGeoTags(image, this->header, &(this->sizeHeader) );
         }
+        if ( stripSizes.size() > 1 ) {
+            this->header = TiffHeader::setStrips(this->header, &(this->sizeHeader), TIFF_ROWS_PER_STRIP, stripSizes );
+        }
+    }
+}
+
+void TiffEncoder::encodeStrips ( size_t sampleSize ) {
+    int height = image->getHeight();
+    size_t lineSize = image->getWidth() * image->getChannels() * sampleSize;
+    std::vector<TiffStrip*> strips;
+
+    for ( int first = 0; first < height; first += TIFF_ROWS_PER_STRIP ) {
+        int lines = std::min ( TIFF_ROWS_PER_STRIP, height - first );
+        TiffStrip* strip = new TiffStrip ( this, lines, lineSize );
+        for ( int l = 0; l < lines; l++ ) {
+            getRawLine ( strip->raw + l * lineSize, first + l );
+        }
+        strips.push_back ( strip );
+        // La bande est compressée pendant la lecture des suivantes
+        if ( pool ) pool->submit ( new TiffStripTask ( strip ) );
+    }
+
+    tmpBufferSize = 0;
+    for ( unsigned int i = 0; i < strips.size(); i++ ) {
+        strips.at ( i )->process();
+        strips.at ( i )->wait();
+        if ( strips.at ( i )->encoded == NULL ) {
+            LOGGER_ERROR ( "TiffEncoder : echec de la compression de la bande " << i );
+            failed = true;
+        }
+        tmpBufferSize += strips.at ( i )->encodedSize;
     }
+
+    if ( failed ) {
+        // Aucune donnée n'est rendue plutôt qu'un TIFF aux bandes manquantes
+        for ( unsigned int i = 0; i < strips.size(); i++ ) TiffStrip::release ( strips.at ( i ) );
+        tmpBufferSize = 0;
+        return;
+    }
+
+    tmpBuffer = new uint8_t[tmpBufferSize];
+    size_t pos = 0;
+    for ( unsigned int i = 0; i < strips.size(); i++ ) {
+        if ( strips.size() > 1 ) stripSizes.push_back ( strips.at ( i )->encodedSize );
+        if ( strips.at ( i )->encoded ) memcpy ( tmpBuffer + pos, strips.at ( i )->encoded, strips.at ( i )->encodedSize );
+        pos += strips.at ( i )->encodedSize;
+        TiffStrip::release ( strips.at ( i ) );
+    }
+}
+
+size_t TiffEncoder::read(uint8_t* buffer, size_t size) {
+    size_t offset = 0, dataToCopy=0;
+    
+    prepare();
+    if ( failed ) return 0;
     
     // Si pas assez de place pour le header, ne rien écrire.
     if ( size < sizeHeader ) return 0;
@@ -132,22 +261,12 @@ size_t TiffEncoder::read(uint8_t* buffer, size_t size) {
 }
 
 bool TiffEncoder::eof() {
-    return ( tmpBufferPos>=tmpBufferSize );
+    return ( failed || tmpBufferPos>=tmpBufferSize );
 }
 
 unsigned int TiffEncoder::getLength(){
-    if ( !tmpBuffer ) {
-        LOGGER_DEBUG("TiffEncoder : preparation du buffer d'image");
-        prepareBuffer();
-    }
-    
-    if ( !header ) {
-        LOGGER_DEBUG("TiffEncoder : preparation de l'en-tete");
-        prepareHeader();
-        if ( isGeoTiff ){
-            this->header = TiffHeader::insertGeoTags(image, this->header, &(this->sizeHeader) );
-        }
-    }
+    prepare();
+    if ( failed ) return 0;
     return sizeHeader + tmpBufferSize;
     
 }
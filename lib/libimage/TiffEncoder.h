@@ -41,8 +41,17 @@
 #include "Data.h"
 #include "Image.h"
 #include "Format.h"
+#include "ThreadPool.h"
+#include <vector>
+
+// Nombre de lignes des bandes des images compressées
+#define TIFF_ROWS_PER_STRIP 256
+
+class TiffStrip;
 
 class TiffEncoder : public DataStream {
+
+    friend class TiffStrip;
   
 protected:
     Image *image;
@@ -58,11 +67,28 @@ protected:
     size_t tmpBufferPos;
     uint8_t* tmpBuffer;
 
+    // Pool compressant les bandes pendant la lecture des suivantes, NULL pour compresser dans le thread courant
+    ThreadPool* pool;
+    // Tailles des bandes compressées, vide pour une image en une seule bande
+    std::vector<uint32_t> stripSizes;
+    // Vrai si la compression d'une bande a échoué : le flux est alors vide, plutôt qu'un TIFF corrompu
+    bool failed;
+
+    void prepare();
+
+    // Lecture d'une ligne de l'image, dans le type de l'encodeur
+    virtual void getRawLine ( uint8_t* buffer, int line ) = 0;
+    // Compression d'une bande, indépendante des autres et appelée depuis n'importe quel thread
+    virtual uint8_t* encodeStrip ( uint8_t* raw, int lines, size_t lineSize, size_t& encodedSize ) = 0;
+    // Lit l'image et compresse ses bandes de TIFF_ROWS_PER_STRIP lignes dans tmpBuffer, failed est positionné en cas d'échec
+    void encodeStrips ( size_t sampleSize );
+
 public:
-    TiffEncoder(Image *image, int line, bool isGeoTiff);
+    TiffEncoder(Image *image, int line, bool isGeoTiff, ThreadPool* pool = NULL);
     TiffEncoder(Image *image, int line);
     ~TiffEncoder();
   
+    static DataStream* getTiffEncoder ( Image* image, Rok4Format::eformat_data format, bool isGeoTiff, ThreadPool* pool );
     static DataStream* getTiffEncoder ( Image* image, Rok4Format::eformat_data format, bool isGeoTiff );
     static DataStream* getTiffEncoder ( Image* image, Rok4Format::eformat_data format );
 
@@ -82,6 +108,7 @@ public:
         return "";
     }
     
+    // 0 si la compression a échoué : l'appelant doit alors renvoyer une exception plutôt que le flux
     unsigned int getLength();
 };
 
@@ -39,6 +39,8 @@
 #define _TIFFHEADER_
 #include "Format.h"
 #include "Image.h"
+#include <vector>
+#include <cstring>
 
 
 
@@ -962,7 +964,51 @@ static uint8_t* insertGeoTags ( Image* image, uint8_t* header, size_t* sizeHeade
     
 };
 
+/**
+ * \~french
+ * \brief Découpe les données d'un en-tête mono-bande en plusieurs bandes
+ * \details Les tableaux des adresses et des tailles des bandes sont ajoutés à la fin de l'en-tête, les données des bandes le suivant dans l'ordre. À appeler en dernier, après insertGeoTags.
+ * \param[in] header en-tête d'une image en une seule bande, libéré
+ * \param[in,out] sizeHeader taille de l'en-tête
+ * \param[in] rowsPerStrip nombre de lignes par bande
+ * \param[in] stripSizes tailles des bandes, dans l'ordre
+ * \return le nouvel en-tête
+ * \~english
+ * \brief Split a single strip header's data in several strips
+ * \details Strips' offsets and sizes arrays are appended to the header, followed by strips' data in order. To call last, after insertGeoTags.
+ * \param[in] header single strip image's header, freed
+ * \param[in,out] sizeHeader header's size
+ * \param[in] rowsPerStrip number of rows per strip
+ * \param[in] stripSizes strips' sizes, in order
+ * \return the new header
+ */
+static uint8_t* setStrips ( uint8_t* header, size_t* sizeHeader, uint32_t rowsPerStrip, std::vector<uint32_t>& stripSizes ) {
+    uint32_t count = stripSizes.size();
+    // Les tableaux commencent sur un mot
+    size_t arraysOffset = *sizeHeader + ( *sizeHeader % 2 );
+    size_t new_sizeHeader = arraysOffset + 2 * count * sizeof ( uint32_t );
+
+    uint8_t* new_header = new uint8_t[new_sizeHeader];
+    memset ( new_header, 0, new_sizeHeader );
+    memcpy ( new_header, header, *sizeHeader );
+
+    uint32_t offset = new_sizeHeader;
+    for ( uint32_t i = 0; i < count; i++ ) {
+        * ( ( uint32_t* ) ( new_header + arraysOffset ) + i ) = offset;
+        * ( ( uint32_t* ) ( new_header + arraysOffset ) + count + i ) = stripSizes.at ( i );
+        offset += stripSizes.at ( i );
+    }
+
+    * ( ( uint32_t* ) ( new_header+74 ) ) = count;
+    * ( ( uint32_t* ) ( new_header+78 ) ) = arraysOffset;
+    * ( ( uint32_t* ) ( new_header+102 ) ) = rowsPerStrip;
+    * ( ( uint32_t* ) ( new_header+110 ) ) = count;
+    * ( ( uint32_t* ) ( new_header+114 ) ) = arraysOffset + count * sizeof ( uint32_t );
 
+    delete[] header;
+    *sizeHeader = new_sizeHeader;
+    return new_header;
+}
 
 
 }
@@ -51,8 +51,14 @@
 template <typename T>
 class TiffLZWEncoder : public TiffEncoder {
 protected:
-    size_t rawBufferSize;
-    T* rawBuffer;
+    virtual void getRawLine ( uint8_t* buffer, int line ) {
+        image->getline ( ( T* ) buffer, line );
+    }
+
+    virtual uint8_t* encodeStrip ( uint8_t* raw, int lines, size_t lineSize, size_t& encodedSize ) {
+        lzwEncoder encoder;
+        return encoder.encode ( raw, lines * lineSize, encodedSize );
+    }
     
     virtual void prepareHeader(){
 	LOGGER_DEBUG("TiffLZWEncoder : preparation de l'en-tete");
@@ -76,23 +82,11 @@ protected:
     
     virtual void prepareBuffer(){
 	LOGGER_DEBUG("TiffLZWEncoder : preparation du buffer d'image");
-	int linesize = image->getWidth()*image->getChannels();
-	rawBuffer = new T[image->getHeight()*image->getWidth()*image->getChannels()];
-	rawBufferSize = 0;
-	int lRead = 0;
-	for ( ; lRead < image->getHeight() ; lRead++ ) {
-	    image->getline ( rawBuffer + rawBufferSize, lRead );
-	    rawBufferSize += linesize;
-	}
-	rawBufferSize *= sizeof ( T );
-	lzwEncoder encoder;
-	tmpBuffer = encoder.encode ( ( uint8_t* ) rawBuffer,rawBufferSize, tmpBufferSize );
-	delete[] rawBuffer;
-	rawBuffer = NULL;
+	encodeStrips ( sizeof ( T ) );
     }
 
 public:
-    TiffLZWEncoder ( Image *image, bool isGeoTiff = false ) : TiffEncoder( image, -1, isGeoTiff ) , rawBufferSize ( 0 ), rawBuffer ( NULL ) {}
+    TiffLZWEncoder ( Image *image, bool isGeoTiff = false, ThreadPool* pool = NULL ) : TiffEncoder( image, -1, isGeoTiff, pool ) {}
     ~TiffLZWEncoder() {
     }
    
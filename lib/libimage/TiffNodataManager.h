@@ -278,6 +278,24 @@ public:
      */
     bool treatNodata ( char* inputImage, char* outputImage, char* outputMask = 0 );
 
+    /** \~french
+     * \brief Fonction de traitement du manager, effectuant les modification d'une image en mémoire
+     * \details Même traitement que #treatNodata(char*, char*, char*), mais sur une image déjà chargée, modifiée sur place. Cela permet aux outils écrivant directement une dalle ROK4 de se passer d'une image de travail.
+     * \param[in,out] image pixels de l'image à modifier, ligne par ligne
+     * \param[in] imageWidth largeur de l'image
+     * \param[in] imageHeight hauteur de l'image
+     * \param[in] channels nombre de canaux de l'image
+     * \return Vrai en cas de réussite, faux sinon
+     ** \~english
+     * \brief Manager treatment function, doing in memory image's modifications
+     * \param[in,out] image Image's pixels to modify, line by line
+     * \param[in] imageWidth Image's width
+     * \param[in] imageHeight Image's height
+     * \param[in] channels Image's samples per pixel
+     * \return True if success, false otherwise
+     */
+    bool treatNodata ( T* image, uint32_t imageWidth, uint32_t imageHeight, uint16_t channels );
+
 };
 
 
@@ -441,6 +459,39 @@ bool TiffNodataManager<T>::treatNodata ( char* inputImage, char* outputImage, ch
     return true;
 }
 
+template<typename T>
+bool TiffNodataManager<T>::treatNodata ( T* image, uint32_t imageWidth, uint32_t imageHeight, uint16_t channels ) {
+    if ( ! newNodataValue && ! removeTargetValue ) {
+        return true;
+    }
+
+    width = imageWidth;
+    height = imageHeight;
+    samplesperpixel = channels;
+
+    if ( samplesperpixel > maxChannels )  {
+        LOGGER_ERROR ( "The nodata manager is not adapted (samplesperpixel have to be " << maxChannels <<
+                       " or less) for the image (" << samplesperpixel << ")" );
+        return false;
+    }
+
+    uint8_t *MSK = new uint8_t[width * height];
+
+    identifyNodataPixels ( image, MSK );
+
+    if ( removeTargetValue ) {
+        changeDataValue ( image, MSK );
+    }
+
+    if ( newNodataValue ) {
+        changeNodataValue ( image, MSK );
+    }
+
+    delete[] MSK;
+
+    return true;
+}
+
 template<typename T>
 inline bool TiffNodataManager<T>::isTargetValue ( T* pix ) {
     int pixint;
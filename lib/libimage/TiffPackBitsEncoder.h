@@ -58,8 +58,24 @@ class TiffPackBitsEncoder : public TiffEncoder {
 
 protected:
 
-    T* rawBuffer;
-    size_t rawBufferSize;
+    virtual void getRawLine ( uint8_t* buffer, int line ) {
+        image->getline ( ( T* ) buffer, line );
+    }
+
+    // Les lignes sont compressées séparément
+    virtual uint8_t* encodeStrip ( uint8_t* raw, int lines, size_t lineSize, size_t& encodedSize ) {
+        uint8_t* encoded = new uint8_t[lines * lineSize * 2];
+        encodedSize = 0;
+        pkbEncoder encoder;
+        for ( int l = 0; l < lines; l++ ) {
+            size_t pkbLineSize = 0;
+            uint8_t* pkbLine = encoder.encode ( raw + l * lineSize, lineSize, pkbLineSize );
+            memcpy ( encoded + encodedSize, pkbLine, pkbLineSize );
+            encodedSize += pkbLineSize;
+            delete[] pkbLine;
+        }
+        return encoded;
+    }
     
     virtual void prepareHeader(){
 	LOGGER_DEBUG("TiffPackBitsEncoder : preparation de l'en-tete");
@@ -83,34 +99,12 @@ protected:
     
     virtual void prepareBuffer(){
 	LOGGER_DEBUG("TiffPackBitsEncoder : preparation du buffer d'image");
-	int linesize = image->getWidth()*image->getChannels();
-	tmpBuffer = new uint8_t[linesize* image->getHeight() * sizeof ( T ) *2];
-	tmpBufferSize = 0;
-	rawBuffer = new T[linesize];
-	rawBufferSize = linesize * sizeof ( T );
-	int lRead = 0;
-	pkbEncoder encoder;
-	uint8_t * pkbLine;
-	for ( ; lRead < image->getHeight() ; lRead++ ) {
-	    image->getline ( rawBuffer, lRead );
-	    size_t pkbLineSize = 0;
-	    pkbLine =  encoder.encode ( ( uint8_t* ) rawBuffer,rawBufferSize, pkbLineSize );
-	    memcpy ( tmpBuffer+tmpBufferSize,pkbLine,pkbLineSize );
-	    tmpBufferSize += pkbLineSize;
-	    delete[] pkbLine;
-	}
-	delete[] rawBuffer;
-	rawBuffer = NULL;
+	encodeStrips ( sizeof ( T ) );
     }
 
 public:
-    TiffPackBitsEncoder ( Image *image, bool isGeoTiff = false ) : TiffEncoder( image, -1, isGeoTiff ) , rawBufferSize ( 0 ), rawBuffer ( NULL ) {
-
-    }
-    ~TiffPackBitsEncoder() {
-        if ( rawBuffer )
-            delete[] rawBuffer;
-    }
+    TiffPackBitsEncoder ( Image *image, bool isGeoTiff = false, ThreadPool* pool = NULL ) : TiffEncoder( image, -1, isGeoTiff, pool ) {}
+    ~TiffPackBitsEncoder() {}
 };
 
 #endif
@@ -44,6 +44,7 @@
 #include "TiffEncoder.h"
 
 #include <cstring>
+#include <algorithm>
 
 template <typename T>
 class TiffRawEncoder : public TiffEncoder {
@@ -68,23 +69,59 @@ protected:
 	* ( ( uint32_t* ) ( header+114 ) ) = tmpBufferSize ;
     }
   
+    virtual void getRawLine ( uint8_t* buffer, int line ) {
+        image->getline ( ( T* ) buffer, line );
+    }
+
+    virtual uint8_t* encodeStrip ( uint8_t* raw, int lines, size_t lineSize, size_t& encodedSize ) {
+        encodedSize = lines * lineSize;
+        uint8_t* encoded = new uint8_t[encodedSize];
+        memcpy ( encoded, raw, encodedSize );
+        return encoded;
+    }
+
+    // Les données non compressées ont une taille connue : seule la ligne en cours d'envoi est conservée
     virtual void prepareBuffer(){
 	LOGGER_DEBUG("TiffRawEncoder : preparation du buffer d'image");
-	tmpBuffer = new uint8_t[image->getHeight()*image->getWidth()*image->getChannels()*sizeof ( T )];
-	int lRead = 0;
-	tmpBufferSize = 0;
-	int linesize = image->getWidth()*image->getChannels();
-	int linesizetmp = linesize * sizeof ( T );
-	for ( ; lRead < image->getHeight() ; lRead++ ) {
-	    image->getline ( ( T* ) (tmpBuffer+tmpBufferSize), lRead );
-	    tmpBufferSize+=linesizetmp;
-	}
+	lineSize = image->getWidth()*image->getChannels()*sizeof ( T );
+	tmpBuffer = new uint8_t[lineSize];
+	tmpBufferSize = lineSize * image->getHeight();
     }
 
+    size_t lineSize;
+
 public:
-    TiffRawEncoder ( Image *image, bool isGeoTiff = false ) : TiffEncoder( image, -1, isGeoTiff ) {}
+    TiffRawEncoder ( Image *image, bool isGeoTiff = false, ThreadPool* pool = NULL ) : TiffEncoder( image, -1, isGeoTiff, pool ), lineSize ( 0 ) {}
     ~TiffRawEncoder() {
     }
+
+    virtual size_t read ( uint8_t *buffer, size_t size ) {
+	size_t offset = 0;
+
+	prepare();
+
+	// Si pas assez de place pour le header, ne rien écrire.
+	if ( size < sizeHeader ) return 0;
+
+	if ( line == -1 ) { // écrire le header tiff
+	    memcpy ( buffer, header, sizeHeader );
+	    offset = sizeHeader;
+	    line = 0;
+	}
+
+	while ( offset < size && tmpBufferPos < tmpBufferSize ) {
+	    size_t linePos = tmpBufferPos % lineSize;
+	    if ( linePos == 0 ) {
+		getRawLine ( tmpBuffer, tmpBufferPos / lineSize );
+	    }
+	    size_t dataToCopy = std::min ( size - offset, lineSize - linePos );
+	    memcpy ( buffer + offset, tmpBuffer + linePos, dataToCopy );
+	    tmpBufferPos += dataToCopy;
+	    offset += dataToCopy;
+	}
+
+	return offset;
+    }
    
 };
 
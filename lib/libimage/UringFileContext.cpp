@@ -0,0 +1,554 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+/**
+ * \file UringFileContext.cpp
+ ** \~french
+ * \brief Implémentation de la classe UringFileContext
+ * \details
+ * \li UringFileContext : utilisation d'un système de fichier, avec entrées/sorties io_uring
+ ** \~english
+ * \brief Implement classe UringFileContext
+ * \details
+ * \li UringFileContext : file system use, with io_uring inputs/outputs
+ */
+
+#include "UringFileContext.h"
+#include "MappedFilePool.h"
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <map>
+
+#if defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#endif
+
+// Les opérations READ et WRITE sont disponibles à partir du noyau 5.6, qui introduit aussi IORING_FEAT_FAST_POLL
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_FAST_POLL)
+#define URING_SUPPORT 1
+#else
+#define URING_SUPPORT 0
+#endif
+
+/**
+ * \~french \brief Nombre d'entrées d'un anneau de lecture
+ * \~english \brief Reading ring's entries number
+ */
+#define URING_READ_ENTRIES 64
+
+/**
+ * \~french \brief Nombre de buffers d'écriture, et d'entrées de l'anneau d'écriture
+ * \~english \brief Writing buffers number, and writing ring's entries number
+ */
+#define URING_WRITE_BUFFERS 8
+
+/**
+ * \~french \brief Taille d'un buffer d'écriture
+ * \~english \brief Writing buffer's size
+ */
+#define URING_WRITE_BUFFER_SIZE 262144
+
+/* ------------------------------------------------------------------------------------------------ */
+/* ------------------------------------------ ANNEAU ---------------------------------------------- */
+
+struct UringRing {
+    int fd;
+    unsigned int entries;
+    unsigned int *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned int *cqHead, *cqTail, *cqMask;
+    void* sqes;
+    void* cqes;
+    void* sqMap;
+    size_t sqMapSize;
+    void* cqMap;
+    size_t cqMapSize;
+    size_t sqesSize;
+};
+
+#if URING_SUPPORT
+
+static UringRing* ringCreate ( unsigned int entries ) {
+    struct io_uring_params p;
+    memset ( &p, 0, sizeof ( p ) );
+
+    int fd = syscall ( __NR_io_uring_setup, entries, &p );
+    if ( fd < 0 ) {
+        return NULL;
+    }
+    if ( ! ( p.features & IORING_FEAT_FAST_POLL ) ) {
+        close ( fd );
+        return NULL;
+    }
+
+    UringRing* r = new UringRing();
+    r->fd = fd;
+    r->entries = p.sq_entries;
+    r->sqMapSize = p.sq_off.array + p.sq_entries * sizeof ( unsigned int );
+    r->cqMapSize = p.cq_off.cqes + p.cq_entries * sizeof ( struct io_uring_cqe );
+    r->sqesSize = p.sq_entries * sizeof ( struct io_uring_sqe );
+
+    if ( p.features & IORING_FEAT_SINGLE_MMAP ) {
+        if ( r->cqMapSize > r->sqMapSize ) r->sqMapSize = r->cqMapSize;
+        r->cqMapSize = r->sqMapSize;
+    }
+
+    r->sqMap = mmap ( NULL, r->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+    if ( r->sqMap == MAP_FAILED ) {
+        close ( fd );
+        delete r;
+        return NULL;
+    }
+
+    if ( p.features & IORING_FEAT_SINGLE_MMAP ) {
+        r->cqMap = r->sqMap;
+    } else {
+        r->cqMap = mmap ( NULL, r->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+        if ( r->cqMap == MAP_FAILED ) {
+            munmap ( r->sqMap, r->sqMapSize );
+            close ( fd );
+            delete r;
+            return NULL;
+        }
+    }
+
+    r->sqes = mmap ( NULL, r->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+    if ( r->sqes == MAP_FAILED ) {
+        if ( r->cqMap != r->sqMap ) munmap ( r->cqMap, r->cqMapSize );
+        munmap ( r->sqMap, r->sqMapSize );
+        close ( fd );
+        delete r;
+        return NULL;
+    }
+
+    uint8_t* sq = ( uint8_t* ) r->sqMap;
+    r->sqHead = ( unsigned int* ) ( sq + p.sq_off.head );
+    r->sqTail = ( unsigned int* ) ( sq + p.sq_off.tail );
+    r->sqMask = ( unsigned int* ) ( sq + p.sq_off.ring_mask );
+    r->sqArray = ( unsigned int* ) ( sq + p.sq_off.array );
+
+    uint8_t* cq = ( uint8_t* ) r->cqMap;
+    r->cqHead = ( unsigned int* ) ( cq + p.cq_off.head );
+    r->cqTail = ( unsigned int* ) ( cq + p.cq_off.tail );
+    r->cqMask = ( unsigned int* ) ( cq + p.cq_off.ring_mask );
+    r->cqes = cq + p.cq_off.cqes;
+
+    return r;
+}
+
+static void ringDestroy ( UringRing* r ) {
+    munmap ( r->sqes, r->sqesSize );
+    if ( r->cqMap != r->sqMap ) munmap ( r->cqMap, r->cqMapSize );
+    munmap ( r->sqMap, r->sqMapSize );
+    close ( r->fd );
+    delete r;
+}
+
+/*
+ * Réserve une entrée de soumission, remise à zéro. Elle sera soumise au prochain appel à ringEnter.
+ * La file de soumission ne doit pas être pleine.
+ */
+static struct io_uring_sqe* ringGetSqe ( UringRing* r ) {
+    unsigned int tail = *r->sqTail;
+    unsigned int index = tail & *r->sqMask;
+    struct io_uring_sqe* sqe = ( ( struct io_uring_sqe* ) r->sqes ) + index;
+    memset ( sqe, 0, sizeof ( struct io_uring_sqe ) );
+    r->sqArray[index] = index;
+    __atomic_store_n ( r->sqTail, tail + 1, __ATOMIC_RELEASE );
+    return sqe;
+}
+
+/*
+ * Soumet les toSubmit dernières entrées et attend au moins wait complétions
+ */
+static int ringEnter ( UringRing* r, unsigned int toSubmit, unsigned int wait ) {
+    while ( true ) {
+        int ret = syscall ( __NR_io_uring_enter, r->fd, toSubmit, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+        if ( ret >= 0 ) return ret;
+        if ( errno != EINTR ) return -errno;
+    }
+}
+
+/*
+ * Consomme une complétion si disponible
+ */
+static bool ringPopCqe ( UringRing* r, uint64_t& userData, int& res ) {
+    unsigned int head = *r->cqHead;
+    if ( head == __atomic_load_n ( r->cqTail, __ATOMIC_ACQUIRE ) ) return false;
+    struct io_uring_cqe* cqe = ( ( struct io_uring_cqe* ) r->cqes ) + ( head & *r->cqMask );
+    userData = cqe->user_data;
+    res = cqe->res;
+    __atomic_store_n ( r->cqHead, head + 1, __ATOMIC_RELEASE );
+    return true;
+}
+
+#else
+
+static UringRing* ringCreate ( unsigned int entries ) {
+    return NULL;
+}
+
+static void ringDestroy ( UringRing* r ) {
+    delete r;
+}
+
+#endif
+
+/* ------------------------------------------------------------------------------------------------ */
+/* ----------------------------------------- CONTEXTE --------------------------------------------- */
+
+pthread_key_t UringFileContext::readRingKey;
+pthread_once_t UringFileContext::readRingOnce = PTHREAD_ONCE_INIT;
+
+static void deleteReadRing ( void* ring ) {
+    if ( ring ) ringDestroy ( ( UringRing* ) ring );
+}
+
+void UringFileContext::createReadRingKey() {
+    pthread_key_create ( &readRingKey, deleteReadRing );
+}
+
+UringRing* UringFileContext::getReadRing() {
+    pthread_once ( &readRingOnce, createReadRingKey );
+    UringRing* r = ( UringRing* ) pthread_getspecific ( readRingKey );
+    if ( r == NULL && isAvailable() ) {
+        r = ringCreate ( URING_READ_ENTRIES );
+        pthread_setspecific ( readRingKey, r );
+    }
+    return r;
+}
+
+bool UringFileContext::isAvailable() {
+    // Test fait une seule fois, l'éventuelle concurrence du premier appel est sans conséquence
+    static int available = -1;
+    if ( available < 0 ) {
+        UringRing* r = ringCreate ( 1 );
+        if ( r ) {
+            ringDestroy ( r );
+            available = 1;
+        } else {
+            LOGGER_INFO ( "io_uring n'est pas disponible, les entrées/sorties fichier seront classiques" );
+            available = 0;
+        }
+    }
+    return ( available == 1 );
+}
+
+UringFileContext::UringFileContext ( std::string root ) : FileContext ( root ),
+    writeRing ( NULL ), writeBuffers ( NULL ), fixedBuffers ( false ), outputFd ( -1 ), outputOffset ( 0 ), writeError ( false ) {}
+
+UringFileContext::~UringFileContext() {
+    if ( outputFd >= 0 ) {
+        reapWritings ( URING_WRITE_BUFFERS - freeBuffers.size() );
+        close ( outputFd );
+    }
+    if ( writeRing ) ringDestroy ( writeRing );
+    if ( writeBuffers ) free ( writeBuffers );
+}
+
+void UringFileContext::readMulti ( std::vector<ContextRead>& reads ) {
+
+    UringRing* ring = NULL;
+    // Les dalles projetées en mémoire sont lues directement depuis leur projection
+    if ( ! MappedFilePool::isEnabled() ) ring = getReadRing();
+
+    if ( ring == NULL ) {
+        FileContext::readMulti ( reads );
+        return;
+    }
+
+#if URING_SUPPORT
+    // Ouverture des fichiers, une seule fois chacun
+    std::map<std::string, int> fds;
+    std::vector<int> fdOfRead ( reads.size(), -1 );
+    for ( unsigned int i = 0; i < reads.size(); i++ ) {
+        reads.at ( i ).result = -1;
+        std::map<std::string, int>::iterator it = fds.find ( reads.at ( i ).name );
+        if ( it == fds.end() ) {
+            std::string fullName = getRootDir() + reads.at ( i ).name;
+            int fildes = open ( fullName.c_str(), O_RDONLY );
+            if ( fildes < 0 ) {
+                LOGGER_DEBUG ( "Can't open file " << fullName );
+            }
+            it = fds.insert ( std::pair<std::string, int> ( reads.at ( i ).name, fildes ) ).first;
+        }
+        fdOfRead.at ( i ) = it->second;
+    }
+
+    // Soumission par paquets de la taille de l'anneau
+    unsigned int next = 0;
+    unsigned int prepared = 0;
+    unsigned int inFlight = 0;
+    bool failed = false;
+    while ( next < reads.size() || prepared > 0 || inFlight > 0 ) {
+        if ( ! failed ) {
+            while ( next < reads.size() && inFlight + prepared < ring->entries ) {
+                if ( fdOfRead.at ( next ) >= 0 && reads.at ( next ).size > 0 ) {
+                    struct io_uring_sqe* sqe = ringGetSqe ( ring );
+                    sqe->opcode = IORING_OP_READ;
+                    sqe->fd = fdOfRead.at ( next );
+                    sqe->addr = ( uint64_t ) ( uintptr_t ) reads.at ( next ).data;
+                    sqe->len = reads.at ( next ).size;
+                    sqe->off = reads.at ( next ).offset;
+                    sqe->user_data = next;
+                    prepared++;
+                }
+                next++;
+            }
+
+            if ( prepared == 0 && inFlight == 0 ) continue;
+
+            // Une soumission partielle laisse les entrées restantes dans la file : elles sont soumises au tour suivant
+            int ret = ringEnter ( ring, prepared, prepared + inFlight );
+            if ( ret < 0 || ( ret == 0 && prepared > 0 && inFlight == 0 ) ) {
+                LOGGER_ERROR ( "Soumission io_uring impossible, code erreur=" << -ret );
+                // Les entrées non soumises ne le seront plus, mais les lectures soumises écrivent encore dans les buffers : on attend leur fin
+                failed = true;
+                prepared = 0;
+                next = reads.size();
+            } else {
+                inFlight += ret;
+                prepared -= ret;
+            }
+        } else {
+            if ( ringEnter ( ring, 0, inFlight ) < 0 ) usleep ( 1000 );
+        }
+
+        uint64_t index;
+        int res;
+        while ( ringPopCqe ( ring, index, res ) ) {
+            inFlight--;
+            ContextRead& cr = reads.at ( index );
+            if ( res != cr.size ) {
+                LOGGER_ERROR ( "Impossible de lire la tuile dans le fichier " << getRootDir() + cr.name );
+                if ( res < 0 ) LOGGER_ERROR ( "Code erreur=" << -res );
+            } else {
+                cr.result = res;
+            }
+        }
+    }
+
+    for ( std::map<std::string, int>::iterator it = fds.begin(); it != fds.end(); ++it ) {
+        if ( it->second >= 0 ) close ( it->second );
+    }
+
+    if ( failed ) {
+        // Plus aucune lecture n'est en cours : l'anneau, dans un état incertain, est détruit et sera recréé au prochain appel
+        ringDestroy ( ring );
+        pthread_setspecific ( readRingKey, NULL );
+        // Les lectures non abouties sont refaites une à une
+        for ( unsigned int i = 0; i < reads.size(); i++ ) {
+            if ( reads.at ( i ).result < 0 && fdOfRead.at ( i ) >= 0 ) {
+                reads.at ( i ).result = FileContext::read ( reads.at ( i ).data, reads.at ( i ).offset, reads.at ( i ).size, reads.at ( i ).name );
+            }
+        }
+    }
+#endif
+}
+
+bool UringFileContext::initWriting() {
+    if ( writeRing ) return true;
+    if ( ! isAvailable() ) return false;
+
+    writeRing = ringCreate ( URING_WRITE_BUFFERS );
+    if ( writeRing == NULL ) return false;
+
+    if ( posix_memalign ( ( void** ) &writeBuffers, 4096, URING_WRITE_BUFFERS * URING_WRITE_BUFFER_SIZE ) != 0 ) {
+        writeBuffers = NULL;
+        ringDestroy ( writeRing );
+        writeRing = NULL;
+        return false;
+    }
+
+#if URING_SUPPORT
+    // Enregistrement des buffers auprès du noyau (peut être refusé selon la limite de mémoire verrouillée)
+    struct iovec iovs[URING_WRITE_BUFFERS];
+    for ( int i = 0; i < URING_WRITE_BUFFERS; i++ ) {
+        iovs[i].iov_base = writeBuffers + i * URING_WRITE_BUFFER_SIZE;
+        iovs[i].iov_len = URING_WRITE_BUFFER_SIZE;
+    }
+    fixedBuffers = ( syscall ( __NR_io_uring_register, writeRing->fd, IORING_REGISTER_BUFFERS, iovs, URING_WRITE_BUFFERS ) == 0 );
+    if ( ! fixedBuffers ) {
+        LOGGER_DEBUG ( "Buffers io_uring non enregistrés, code erreur=" << errno );
+    }
+#endif
+
+    freeBuffers.clear();
+    for ( int i = URING_WRITE_BUFFERS - 1; i >= 0; i-- ) freeBuffers.push_back ( i );
+    pendingSizes.assign ( URING_WRITE_BUFFERS, 0 );
+    pendingOffsets.assign ( URING_WRITE_BUFFERS, 0 );
+
+    return true;
+}
+
+void UringFileContext::reapWritings ( unsigned int wait ) {
+#if URING_SUPPORT
+    unsigned int reaped = 0;
+    do {
+        if ( reaped < wait ) {
+            int ret = ringEnter ( writeRing, 0, wait - reaped );
+            if ( ret < 0 ) {
+                LOGGER_ERROR ( "Attente des écritures io_uring impossible, code erreur=" << -ret );
+                writeError = true;
+                return;
+            }
+        }
+
+        uint64_t buffer;
+        int res;
+        while ( ringPopCqe ( writeRing, buffer, res ) ) {
+            if ( res != pendingSizes.at ( buffer ) ) {
+                LOGGER_ERROR ( "Écriture io_uring incomplète (" << res << " octets sur " << pendingSizes.at ( buffer ) << ")" );
+                writeError = true;
+            }
+            pendingSizes.at ( buffer ) = 0;
+            freeBuffers.push_back ( buffer );
+            reaped++;
+        }
+    } while ( reaped < wait );
+#endif
+}
+
+bool UringFileContext::submitWriting ( uint8_t* data, int64_t offset, int size ) {
+#if URING_SUPPORT
+    while ( size > 0 ) {
+        if ( freeBuffers.empty() ) reapWritings ( 1 );
+        if ( freeBuffers.empty() ) return false;
+
+        int chunk = ( size < URING_WRITE_BUFFER_SIZE ) ? size : URING_WRITE_BUFFER_SIZE;
+
+        // Une réécriture (en-tête, index) ne doit pas être doublée par une écriture antérieure encore en cours
+        for ( int i = 0; i < URING_WRITE_BUFFERS; i++ ) {
+            if ( pendingSizes.at ( i ) > 0 && offset < pendingOffsets.at ( i ) + pendingSizes.at ( i ) && pendingOffsets.at ( i ) < offset + chunk ) {
+                reapWritings ( URING_WRITE_BUFFERS - freeBuffers.size() );
+                break;
+            }
+        }
+
+        int buffer = freeBuffers.back();
+        freeBuffers.pop_back();
+        uint8_t* dest = writeBuffers + buffer * URING_WRITE_BUFFER_SIZE;
+        memcpy ( dest, data, chunk );
+        pendingSizes.at ( buffer ) = chunk;
+        pendingOffsets.at ( buffer ) = offset;
+
+        struct io_uring_sqe* sqe = ringGetSqe ( writeRing );
+        sqe->opcode = fixedBuffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe->fd = outputFd;
+        sqe->addr = ( uint64_t ) ( uintptr_t ) dest;
+        sqe->len = chunk;
+        sqe->off = offset;
+        if ( fixedBuffers ) sqe->buf_index = buffer;
+        sqe->user_data = buffer;
+
+        int ret = ringEnter ( writeRing, 1, 0 );
+        if ( ret < 0 ) {
+            LOGGER_ERROR ( "Soumission io_uring impossible, code erreur=" << -ret );
+            freeBuffers.push_back ( buffer );
+            return false;
+        }
+
+        data += chunk;
+        offset += chunk;
+        size -= chunk;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool UringFileContext::openToWrite ( std::string name ) {
+    if ( ! initWriting() ) {
+        return FileContext::openToWrite ( name );
+    }
+
+    std::string fullName = getRootDir() + name;
+    MappedFilePool::invalidate ( fullName );
+
+    outputFd = open ( fullName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+    if ( outputFd < 0 ) {
+        return false;
+    }
+    outputOffset = 0;
+    writeError = false;
+    return true;
+}
+
+bool UringFileContext::write ( uint8_t* data, int offset, int size, std::string name ) {
+    if ( outputFd < 0 ) {
+        return FileContext::write ( data, offset, size, name );
+    }
+
+    LOGGER_DEBUG ( "File write (io_uring) : " << size << " bytes (from the " << offset << " one) in the file " << getRootDir() + name );
+
+    if ( writeError || ! submitWriting ( data, offset, size ) ) {
+        return false;
+    }
+    outputOffset = ( int64_t ) offset + size;
+    return true;
+}
+
+bool UringFileContext::writeFull ( uint8_t* data, int size, std::string name ) {
+    if ( outputFd < 0 ) {
+        return FileContext::writeFull ( data, size, name );
+    }
+
+    LOGGER_DEBUG ( "File write (io_uring) : " << size << " bytes (one shot) in the file " << getRootDir() + name );
+
+    if ( writeError || ! submitWriting ( data, outputOffset, size ) ) {
+        return false;
+    }
+    outputOffset += size;
+    return true;
+}
+
+bool UringFileContext::closeToWrite ( std::string name ) {
+    if ( outputFd < 0 ) {
+        return FileContext::closeToWrite ( name );
+    }
+
+    reapWritings ( URING_WRITE_BUFFERS - freeBuffers.size() );
+
+    bool ok = ! writeError;
+    if ( close ( outputFd ) != 0 ) ok = false;
+    outputFd = -1;
+
+    return ok;
+}
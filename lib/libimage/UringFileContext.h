@@ -0,0 +1,237 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+/**
+ * \file UringFileContext.h
+ ** \~french
+ * \brief Définition de la classe UringFileContext
+ * \details
+ * \li UringFileContext : utilisation d'un système de fichier, avec entrées/sorties io_uring
+ ** \~english
+ * \brief Define classe UringFileContext
+ * \details
+ * \li UringFileContext : file system use, with io_uring inputs/outputs
+ */
+
+#ifndef URING_FILE_CONTEXT_H
+#define URING_FILE_CONTEXT_H
+
+#include "FileContext.h"
+#include <pthread.h>
+#include <vector>
+
+/**
+ * \~french \brief Anneau io_uring (files de soumission et de complétion)
+ * \~english \brief io_uring ring (submission and completion queues)
+ */
+struct UringRing;
+
+/**
+ * \author Institut national de l'information géographique et forestière
+ * \~french
+ * \brief Contexte fichier utilisant io_uring
+ * \details Les lectures groupées (#readMulti) sont soumises simultanément au noyau, via un anneau propre à chaque thread. Les écritures (#write, #writeFull) sont asynchrones : la donnée est copiée dans des buffers enregistrés auprès du noyau et l'écriture est soumise sans attendre sa fin. Les erreurs d'écriture sont remontées au plus tard par #closeToWrite, qui attend la fin de toutes les écritures.
+ *
+ * Sur un noyau sans io_uring (ou si la création de l'anneau est refusée), le comportement est celui de FileContext.
+ * \~english
+ * \brief File context using io_uring
+ * \details Grouped readings (#readMulti) are submitted simultaneously to the kernel, with a ring specific to each thread. Writings (#write, #writeFull) are asynchronous : data is copied in buffers registered with the kernel and writing is submitted without waiting for its end. Writing errors are reported at the latest by #closeToWrite, which waits for the end of all writings.
+ *
+ * With a kernel without io_uring (or if ring creation is refused), behaviour is FileContext's one.
+ */
+class UringFileContext : public FileContext {
+
+private:
+
+    /**
+     * \~french \brief Clé des anneaux de lecture propres à chaque thread
+     * \~english \brief Key of reading rings specific to each thread
+     */
+    static pthread_key_t readRingKey;
+
+    /**
+     * \~french \brief Création unique de #readRingKey
+     * \~english \brief Single creation of #readRingKey
+     */
+    static pthread_once_t readRingOnce;
+
+    /**
+     * \~french \brief Crée #readRingKey
+     * \~english \brief Create #readRingKey
+     */
+    static void createReadRingKey();
+
+    /**
+     * \~french \brief Retourne l'anneau de lecture du thread appelant, NULL si io_uring n'est pas disponible
+     * \~english \brief Return the calling thread's reading ring, NULL if io_uring is not available
+     */
+    static UringRing* getReadRing();
+
+    /**
+     * \~french \brief Anneau d'écriture, créé à la première ouverture en écriture
+     * \~english \brief Writing ring, created at the first opening to write
+     */
+    UringRing* writeRing;
+
+    /**
+     * \~french \brief Buffers d'écriture, contigus
+     * \~english \brief Writing buffers, contiguous
+     */
+    uint8_t* writeBuffers;
+
+    /**
+     * \~french \brief Les buffers d'écriture sont-ils enregistrés auprès du noyau
+     * \~english \brief Are writing buffers registered with the kernel
+     */
+    bool fixedBuffers;
+
+    /**
+     * \~french \brief Indices des buffers d'écriture libres
+     * \~english \brief Free writing buffers' indices
+     */
+    std::vector<int> freeBuffers;
+
+    /**
+     * \~french \brief Taille attendue de l'écriture en cours, par buffer
+     * \~english \brief Expected size of the writing in progress, for each buffer
+     */
+    std::vector<int> pendingSizes;
+
+    /**
+     * \~french \brief Position de l'écriture en cours, par buffer
+     * \details Les écritures soumises pouvant être exécutées dans le désordre, une écriture recouvrant une écriture en cours attend la fin de celle-ci
+     * \~english \brief Position of the writing in progress, for each buffer
+     * \details Submitted writings can be executed out of order, so a writing overlapping a writing in progress waits for its end
+     */
+    std::vector<int64_t> pendingOffsets;
+
+    /**
+     * \~french \brief Descripteur du fichier en écriture, -1 si écriture via FileContext
+     * \~english \brief Descriptor of the file being written, -1 if writing through FileContext
+     */
+    int outputFd;
+
+    /**
+     * \~french \brief Position courante d'écriture, pour #writeFull
+     * \~english \brief Current writing position, for #writeFull
+     */
+    int64_t outputOffset;
+
+    /**
+     * \~french \brief Une écriture asynchrone a-t-elle échoué
+     * \~english \brief Has an asynchronous writing failed
+     */
+    bool writeError;
+
+    /**
+     * \~french \brief Crée l'anneau et les buffers d'écriture
+     * \return faux si io_uring n'est pas disponible
+     * \~english \brief Create writing ring and buffers
+     * \return false if io_uring is not available
+     */
+    bool initWriting();
+
+    /**
+     * \~french \brief Récupère les écritures terminées
+     * \param[in] wait Nombre minimal d'écritures terminées à attendre
+     * \~english \brief Get finished writings
+     * \param[in] wait Minimal number of finished writings to wait for
+     */
+    void reapWritings ( unsigned int wait );
+
+    /**
+     * \~french \brief Soumet une écriture asynchrone
+     * \~english \brief Submit an asynchronous writing
+     */
+    bool submitWriting ( uint8_t* data, int64_t offset, int size );
+
+public:
+
+    /**
+     * \~french
+     * \brief Constructeur pour un contexte Fichier io_uring
+     * \param[in] root Répertoire des fichiers manipulés
+     * \~english
+     * \brief Constructor for io_uring File context
+     * \param[in] root Directory for manipulated files
+     */
+    UringFileContext ( std::string root );
+
+    /**
+     * \~french \brief Le noyau permet-il l'utilisation d'io_uring
+     * \~english \brief Does the kernel allow io_uring use
+     */
+    static bool isAvailable();
+
+    void readMulti ( std::vector<ContextRead>& reads );
+    bool write ( uint8_t* data, int offset, int size, std::string name );
+    bool writeFull ( uint8_t* data, int size, std::string name );
+
+    /**
+     * \~french \brief Ouvre le fichier en écriture
+     * \details Sans io_uring, le flux de FileContext est utilisé
+     * \~english \brief Open file to write
+     * \details Without io_uring, FileContext's stream is used
+     */
+    bool openToWrite ( std::string name );
+
+    /**
+     * \~french \brief Attend la fin des écritures et ferme le fichier
+     * \return faux si une des écritures a échoué
+     * \~english \brief Wait for writings' end and close file
+     * \return false if one of writings failed
+     */
+    bool closeToWrite ( std::string name );
+
+    virtual void print() {
+        LOGGER_INFO ( "------ File Context (io_uring) -------" );
+        LOGGER_INFO ( "\t- root directory = " << getRootDir() );
+        LOGGER_INFO ( "\t- io_uring = " << ( isAvailable() ? "yes" : "no" ) );
+    }
+
+    virtual std::string toString() {
+        std::ostringstream oss;
+        oss.setf ( std::ios::fixed,std::ios::floatfield );
+        oss << "------ File Context (io_uring) -------" << std::endl;
+        oss << "\t- root directory = " << getRootDir() << std::endl;
+        oss << "\t- io_uring = " << ( isAvailable() ? "yes" : "no" ) << std::endl;
+        return oss.str() ;
+    }
+
+    virtual ~UringFileContext();
+};
+
+#endif
@@ -696,6 +696,86 @@ inline void dot_prod ( int C, int K, float* to, const float* from, const float*
     }
 }
 
+/**
+ * \brief Somme terme à terme de deux lignes d'entiers 8 bits
+ * \details Le résultat est stocké sur 16 bits, sans saturation : to[i] = from1[i] + from2[i]
+ * @param to Tableau d'entiers 16 bits destination
+ * @param from1 Première ligne source
+ * @param from2 Seconde ligne source
+ * @param length Nombre d'éléments à sommer
+ */
+#ifdef __SSE2__
+inline void add_lines ( uint16_t* to, const uint8_t* from1, const uint8_t* from2, int length ) {
+    __m128i z = _mm_setzero_si128();
+    int i = 0;
+
+    // On traite les éléments 16 par 16 en utlisant les fonctions intrinsics SSE
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m128i a = _mm_loadu_si128 ( ( const __m128i* ) ( from1 + i ) );
+        __m128i b = _mm_loadu_si128 ( ( const __m128i* ) ( from2 + i ) );
+
+        _mm_storeu_si128 ( ( __m128i* ) ( to + i ),     _mm_add_epi16 ( _mm_unpacklo_epi8 ( a, z ), _mm_unpacklo_epi8 ( b, z ) ) );
+        _mm_storeu_si128 ( ( __m128i* ) ( to + i + 8 ), _mm_add_epi16 ( _mm_unpackhi_epi8 ( a, z ), _mm_unpackhi_epi8 ( b, z ) ) );
+    }
+
+    for ( ; i < length; i++ ) to[i] = ( uint16_t ) from1[i] + ( uint16_t ) from2[i];
+}
+#else // Version non SSE
+inline void add_lines ( uint16_t* to, const uint8_t* from1, const uint8_t* from2, int length ) {
+    for ( int i = 0; i < length; i++ ) to[i] = ( uint16_t ) from1[i] + ( uint16_t ) from2[i];
+}
 #endif
 
+/**
+ * \brief Somme terme à terme de deux lignes de flottants
+ * @param to Tableau de flottants destination
+ * @param from1 Première ligne source
+ * @param from2 Seconde ligne source
+ * @param length Nombre d'éléments à sommer
+ */
+#ifdef __SSE2__
+inline void add_lines ( float* to, const float* from1, const float* from2, int length ) {
+    int i = 0;
+
+    for ( ; i + 4 <= length; i += 4 ) {
+        _mm_storeu_ps ( to + i, _mm_add_ps ( _mm_loadu_ps ( from1 + i ), _mm_loadu_ps ( from2 + i ) ) );
+    }
 
+    for ( ; i < length; i++ ) to[i] = from1[i] + from2[i];
+}
+#else // Version non SSE
+inline void add_lines ( float* to, const float* from1, const float* from2, int length ) {
+    for ( int i = 0; i < length; i++ ) to[i] = from1[i] + from2[i];
+}
+#endif
+
+/**
+ * \brief Compte, pour chaque pixel, le nombre de masques contenant de la donnée
+ * \details to[i] vaut 0, 1 ou 2 selon que mask1[i] et mask2[i] sont nuls ou non
+ * @param to Tableau destination
+ * @param mask1 Premier masque source
+ * @param mask2 Second masque source
+ * @param length Nombre de pixels
+ */
+#ifdef __SSE2__
+inline void count_masks ( uint8_t* to, const uint8_t* mask1, const uint8_t* mask2, int length ) {
+    __m128i z = _mm_setzero_si128();
+    __m128i one = _mm_set1_epi8 ( 1 );
+    int i = 0;
+
+    for ( ; i + 16 <= length; i += 16 ) {
+        __m128i a = _mm_cmpeq_epi8 ( _mm_loadu_si128 ( ( const __m128i* ) ( mask1 + i ) ), z );
+        __m128i b = _mm_cmpeq_epi8 ( _mm_loadu_si128 ( ( const __m128i* ) ( mask2 + i ) ), z );
+
+        _mm_storeu_si128 ( ( __m128i* ) ( to + i ), _mm_add_epi8 ( _mm_andnot_si128 ( a, one ), _mm_andnot_si128 ( b, one ) ) );
+    }
+
+    for ( ; i < length; i++ ) to[i] = ( mask1[i] ? 1 : 0 ) + ( mask2[i] ? 1 : 0 );
+}
+#else // Version non SSE
+inline void count_masks ( uint8_t* to, const uint8_t* mask1, const uint8_t* mask2, int length ) {
+    for ( int i = 0; i < length; i++ ) to[i] = ( mask1[i] ? 1 : 0 ) + ( mask2[i] ? 1 : 0 );
+}
+#endif
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "Utils.h"
+#include <cstdlib>
+
+#include <iostream>
+using namespace std;
+
+
+class CppUnitAddLines : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitAddLines );
+
+    CPPUNIT_TEST ( test_add_lines_uint8 );
+    CPPUNIT_TEST ( test_add_lines_float );
+    CPPUNIT_TEST ( test_count_masks );
+    CPPUNIT_TEST_SUITE_END();
+
+
+public:
+    void setUp() {};
+
+protected:
+
+    void test_add_lines_uint8() {
+        uint8_t from1[2000];
+        uint8_t from2[2000];
+        uint16_t to[2000];
+        for ( int k = 0; k < 2000; k++ ) {
+            from1[k] = rand() %256;
+            from2[k] = rand() %256;
+        }
+
+        for ( int k = 0; k < 1000; k++ ) {
+            int i1 = rand() %100;
+            int i2 = rand() %100;
+            int length = rand() %500;
+
+            for ( int i = 0; i < 2000; i++ ) to[i] = 60000;
+            add_lines ( to, from1 + i1, from2 + i2, length );
+            for ( int i = 0; i < length; i++ ) CPPUNIT_ASSERT_EQUAL ( ( uint16_t ) ( from1[i+i1] + from2[i+i2] ), to[i] );
+            for ( int i = length; i < 2000; i++ ) CPPUNIT_ASSERT_EQUAL ( ( uint16_t ) 60000, to[i] );
+        }
+    }
+
+    void test_add_lines_float() {
+        float from1[2000];
+        float from2[2000];
+        float to[2000];
+        for ( int k = 0; k < 2000; k++ ) {
+            from1[k] = float ( k );
+            from2[k] = - float ( k ) / 3.f;
+        }
+
+        for ( int k = 0; k < 1000; k++ ) {
+            int i1 = rand() %100;
+            int i2 = rand() %100;
+            int length = rand() %500;
+
+            for ( int i = 0; i < 2000; i++ ) to[i] = -1.f;
+            add_lines ( to, from1 + i1, from2 + i2, length );
+            for ( int i = 0; i < length; i++ ) CPPUNIT_ASSERT_EQUAL ( from1[i+i1] + from2[i+i2], to[i] );
+            for ( int i = length; i < 2000; i++ ) CPPUNIT_ASSERT_EQUAL ( -1.f, to[i] );
+        }
+    }
+
+    void test_count_masks() {
+        uint8_t mask1[2000];
+        uint8_t mask2[2000];
+        uint8_t to[2000];
+        for ( int k = 0; k < 2000; k++ ) {
+            mask1[k] = ( rand() %2 ) ? 255 : 0;
+            mask2[k] = ( rand() %3 ) ? 0 : rand() %255 + 1;
+        }
+
+        for ( int k = 0; k < 1000; k++ ) {
+            int i1 = rand() %100;
+            int i2 = rand() %100;
+            int length = rand() %500;
+
+            count_masks ( to, mask1 + i1, mask2 + i2, length );
+            for ( int i = 0; i < length; i++ ) {
+                uint8_t expected = ( mask1[i+i1] ? 1 : 0 ) + ( mask2[i+i2] ? 1 : 0 );
+                CPPUNIT_ASSERT_EQUAL ( expected, to[i] );
+            }
+        }
+    }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitAddLines );
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION ( CppUnitAddLines, "CppUnitAddLines" );
@@ -0,0 +1,210 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "AscEncoder.h"
+#include "BilEncoder.h"
+#include "GzipDataStream.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Image flottante dont les valeurs, positives et négatives, dépendent de la position du pixel
+ */
+class SlopeImage : public Image {
+private:
+    template<typename T>
+    int _getline ( T* buffer, int line ) {
+        for ( int i = 0; i < width * channels; i++ ) {
+            buffer[i] = ( T ) ( ( i % 17 ) * 0.37 - line * 1.125 + ( i % channels ) * 1000 );
+        }
+        return width * channels;
+    }
+
+public:
+    SlopeImage ( int width, int height, int channels = 1 ) : Image ( width, height, channels ) {}
+
+    int getline ( uint8_t* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+    int getline ( uint16_t* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+    int getline ( float* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+};
+
+class CppUnitAscEncoder : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitAscEncoder );
+
+    CPPUNIT_TEST ( test_format_value );
+    CPPUNIT_TEST ( test_asc_output );
+    CPPUNIT_TEST ( test_bil_output );
+    CPPUNIT_TEST ( test_gzip );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    static std::string readAll ( DataStream* stream, size_t chunk ) {
+        std::string data;
+        std::vector<uint8_t> buffer ( chunk );
+        while ( true ) {
+            size_t size = stream->read ( &buffer[0], chunk );
+            if ( size == 0 ) break;
+            data.append ( ( char* ) &buffer[0], size );
+        }
+        CPPUNIT_ASSERT ( stream->eof() );
+        return data;
+    }
+
+    static void checkValue ( float value ) {
+        char expected[64];
+        snprintf ( expected, 64, "%.2f", value );
+        char out[ASC_VALUE_MAX_SIZE];
+        char* end = AscEncoder::formatValue ( out, value );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( expected ), std::string ( out, end - out ) );
+    }
+
+public:
+
+    void test_format_value() {
+        // Arrondis au pair des valeurs exactement à mi-chemin, comme printf
+        float values[] = { 0.f, -0.f, 0.125f, 0.375f, -0.125f, 2.5f, -0.001f, 0.005f, 1.f / 3.f, -99999.f,
+                           8848.86f, 123456789.f, 1e15f, 1e16f, 1e20f, -3.4e38f, 1e-30f, INFINITY, -INFINITY };
+        for ( unsigned int i = 0; i < sizeof ( values ) / sizeof ( float ); i++ ) checkValue ( values[i] );
+        checkValue ( NAN );
+
+        srand ( 42 );
+        for ( int i = 0; i < 100000; i++ ) {
+            float scale = powf ( 10.f, ( float ) ( rand() % 12 - 4 ) );
+            checkValue ( ( ( float ) rand() / RAND_MAX - 0.5f ) * scale );
+        }
+    }
+
+    void test_asc_output() {
+        // Référence : ancien formatage par flux
+        SlopeImage reference ( 300, 20 );
+        std::ostringstream expected;
+        expected << std::fixed << std::setprecision ( 8 )
+                 << "ncols        " << reference.getWidth() << std::endl
+                 << "nrows        " << reference.getHeight() << std::endl
+                 << "xllcorner    " << reference.getXmin() << std::endl
+                 << "yllcorner    " << reference.getYmin() << std::endl
+                 << "cellsize     " << reference.getResXmeter() << std::endl
+                 << "NODATA_value " << std::setprecision ( 2 ) << -99999.00;
+        float line[300];
+        for ( int l = 0; l < 20; l++ ) {
+            reference.getline ( line, l );
+            expected << std::endl;
+            for ( int i = 0; i < 300; i++ ) expected << " " << line[i];
+        }
+
+        // Lecture par gros tampon ou par petits morceaux coupant les lignes
+        size_t chunks[] = { 2 << 20, 1000, 7 };
+        for ( int c = 0; c < 3; c++ ) {
+            AscEncoder encoder ( new SlopeImage ( 300, 20 ) );
+            CPPUNIT_ASSERT_EQUAL ( expected.str(), readAll ( &encoder, chunks[c] ) );
+        }
+    }
+
+    void test_bil_output() {
+        int width = 301, height = 10;
+        SlopeImage reference ( width, height, 3 );
+        std::vector<float> line ( width * 3 );
+        std::string expected;
+        for ( int l = 0; l < height; l++ ) {
+            reference.getline ( &line[0], l );
+            for ( int i = 0; i < width; i++ ) expected.append ( ( char* ) &line[i * 3], sizeof ( float ) );
+        }
+
+        // Seul le premier canal est diffusé, quel que soit le découpage des lectures
+        size_t chunks[] = { 2 << 20, 4096, 13 };
+        for ( int c = 0; c < 3; c++ ) {
+            BilEncoder encoder ( new SlopeImage ( width, height, 3 ) );
+            CPPUNIT_ASSERT_EQUAL ( ( size_t ) encoder.getLength(), expected.size() );
+            CPPUNIT_ASSERT ( expected == readAll ( &encoder, chunks[c] ) );
+        }
+
+        // Image à un canal : lecture directe dans le tampon
+        SlopeImage single ( width, height );
+        expected.clear();
+        for ( int l = 0; l < height; l++ ) {
+            single.getline ( &line[0], l );
+            expected.append ( ( char* ) &line[0], width * sizeof ( float ) );
+        }
+        for ( int c = 0; c < 3; c++ ) {
+            BilEncoder encoder ( new SlopeImage ( width, height ) );
+            CPPUNIT_ASSERT ( expected == readAll ( &encoder, chunks[c] ) );
+        }
+    }
+
+    void test_gzip() {
+        AscEncoder reference ( new SlopeImage ( 500, 600 ) );
+        std::string expected = readAll ( &reference, 2 << 20 );
+
+        GzipDataStream gzip ( new AscEncoder ( new SlopeImage ( 500, 600 ) ) );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "gzip" ), gzip.getEncoding() );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "text/asc" ), gzip.getType() );
+        CPPUNIT_ASSERT_EQUAL ( 0u, gzip.getLength() );
+        std::string compressed = readAll ( &gzip, 1000 );
+        CPPUNIT_ASSERT ( compressed.size() < expected.size() );
+        CPPUNIT_ASSERT_EQUAL ( ( char ) 0x1f, compressed[0] );
+        CPPUNIT_ASSERT_EQUAL ( ( char ) 0x8b, compressed[1] );
+
+        z_stream zstream;
+        memset ( &zstream, 0, sizeof ( zstream ) );
+        CPPUNIT_ASSERT_EQUAL ( Z_OK, inflateInit2 ( &zstream, MAX_WBITS + 16 ) );
+        std::vector<char> inflated ( expected.size() + 1 );
+        zstream.next_in = ( Bytef* ) compressed.data();
+        zstream.avail_in = compressed.size();
+        zstream.next_out = ( Bytef* ) &inflated[0];
+        zstream.avail_out = inflated.size();
+        CPPUNIT_ASSERT_EQUAL ( Z_STREAM_END, inflate ( &zstream, Z_FINISH ) );
+        CPPUNIT_ASSERT_EQUAL ( expected.size(), ( size_t ) zstream.total_out );
+        inflateEnd ( &zstream );
+        CPPUNIT_ASSERT ( expected == std::string ( &inflated[0], zstream.total_out ) );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitAscEncoder );
@@ -0,0 +1,169 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "BandImage.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+/**
+ * Image dont les valeurs sont calculées à partir de la position du pixel
+ */
+class RampImage : public Image {
+private:
+    int seed;
+
+    template<typename T>
+    int _getline ( T* buffer, int line ) {
+        for ( int i = 0; i < width * channels; i++ ) {
+            buffer[i] = ( T ) ( ( i * 7 + line * 3 + seed ) % 251 );
+        }
+        __atomic_add_fetch ( &calls, 1, __ATOMIC_RELAXED );
+        return width * channels;
+    }
+
+public:
+    int calls;
+
+    RampImage ( int width, int height, int channels, int seed ) : Image ( width, height, channels ), seed ( seed ), calls ( 0 ) {}
+
+    int getline ( uint8_t* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+    int getline ( uint16_t* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+    int getline ( float* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+};
+
+class CppUnitBandImage : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitBandImage );
+
+    CPPUNIT_TEST ( test_incompatible );
+    CPPUNIT_TEST ( test_uint8_mask );
+    CPPUNIT_TEST ( test_float );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    ThreadPool* pool;
+
+    template<typename T>
+    void checkLine ( Image* image, int seed, int line ) {
+        int size = image->getWidth() * image->getChannels();
+        RampImage reference ( image->getWidth(), image->getHeight(), image->getChannels(), seed );
+        T expected[size];
+        T got[size];
+        CPPUNIT_ASSERT_EQUAL ( size, reference.getline ( expected, line ) );
+        CPPUNIT_ASSERT_EQUAL ( size, image->getline ( got, line ) );
+        for ( int i = 0; i < size; i++ ) CPPUNIT_ASSERT_EQUAL ( expected[i], got[i] );
+    }
+
+public:
+    void setUp() {
+        pool = new ThreadPool ( 2 );
+    }
+
+    void tearDown() {
+        delete pool;
+    }
+
+    void test_incompatible() {
+        std::vector<Image*> images;
+        images.push_back ( new RampImage ( 10, 10, 1, 0 ) );
+        CPPUNIT_ASSERT ( ! BandImageFactory().createBandImages ( images, pool ) );
+        images.push_back ( new RampImage ( 10, 11, 1, 0 ) );
+        CPPUNIT_ASSERT ( ! BandImageFactory().createBandImages ( images, pool ) );
+        CPPUNIT_ASSERT_EQUAL ( 10, images.at ( 1 )->getWidth() );
+        delete images.at ( 0 );
+        delete images.at ( 1 );
+    }
+
+    void test_uint8_mask() {
+        std::vector<Image*> images;
+        std::vector<RampImage*> sources;
+        for ( int i = 0; i < 3; i++ ) {
+            RampImage* source = new RampImage ( 50, 150, 3, i );
+            if ( i != 1 ) source->setMask ( new RampImage ( 50, 150, 1, 10 * i ) );
+            sources.push_back ( source );
+            images.push_back ( source );
+        }
+
+        CPPUNIT_ASSERT ( BandImageFactory().createBandImages ( images, pool ) );
+
+        for ( int i = 0; i < 3; i++ ) {
+            CPPUNIT_ASSERT ( images.at ( i ) != sources.at ( i ) );
+            CPPUNIT_ASSERT_EQUAL ( 3, images.at ( i )->getChannels() );
+            CPPUNIT_ASSERT_EQUAL ( i != 1, images.at ( i )->getMask() != NULL );
+        }
+
+        // Lecture intercalée des images et des masques, ligne à ligne comme le fait une fusion
+        for ( int l = 0; l < 150; l++ ) {
+            for ( int i = 0; i < 3; i++ ) {
+                checkLine<uint8_t> ( images.at ( i ), i, l );
+                if ( i != 1 ) checkLine<uint8_t> ( images.at ( i )->getMask(), 10 * i, l );
+            }
+        }
+
+        // Chaque ligne source n'est calculée qu'une fois, dans une bande
+        for ( int i = 0; i < 3; i++ ) CPPUNIT_ASSERT_EQUAL ( 150, sources.at ( i )->calls );
+
+        for ( int i = 0; i < 3; i++ ) delete images.at ( i );
+    }
+
+    void test_float() {
+        std::vector<Image*> images;
+        for ( int i = 0; i < 4; i++ ) images.push_back ( new RampImage ( 20, 70, 1, i ) );
+
+        CPPUNIT_ASSERT ( BandImageFactory().createBandImages ( images, pool ) );
+
+        for ( int l = 0; l < 70; l++ ) {
+            for ( int i = 0; i < 4; i++ ) checkLine<float> ( images.at ( i ), i, l );
+        }
+
+        // Un type différent de celui des bandes est lu directement sur la source
+        uint16_t direct[20];
+        CPPUNIT_ASSERT_EQUAL ( 20, images.at ( 2 )->getline ( direct, 5 ) );
+        CPPUNIT_ASSERT_EQUAL ( ( uint16_t ) ( ( 5 * 3 + 2 ) % 251 ), direct[0] );
+
+        for ( int i = 0; i < 4; i++ ) delete images.at ( i );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitBandImage );
@@ -0,0 +1,148 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "CephPoolContext.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+using namespace std;
+
+#define TEST_OBJECTS_NUMBER 3
+#define TEST_OBJECT_SIZE 65536
+
+/**
+ * Tests des lectures groupées sur un cluster Ceph réel, par exemple un cluster mono-nœud lancé avec vstart.sh.
+ * Le pool de test est donné par la variable d'environnement ROK4_CEPH_TEST_POOL (la connexion utilise les variables
+ * ROK4_CEPH_CLUSTERNAME, ROK4_CEPH_USERNAME et ROK4_CEPH_CONFFILE). Sans elle, les tests ne font rien.
+ */
+class CppUnitCephPoolContext : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitCephPoolContext );
+
+    CPPUNIT_TEST ( test_readMulti );
+    CPPUNIT_TEST ( test_readMulti_failure );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    CephPoolContext* context;
+    uint8_t* contents[TEST_OBJECTS_NUMBER];
+
+    string objectName ( int i ) {
+        char name[64];
+        sprintf ( name, "CppUnitCephPoolContext_%d", i );
+        return string ( name );
+    }
+
+public:
+    void setUp() {
+        context = NULL;
+        for ( int i = 0; i < TEST_OBJECTS_NUMBER; i++ ) contents[i] = NULL;
+
+        char* pool = getenv ( "ROK4_CEPH_TEST_POOL" );
+        if ( pool == NULL ) {
+            cout << endl << "ROK4_CEPH_TEST_POOL non défini : pas de test Ceph" << endl;
+            return;
+        }
+
+        context = new CephPoolContext ( string ( pool ) );
+        CPPUNIT_ASSERT ( context->connection() );
+
+        for ( int i = 0; i < TEST_OBJECTS_NUMBER; i++ ) {
+            contents[i] = new uint8_t[TEST_OBJECT_SIZE];
+            for ( int j = 0; j < TEST_OBJECT_SIZE; j++ ) contents[i][j] = ( uint8_t ) ( ( j * 7 + i * 13 ) ^ ( j >> 8 ) );
+            CPPUNIT_ASSERT ( context->openToWrite ( objectName ( i ) ) );
+            CPPUNIT_ASSERT ( context->writeFull ( contents[i], TEST_OBJECT_SIZE, objectName ( i ) ) );
+            CPPUNIT_ASSERT ( context->closeToWrite ( objectName ( i ) ) );
+        }
+    }
+
+    void tearDown() {
+        for ( int i = 0; i < TEST_OBJECTS_NUMBER; i++ ) delete[] contents[i];
+        delete context;
+    }
+
+protected:
+
+    void test_readMulti() {
+        if ( context == NULL ) return;
+
+        // Plusieurs lectures par objet, mélangées : elles sont regroupées en une opération par objet
+        std::vector<ContextRead> reads;
+        for ( int k = 0; k < 60; k++ ) {
+            int i = k % TEST_OBJECTS_NUMBER;
+            int size = 100 + k * 37;
+            int offset = ( k * 4099 ) % ( TEST_OBJECT_SIZE - size );
+            reads.push_back ( ContextRead ( new uint8_t[size], offset, size, objectName ( i ) ) );
+        }
+
+        context->readMulti ( reads );
+
+        for ( unsigned int k = 0; k < reads.size(); k++ ) {
+            ContextRead& cr = reads.at ( k );
+            CPPUNIT_ASSERT_EQUAL ( cr.size, cr.result );
+            CPPUNIT_ASSERT ( memcmp ( cr.data, contents[k % TEST_OBJECTS_NUMBER] + cr.offset, cr.size ) == 0 );
+            delete[] cr.data;
+        }
+    }
+
+    void test_readMulti_failure() {
+        if ( context == NULL ) return;
+
+        // Une lecture sur un objet absent échoue seule, les autres lectures du lot aboutissent
+        std::vector<ContextRead> reads;
+        reads.push_back ( ContextRead ( new uint8_t[1000], 0, 1000, objectName ( 0 ) ) );
+        reads.push_back ( ContextRead ( new uint8_t[1000], 0, 1000, "CppUnitCephPoolContext_absent" ) );
+        reads.push_back ( ContextRead ( new uint8_t[1000], 5000, 1000, objectName ( 1 ) ) );
+        // Lecture au delà de la fin de l'objet : moins d'octets que demandé
+        reads.push_back ( ContextRead ( new uint8_t[1000], TEST_OBJECT_SIZE - 10, 1000, objectName ( 2 ) ) );
+
+        context->readMulti ( reads );
+
+        CPPUNIT_ASSERT_EQUAL ( 1000, reads.at ( 0 ).result );
+        CPPUNIT_ASSERT ( memcmp ( reads.at ( 0 ).data, contents[0], 1000 ) == 0 );
+        CPPUNIT_ASSERT ( reads.at ( 1 ).result < 0 );
+        CPPUNIT_ASSERT_EQUAL ( 1000, reads.at ( 2 ).result );
+        CPPUNIT_ASSERT ( memcmp ( reads.at ( 2 ).data, contents[1] + 5000, 1000 ) == 0 );
+        CPPUNIT_ASSERT_EQUAL ( 10, reads.at ( 3 ).result );
+        CPPUNIT_ASSERT ( memcmp ( reads.at ( 3 ).data, contents[2] + TEST_OBJECT_SIZE - 10, 10 ) == 0 );
+
+        for ( unsigned int k = 0; k < reads.size(); k++ ) delete[] reads.at ( k ).data;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitCephPoolContext );
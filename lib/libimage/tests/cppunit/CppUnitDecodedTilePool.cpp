@@ -0,0 +1,165 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "DecodedTilePool.h"
+
+#include <cstring>
+using namespace std;
+
+/* Nombre de décodages et de sources détruites */
+static int nbDecode = 0;
+static int nbDeleted = 0;
+
+/* Source simulant le décodage d'une tuile de size octets de valeur value */
+class FakeDecoder : public DataSource {
+private:
+    uint8_t* data;
+    size_t size;
+    uint8_t value;
+public:
+    FakeDecoder ( size_t size, uint8_t value ) : data ( NULL ), size ( size ), value ( value ) {}
+    ~FakeDecoder() {
+        delete[] data;
+        nbDeleted++;
+    }
+    const uint8_t* getData ( size_t &s ) {
+        if ( ! data ) {
+            data = new uint8_t[size];
+            memset ( data, value, size );
+            nbDecode++;
+        }
+        s = size;
+        return data;
+    }
+    bool releaseData() {
+        delete[] data;
+        data = NULL;
+        return true;
+    }
+    std::string getType() { return "image/bil"; }
+    int getHttpStatus() { return 200; }
+    std::string getEncoding() { return ""; }
+    unsigned int getLength() { return size; }
+};
+
+/* Lit la tuile de clé key, en la décodant si elle n'est pas en cache, et retourne son premier octet */
+static int readTile ( string key, size_t size, uint8_t value ) {
+    DataSource* ds = DecodedTilePool::get ( key );
+    if ( ds == NULL ) ds = DecodedTilePool::wrap ( key, new FakeDecoder ( size, value ) );
+    size_t s;
+    const uint8_t* data = ds->getData ( s );
+    int first = ( data && s == size ) ? data[0] : -1;
+    delete ds;
+    return first;
+}
+
+class CppUnitDecodedTilePool : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitDecodedTilePool );
+
+    CPPUNIT_TEST ( test_hit );
+    CPPUNIT_TEST ( test_eviction );
+    CPPUNIT_TEST ( test_shared );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() {
+        // 1 Mo, soit deux tuiles de 400 ko
+        DecodedTilePool::setMaxSize ( 1 );
+        nbDecode = 0;
+        nbDeleted = 0;
+    }
+
+    void tearDown() {
+        DecodedTilePool::setMaxSize ( 0 );
+    }
+
+protected:
+
+    void test_hit() {
+        uint64_t hits = DecodedTilePool::getHits();
+        uint64_t misses = DecodedTilePool::getMisses();
+
+        CPPUNIT_ASSERT_EQUAL ( 10, readTile ( "A", 400000, 10 ) );
+        CPPUNIT_ASSERT_EQUAL ( 10, readTile ( "A", 400000, 10 ) );
+        CPPUNIT_ASSERT_EQUAL ( 1, nbDecode );
+        CPPUNIT_ASSERT_EQUAL ( 1, DecodedTilePool::getNbTiles() );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 400000, DecodedTilePool::getSize() );
+        CPPUNIT_ASSERT_EQUAL ( hits + 1, DecodedTilePool::getHits() );
+        CPPUNIT_ASSERT_EQUAL ( misses + 1, DecodedTilePool::getMisses() );
+
+        // Tuile plus grande que le cache : décodée mais pas conservée
+        CPPUNIT_ASSERT_EQUAL ( 20, readTile ( "B", 2000000, 20 ) );
+        CPPUNIT_ASSERT_EQUAL ( 1, DecodedTilePool::getNbTiles() );
+        CPPUNIT_ASSERT_EQUAL ( 1, nbDeleted );
+    }
+
+    void test_eviction() {
+        readTile ( "A", 400000, 10 );
+        readTile ( "B", 400000, 20 );
+        readTile ( "A", 400000, 10 );
+        readTile ( "C", 400000, 30 );
+        // B, la moins récemment utilisée, a été libérée
+        CPPUNIT_ASSERT_EQUAL ( 2, DecodedTilePool::getNbTiles() );
+        CPPUNIT_ASSERT_EQUAL ( 1, nbDeleted );
+        CPPUNIT_ASSERT_EQUAL ( 20, readTile ( "B", 400000, 20 ) );
+        CPPUNIT_ASSERT_EQUAL ( 4, nbDecode );
+        // Désactivation : tout est libéré
+        DecodedTilePool::setMaxSize ( 0 );
+        CPPUNIT_ASSERT_EQUAL ( 0, DecodedTilePool::getNbTiles() );
+        CPPUNIT_ASSERT_EQUAL ( 4, nbDeleted );
+    }
+
+    void test_shared() {
+        readTile ( "A", 400000, 10 );
+        DataSource* ds = DecodedTilePool::get ( "A" );
+        CPPUNIT_ASSERT ( ds != NULL );
+        size_t s;
+        const uint8_t* data = ds->getData ( s );
+
+        // La tuile est sortie du cache mais reste lisible tant qu'elle est référencée
+        readTile ( "B", 400000, 20 );
+        readTile ( "C", 400000, 30 );
+        CPPUNIT_ASSERT_EQUAL ( 0, nbDeleted );
+        CPPUNIT_ASSERT_EQUAL ( 10, ( int ) data[s - 1] );
+
+        delete ds;
+        CPPUNIT_ASSERT_EQUAL ( 1, nbDeleted );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitDecodedTilePool );
@@ -0,0 +1,190 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "ExtendedCompoundImage.h"
+#include "MergeImage.h"
+#include "EmptyImage.h"
+#include <sys/time.h>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+class CppUnitExtendedCompoundImage : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitExtendedCompoundImage );
+    // enregistrement des methodes de tests à jouer :
+    CPPUNIT_TEST ( testCompound );
+    CPPUNIT_TEST ( testBlock );
+    CPPUNIT_TEST ( testMerge );
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() {};
+
+protected:
+
+    /* Dalles de 50x30 pixels, sur une grille de nbX x nbY, certaines absentes, et une dernière dalle
+     * au dessus de toutes les autres au centre. On retourne la valeur attendue par pixel. */
+    ExtendedCompoundImage* buildGrid ( int nbX, int nbY, std::vector<int>& expected ) {
+        int width = 50 * nbX, height = 30 * nbY;
+        int nodata[1] = {0};
+        expected.assign ( width * height, 0 );
+
+        std::vector<Image*> images;
+        for ( int ty = 0; ty < nbY; ty++ ) {
+            for ( int tx = 0; tx < nbX; tx++ ) {
+                if ( ( tx + ty ) % 7 == 3 ) continue;
+                int color[1] = { 1 + ( ty * nbX + tx ) % 250 };
+                Image* tile = new EmptyImage ( 50, 30, 1, color );
+                tile->setBbox ( BoundingBox<double> ( tx * 50, height - ( ty + 1 ) * 30, ( tx + 1 ) * 50, height - ty * 30 ) );
+                images.push_back ( tile );
+                for ( int l = ty * 30; l < ( ty + 1 ) * 30; l++ )
+                    for ( int c = tx * 50; c < ( tx + 1 ) * 50; c++ )
+                        expected[l * width + c] = color[0];
+            }
+        }
+
+        int top[1] = {255};
+        Image* tile = new EmptyImage ( 100, 60, 1, top );
+        tile->setBbox ( BoundingBox<double> ( width / 2 - 75, height / 2 - 45, width / 2 + 25, height / 2 + 15 ) );
+        images.push_back ( tile );
+        for ( int l = height / 2 - 15; l < height / 2 + 45; l++ )
+            for ( int c = width / 2 - 75; c < width / 2 + 25; c++ )
+                expected[l * width + c] = 255;
+
+        ExtendedCompoundImageFactory ECIF;
+        return ECIF.createExtendedCompoundImage ( width, height, 1, BoundingBox<double> ( 0, 0, width, height ), images, nodata, 0 );
+    }
+
+    void testCompound() {
+        std::vector<int> expected;
+        ExtendedCompoundImage* eci = buildGrid ( 12, 20, expected );
+        CPPUNIT_ASSERT ( eci != NULL );
+
+        uint8_t line8[eci->getWidth()];
+        float lineF[eci->getWidth()];
+        for ( int l = 0; l < eci->getHeight(); l++ ) {
+            eci->getline ( line8, l );
+            eci->getline ( lineF, l );
+            for ( int c = 0; c < eci->getWidth(); c++ ) {
+                CPPUNIT_ASSERT_EQUAL ( expected[l * eci->getWidth() + c], ( int ) line8[c] );
+                CPPUNIT_ASSERT_DOUBLES_EQUAL ( expected[l * eci->getWidth() + c], lineF[c], 1e-6 );
+            }
+        }
+
+        delete eci;
+    }
+
+    void testBlock() {
+        std::vector<int> expected;
+        ExtendedCompoundImage* eci = buildGrid ( 12, 20, expected );
+        CPPUNIT_ASSERT ( eci != NULL );
+
+        int width = eci->getWidth();
+        uint8_t* block8 = new uint8_t[width * eci->getHeight()];
+        float* blockF = new float[width * eci->getHeight()];
+
+        for ( int b = 0; b < 50; b++ ) {
+            int x = rand() % width;
+            int y = rand() % eci->getHeight();
+            int w = 1 + rand() % ( width - x );
+            int h = 1 + rand() % ( eci->getHeight() - y );
+
+            CPPUNIT_ASSERT_EQUAL ( w * h, eci->getBlock ( block8, x, y, w, h ) );
+            CPPUNIT_ASSERT ( eci->getBlock ( blockF, x, y, w, h ) != 0 );
+            for ( int l = 0; l < h; l++ ) {
+                for ( int c = 0; c < w; c++ ) {
+                    CPPUNIT_ASSERT_EQUAL ( expected[ ( y + l ) * width + x + c], ( int ) block8[l * w + c] );
+                    CPPUNIT_ASSERT_DOUBLES_EQUAL ( expected[ ( y + l ) * width + x + c], blockF[l * w + c], 1e-6 );
+                }
+            }
+        }
+
+        // Bloc hors de l'image
+        CPPUNIT_ASSERT_EQUAL ( 0, eci->getBlock ( block8, width - 10, 0, 20, 10 ) );
+
+        delete [] block8;
+        delete [] blockF;
+        delete eci;
+    }
+
+    void testMerge() {
+        int bottom[3] = {10, 20, 30};
+        int top[3] = {40, 50, 60};
+        int bg[3] = {0, 0, 0};
+        std::vector<Image*> images;
+        images.push_back ( new EmptyImage ( 300, 200, 3, bottom ) );
+        images.push_back ( new EmptyImage ( 300, 200, 3, top ) );
+
+        MergeImageFactory MIF;
+        MergeImage* mi = MIF.createMergeImage ( images, 3, bg, NULL, Merge::NORMAL );
+        CPPUNIT_ASSERT ( mi != NULL );
+
+        uint8_t line8[300 * 3];
+        float lineF[300 * 3];
+        for ( int l = 0; l < 200; l++ ) {
+            mi->getline ( line8, l );
+            mi->getline ( lineF, l );
+            for ( int i = 0; i < 300 * 3; i++ ) {
+                CPPUNIT_ASSERT_EQUAL ( top[i % 3], ( int ) line8[i] );
+                CPPUNIT_ASSERT_DOUBLES_EQUAL ( top[i % 3], lineF[i], 1e-4 );
+            }
+        }
+
+        delete mi;
+    }
+
+    void performance() {
+        std::vector<int> expected;
+        ExtendedCompoundImage* eci = buildGrid ( 40, 60, expected );
+
+        uint8_t line[eci->getWidth()];
+        timeval BEGIN, NOW;
+        gettimeofday ( &BEGIN, NULL );
+        for ( int l = 0; l < eci->getHeight(); l++ ) eci->getline ( line, l );
+        gettimeofday ( &NOW, NULL );
+        double time = NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000.;
+        cerr << time << "s : lecture de " << eci->getHeight() << " lignes d'une image composée de " << eci->getImages()->size() << " images" << endl;
+
+        delete eci;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitExtendedCompoundImage );
@@ -87,6 +87,8 @@ void CppUnitFormat::formatFromString() {
     CPPUNIT_ASSERT_MESSAGE ( "TIFF_LZW_FLOAT32", Rok4Format::fromString ( "TIFF_LZW_FLOAT32" ) == Rok4Format::TIFF_LZW_FLOAT32 );
     CPPUNIT_ASSERT_MESSAGE ( "TIFF_ZIP_FLOAT32", Rok4Format::fromString ( "TIFF_ZIP_FLOAT32" ) == Rok4Format::TIFF_ZIP_FLOAT32 );
     CPPUNIT_ASSERT_MESSAGE ( "TIFF_ZIP_INT8", Rok4Format::fromString ( "TIFF_ZIP_INT8" ) == Rok4Format::TIFF_ZIP_INT8 );
+    CPPUNIT_ASSERT_MESSAGE ( "TIFF_PBF_MVT", Rok4Format::fromString ( "TIFF_PBF_MVT" ) == Rok4Format::TIFF_PBF_MVT );
+    CPPUNIT_ASSERT_MESSAGE ( "TIFF_PBF_GZIP_MVT", Rok4Format::fromString ( "TIFF_PBF_GZIP_MVT" ) == Rok4Format::TIFF_PBF_GZIP_MVT );
     CPPUNIT_ASSERT_MESSAGE ( "Wrong Value", Rok4Format::fromString ( "Wrong" ) == Rok4Format::UNKNOWN );
 }
 
@@ -109,4 +111,7 @@ void CppUnitFormat::formatToMime() {
     CPPUNIT_ASSERT_MESSAGE ( "TIFF_LZW_FLOAT32", Rok4Format::toMimeType ( tlf32 ).compare ( "image/tiff" ) == 0 );
     CPPUNIT_ASSERT_MESSAGE ( "TIFF_ZIP_INT8", Rok4Format::toMimeType ( tzi8 ).compare ( "image/tiff" ) == 0 );
     CPPUNIT_ASSERT_MESSAGE ( "TIFF_ZIP_FLOAT32", Rok4Format::toMimeType ( tzf32 ).compare ( "image/x-bil;bits=32" ) == 0 );
+    CPPUNIT_ASSERT_MESSAGE ( "TIFF_PBF_GZIP_MVT", Rok4Format::toMimeType ( Rok4Format::TIFF_PBF_GZIP_MVT ).compare ( "application/x-protobuf" ) == 0 );
+    CPPUNIT_ASSERT_MESSAGE ( "TIFF_PBF_GZIP_MVT encoding", Rok4Format::toEncoding ( Rok4Format::TIFF_PBF_GZIP_MVT ).compare ( "gzip" ) == 0 );
+    CPPUNIT_ASSERT_MESSAGE ( "TIFF_PBF_GZIP_MVT is vector", ! Rok4Format::isRaster ( Rok4Format::TIFF_PBF_GZIP_MVT ) );
 }
@@ -0,0 +1,173 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "MappedFilePool.h"
+
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+#include <pthread.h>
+#include <iostream>
+using namespace std;
+
+/* Écrit un fichier de size octets, de valeurs value + (position modulo 7) */
+static void writeFile ( string path, int size, uint8_t value ) {
+    ofstream out ( path.c_str(), ios_base::trunc | ios::binary );
+    for ( int i = 0; i < size; i++ ) out.put ( ( char ) ( value + i % 7 ) );
+    out.close();
+}
+
+/* Lectures concurrentes : chaque thread lit alternativement les trois fichiers et vérifie leur contenu */
+struct ConcurrentReads {
+    string paths[3];
+    int sizes[3];
+    int values[3];
+    int errors;
+};
+
+static void* concurrentReads ( void* arg ) {
+    ConcurrentReads* job = ( ConcurrentReads* ) arg;
+    uint8_t data[50];
+    for ( int i = 0; i < 2000; i++ ) {
+        int f = i % 3;
+        int offset = ( i * 37 ) % ( job->sizes[f] - 50 );
+        if ( MappedFilePool::read ( data, offset, 50, job->paths[f] ) != 50 ||
+             data[0] != ( uint8_t ) ( job->values[f] + offset % 7 ) ) {
+            __sync_fetch_and_add ( &job->errors, 1 );
+        }
+    }
+    return NULL;
+}
+
+class CppUnitMappedFilePool : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitMappedFilePool );
+
+    CPPUNIT_TEST ( test_read );
+    CPPUNIT_TEST ( test_eviction );
+    CPPUNIT_TEST ( test_replace );
+    CPPUNIT_TEST ( test_concurrent );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    string pathA;
+    string pathB;
+    string pathC;
+
+public:
+    void setUp() {
+        char buf[64];
+        sprintf ( buf, "/tmp/CppUnitMappedFilePool_%d_", getpid() );
+        pathA = string ( buf ) + "A";
+        pathB = string ( buf ) + "B";
+        pathC = string ( buf ) + "C";
+        writeFile ( pathA, 10000, 10 );
+        writeFile ( pathB, 5000, 20 );
+        writeFile ( pathC, 100, 30 );
+        MappedFilePool::setMaxFiles ( 2 );
+    }
+
+    void tearDown() {
+        MappedFilePool::setMaxFiles ( 0 );
+        remove ( pathA.c_str() );
+        remove ( pathB.c_str() );
+        remove ( pathC.c_str() );
+    }
+
+protected:
+
+    void test_read() {
+        uint8_t data[100];
+        CPPUNIT_ASSERT_EQUAL ( 100, MappedFilePool::read ( data, 9900, 100, pathA ) );
+        for ( int i = 0; i < 100; i++ ) CPPUNIT_ASSERT_EQUAL ( ( int ) ( 10 + ( 9900 + i ) % 7 ), ( int ) data[i] );
+        // Lecture hors du fichier et fichier absent
+        CPPUNIT_ASSERT_EQUAL ( -1, MappedFilePool::read ( data, 9950, 100, pathA ) );
+        CPPUNIT_ASSERT_EQUAL ( -1, MappedFilePool::read ( data, 0, 10, pathA + "_absent" ) );
+        CPPUNIT_ASSERT_EQUAL ( 1, MappedFilePool::getNbFiles() );
+    }
+
+    void test_eviction() {
+        uint8_t data[10];
+        MappedFilePool::read ( data, 0, 10, pathA );
+        MappedFilePool::read ( data, 0, 10, pathB );
+        MappedFilePool::read ( data, 0, 10, pathA );
+        MappedFilePool::read ( data, 0, 10, pathC );
+        CPPUNIT_ASSERT_EQUAL ( 2, MappedFilePool::getNbFiles() );
+        // B, le moins récemment utilisé, a été libéré mais reste lisible
+        CPPUNIT_ASSERT_EQUAL ( 10, MappedFilePool::read ( data, 4990, 10, pathB ) );
+        CPPUNIT_ASSERT_EQUAL ( ( int ) ( 20 + 4990 % 7 ), ( int ) data[0] );
+        CPPUNIT_ASSERT_EQUAL ( 2, MappedFilePool::getNbFiles() );
+        // Désactivation : tout est libéré
+        MappedFilePool::setMaxFiles ( 0 );
+        CPPUNIT_ASSERT_EQUAL ( 0, MappedFilePool::getNbFiles() );
+        CPPUNIT_ASSERT_EQUAL ( -1, MappedFilePool::read ( data, 0, 10, pathA ) );
+    }
+
+    void test_replace() {
+        uint8_t data[10];
+        CPPUNIT_ASSERT_EQUAL ( 10, MappedFilePool::read ( data, 0, 10, pathA ) );
+        CPPUNIT_ASSERT_EQUAL ( 10, ( int ) data[0] );
+
+        // Remplacement de la dalle par renommage, puis invalidation explicite
+        writeFile ( pathA + "_new", 50, 40 );
+        rename ( ( pathA + "_new" ).c_str(), pathA.c_str() );
+        MappedFilePool::invalidate ( pathA );
+        CPPUNIT_ASSERT_EQUAL ( 0, MappedFilePool::getNbFiles() );
+
+        CPPUNIT_ASSERT_EQUAL ( 10, MappedFilePool::read ( data, 0, 10, pathA ) );
+        CPPUNIT_ASSERT_EQUAL ( 40, ( int ) data[0] );
+        CPPUNIT_ASSERT_EQUAL ( -1, MappedFilePool::read ( data, 9000, 10, pathA ) );
+    }
+
+    void test_concurrent() {
+        // Trois fichiers pour deux projections : les évictions et reprojections se font pendant les lectures
+        ConcurrentReads job;
+        job.paths[0] = pathA; job.sizes[0] = 10000; job.values[0] = 10;
+        job.paths[1] = pathB; job.sizes[1] = 5000; job.values[1] = 20;
+        job.paths[2] = pathC; job.sizes[2] = 100; job.values[2] = 30;
+        job.errors = 0;
+
+        pthread_t threads[8];
+        for ( int t = 0; t < 8; t++ ) pthread_create ( & ( threads[t] ), NULL, concurrentReads, &job );
+        for ( int t = 0; t < 8; t++ ) pthread_join ( threads[t], NULL );
+
+        CPPUNIT_ASSERT_EQUAL ( 0, job.errors );
+        CPPUNIT_ASSERT ( MappedFilePool::getNbFiles() <= 2 );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitMappedFilePool );
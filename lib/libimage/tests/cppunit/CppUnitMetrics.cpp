@@ -0,0 +1,99 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "Metrics.h"
+
+#include <pthread.h>
+using namespace std;
+
+static void* countMany ( void* arg ) {
+    MetricCounter* counter = ( MetricCounter* ) arg;
+    for ( int i = 0; i < 100000; i++ ) counter->add();
+    return NULL;
+}
+
+class CppUnitMetrics : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitMetrics );
+
+    CPPUNIT_TEST ( test_registry );
+    CPPUNIT_TEST ( test_concurrency );
+    CPPUNIT_TEST ( test_export );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() {};
+
+protected:
+
+    void test_registry() {
+        MetricCounter* c1 = Metrics::getCounter ( "test_registry_total", "Test", Metrics::label ( "storage", "FILE" ) );
+        MetricCounter* c2 = Metrics::getCounter ( "test_registry_total", "Test", Metrics::label ( "storage", "FILE" ) );
+        MetricCounter* c3 = Metrics::getCounter ( "test_registry_total", "Test", Metrics::label ( "storage", "S3" ) );
+        CPPUNIT_ASSERT ( c1 == c2 );
+        CPPUNIT_ASSERT ( c1 != c3 );
+        CPPUNIT_ASSERT_EQUAL ( string ( "layer=\"a\\\"b\"" ), Metrics::label ( "layer", "a\"b" ) );
+    }
+
+    void test_concurrency() {
+        MetricCounter* counter = Metrics::getCounter ( "test_concurrency_total", "Test" );
+        pthread_t threads[4];
+        for ( int i = 0; i < 4; i++ ) pthread_create ( &threads[i], NULL, countMany, counter );
+        for ( int i = 0; i < 4; i++ ) pthread_join ( threads[i], NULL );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 400000, counter->get() );
+    }
+
+    void test_export() {
+        MetricHistogram* h = Metrics::getHistogram ( "test_export_seconds", "Durée de test", Metrics::label ( "format", "png" ) );
+        h->observe ( 0.0002 );
+        h->observe ( 0.003 );
+        h->observe ( 20 );
+        Metrics::getGauge ( "test_export_gauge", "Jauge de test" )->set ( -3 );
+
+        string out = Metrics::toPrometheus();
+        CPPUNIT_ASSERT ( out.find ( "# TYPE test_export_seconds histogram\n" ) != string::npos );
+        CPPUNIT_ASSERT ( out.find ( "test_export_seconds_bucket{format=\"png\",le=\"0.0005\"} 1\n" ) != string::npos );
+        CPPUNIT_ASSERT ( out.find ( "test_export_seconds_bucket{format=\"png\",le=\"0.005\"} 2\n" ) != string::npos );
+        CPPUNIT_ASSERT ( out.find ( "test_export_seconds_bucket{format=\"png\",le=\"10\"} 2\n" ) != string::npos );
+        CPPUNIT_ASSERT ( out.find ( "test_export_seconds_bucket{format=\"png\",le=\"+Inf\"} 3\n" ) != string::npos );
+        CPPUNIT_ASSERT ( out.find ( "test_export_seconds_count{format=\"png\"} 3\n" ) != string::npos );
+        CPPUNIT_ASSERT ( out.find ( "test_export_seconds_sum{format=\"png\"} 20.003200\n" ) != string::npos );
+        CPPUNIT_ASSERT ( out.find ( "# TYPE test_export_gauge gauge\ntest_export_gauge -3\n" ) != string::npos );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitMetrics );
@@ -0,0 +1,137 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "PartedBuffer.h"
+
+#include <vector>
+using namespace std;
+
+class CppUnitPartedBuffer : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitPartedBuffer );
+
+    CPPUNIT_TEST ( test_single );
+    CPPUNIT_TEST ( test_stream );
+    CPPUNIT_TEST ( test_reset );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    /* Écrit size octets de valeur value à la position offset */
+    bool writeBytes ( PartedBuffer& buffer, int64_t offset, int size, uint8_t value ) {
+        vector<uint8_t> data ( size, value );
+        return buffer.write ( & ( data[0] ), offset, size );
+    }
+
+    void test_single() {
+        PartedBuffer buffer ( 100 );
+        CPPUNIT_ASSERT ( writeBytes ( buffer, 10, 50, 1 ) );
+        CPPUNIT_ASSERT ( writeBytes ( buffer, 0, 5, 2 ) );
+        CPPUNIT_ASSERT_EQUAL ( 1, buffer.getPartsNumber() );
+        CPPUNIT_ASSERT_EQUAL ( -1, buffer.getCompletePart() );
+
+        vector<char>* part = buffer.takePart ( 0 );
+        CPPUNIT_ASSERT ( part != NULL );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 60, part->size() );
+        CPPUNIT_ASSERT_EQUAL ( 2, ( int ) ( *part ) [4] );
+        CPPUNIT_ASSERT_EQUAL ( 0, ( int ) ( *part ) [7] );
+        CPPUNIT_ASSERT_EQUAL ( 1, ( int ) ( *part ) [59] );
+        delete part;
+
+        // La première partie ne peut être ni réécrite, ni retirée deux fois
+        CPPUNIT_ASSERT ( ! writeBytes ( buffer, 0, 5, 2 ) );
+        CPPUNIT_ASSERT ( buffer.takePart ( 0 ) == NULL );
+    }
+
+    void test_stream() {
+        PartedBuffer buffer ( 100 );
+        CPPUNIT_ASSERT ( writeBytes ( buffer, 0, 20, 1 ) );
+        CPPUNIT_ASSERT ( writeBytes ( buffer, 120, 100, 3 ) );
+        // Écriture à cheval sur les parties 2 et 3 : les parties 1 et 2 sont complètes
+        CPPUNIT_ASSERT ( writeBytes ( buffer, 250, 100, 4 ) );
+        CPPUNIT_ASSERT_EQUAL ( ( int64_t ) 350, buffer.getLength() );
+        CPPUNIT_ASSERT_EQUAL ( 4, buffer.getPartsNumber() );
+
+        CPPUNIT_ASSERT_EQUAL ( 1, buffer.getCompletePart() );
+        vector<char>* part = buffer.takePart ( 1 );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 100, part->size() );
+        CPPUNIT_ASSERT_EQUAL ( 0, ( int ) ( *part ) [0] );
+        CPPUNIT_ASSERT_EQUAL ( 3, ( int ) ( *part ) [99] );
+        delete part;
+
+        CPPUNIT_ASSERT_EQUAL ( 2, buffer.getCompletePart() );
+        part = buffer.takePart ( 2 );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 100, part->size() );
+        CPPUNIT_ASSERT_EQUAL ( 3, ( int ) ( *part ) [19] );
+        CPPUNIT_ASSERT_EQUAL ( 0, ( int ) ( *part ) [20] );
+        CPPUNIT_ASSERT_EQUAL ( 4, ( int ) ( *part ) [50] );
+        delete part;
+
+        // La dernière partie n'est jamais complète
+        CPPUNIT_ASSERT_EQUAL ( -1, buffer.getCompletePart() );
+        CPPUNIT_ASSERT ( buffer.isStreamed() );
+
+        // Une partie envoyée n'est plus modifiable, la première partie l'est toujours
+        CPPUNIT_ASSERT ( ! writeBytes ( buffer, 150, 10, 5 ) );
+        CPPUNIT_ASSERT ( writeBytes ( buffer, 90, 10, 6 ) );
+
+        part = buffer.takePart ( 0 );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 100, part->size() );
+        CPPUNIT_ASSERT_EQUAL ( 6, ( int ) ( *part ) [95] );
+        delete part;
+
+        CPPUNIT_ASSERT_EQUAL ( 3, buffer.getNextPart() );
+        part = buffer.takePart ( 3 );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 50, part->size() );
+        CPPUNIT_ASSERT_EQUAL ( 4, ( int ) ( *part ) [49] );
+        delete part;
+    }
+
+    void test_reset() {
+        PartedBuffer buffer ( 100 );
+        CPPUNIT_ASSERT ( writeBytes ( buffer, 0, 150, 1 ) );
+        CPPUNIT_ASSERT ( buffer.reset() );
+        CPPUNIT_ASSERT_EQUAL ( ( int64_t ) 0, buffer.getLength() );
+        CPPUNIT_ASSERT_EQUAL ( 0, buffer.getPartsNumber() );
+
+        CPPUNIT_ASSERT ( writeBytes ( buffer, 0, 250, 1 ) );
+        delete buffer.takePart ( buffer.getCompletePart() );
+        CPPUNIT_ASSERT ( ! buffer.reset() );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitPartedBuffer );
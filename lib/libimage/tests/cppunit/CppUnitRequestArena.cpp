@@ -0,0 +1,175 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "RequestArena.h"
+#include "EmptyImage.h"
+#include "ConvertedChannelsImage.h"
+#include "MirrorImage.h"
+
+#include <sys/time.h>
+#include <iostream>
+using namespace std;
+
+class CppUnitRequestArena : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitRequestArena );
+
+    CPPUNIT_TEST ( test_inactive );
+    CPPUNIT_TEST ( test_lifo );
+    CPPUNIT_TEST ( test_reset );
+    CPPUNIT_TEST ( test_pipeline );
+    CPPUNIT_TEST ( performance );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() {};
+
+    void tearDown() {
+        RequestArena::end();
+    }
+
+protected:
+
+    void test_inactive() {
+        RequestArena* arena = RequestArena::getThreadArena();
+        CPPUNIT_ASSERT ( ! arena->isActive() );
+        CPPUNIT_ASSERT ( arena->allocate ( 100 ) == NULL );
+        // Hors requête, le tampon est pris dans le tas
+        ArenaBuffer<float> buf ( 100 );
+        CPPUNIT_ASSERT ( buf.get() != NULL );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 0, arena->getAllocations() );
+    }
+
+    void test_lifo() {
+        RequestArena::begin();
+        RequestArena* arena = RequestArena::getThreadArena();
+        float* first;
+        {
+            ArenaBuffer<float> a ( 1000 );
+            first = a.get();
+            {
+                ArenaBuffer<uint8_t> b ( 10 );
+                CPPUNIT_ASSERT ( ( uint8_t* ) b.get() >= ( uint8_t* ) ( a.get() + 1000 ) );
+            }
+        }
+        // Les tampons rendus dans l'ordre inverse libèrent leur place
+        ArenaBuffer<float> c ( 1000 );
+        CPPUNIT_ASSERT ( c.get() == first );
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 3, arena->getAllocations() );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 4016, arena->getPeak() );
+    }
+
+    void test_reset() {
+        RequestArena::begin();
+        RequestArena* arena = RequestArena::getThreadArena();
+        // Allocations conservées jusqu'à la fin de la requête, sur plusieurs blocs
+        for ( int i = 0; i < 12; i++ ) CPPUNIT_ASSERT ( arena->allocate ( 500000 ) != NULL );
+        CPPUNIT_ASSERT ( arena->getCapacity() >= ( size_t ) 6000000 );
+        RequestArena::end();
+        CPPUNIT_ASSERT ( ! arena->isActive() );
+        // Seuls les premiers blocs sont conservés
+        CPPUNIT_ASSERT ( arena->getCapacity() <= ( size_t ) 4 * 1048576 );
+    }
+
+    void test_pipeline() {
+        int color[1] = {42};
+        Image* img = new ConvertedChannelsImage ( 3, new EmptyImage ( 100, 10, 1, color ) );
+        uint8_t line[300];
+        uint8_t block[30];
+
+        RequestArena::begin();
+        RequestArena* arena = RequestArena::getThreadArena();
+        for ( int l = 0; l < 10; l++ ) {
+            CPPUNIT_ASSERT_EQUAL ( 300, img->getline ( line, l ) );
+            CPPUNIT_ASSERT_EQUAL ( 42, ( int ) line[299] );
+        }
+        CPPUNIT_ASSERT_EQUAL ( 30, img->getBlock ( block, 10, 2, 5, 2 ) );
+        CPPUNIT_ASSERT_EQUAL ( 42, ( int ) block[29] );
+        // Une ligne temporaire par getline, une pour le bloc et une par ligne du bloc : toujours la même place
+        CPPUNIT_ASSERT_EQUAL ( ( uint64_t ) 13, arena->getAllocations() );
+        CPPUNIT_ASSERT ( arena->getPeak() <= ( size_t ) ( 100 * 3 * 4 + 100 + 32 ) );
+        RequestArena::end();
+
+        delete img;
+    }
+
+    /* Lecture complète d'une image, nbRequests fois, avec ou sans arène */
+    double readImage ( Image* img, int nbRequests, bool useArena, uint64_t& allocations ) {
+        uint8_t line[img->getWidth() * img->getChannels()];
+        allocations = 0;
+        timeval BEGIN, NOW;
+        gettimeofday ( &BEGIN, NULL );
+        for ( int r = 0; r < nbRequests; r++ ) {
+            if ( useArena ) RequestArena::begin();
+            for ( int l = 0; l < img->getHeight(); l++ ) img->getline ( line, l );
+            if ( useArena ) {
+                allocations += RequestArena::getThreadArena()->getAllocations();
+                RequestArena::end();
+            }
+        }
+        gettimeofday ( &NOW, NULL );
+        return ( NOW.tv_sec - BEGIN.tv_sec + ( NOW.tv_usec - BEGIN.tv_usec ) /1000000. ) / nbRequests;
+    }
+
+    void performance() {
+        int color[3] = {10, 20, 30};
+
+        // GetTile : tuile 256x256 en niveaux de gris convertie en RGB
+        Image* tile = new ConvertedChannelsImage ( 3, new EmptyImage ( 256, 256, 1, color ) );
+        // GetMap : image 1024x768 RGB complétée par miroir
+        EmptyImage* src = new EmptyImage ( 1024, 768, 3, color );
+        src->setBbox ( BoundingBox<double> ( 0, 0, 1024, 768 ) );
+        MirrorImageFactory MIF;
+        Image* map = MIF.createMirrorImage ( src, 1, 3 );
+
+        Image* images[2] = { tile, map };
+        const char* names[2] = { "GetTile", "GetMap" };
+        for ( int i = 0; i < 2; i++ ) {
+            uint64_t allocations;
+            double heapTime = readImage ( images[i], 200, false, allocations );
+            double arenaTime = readImage ( images[i], 200, true, allocations );
+            cerr << names[i] << " : " << allocations / 200 << " allocations par requête, "
+                 << heapTime * 1000000 << " µs avec le tas, " << arenaTime * 1000000 << " µs avec l'arène" << endl;
+        }
+
+        delete tile;
+        delete map;
+        delete src;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitRequestArena );
@@ -0,0 +1,177 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "RequestTileSet.h"
+
+#include <pthread.h>
+
+/**
+ * Source comptant ses lectures et signalant sa destruction
+ */
+class CountedDataSource : public DataSource {
+private:
+    uint8_t data[16];
+public:
+    int reads;
+    bool* deleted;
+
+    CountedDataSource ( bool* deleted ) : reads ( 0 ), deleted ( deleted ) {
+        for ( int i = 0; i < 16; i++ ) data[i] = i;
+        *deleted = false;
+    }
+    ~CountedDataSource() {
+        *deleted = true;
+    }
+
+    const uint8_t* getData ( size_t &size ) {
+        __atomic_add_fetch ( &reads, 1, __ATOMIC_RELAXED );
+        size = 16;
+        return data;
+    }
+    bool releaseData() {
+        return true;
+    }
+    std::string getType() {
+        return "image/bil";
+    }
+    int getHttpStatus() {
+        return 200;
+    }
+    std::string getEncoding() {
+        return "";
+    }
+    unsigned int getLength() {
+        return 16;
+    }
+};
+
+class CppUnitRequestTileSet : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitRequestTileSet );
+
+    CPPUNIT_TEST ( test_inactive );
+    CPPUNIT_TEST ( test_shared );
+    CPPUNIT_TEST ( test_missing );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() {};
+
+    void tearDown() {
+        RequestTileSet::end();
+    }
+
+protected:
+
+    static void* readSource ( void* arg ) {
+        DataSource* source = ( DataSource* ) arg;
+        size_t size;
+        const uint8_t* data = source->getData ( size );
+        return ( size == 16 ) ? ( void* ) data : NULL;
+    }
+
+    void test_inactive() {
+        bool deleted;
+        DataSource* source = new CountedDataSource ( &deleted );
+        DataSource* found;
+
+        CPPUNIT_ASSERT ( ! RequestTileSet::isActive() );
+        CPPUNIT_ASSERT ( RequestTileSet::add ( "tile", source ) == source );
+        CPPUNIT_ASSERT ( ! RequestTileSet::get ( "tile", found ) );
+        CPPUNIT_ASSERT ( found == NULL );
+        delete source;
+    }
+
+    void test_shared() {
+        bool deleted;
+        CountedDataSource* source = new CountedDataSource ( &deleted );
+        DataSource* first;
+        DataSource* other;
+
+        RequestTileSet::begin();
+        CPPUNIT_ASSERT ( ! RequestTileSet::get ( "tile", first ) );
+        first = RequestTileSet::add ( "tile", source );
+        CPPUNIT_ASSERT ( first != NULL && first != source );
+
+        // Les chaînes suivantes reçoivent la même tuile
+        DataSource* chains[4];
+        for ( int i = 0; i < 4; i++ ) {
+            CPPUNIT_ASSERT ( RequestTileSet::get ( "tile", chains[i] ) );
+            CPPUNIT_ASSERT ( chains[i] != NULL );
+        }
+        CPPUNIT_ASSERT ( ! RequestTileSet::get ( "other", other ) );
+        RequestTileSet::end();
+
+        // Les références restent valides après la fin de l'enregistrement et sont lues en parallèle
+        pthread_t T[4];
+        for ( int i = 0; i < 4; i++ ) pthread_create ( &T[i], NULL, readSource, ( void* ) chains[i] );
+        void* data[4];
+        for ( int i = 0; i < 4; i++ ) pthread_join ( T[i], &data[i] );
+
+        size_t size;
+        const uint8_t* firstData = first->getData ( size );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 16, size );
+        for ( int i = 0; i < 4; i++ ) CPPUNIT_ASSERT ( data[i] == ( void* ) firstData );
+        CPPUNIT_ASSERT_EQUAL ( 1, source->reads );
+        CPPUNIT_ASSERT_EQUAL ( 16U, first->getLength() );
+
+        // La source n'est détruite qu'avec la dernière référence
+        first->releaseData();
+        delete first;
+        for ( int i = 0; i < 3; i++ ) delete chains[i];
+        CPPUNIT_ASSERT ( ! deleted );
+        delete chains[3];
+        CPPUNIT_ASSERT ( deleted );
+    }
+
+    void test_missing() {
+        DataSource* found;
+
+        RequestTileSet::begin();
+        CPPUNIT_ASSERT ( RequestTileSet::add ( "missing", NULL ) == NULL );
+        // La tuile absente n'est pas relue par les chaînes suivantes
+        CPPUNIT_ASSERT ( RequestTileSet::get ( "missing", found ) );
+        CPPUNIT_ASSERT ( found == NULL );
+        RequestTileSet::end();
+
+        // Un nouvel enregistrement repart d'un ensemble vide
+        RequestTileSet::begin();
+        CPPUNIT_ASSERT ( ! RequestTileSet::get ( "missing", found ) );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitRequestTileSet );
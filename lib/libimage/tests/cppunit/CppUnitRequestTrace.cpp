@@ -0,0 +1,134 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "RequestTrace.h"
+#include "Metrics.h"
+
+#include <unistd.h>
+#include <string>
+
+class CppUnitRequestTrace : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitRequestTrace );
+
+    CPPUNIT_TEST ( test_inactive );
+    CPPUNIT_TEST ( test_nested );
+    CPPUNIT_TEST ( test_server_timing );
+    CPPUNIT_TEST ( test_valid_id );
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    void setUp() {};
+
+    void tearDown() {
+        RequestTrace::end();
+    }
+
+protected:
+
+    static void wait ( double seconds ) {
+        double start = Metrics::now();
+        while ( Metrics::now() - start < seconds ) usleep ( 100 );
+    }
+
+    void test_inactive() {
+        RequestTrace::begin ( "untracked", false, false );
+        {
+            TraceScope scope ( TraceStage::READ );
+        }
+        RequestTrace* trace = RequestTrace::getThreadTrace();
+        CPPUNIT_ASSERT ( ! trace->isActive() );
+        CPPUNIT_ASSERT_EQUAL ( 0u, trace->getCount ( TraceStage::READ ) );
+        // L'identifiant est conservé même sans suivi
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "untracked" ), RequestTrace::getId() );
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "" ), RequestTrace::getServerTiming() );
+
+        RequestTrace::end();
+        CPPUNIT_ASSERT_EQUAL ( std::string ( "" ), RequestTrace::getId() );
+    }
+
+    void test_nested() {
+        RequestTrace::begin ( RequestTrace::newId(), true, false );
+        {
+            TraceScope encode ( TraceStage::ENCODE );
+            wait ( 0.01 );
+            for ( int i = 0; i < 2; i++ ) {
+                TraceScope read ( TraceStage::READ );
+                wait ( 0.02 );
+            }
+        }
+        RequestTrace* trace = RequestTrace::getThreadTrace();
+        CPPUNIT_ASSERT_EQUAL ( 1u, trace->getCount ( TraceStage::ENCODE ) );
+        CPPUNIT_ASSERT_EQUAL ( 2u, trace->getCount ( TraceStage::READ ) );
+        // Le temps des lectures imbriquées n'est pas compté dans l'encodage
+        CPPUNIT_ASSERT ( trace->getDuration ( TraceStage::READ ) >= 0.04 );
+        CPPUNIT_ASSERT ( trace->getDuration ( TraceStage::ENCODE ) >= 0.01 );
+        CPPUNIT_ASSERT ( trace->getDuration ( TraceStage::ENCODE ) < 0.04 );
+    }
+
+    void test_server_timing() {
+        std::string id = RequestTrace::newId();
+        CPPUNIT_ASSERT ( id != RequestTrace::newId() );
+
+        RequestTrace::begin ( id, true, false );
+        RequestTrace::add ( TraceStage::PARSE, 0.0015 );
+        {
+            TraceScope level ( TraceStage::LEVEL );
+        }
+        std::string timing = RequestTrace::getServerTiming();
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 0, timing.find ( "parse;dur=1.500;desc=\"1\", level;dur=" ) );
+        CPPUNIT_ASSERT ( timing.find ( "read" ) == std::string::npos );
+        CPPUNIT_ASSERT ( timing.find ( "total;dur=" ) != std::string::npos );
+        CPPUNIT_ASSERT ( timing.find ( "request;desc=\"" + id + "\"" ) != std::string::npos );
+    }
+
+    void test_valid_id() {
+        CPPUNIT_ASSERT ( RequestTrace::isValidId ( "abc-DEF_012.3" ) );
+        CPPUNIT_ASSERT ( RequestTrace::isValidId ( std::string ( REQUEST_ID_MAX_LENGTH, 'a' ).c_str() ) );
+
+        CPPUNIT_ASSERT ( ! RequestTrace::isValidId ( NULL ) );
+        CPPUNIT_ASSERT ( ! RequestTrace::isValidId ( "" ) );
+        CPPUNIT_ASSERT ( ! RequestTrace::isValidId ( std::string ( REQUEST_ID_MAX_LENGTH + 1, 'a' ).c_str() ) );
+        // Injection dans les logs ou les en-têtes HTTP
+        CPPUNIT_ASSERT ( ! RequestTrace::isValidId ( "abc\nTrace forged" ) );
+        CPPUNIT_ASSERT ( ! RequestTrace::isValidId ( "abc\r\nSet-Cookie: x" ) );
+        CPPUNIT_ASSERT ( ! RequestTrace::isValidId ( "abc\"def" ) );
+        CPPUNIT_ASSERT ( ! RequestTrace::isValidId ( "abc def" ) );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitRequestTrace );
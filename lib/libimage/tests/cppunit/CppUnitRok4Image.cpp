@@ -0,0 +1,237 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "Rok4Image.h"
+#include "FileContext.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+#define TEST_TILE_SIZE 1024
+
+class CppUnitRok4Image : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitRok4Image );
+
+    CPPUNIT_TEST ( test_dedup_vector );
+    CPPUNIT_TEST ( test_dedup_memory );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    string dir;
+
+    /* Lecture de l'index (offsets puis tailles) d'une dalle ROK4 */
+    void readIndex ( string path, int tilesNumber, vector<uint32_t>& offsets, vector<uint32_t>& sizes ) {
+        offsets.resize ( tilesNumber );
+        sizes.resize ( tilesNumber );
+        ifstream in ( path.c_str(), ios::binary );
+        in.seekg ( ROK4_IMAGE_HEADER_SIZE );
+        in.read ( ( char* ) &offsets[0], 4 * tilesNumber );
+        in.read ( ( char* ) &sizes[0], 4 * tilesNumber );
+        CPPUNIT_ASSERT ( in.good() );
+    }
+
+    /* Lecture des octets d'une tuile de la dalle */
+    string readTile ( string path, uint32_t offset, uint32_t size ) {
+        string data ( size, '\0' );
+        ifstream in ( path.c_str(), ios::binary );
+        in.seekg ( offset );
+        if ( size > 0 ) in.read ( &data[0], size );
+        CPPUNIT_ASSERT ( in.good() );
+        return data;
+    }
+
+    void writePbf ( int col, int row, string content ) {
+        char path[512];
+        sprintf ( path, "%s/%d", dir.c_str(), col );
+        mkdir ( path, 0755 );
+        sprintf ( path, "%s/%d/%d.pbf", dir.c_str(), col, row );
+        ofstream out ( path, ios_base::trunc | ios::binary );
+        out.write ( content.data(), content.size() );
+    }
+
+public:
+    void setUp() {
+        char buf[64];
+        sprintf ( buf, "/tmp/CppUnitRok4Image_%d", getpid() );
+        dir = string ( buf );
+        mkdir ( dir.c_str(), 0755 );
+    }
+
+    void tearDown() {
+        char path[512];
+        for ( int col = 0; col < 3; col++ ) {
+            for ( int row = 0; row < 2; row++ ) {
+                sprintf ( path, "%s/%d/%d.pbf", dir.c_str(), col, row );
+                remove ( path );
+            }
+            sprintf ( path, "%s/%d", dir.c_str(), col );
+            rmdir ( path );
+        }
+        remove ( ( dir + "/vector.tif" ).c_str() );
+        remove ( ( dir + "/raster.tif" ).c_str() );
+        rmdir ( dir.c_str() );
+    }
+
+protected:
+
+    void test_dedup_vector() {
+        // Tuiles répétées (A, B), distincte (C) et absente (0/1)
+        string a ( 3000, 'a' ), b ( 5000, 'b' ), c ( 4000, 'a' );
+        writePbf ( 0, 0, a );
+        writePbf ( 1, 0, b );
+        writePbf ( 2, 0, a );
+        writePbf ( 1, 1, b );
+        writePbf ( 2, 1, c );
+        string contents[6] = { a, b, a, "", b, c };
+
+        FileContext context ( dir + "/" );
+        context.connection();
+        Rok4ImageFactory factory;
+        Rok4Image* slab = factory.createRok4ImageToWrite ( "vector.tif", 3, 2, &context );
+        CPPUNIT_ASSERT ( slab );
+        CPPUNIT_ASSERT_EQUAL ( 0, slab->writePbfTiles ( 0, 0, ( char* ) dir.c_str() ) );
+        delete slab;
+
+        vector<uint32_t> offsets, sizes;
+        string path = dir + "/vector.tif";
+        readIndex ( path, 6, offsets, sizes );
+
+        // Les répétitions pointent sur les mêmes octets
+        CPPUNIT_ASSERT_EQUAL ( offsets[0], offsets[2] );
+        CPPUNIT_ASSERT_EQUAL ( offsets[1], offsets[4] );
+        CPPUNIT_ASSERT_EQUAL ( sizes[0], sizes[2] );
+        CPPUNIT_ASSERT_EQUAL ( sizes[1], sizes[4] );
+
+        // Les tuiles distinctes ont leurs propres octets, même à contenu proche
+        CPPUNIT_ASSERT ( offsets[0] != offsets[1] );
+        CPPUNIT_ASSERT ( offsets[0] != offsets[5] );
+        CPPUNIT_ASSERT ( offsets[1] != offsets[5] );
+
+        // La tuile absente a une taille nulle
+        CPPUNIT_ASSERT_EQUAL ( ( uint32_t ) 0, sizes[3] );
+
+        for ( int i = 0; i < 6; i++ ) {
+            CPPUNIT_ASSERT_EQUAL ( ( uint32_t ) contents[i].size(), sizes[i] );
+            CPPUNIT_ASSERT ( readTile ( path, offsets[i], sizes[i] ) == contents[i] );
+        }
+
+        // Seules les trois tuiles distinctes occupent la dalle
+        struct stat st;
+        stat ( path.c_str(), &st );
+        CPPUNIT_ASSERT ( st.st_size < ROK4_IMAGE_HEADER_SIZE + 8 * 6 + 3000 + 5000 + 4000 + 3 * 16 );
+    }
+
+    void test_dedup_memory() {
+        // 5x4 tuiles brutes de 1 Mo : les 16 premières, distinctes, remplissent la mémoire de déduplication
+        int tilesPerWidth = 5, tilesPerHeight = 4, tilesNumber = 20;
+        int width = tilesPerWidth * TEST_TILE_SIZE, height = tilesPerHeight * TEST_TILE_SIZE;
+        CPPUNIT_ASSERT_EQUAL ( ROK4_IMAGE_DEDUP_MEMORY, 16 * TEST_TILE_SIZE * TEST_TILE_SIZE );
+
+        // Valeur de chaque tuile : 16 = 0 (dédupliquée), 17 nouvelle, 18 = 17 (non retenue), 19 = 5 (dédupliquée)
+        uint8_t values[20];
+        for ( int i = 0; i < 16; i++ ) values[i] = i + 1;
+        values[16] = values[0];
+        values[17] = 100;
+        values[18] = values[17];
+        values[19] = values[5];
+
+        uint8_t* buffer = new uint8_t[width * height];
+        for ( int y = 0; y < height; y++ ) {
+            for ( int x = 0; x < width; x++ ) {
+                int tileInd = ( y / TEST_TILE_SIZE ) * tilesPerWidth + x / TEST_TILE_SIZE;
+                // Un pixel propre à la position dans la tuile, pour que la relecture vérifie l'ordre des octets
+                buffer[y * width + x] = values[tileInd] + ( ( x + y ) % TEST_TILE_SIZE == 0 ? 1 : 0 );
+            }
+        }
+
+        FileContext context ( dir + "/" );
+        context.connection();
+        Rok4ImageFactory factory;
+        BoundingBox<double> bbox ( 0, 0, width, height );
+        Rok4Image* slab = factory.createRok4ImageToWrite (
+            "raster.tif", bbox, 1, 1, width, height, 1, SampleFormat::UINT, 8, Photometric::GRAY,
+            Compression::NONE, TEST_TILE_SIZE, TEST_TILE_SIZE, &context
+        );
+        CPPUNIT_ASSERT ( slab );
+        CPPUNIT_ASSERT_EQUAL ( 0, slab->writeImage ( buffer ) );
+        delete slab;
+
+        vector<uint32_t> offsets, sizes;
+        string path = dir + "/raster.tif";
+        readIndex ( path, tilesNumber, offsets, sizes );
+
+        for ( int i = 0; i < tilesNumber; i++ ) {
+            CPPUNIT_ASSERT_EQUAL ( ( uint32_t ) ( TEST_TILE_SIZE * TEST_TILE_SIZE ), sizes[i] );
+        }
+        for ( int i = 0; i < 16; i++ ) {
+            for ( int j = 0; j < i; j++ ) CPPUNIT_ASSERT ( offsets[i] != offsets[j] );
+        }
+
+        // Tuiles retenues avant la limite : la répétition est dédupliquée, même après la limite
+        CPPUNIT_ASSERT_EQUAL ( offsets[0], offsets[16] );
+        CPPUNIT_ASSERT_EQUAL ( offsets[5], offsets[19] );
+
+        // Tuile écrite après la limite : elle n'est plus retenue, sa répétition est réécrite
+        CPPUNIT_ASSERT ( offsets[17] != offsets[18] );
+        for ( int i = 0; i < 16; i++ ) {
+            CPPUNIT_ASSERT ( offsets[17] != offsets[i] );
+            CPPUNIT_ASSERT ( offsets[18] != offsets[i] );
+        }
+        CPPUNIT_ASSERT ( readTile ( path, offsets[17], sizes[17] ) == readTile ( path, offsets[18], sizes[18] ) );
+
+        // Relecture identique à l'image écrite
+        Rok4Image* read = factory.createRok4ImageToRead ( "raster.tif", bbox, 1, 1, &context );
+        CPPUNIT_ASSERT ( read );
+        CPPUNIT_ASSERT_EQUAL ( width, read->getWidth() );
+        CPPUNIT_ASSERT_EQUAL ( height, read->getHeight() );
+        uint8_t* line = new uint8_t[width];
+        for ( int y = 0; y < height; y++ ) {
+            CPPUNIT_ASSERT_EQUAL ( width, read->getline ( line, y ) );
+            CPPUNIT_ASSERT ( memcmp ( line, buffer + y * width, width ) == 0 );
+        }
+        delete[] line;
+        delete read;
+        delete[] buffer;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitRok4Image );
@@ -0,0 +1,161 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "StripImage.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+/**
+ * Image dont les valeurs sont calculées à partir de la position du pixel, comptant les lignes lues
+ */
+class CountedImage : public Image {
+private:
+    template<typename T>
+    int _getline ( T* buffer, int line ) {
+        for ( int i = 0; i < width * channels; i++ ) {
+            buffer[i] = ( T ) ( ( i * 5 + line * 11 ) % 241 );
+        }
+        __atomic_add_fetch ( &calls, 1, __ATOMIC_RELAXED );
+        return width * channels;
+    }
+
+public:
+    int calls;
+
+    CountedImage ( int width, int height, int channels ) : Image ( width, height, channels ), calls ( 0 ) {}
+
+    int getline ( uint8_t* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+    int getline ( uint16_t* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+    int getline ( float* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+};
+
+class CppUnitStripImage : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitStripImage );
+
+    CPPUNIT_TEST ( test_incompatible );
+    CPPUNIT_TEST ( test_sequential );
+    CPPUNIT_TEST ( test_random );
+    CPPUNIT_TEST ( test_partial );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    ThreadPool* pool;
+    std::vector<CountedImage*> sources;
+
+    StripImage* create ( int chainCount, int width, int height ) {
+        std::vector<Image*> chains;
+        sources.clear();
+        for ( int i = 0; i < chainCount; i++ ) {
+            sources.push_back ( new CountedImage ( width, height, 2 ) );
+            chains.push_back ( sources.back() );
+        }
+        return StripImageFactory().createStripImage ( chains, pool );
+    }
+
+    template<typename T>
+    void checkLine ( Image* image, int line ) {
+        int size = image->getWidth() * image->getChannels();
+        CountedImage reference ( image->getWidth(), image->getHeight(), image->getChannels() );
+        T expected[size];
+        T got[size];
+        reference.getline ( expected, line );
+        CPPUNIT_ASSERT_EQUAL ( size, image->getline ( got, line ) );
+        for ( int i = 0; i < size; i++ ) CPPUNIT_ASSERT_EQUAL ( expected[i], got[i] );
+    }
+
+public:
+    void setUp() {
+        pool = new ThreadPool ( 3 );
+    }
+
+    void tearDown() {
+        delete pool;
+    }
+
+    void test_incompatible() {
+        std::vector<Image*> chains;
+        chains.push_back ( new CountedImage ( 10, 10, 1 ) );
+        CPPUNIT_ASSERT ( StripImageFactory().createStripImage ( chains, pool ) == NULL );
+        chains.push_back ( new CountedImage ( 10, 10, 3 ) );
+        CPPUNIT_ASSERT ( StripImageFactory().createStripImage ( chains, pool ) == NULL );
+        delete chains.at ( 0 );
+        delete chains.at ( 1 );
+    }
+
+    void test_sequential() {
+        StripImage* image = create ( 3, 40, 1000 );
+        CPPUNIT_ASSERT ( image != NULL );
+        CPPUNIT_ASSERT_EQUAL ( 1000, image->getHeight() );
+
+        for ( int l = 0; l < 1000; l++ ) checkLine<uint8_t> ( image, l );
+
+        // Chaque ligne n'est calculée qu'une fois, par la chaîne de sa bande
+        CPPUNIT_ASSERT_EQUAL ( 1000 - 2 * STRIP_HEIGHT, sources.at ( 0 )->calls );
+        CPPUNIT_ASSERT_EQUAL ( STRIP_HEIGHT, sources.at ( 1 )->calls );
+        CPPUNIT_ASSERT_EQUAL ( STRIP_HEIGHT, sources.at ( 2 )->calls );
+
+        // Un autre type est lu directement sur la chaîne
+        checkLine<float> ( image, 700 );
+        checkLine<uint8_t> ( image, 10 );
+
+        delete image;
+    }
+
+    void test_random() {
+        StripImage* image = create ( 2, 25, 1200 );
+        int lines[] = { 1100, 5, 600, 599, 1199, 0, 300 };
+        for ( int i = 0; i < 7; i++ ) checkLine<float> ( image, lines[i] );
+        delete image;
+    }
+
+    void test_partial() {
+        // Destruction avec des bandes en cours
+        StripImage* image = create ( 4, 200, 3000 );
+        checkLine<uint16_t> ( image, 3 );
+        delete image;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitStripImage );
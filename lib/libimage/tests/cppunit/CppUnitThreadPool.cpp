@@ -0,0 +1,120 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "ThreadPool.h"
+
+#include <iostream>
+using namespace std;
+
+/* Compteur partagé, protégé par un verrou */
+struct Counter {
+    pthread_mutex_t mutex;
+    int value;
+};
+
+/* Tâche incrémentant le compteur, et soumettant éventuellement de nouvelles tâches */
+class IncrementTask : public Task {
+private:
+    Counter* counter;
+    ThreadPool* pool;
+    int depth;
+
+public:
+    IncrementTask ( Counter* counter, ThreadPool* pool, int depth ) : counter ( counter ), pool ( pool ), depth ( depth ) {}
+
+    void run() {
+        pthread_mutex_lock ( &counter->mutex );
+        counter->value++;
+        pthread_mutex_unlock ( &counter->mutex );
+        if ( depth > 0 ) {
+            pool->submit ( new IncrementTask ( counter, pool, depth - 1 ) );
+            pool->submit ( new IncrementTask ( counter, pool, depth - 1 ) );
+        }
+    }
+};
+
+class CppUnitThreadPool : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitThreadPool );
+
+    CPPUNIT_TEST ( test_flat );
+    CPPUNIT_TEST ( test_nested );
+    CPPUNIT_TEST ( test_reuse );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    Counter counter;
+
+public:
+    void setUp() {
+        pthread_mutex_init ( &counter.mutex, NULL );
+        counter.value = 0;
+    }
+
+    void tearDown() {
+        pthread_mutex_destroy ( &counter.mutex );
+    }
+
+protected:
+
+    void test_flat() {
+        ThreadPool pool ( 4 );
+        CPPUNIT_ASSERT_EQUAL ( 4, pool.getNbThreads() );
+        for ( int i = 0; i < 1000; i++ ) pool.submit ( new IncrementTask ( &counter, &pool, 0 ) );
+        pool.wait();
+        CPPUNIT_ASSERT_EQUAL ( 1000, counter.value );
+    }
+
+    void test_nested() {
+        // Arbre binaire de profondeur 10 : 2^11 - 1 tâches, soumises depuis les threads du pool
+        ThreadPool pool ( 3 );
+        pool.submit ( new IncrementTask ( &counter, &pool, 10 ) );
+        pool.wait();
+        CPPUNIT_ASSERT_EQUAL ( 2047, counter.value );
+    }
+
+    void test_reuse() {
+        ThreadPool pool ( 2 );
+        for ( int k = 1; k <= 5; k++ ) {
+            for ( int i = 0; i < 100; i++ ) pool.submit ( new IncrementTask ( &counter, &pool, 1 ) );
+            pool.wait();
+            CPPUNIT_ASSERT_EQUAL ( k * 300, counter.value );
+        }
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitThreadPool );
@@ -0,0 +1,225 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TiffDeflateEncoder.h"
+#include "TiffRawEncoder.h"
+#include "ThreadPool.h"
+
+#include <zlib.h>
+#include <vector>
+
+/**
+ * Image flottante dont les valeurs sont calculées à partir de la position du pixel
+ */
+class GradientImage : public Image {
+private:
+    template<typename T>
+    int _getline ( T* buffer, int line ) {
+        for ( int i = 0; i < width * channels; i++ ) {
+            buffer[i] = ( T ) ( ( i % 13 ) * 0.5 + line );
+        }
+        return width * channels;
+    }
+
+public:
+    GradientImage ( int width, int height ) : Image ( width, height, 1 ) {}
+
+    int getline ( uint8_t* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+    int getline ( uint16_t* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+    int getline ( float* buffer, int line ) {
+        return _getline ( buffer, line );
+    }
+};
+
+/**
+ * Encodeur dont la compression de la dernière bande, incomplète, échoue
+ */
+class FailingDeflateEncoder : public TiffDeflateEncoder<float> {
+protected:
+    uint8_t* encodeStrip ( uint8_t* raw, int lines, size_t lineSize, size_t& encodedSize ) {
+        if ( lines < TIFF_ROWS_PER_STRIP ) return NULL;
+        return TiffDeflateEncoder<float>::encodeStrip ( raw, lines, lineSize, encodedSize );
+    }
+
+public:
+    FailingDeflateEncoder ( Image* image, ThreadPool* pool ) : TiffDeflateEncoder<float> ( image, false, pool ) {}
+};
+
+class CppUnitTiffEncoder : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitTiffEncoder );
+
+    CPPUNIT_TEST ( test_deflate_strips );
+    CPPUNIT_TEST ( test_deflate_single_strip );
+    CPPUNIT_TEST ( test_raw_stream );
+    CPPUNIT_TEST ( test_geotiff_strips );
+    CPPUNIT_TEST ( test_strip_failure );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+
+    static std::vector<uint8_t> readAll ( DataStream* stream, size_t chunk ) {
+        std::vector<uint8_t> data;
+        uint8_t buffer[chunk];
+        while ( ! stream->eof() ) {
+            size_t size = stream->read ( buffer, chunk );
+            CPPUNIT_ASSERT ( size > 0 );
+            data.insert ( data.end(), buffer, buffer + size );
+        }
+        return data;
+    }
+
+    static uint32_t get32 ( std::vector<uint8_t>& data, size_t offset ) {
+        return * ( ( uint32_t* ) ( &data[0] + offset ) );
+    }
+
+    static void checkLines ( float* lines, int first, int count, int width ) {
+        GradientImage reference ( width, first + count );
+        float expected[width];
+        for ( int l = 0; l < count; l++ ) {
+            reference.getline ( expected, first + l );
+            for ( int i = 0; i < width; i++ ) CPPUNIT_ASSERT_EQUAL ( expected[i], lines[l * width + i] );
+        }
+    }
+
+    // Valeur du premier tag de l'IFD portant ce code, 0 s'il est absent
+    static uint32_t getTag ( std::vector<uint8_t>& data, uint16_t code ) {
+        uint32_t ifd = get32 ( data, 4 );
+        uint16_t count = * ( ( uint16_t* ) ( &data[0] + ifd ) );
+        for ( uint16_t t = 0; t < count; t++ ) {
+            if ( * ( ( uint16_t* ) ( &data[0] + ifd + 2 + 12 * t ) ) == code ) return get32 ( data, ifd + 2 + 12 * t + 8 );
+        }
+        return 0;
+    }
+
+    std::vector<uint8_t> checkDeflate ( int width, int height, ThreadPool* pool, bool isGeoTiff = false ) {
+        GradientImage* image = new GradientImage ( width, height );
+        if ( isGeoTiff ) {
+            image->setCRS ( CRS ( "EPSG:4326" ) );
+            image->setBbox ( BoundingBox<double> ( 2.0, 48.0, 2.0 + width * 0.001, 48.0 + height * 0.001 ) );
+        }
+        TiffDeflateEncoder<float> encoder ( image, isGeoTiff, pool );
+        unsigned int length = encoder.getLength();
+        std::vector<uint8_t> data = readAll ( &encoder, 4096 );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) length, data.size() );
+
+        uint32_t stripCount = ( height + TIFF_ROWS_PER_STRIP - 1 ) / TIFF_ROWS_PER_STRIP;
+        CPPUNIT_ASSERT_EQUAL ( stripCount, get32 ( data, 74 ) );
+        CPPUNIT_ASSERT_EQUAL ( stripCount, get32 ( data, 110 ) );
+        CPPUNIT_ASSERT_EQUAL ( ( uint32_t ) ( stripCount > 1 ? TIFF_ROWS_PER_STRIP : height ), get32 ( data, 102 ) );
+
+        float lines[TIFF_ROWS_PER_STRIP * width];
+        for ( uint32_t s = 0; s < stripCount; s++ ) {
+            uint32_t offset = ( stripCount > 1 ) ? get32 ( data, get32 ( data, 78 ) + 4 * s ) : get32 ( data, 78 );
+            uint32_t size = ( stripCount > 1 ) ? get32 ( data, get32 ( data, 114 ) + 4 * s ) : get32 ( data, 114 );
+            CPPUNIT_ASSERT ( offset + size <= data.size() );
+
+            int rows = std::min ( TIFF_ROWS_PER_STRIP, height - ( int ) s * TIFF_ROWS_PER_STRIP );
+            uLongf rawSize = rows * width * sizeof ( float );
+            CPPUNIT_ASSERT_EQUAL ( Z_OK, uncompress ( ( Bytef* ) lines, &rawSize, &data[offset], size ) );
+            CPPUNIT_ASSERT_EQUAL ( ( uLongf ) ( rows * width * sizeof ( float ) ), rawSize );
+            checkLines ( lines, s * TIFF_ROWS_PER_STRIP, rows, width );
+        }
+        return data;
+    }
+
+public:
+    void setUp() {};
+
+    void tearDown() {};
+
+    void test_deflate_strips() {
+        // Compression dans le thread courant puis sur un pool
+        checkDeflate ( 50, 3 * TIFF_ROWS_PER_STRIP + 17, NULL );
+        ThreadPool pool ( 3 );
+        checkDeflate ( 50, 3 * TIFF_ROWS_PER_STRIP + 17, &pool );
+    }
+
+    void test_deflate_single_strip() {
+        checkDeflate ( 30, 100, NULL );
+    }
+
+    void test_raw_stream() {
+        int width = 20, height = 40;
+        TiffRawEncoder<float> encoder ( new GradientImage ( width, height ) );
+        unsigned int length = encoder.getLength();
+        CPPUNIT_ASSERT_EQUAL ( ( unsigned int ) ( TiffHeader::headerSize ( 1 ) + width * height * sizeof ( float ) ), length );
+
+        // Lectures plus petites qu'une ligne, l'en-tête étant envoyé seul dans la première
+        std::vector<uint8_t> data = readAll ( &encoder, TiffHeader::headerSize ( 1 ) + 3 );
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) length, data.size() );
+        CPPUNIT_ASSERT_EQUAL ( ( uint32_t ) TiffHeader::headerSize ( 1 ), get32 ( data, 78 ) );
+        checkLines ( ( float* ) ( &data[0] + TiffHeader::headerSize ( 1 ) ), 0, height, width );
+    }
+
+    void test_geotiff_strips() {
+        // Les tableaux des bandes sont ajoutés après les tags géographiques
+        int width = 40, height = 2 * TIFF_ROWS_PER_STRIP + 5;
+        std::vector<uint8_t> plain = checkDeflate ( width, height, NULL );
+        ThreadPool pool ( 2 );
+        std::vector<uint8_t> geo = checkDeflate ( width, height, &pool, true );
+
+        uint16_t plainTags = * ( ( uint16_t* ) ( &plain[0] + 8 ) );
+        CPPUNIT_ASSERT_EQUAL ( ( uint16_t ) ( plainTags + 5 ), * ( ( uint16_t* ) ( &geo[0] + 8 ) ) );
+        uint32_t scaleOffset = getTag ( geo, 33550 );
+        uint32_t asciiOffset = getTag ( geo, 34737 );
+        CPPUNIT_ASSERT ( scaleOffset != 0 && asciiOffset != 0 );
+        CPPUNIT_ASSERT_DOUBLES_EQUAL ( 0.001, * ( ( double* ) ( &geo[0] + scaleOffset ) ), 1e-12 );
+        CPPUNIT_ASSERT ( get32 ( geo, 78 ) > asciiOffset );
+        CPPUNIT_ASSERT ( get32 ( geo, get32 ( geo, 78 ) ) > get32 ( geo, 114 ) );
+    }
+
+    void test_strip_failure() {
+        // Une bande non compressée donne un flux vide plutôt qu'un TIFF corrompu
+        ThreadPool pool ( 2 );
+        FailingDeflateEncoder failing ( new GradientImage ( 20, 2 * TIFF_ROWS_PER_STRIP + 5 ), &pool );
+        CPPUNIT_ASSERT_EQUAL ( 0U, failing.getLength() );
+        CPPUNIT_ASSERT ( failing.eof() );
+        uint8_t buffer[4096];
+        CPPUNIT_ASSERT_EQUAL ( ( size_t ) 0, failing.read ( buffer, 4096 ) );
+
+        // Toutes les bandes complètes : le flux est rendu
+        FailingDeflateEncoder complete ( new GradientImage ( 20, 2 * TIFF_ROWS_PER_STRIP ), NULL );
+        CPPUNIT_ASSERT ( complete.getLength() > 0 );
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitTiffEncoder );
@@ -0,0 +1,172 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "UringFileContext.h"
+
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+#include <sys/time.h>
+#include <iostream>
+using namespace std;
+
+#define TEST_FILE_SIZE 4194304
+
+/* Durée écoulée en millisecondes */
+static double elapsed ( struct timeval& start ) {
+    struct timeval end;
+    gettimeofday ( &end, NULL );
+    return ( end.tv_sec - start.tv_sec ) * 1000. + ( end.tv_usec - start.tv_usec ) / 1000.;
+}
+
+class CppUnitUringFileContext : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE ( CppUnitUringFileContext );
+
+    CPPUNIT_TEST ( test_readMulti );
+    CPPUNIT_TEST ( test_write );
+    CPPUNIT_TEST ( test_benchmark );
+    CPPUNIT_TEST_SUITE_END();
+
+protected:
+    string dir;
+    string name;
+    uint8_t* content;
+
+public:
+    void setUp() {
+        char buf[64];
+        sprintf ( buf, "/tmp/CppUnitUringFileContext_%d_", getpid() );
+        dir = string ( buf );
+        name = "slab.tif";
+        content = new uint8_t[TEST_FILE_SIZE];
+        for ( int i = 0; i < TEST_FILE_SIZE; i++ ) content[i] = ( uint8_t ) ( ( i * 31 ) ^ ( i >> 11 ) );
+        ofstream out ( ( dir + name ).c_str(), ios_base::trunc | ios::binary );
+        out.write ( ( char* ) content, TEST_FILE_SIZE );
+        out.close();
+    }
+
+    void tearDown() {
+        remove ( ( dir + name ).c_str() );
+        remove ( ( dir + "written.tif" ).c_str() );
+        delete[] content;
+    }
+
+protected:
+
+    void test_readMulti() {
+        UringFileContext context ( dir );
+        context.connection();
+
+        // Plus de lectures que d'entrées dans l'anneau, dont une sur un fichier absent et une hors du fichier
+        std::vector<ContextRead> reads;
+        for ( int i = 0; i < 150; i++ ) {
+            int offset = ( i * 104729 ) % ( TEST_FILE_SIZE - 5000 );
+            reads.push_back ( ContextRead ( new uint8_t[1000 + i], offset, 1000 + i, name ) );
+        }
+        reads.push_back ( ContextRead ( new uint8_t[10], 0, 10, "absent.tif" ) );
+        reads.push_back ( ContextRead ( new uint8_t[10], TEST_FILE_SIZE - 5, 10, name ) );
+
+        context.readMulti ( reads );
+
+        for ( int i = 0; i < 150; i++ ) {
+            CPPUNIT_ASSERT_EQUAL ( 1000 + i, reads.at ( i ).result );
+            CPPUNIT_ASSERT ( memcmp ( reads.at ( i ).data, content + reads.at ( i ).offset, reads.at ( i ).size ) == 0 );
+        }
+        CPPUNIT_ASSERT ( reads.at ( 150 ).result < 0 );
+        CPPUNIT_ASSERT ( reads.at ( 151 ).result < 0 );
+
+        for ( unsigned int i = 0; i < reads.size(); i++ ) delete[] reads.at ( i ).data;
+    }
+
+    void test_write() {
+        UringFileContext context ( dir );
+        context.connection();
+
+        // Écritures plus grandes que les buffers, plus nombreuses que les buffers, et réécriture de l'en-tête
+        CPPUNIT_ASSERT ( context.openToWrite ( "written.tif" ) );
+        CPPUNIT_ASSERT ( context.write ( content, 0, 100, "written.tif" ) );
+        CPPUNIT_ASSERT ( context.writeFull ( content + 100, 1000000, "written.tif" ) );
+        for ( int i = 0; i < 40; i++ ) {
+            CPPUNIT_ASSERT ( context.write ( content + 1000100 + i * 5000, 1000100 + i * 5000, 5000, "written.tif" ) );
+        }
+        uint8_t header[100];
+        memset ( header, 7, 100 );
+        CPPUNIT_ASSERT ( context.write ( header, 0, 100, "written.tif" ) );
+        CPPUNIT_ASSERT ( context.closeToWrite ( "written.tif" ) );
+
+        int size = 1000100 + 40 * 5000;
+        uint8_t* written = new uint8_t[size];
+        CPPUNIT_ASSERT_EQUAL ( size, context.read ( written, 0, size, "written.tif" ) );
+        CPPUNIT_ASSERT ( memcmp ( written, header, 100 ) == 0 );
+        CPPUNIT_ASSERT ( memcmp ( written + 100, content + 100, size - 100 ) == 0 );
+        delete[] written;
+    }
+
+    void test_benchmark() {
+        // Lecture de 4096 portions de 16 Ko : lectures groupées io_uring contre open/pread/close unitaires
+        FileContext fileContext ( dir );
+        fileContext.connection();
+        UringFileContext uringContext ( dir );
+        uringContext.connection();
+
+        std::vector<ContextRead> reads;
+        for ( int i = 0; i < 4096; i++ ) {
+            int offset = ( ( i * 7919 ) % 256 ) * 16384;
+            reads.push_back ( ContextRead ( new uint8_t[16384], offset, 16384, name ) );
+        }
+
+        struct timeval start;
+        gettimeofday ( &start, NULL );
+        fileContext.readMulti ( reads );
+        double preadTime = elapsed ( start );
+
+        gettimeofday ( &start, NULL );
+        uringContext.readMulti ( reads );
+        double uringTime = elapsed ( start );
+
+        for ( unsigned int i = 0; i < reads.size(); i++ ) {
+            CPPUNIT_ASSERT_EQUAL ( 16384, reads.at ( i ).result );
+            CPPUNIT_ASSERT ( memcmp ( reads.at ( i ).data, content + reads.at ( i ).offset, 16384 ) == 0 );
+            delete[] reads.at ( i ).data;
+        }
+
+        cout << endl << "pread : " << preadTime << " ms, io_uring" << ( UringFileContext::isAvailable() ? "" : " (indisponible)" ) << " : " << uringTime << " ms" << endl;
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION ( CppUnitUringFileContext );
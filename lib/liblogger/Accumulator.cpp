@@ -39,12 +39,43 @@
 #include <time.h>
 #include <errno.h>
 #include <csignal>
+#include <cstring>
 #include "sys/time.h"
 
+/** Compteur fournissant un identifiant unique à chaque accumulateur */
+static uint64_t accumulatorCount = 0;
+
+/** Files du thread courant, une par accumulateur utilisé : (identifiant de l'accumulateur, file) */
+typedef std::vector<std::pair<uint64_t, LogRing*> > ThreadRings;
+
+static pthread_once_t rings_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t rings_key;
+
+/** Lâche une référence sur la file, et la libère s'il s'agissait de la dernière */
+static void releaseRing ( LogRing* ring ) {
+    if ( __atomic_sub_fetch ( &ring->refs, 1, __ATOMIC_ACQ_REL ) == 0 ) delete ring;
+}
+
+/**
+ * Appelée à la fin d'un thread producteur : ses files sont marquées orphelines, le thread d'écriture
+ * les videra avant de les libérer.
+ */
+static void destroyThreadRings ( void* arg ) {
+    ThreadRings* tr = ( ThreadRings* ) arg;
+    for ( size_t i = 0; i < tr->size(); i++ ) {
+        __atomic_store_n ( & ( *tr ) [i].second->orphan, true, __ATOMIC_RELEASE );
+        releaseRing ( ( *tr ) [i].second );
+    }
+    delete tr;
+}
+
+static void init_rings_key() {
+    pthread_key_create ( &rings_key, destroyThreadRings );
+}
 
 /**
  * Boucle principale d'écriture exécutée par un thread spcifique encapsulé dans la classe.
- * Cette boucle se charge de récuperrer des messages dans le buffer de message et de
+ * Cette boucle se charge de récuperrer des messages dans les files des threads et de
  * les écrire dans le flux de sortie. Ainsi les éventuelles latences d'écriture de fichier
  * sont supportées par ce thread et non par les thread qui initient les écritures de log.
  *
@@ -53,60 +84,183 @@
 void* Accumulator::loop ( void* arg ) {
     Accumulator* A = ( Accumulator* ) arg;
 
-    while ( A->waitMessage() )
-        A->flushFrontMessage();
+    while ( true ) {
+        // Le statut est lu avant de vider les files : après l'arrêt, un dernier passage écrit tout ce qui a été publié
+        bool running = ( __atomic_load_n ( &A->status, __ATOMIC_ACQUIRE ) > 0 );
+
+        // Réouverture demandée : seul ce thread utilise le flux, il peut le fermer sans concurrence.
+        // Les messages publiés avant la demande sont d'abord écrits dans l'ancien flux.
+        if ( __atomic_load_n ( &A->reopenRequested, __ATOMIC_ACQUIRE ) ) {
+            A->drainRings();
+            A->getStream().flush();
+            A->close();
+            pthread_mutex_lock ( &A->mutex );
+            __atomic_store_n ( &A->reopenRequested, false, __ATOMIC_SEQ_CST );
+            pthread_cond_broadcast ( &A->cond_reopened );
+            pthread_mutex_unlock ( &A->mutex );
+        }
+
+        if ( A->drainRings() > 0 ) {
+            A->getStream().flush();
+            continue;
+        }
+        if ( ! running ) break;
+
+        // Rien à écrire : on s'endort jusqu'au prochain message (ou au plus une seconde)
+        timeval tv;
+        timespec tsp;
+        gettimeofday ( &tv, NULL );
+        tsp.tv_sec  = tv.tv_sec + 1;
+        tsp.tv_nsec = tv.tv_usec * 1000;
+
+        pthread_mutex_lock ( &A->mutex );
+        __atomic_store_n ( &A->sleeping, true, __ATOMIC_SEQ_CST );
+        // Un producteur publie puis lit sleeping, on écrit sleeping puis on relit les files : l'un des deux voit l'autre
+        if ( ! A->hasPending() && __atomic_load_n ( &A->status, __ATOMIC_SEQ_CST ) > 0 && ! __atomic_load_n ( &A->reopenRequested, __ATOMIC_SEQ_CST ) ) {
+            pthread_cond_timedwait ( &A->cond_get, &A->mutex, &tsp );
+        }
+        __atomic_store_n ( &A->sleeping, false, __ATOMIC_RELAXED );
+        pthread_mutex_unlock ( &A->mutex );
+    }
 
     A->getStream().flush();
+
+    // Une demande de réouverture arrivée pendant l'arrêt ne doit pas rester en attente
+    pthread_mutex_lock ( &A->mutex );
+    __atomic_store_n ( &A->reopenRequested, false, __ATOMIC_SEQ_CST );
+    pthread_cond_broadcast ( &A->cond_reopened );
+    pthread_mutex_unlock ( &A->mutex );
+
+    return NULL;
 }
 
 /**
- * Attend (et bloque) l'arrivée d'un nouveau message dans le buffer.
- * Cette fonction est exclusivement utilisée par le thread encapsulé.
- * Cette fonction retourne dès qu'un message est dispoible dans buffer ou lorsque l'objet rentre en phase de destruction
+ * Écrit sur le flux de sortie les messages complets présents dans toutes les files.
+ * Seul le thread d'écriture retire des files de la liste : il peut donc la parcourir sans verrou.
  */
-bool Accumulator::waitMessage() {
-    // On prépare une timeout à +1s
-    timeval tv;
-    timespec tsp;
-    gettimeofday ( &tv, NULL );
-    tsp.tv_sec  = tv.tv_sec + 1;
-    tsp.tv_nsec = tv.tv_usec * 1000;
-
-    // On attend avec un timeout de 1 seconde
-    pthread_mutex_lock ( &mutex );
-    if ( size == 0 && status > 0 && pthread_cond_timedwait ( &cond_get, &mutex, &tsp ) == ETIMEDOUT ) {
-        pthread_mutex_unlock ( &mutex );
-        getStream().flush(); // Flush hors mutex (car peut prendre du temps)
+size_t Accumulator::drainRings() {
+    size_t written = 0;
+    LogRing* ring = __atomic_load_n ( &rings, __ATOMIC_ACQUIRE );
+
+    while ( ring ) {
+        LogRing* next = ring->next;
+        bool orphan = __atomic_load_n ( &ring->orphan, __ATOMIC_ACQUIRE );
+        uint64_t tail = ring->tail;
+        uint64_t head = __atomic_load_n ( &ring->head, __ATOMIC_ACQUIRE );
+
+        // On n'écrit que des messages complets, pour ne pas entrelacer les lignes de deux threads
+        uint64_t end = tail;
+        for ( uint64_t i = tail; i < head; i++ ) {
+            if ( ring->slots[i % ring->capacity].last ) end = i + 1;
+        }
+        // Message plus long que la file, ou thread terminé : on écrit ce qu'on a
+        if ( end == tail && ( head - tail == ring->capacity || orphan ) ) end = head;
+
+        if ( end != tail ) {
+            std::ostream& out = getStream();
+            for ( uint64_t i = tail; i < end; i++ ) {
+                LogSlot& slot = ring->slots[i % ring->capacity];
+                out.write ( slot.text, slot.length );
+            }
+            //TODO: gérer les cas d'erreur d'écriture du flux.
+            __atomic_store_n ( &ring->tail, end, __ATOMIC_SEQ_CST );
+            written += end - tail;
+        } else if ( orphan ) {
+            // Thread terminé et file vide : on la retire de la liste
+            pthread_mutex_lock ( &mutex );
+            LogRing** prev = &rings;
+            while ( *prev != ring ) prev = & ( *prev )->next;
+            *prev = ring->next;
+            pthread_mutex_unlock ( &mutex );
+            releaseRing ( ring );
+        }
+
+        ring = next;
+    }
+
+    // Un producteur incrémente blocked puis relit tail, on écrit tail puis on lit blocked : l'un des deux voit l'autre
+    if ( written > 0 && __atomic_load_n ( &blocked, __ATOMIC_SEQ_CST ) > 0 ) {
         pthread_mutex_lock ( &mutex );
+        pthread_cond_broadcast ( &cond_space );
+        pthread_mutex_unlock ( &mutex );
     }
 
-    // maintenant on attend qu'il y ait des messages sans timemout
-    while ( size == 0 && status > 0 ) pthread_cond_wait ( &cond_get, &mutex );
-    pthread_mutex_unlock ( &mutex );
+    return written;
+}
 
-    // Seul le thread interne peut décrémenter size, donc la contidtion size > 0 ne peut changer après la libération du mutex.
-    return ( size > 0 );
+/** Indique si au moins une file contient des cases non consommées */
+bool Accumulator::hasPending() {
+    for ( LogRing* ring = __atomic_load_n ( &rings, __ATOMIC_SEQ_CST ); ring; ring = ring->next ) {
+        if ( __atomic_load_n ( &ring->head, __ATOMIC_SEQ_CST ) != ring->tail ) return true;
+    }
+    return false;
 }
 
-/**
- * Retire le premier message du buffer et l'envoie dans flux de sortie.
- * Cette fonction est exclusivement utilisée par le thread encapsulé.
- * Cette fonction décrémente size et ne doit pas être apellée avec un buffer vide.
- */
-void Accumulator::flushFrontMessage() {
-    getStream() << buffer[front];
-    //TODO: gérer les cas d'erreur d'écriture du flux.
+/** Retourne la file du thread courant, en la créant au besoin */
+LogRing* Accumulator::getRing() {
+    pthread_once ( &rings_key_once, init_rings_key );
 
-    getStream().flush();
+    ThreadRings* tr = ( ThreadRings* ) pthread_getspecific ( rings_key );
+    if ( tr == NULL ) {
+        tr = new ThreadRings();
+        pthread_setspecific ( rings_key, ( void* ) tr );
+    }
 
-    // On retire le message du buffer en incrémentant front.
+    for ( size_t i = 0; i < tr->size(); i++ ) {
+        if ( ( *tr ) [i].first == id ) return ( *tr ) [i].second;
+    }
+
+    // Premier message de ce thread pour cet accumulateur : on enregistre une nouvelle file
+    LogRing* ring = new LogRing ( capacity );
+    pthread_mutex_lock ( &mutex );
+    ring->next = rings;
+    __atomic_store_n ( &rings, ring, __ATOMIC_RELEASE );
+    pthread_mutex_unlock ( &mutex );
+
+    tr->push_back ( std::make_pair ( id, ring ) );
+    return ring;
+}
+
+/** Réveille le thread d'écriture s'il est endormi */
+void Accumulator::wakeUp() {
+    if ( __atomic_load_n ( &sleeping, __ATOMIC_SEQ_CST ) ) {
+        pthread_mutex_lock ( &mutex );
+        pthread_cond_signal ( &cond_get );
+        pthread_mutex_unlock ( &mutex );
+    }
+}
+
+/** Attend, endormi, que le thread d'écriture libère de la place dans la file pleine du thread courant */
+bool Accumulator::waitForSpace ( LogRing* ring, uint64_t head ) {
+    bool running = true;
     pthread_mutex_lock ( &mutex );
-    front = ( front+1 ) % buffer.size();
-    size--;
-    pthread_cond_signal ( &cond_add );
+    __atomic_add_fetch ( &blocked, 1, __ATOMIC_SEQ_CST );
+    while ( head - __atomic_load_n ( &ring->tail, __ATOMIC_SEQ_CST ) >= ring->capacity ) {
+        // Le thread d'écriture s'arrête sans plus vider les files : le message est abandonné
+        if ( __atomic_load_n ( &status, __ATOMIC_SEQ_CST ) <= 0 ) {
+            running = false;
+            break;
+        }
+        pthread_cond_signal ( &cond_get );
+        pthread_cond_wait ( &cond_space, &mutex );
+    }
+    __atomic_sub_fetch ( &blocked, 1, __ATOMIC_SEQ_CST );
     pthread_mutex_unlock ( &mutex );
+    return running;
 }
 
+/** Demande au thread d'écriture de fermer son flux, qu'il rouvrira à sa prochaine écriture, et attend la fermeture */
+void Accumulator::reopen() {
+    pthread_mutex_lock ( &mutex );
+    if ( __atomic_load_n ( &status, __ATOMIC_SEQ_CST ) > 0 ) {
+        __atomic_store_n ( &reopenRequested, true, __ATOMIC_SEQ_CST );
+        pthread_cond_signal ( &cond_get );
+        while ( __atomic_load_n ( &reopenRequested, __ATOMIC_SEQ_CST ) ) {
+            pthread_cond_wait ( &cond_reopened, &mutex );
+        }
+    }
+    pthread_mutex_unlock ( &mutex );
+}
 
 /**
  * Rentre dans l'état en cours de destruction et attend que le thread encapsulé s'arrêter proprement.
@@ -118,43 +272,77 @@ void Accumulator::flushFrontMessage() {
 void Accumulator::stop() {
     pthread_mutex_lock ( &mutex );
     // On indique que l'objet est encours de destruction.
-    status = 0;
+    __atomic_store_n ( &status, 0, __ATOMIC_SEQ_CST );
     // On réveille le thread interne si celui-ci était en train de dormir
     pthread_cond_signal ( &cond_get );
+    // Ainsi que les producteurs attendant de la place dans leur file
+    pthread_cond_broadcast ( &cond_space );
     // Attendre la fin du thread interne
     pthread_mutex_unlock ( &mutex );
     pthread_join ( threadId, NULL );
+
+    // Les files encore utilisées par des threads vivants seront libérées à la fin de ceux-ci
+    pthread_mutex_lock ( &mutex );
+    LogRing* ring = rings;
+    rings = NULL;
+    pthread_mutex_unlock ( &mutex );
+    while ( ring ) {
+        LogRing* next = ring->next;
+        releaseRing ( ring );
+        ring = next;
+    }
 }
 
 /**
  * Ajoute un message dans la file d'attente des messages à écrire sur le flux de sortie.
- * Cette fonction peut bloquer lorsque le buffer est plein. Dans ce cas le thread apellant attend que le thread encapsulé libère de la place dans le buffer.
- * L'ordre d'enregistrement des messages concurents dépend de la politique de gestion des mutex (ça doit être du FIFO).
+ * Cette fonction peut bloquer lorsque la file du thread est pleine. Dans ce cas le thread apellant s'endort jusqu'à ce que le thread encapsulé libère de la place dans la file.
  *
  * @param message Le message à écrire, ne pas oublier de rajouter des retours à la ligne si l'on veut écrire des lignes
  * @return true si le message a bien été pris en compte false sinon.
  */
 bool Accumulator::addMessage ( std::string message ) {
+    return addMessage ( message.data(), message.size(), true );
+}
+
+/**
+ * Découpe le texte en cases de la file du thread courant. Seul ce thread écrit head : aucun verrou n'est nécessaire.
+ */
+bool Accumulator::addMessage ( const char* message, size_t length, bool last ) {
     // Ne pas accepter de nouveau message en cours de destruction.
-    if ( status <= 0 ) return false;
+    if ( __atomic_load_n ( &status, __ATOMIC_ACQUIRE ) <= 0 ) return false;
 
+    LogRing* ring = getRing();
+    uint64_t head = ring->head;
 
-    pthread_mutex_lock ( &mutex );
-    // On attend qu'il y ait de la place dans le buffer
-    while ( size == buffer.size() ) pthread_cond_wait ( &cond_add, &mutex );
+    do {
+        // File pleine : on s'endort jusqu'à ce que le thread d'écriture libère de la place
+        if ( head - __atomic_load_n ( &ring->tail, __ATOMIC_ACQUIRE ) >= ring->capacity ) {
+            if ( ! waitForSpace ( ring, head ) ) return false;
+        }
 
-    buffer[ ( front + size ) %buffer.size()] = message;
-    size++;
-    pthread_cond_signal ( &cond_get );
-    pthread_mutex_unlock ( &mutex );
+        LogSlot& slot = ring->slots[head % ring->capacity];
+        size_t n = ( length > LOGGER_SLOT_SIZE ) ? LOGGER_SLOT_SIZE : length;
+        memcpy ( slot.text, message, n );
+        slot.length = n;
+        message += n;
+        length -= n;
+        slot.last = ( last && length == 0 );
+
+        head++;
+        __atomic_store_n ( &ring->head, head, __ATOMIC_SEQ_CST );
+    } while ( length > 0 );
+
+    wakeUp();
     return true;
 }
 
-/** Constructeur permettant de définir la capacité du buffer de messages. */
-Accumulator::Accumulator ( int capacity ) : status ( 1 ), buffer ( capacity ), front ( 0 ), size ( 0 ) {
+/** Constructeur permettant de définir la capacité (en cases) de la file de messages de chaque thread. */
+Accumulator::Accumulator ( int capacity ) : status ( 1 ), sleeping ( false ), reopenRequested ( false ), blocked ( 0 ), capacity ( capacity > 0 ? capacity : 1 ), rings ( NULL ) {
+    id = __atomic_add_fetch ( &accumulatorCount, 1, __ATOMIC_RELAXED );
     pthread_mutex_init ( &mutex, 0 );
     pthread_cond_init ( &cond_get, 0 );
-    pthread_cond_init ( &cond_add, 0 );
+    pthread_cond_init ( &cond_reopened, 0 );
+    pthread_cond_init ( &cond_space, 0 );
 
     // On crée et lance le thread interne
     pthread_create ( &threadId, NULL, Accumulator::loop, ( void* ) this );
@@ -169,7 +357,8 @@ Accumulator::~Accumulator() {
 void Accumulator::destroy() {
     // Note : Le thread interne doit être arrêté par le destructeur de la classe fille en utilisant stop().
     pthread_cond_destroy ( &cond_get );
-    pthread_cond_destroy ( &cond_add );
+    pthread_cond_destroy ( &cond_reopened );
+    pthread_cond_destroy ( &cond_space );
     pthread_mutex_destroy ( &mutex );
 }
 
@@ -44,6 +44,52 @@
 #include <ctime>
 //#include <cstdlib>
 #include <vector>
+#include <string>
+#include <stdint.h>
+#include <pthread.h>
+
+/** Taille du texte porté par une case de file de messages (un message plus long occupe plusieurs cases consécutives) */
+#define LOGGER_SLOT_SIZE 120
+
+/**
+ * Case d'une file de messages : un morceau de message de taille fixe, pour ne faire aucune allocation lors de la transmission.
+ */
+struct LogSlot {
+    /** Nombre d'octets utiles dans text */
+    unsigned short length;
+    /** Vrai si cette case termine un message */
+    bool last;
+    /** Morceau du message */
+    char text[LOGGER_SLOT_SIZE];
+};
+
+/**
+ * File circulaire sans verrou d'un thread producteur vers le thread d'écriture d'un accumulateur.
+ *
+ * Un seul thread écrit (head), un seul thread lit (tail) : les échanges se font par de simples lectures/écritures atomiques.
+ * La file appartient à la fois au thread producteur et à l'accumulateur, elle est libérée par le dernier des deux qui la lâche.
+ */
+struct LogRing {
+    /** Cases de la file */
+    LogSlot* slots;
+    /** Nombre de cases */
+    unsigned int capacity;
+    /** Nombre total de cases publiées par le producteur */
+    uint64_t head;
+    /** Nombre total de cases consommées par le thread d'écriture */
+    uint64_t tail;
+    /** Vrai une fois le thread producteur terminé */
+    bool orphan;
+    /** Nombre de propriétaires (thread producteur, accumulateur) */
+    int refs;
+    /** File suivante dans la liste de l'accumulateur */
+    LogRing* next;
+
+    LogRing ( unsigned int capacity ) : slots ( new LogSlot[capacity] ), capacity ( capacity ), head ( 0 ), tail ( 0 ), orphan ( false ), refs ( 2 ), next ( NULL ) {}
+    ~LogRing() {
+        delete[] slots;
+    }
+};
 
 /**
  * Collecte les messages de logs de plusieurs threads et les écrit dans un flux de sortie.
@@ -52,6 +98,10 @@
  * Un unique thread indépendant encapsulé dans la classe écrit les messages sur un flux de sortie.
  * Une telle architecture permet aux thread apellant de ne pas être bloqués par des latences dues aux I/O.
  * Les accumulateurs seront eux même encapsulés dans des Loggers, plusieurs loggers peuvent utiliser un même accumulateur.
+ *
+ * Chaque thread producteur dispose de sa propre file (LogRing), créée à son premier message : l'ajout d'un message
+ * ne prend aucun verrou et ne fait aucune allocation. L'ordre des messages est conservé pour un même thread, les messages
+ * de threads différents sont entrelacés par le thread d'écriture (chaque ligne porte sa date).
  */
 class Accumulator {
 private:
@@ -63,30 +113,42 @@ private:
      */
     int status;
 
+    /** Identifiant unique de l'accumulateur, pour retrouver les files du thread courant */
+    uint64_t id;
+
     /** Id du thread d'écriture spécifique */
     pthread_t threadId;
 
-    /** mutex pour synchroniser les ajouts et retraits de message du buffer */
+    /** mutex protégeant l'enregistrement des files et l'endormissement du thread d'écriture */
     pthread_mutex_t mutex;
 
     /** Condition d'attente du thread d'écriture  */
     pthread_cond_t  cond_get;
 
-    /** Condition d'attente des thread d'ajout de message */
-    pthread_cond_t  cond_add;
+    /** Vrai lorsque le thread d'écriture attend sur cond_get : seuls ces cas coûtent un signal aux producteurs */
+    bool sleeping;
+
+    /** Vrai lorsqu'une réouverture du flux de sortie a été demandée (#reopen), et pas encore faite par le thread d'écriture */
+    bool reopenRequested;
+
+    /** Condition signalée par le thread d'écriture une fois le flux fermé, suite à une demande de réouverture */
+    pthread_cond_t cond_reopened;
 
-    /** Position du plus ancien message présent dans le buffer */
-    int front;
+    /** Nombre de producteurs attendant de la place dans leur file pleine */
+    unsigned int blocked;
 
-    /** Nombre de messages actuellement bufferisés */
-    int size;
+    /** Condition signalée par le thread d'écriture après avoir vidé des files, lorsque des producteurs attendent */
+    pthread_cond_t cond_space;
 
-    /** Buffer de string contenant les messages */
-    std::vector<std::string> buffer;
+    /** Nombre de cases des files par thread */
+    unsigned int capacity;
+
+    /** Liste des files des threads producteurs */
+    LogRing* rings;
 
     /**
      * Boucle principale d'écriture exécutée par un thread spcifique encapsulé dans la classe.
-     * Cette boucle se charge de récuperrer des messages dans le buffer de message et de
+     * Cette boucle se charge de récuperrer des messages dans les files des threads et de
      * les écrire dans le flux de sortie. Ainsi les éventuelles latences d'écriture de fichier
      * sont supportées par ce thread et non par les thread qui initient les écritures de log.
      *
@@ -94,21 +156,27 @@ private:
      */
     static void* loop ( void* arg );
 
-
     /**
-     * Attend (et bloque) l'arrivée d'un nouveau message dans le buffer.
-     * Cette fonction est exclusivement utilisée par le thread encapsulé.
-     * Cette fonction retourne dès qu'un message est dispoible dans buffer ou lorsque l'objet rentre en phase de destruction
+     * Écrit sur le flux de sortie les messages complets présents dans toutes les files.
+     * Cette fonction est exclusivement utilisée par le thread encapsulé. Les files des threads terminés et vides sont libérées.
+     * @return le nombre de cases écrites
      */
-    bool waitMessage();
+    size_t drainRings();
+
+    /** Indique si au moins une file contient des cases non consommées */
+    bool hasPending();
+
+    /** Retourne la file du thread courant, en la créant au besoin */
+    LogRing* getRing();
+
+    /** Réveille le thread d'écriture s'il est endormi */
+    void wakeUp();
 
     /**
-     * Retire le premier message du buffer et l'envoie dans flux de sortie.
-     * Cette fonction est exclusivement utilisée par le thread encapsulé.
-     * Cette fonction décrémente size et ne doit pas être apellée avec un buffer vide.
+     * Attend que le thread d'écriture libère de la place dans la file pleine du thread courant, sans consommer de CPU.
+     * @return faux si l'accumulateur est arrêté pendant l'attente
      */
-    void flushFrontMessage();
-
+    bool waitForSpace ( LogRing* ring, uint64_t head );
 
     /** Constructeur de copie privé pour éviter toute copie de l'objet */
     Accumulator ( Accumulator& ) {}
@@ -121,6 +189,12 @@ protected:
      */
     virtual std::ostream& getStream() = 0;
 
+    /**
+     * Ferme les descripteurs de fichier utilisés, qui seront rouverts par le prochain appel à getStream().
+     * Cette fonction n'est appelée que par le thread encapsulé, entre deux écritures : elle ne doit pas être appelée
+     * directement pendant que des messages peuvent être écrits, voir #reopen.
+     */
+    virtual void close() = 0;
 
 
 
@@ -128,13 +202,21 @@ public:
 
     /**
      * Ajoute un message dans la file d'attente des messages à écrire sur le flux de sortie.
-     * Cette fonction peut bloquer lorsque le buffer est plein. Dans ce cas le thread apellant attend que le thread encapsulé libère de la place dans le buffer.
-     * L'ordre d'enregistrement des messages concurents dépend de la politique de gestion des mutex (ça doit être du FIFO).
+     * Cette fonction peut bloquer lorsque la file du thread est pleine. Dans ce cas le thread apellant s'endort jusqu'à ce que le thread encapsulé libère de la place dans la file.
      *
      * @param message Le message à écrire, ne pas oublier de rajouter des retours à la ligne si l'on veut écrire des lignes
      */
     bool addMessage ( std::string message );
 
+    /**
+     * Ajoute un morceau de message dans la file du thread courant, sans copie intermédiaire ni verrou.
+     *
+     * @param message Début du texte
+     * @param length Nombre d'octets du texte
+     * @param last Faux si le message se poursuit dans un prochain appel : le thread d'écriture n'écrit que des messages complets
+     */
+    bool addMessage ( const char* message, size_t length, bool last = true );
+
     /**
      * Rentre dans l'état "en cours de destruction" et attend que le thread encapsulé s'arrête proprement.
      * Cette fonction doit être apellée par la classe fille.
@@ -159,11 +241,14 @@ public:
     void destroy();
 
     /**
-     * ferme les descripteur de fichier utilisé
+     * Demande la fermeture puis la réouverture du flux de sortie (après une rotation externe des fichiers de log par exemple).
+     * La fermeture est faite par le thread d'écriture lui-même, entre deux vidages des files : les threads producteurs
+     * peuvent continuer à écrire des messages. L'appel rend la main une fois le flux fermé : les messages ajoutés ensuite
+     * sont écrits dans le flux rouvert.
      */
-    virtual void close() = 0;
+    void reopen();
 
-    /** Constructeur permettant de définir la capacité du buffer de messages. */
+    /** Constructeur permettant de définir la capacité (en cases) de la file de messages de chaque thread. */
     Accumulator ( int capacity ) ;
 
     /** Destructeur virtual car nous avons un classe abstraite */
@@ -186,13 +271,13 @@ protected:
         return out;
     }
 
+    /** Implémentation de la fonction virtuelle de la classe mère */
+    void close(){}
+
 public:
 
     /** Constructeur */
     StreamAccumulator ( std::ostream &out = std::cerr, int capacity = 1024 ) : Accumulator ( capacity ), out ( out ) {}
-
-    /** Implémentation de la fonction virtuelle de la classe mère */
-    void close(){}
     
     /**
      * Destructeur.
@@ -231,13 +316,13 @@ protected:
     /** Implémentation de la fonction virtuelle de la classe mère */
     virtual std::ostream& getStream();
 
+    /** Implémentation de la fonction virtuelle de la classe mère */
+    void close();
+
 public:
 
     ///** Constructeur */
     RollingFileAccumulator ( std::string filePrefix, int period, int capacity = 1024 ) : Accumulator ( capacity ), filePrefix ( filePrefix ), validity ( 0 ), period ( period ) {}
-
-    /** Implémentation de la fonction virtuelle de la classe mère */
-    void close();
     
     /**
      * Destructeur.
@@ -267,13 +352,13 @@ protected:
     /** Implémentation de la fonction virtuelle de la classe mère */
     virtual std::ostream& getStream();
 
+    /** Implémentation de la fonction virtuelle de la classe mère */
+    void close();
+
 public:
 
     ///** Constructeur */
     StaticFileAccumulator ( std::string file, int capacity = 1024 ) : Accumulator ( capacity ), file ( file ) {}
-
-    /** Implémentation de la fonction virtuelle de la classe mère */
-    void close();
     
     /**
      * Destructeur.
@@ -52,23 +52,77 @@ LogOutput Logger::logOutput=ROLLING_FILE;
 
 const char* LogLevelText[nbLogLevel] = {"FATAL", "ERROR", "WARN", "INFO", "DEBUG"};
 
-class logbuffer : public std::stringbuf {
+/** Taille du tampon de formatage d'un thread : un message plus long est transmis en plusieurs morceaux */
+#define LOGGER_BUFFER_SIZE 1024
+
+/**
+ * Tampon de formatage propre à un thread et à un niveau.
+ * Le message est formaté dans un tableau de taille fixe puis transmis à l'accumulateur sans allocation.
+ */
+class logbuffer : public std::streambuf {
 private:
     LogLevel level;
+    char buffer[LOGGER_BUFFER_SIZE];
+
+    /** Seconde pour laquelle date a été formatée */
+    time_t dateSecond;
+    /** Date formatée jusqu'à la seconde, réutilisée tant que la seconde ne change pas */
+    char date[32];
+    int dateLength;
+
+    void push(bool last) {
+        Accumulator* acc = Logger::getAccumulator(level);
+        if (acc && pptr() > pbase()) acc->addMessage(pbase(), pptr() - pbase(), last);
+        setp(buffer, buffer + LOGGER_BUFFER_SIZE);
+    }
 
 protected:
-    virtual int sync();
+    virtual int sync() {
+        push(true);
+        return 0;
+    }
+
+    virtual int overflow(int c) {
+        // Tampon plein : on transmet le début du message, la suite sera dans le prochain morceau
+        push(false);
+        if (c != traits_type::eof()) {
+            *pptr() = (char) c;
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
 public:
-    logbuffer(LogLevel level) : std::stringbuf(std::ios_base::out), level(level) {}
+    logbuffer(LogLevel level) : level(level), dateSecond(-1), dateLength(0) {
+        setp(buffer, buffer + LOGGER_BUFFER_SIZE);
+    }
+
+    /** Écrit l'horodatage en tête du message */
+    void putDate() {
+        timeval tim;
+        gettimeofday(&tim, NULL);
+        if (tim.tv_sec != dateSecond) {
+            tm now;
+            localtime_r(&tim.tv_sec, &now);
+            dateLength = sprintf(date, "%04d/%02d/%02d %02d:%02d:%02d", now.tm_year+1900, now.tm_mon+1, now.tm_mday, now.tm_hour, now.tm_min, now.tm_sec);
+            dateSecond = tim.tv_sec;
+        }
+        char usec[16];
+        int usecLength = sprintf(usec, ".%06d\t\t", (int) (tim.tv_usec));
+        sputn(date, dateLength);
+        sputn(usec, usecLength);
+    }
 };
 
-int logbuffer::sync() {
-    Accumulator* acc = Logger::getAccumulator(level);
-    if (acc) acc->addMessage(str());
-    str("");
-    return 0;
+pid_t Logger::pid = getpid();
+
+static void refresh_pid() {
+    Logger::refreshPid();
 }
 
+// Le pid mis en cache doit suivre les fork
+static int pid_atfork = pthread_atfork(NULL, NULL, refresh_pid);
+
 Accumulator* Logger::accumulator[nbLogLevel] = {0};
 static pthread_once_t key_once = PTHREAD_ONCE_INIT;
 static pthread_key_t logger_key[nbLogLevel];
@@ -109,12 +163,7 @@ std::ostream& Logger::getLogger(LogLevel level) {
         pthread_setspecific(logger_key[level], (void*) L);
     }
 
-    timeval tim;
-    gettimeofday(&tim, NULL);
-    char date[64];
-    tm *now = localtime(&tim.tv_sec);
-    sprintf(date, "%04d/%02d/%02d %02d:%02d:%02d.%06d\t", now->tm_year+1900, now->tm_mon+1, now->tm_mday, now->tm_hour, now->tm_min, now->tm_sec, (int) (tim.tv_usec));
-    *L << date << "\t";
+    ((logbuffer*) L->rdbuf())->putDate();
     return *L;
 }
 
@@ -65,6 +65,7 @@ class Logger {
         // TODO: ce serait plus propre d'utiliser des shared_ptr
         static Accumulator* accumulator[nbLogLevel];
         static LogOutput logOutput;
+        static pid_t pid;
     public:
         /**
          * Obtient un pointeur vers la sortie du niveau de log.
@@ -106,6 +107,17 @@ class Logger {
          */
         static std::ostream& getLogger(LogLevel level);
 
+        /**
+         * Identifiant du processus, mis en cache pour ne pas faire un appel système par message.
+         * Il est mis à jour dans le processus fils lors d'un fork.
+         */
+        inline static pid_t getPid() {
+            return pid;
+        }
+        inline static void refreshPid() {
+            pid = getpid();
+        }
+
         inline static void setOutput(LogOutput output) {logOutput=output;}
         inline static LogOutput& getOutput() {return logOutput;}
 
@@ -127,12 +139,18 @@ extern std::ostream nullstream;
 //#define LOGGER(x) (Logger::getOutput()==ROLLING_FILE?(Logger::getAccumulator(x)?Logger::getLogger(x):nullstream):std::cerr)
 #define LOGGER(x) (Logger::getAccumulator(x)?(Logger::getOutput()==STANDARD_OUTPUT_STREAM_FOR_ERRORS?std::cerr:Logger::getLogger(x)):nullstream)
 
-#define LOGGER_DEBUG(m) LOGGER(DEBUG)<<"pid="<<getpid()<<" DEBUG : "<<m<<" ("<<__FILE__<<":"<<__LINE__<<" in "<<__FUNCTION__<<")"<<std::endl
+/**
+ * Les macros de niveau ne testent le niveau qu'une fois, avant toute évaluation du message : un niveau désactivé
+ * ne coûte qu'un branchement. La forme if/else garde la macro utilisable comme une instruction simple.
+ */
+#define LOGGER_ENABLED(x) __builtin_expect(Logger::getAccumulator(x)!=0,0)
+#define LOGGER_STREAM(x) (Logger::getOutput()==STANDARD_OUTPUT_STREAM_FOR_ERRORS?std::cerr:Logger::getLogger(x))
 
-#define LOGGER_INFO(m) LOGGER(INFO)<<"pid="<<getpid()<<"  INFO : "<<m<<std::endl
-#define LOGGER_WARN(m) LOGGER(WARN)<<"pid="<<getpid()<<"  WARN : "<<m<<std::endl
-#define LOGGER_ERROR(m) LOGGER(ERROR)<<"pid="<<getpid()<<" ERROR : "<<m<<std::endl
-#define LOGGER_FATAL(m) LOGGER(FATAL)<<"pid="<<getpid()<<" FATAL : "<<m<<std::endl
+#define LOGGER_DEBUG(m) if (!LOGGER_ENABLED(DEBUG)) {} else LOGGER_STREAM(DEBUG)<<"pid="<<Logger::getPid()<<" DEBUG : "<<m<<" ("<<__FILE__<<":"<<__LINE__<<" in "<<__FUNCTION__<<")"<<std::endl
 
+#define LOGGER_INFO(m) if (!LOGGER_ENABLED(INFO)) {} else LOGGER_STREAM(INFO)<<"pid="<<Logger::getPid()<<"  INFO : "<<m<<std::endl
+#define LOGGER_WARN(m) if (!LOGGER_ENABLED(WARN)) {} else LOGGER_STREAM(WARN)<<"pid="<<Logger::getPid()<<"  WARN : "<<m<<std::endl
+#define LOGGER_ERROR(m) if (!LOGGER_ENABLED(ERROR)) {} else LOGGER_STREAM(ERROR)<<"pid="<<Logger::getPid()<<" ERROR : "<<m<<std::endl
+#define LOGGER_FATAL(m) if (!LOGGER_ENABLED(FATAL)) {} else LOGGER_STREAM(FATAL)<<"pid="<<Logger::getPid()<<" FATAL : "<<m<<std::endl
 
 #endif
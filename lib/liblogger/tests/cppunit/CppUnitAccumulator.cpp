@@ -39,6 +39,9 @@
 #include "Accumulator.h"
 #include <sys/time.h>
 #include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
 #include <map>
 
 class CppUnitAccumulator : public CPPUNIT_NS::TestFixture
@@ -48,6 +51,9 @@ class CppUnitAccumulator : public CPPUNIT_NS::TestFixture
   CPPUNIT_TEST( test_mono_thread );
   CPPUNIT_TEST( test_multi_thread );
   CPPUNIT_TEST( test_rollingfile );
+  CPPUNIT_TEST( test_long_message );
+  CPPUNIT_TEST( test_full_ring );
+  CPPUNIT_TEST( test_reopen );
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -64,7 +70,7 @@ protected:
       A->addMessage(S.str());
     }
 
-
+    return NULL;
   }
 
 
@@ -114,6 +120,94 @@ protected:
     for(int i =  0; i < 64; i++) CPPUNIT_ASSERT_EQUAL(M[T[i]], 100);
   }
 
+  void test_long_message() {
+    std::stringstream out;
+    // Une file de 16 cases : le long message ne tient pas en entier dans la file
+    Accumulator* A = new StreamAccumulator(out, 16);
+
+    std::string longMessage;
+    for(int i = 0; i < 10000; i++) longMessage += (char) ('a' + i % 26);
+    longMessage += "\n";
+
+    A->addMessage("first\n");
+    A->addMessage(longMessage.data(), 5000, false);
+    A->addMessage(longMessage.data() + 5000, longMessage.size() - 5000, true);
+    A->addMessage("last\n");
+    A->stop();
+    A->destroy();
+    delete A;
+
+    CPPUNIT_ASSERT_EQUAL(std::string("first\n") + longMessage + "last\n", out.str());
+  }
+
+  void test_full_ring() {
+    std::stringstream out;
+    // Des files de 2 cases : les producteurs attendent sans cesse le thread d'écriture
+    Accumulator* A = new StreamAccumulator(out, 2);
+
+    pthread_t T[16];
+    for(int i = 0; i < 16; i++)
+      pthread_create(&T[i], NULL, fill_accumulator, (void*) A);
+    for(int i = 0; i < 16; i++)
+      pthread_join(T[i], 0);
+    A->stop();
+    A->destroy();
+    delete A;
+
+    std::map<pthread_t, int> M;
+    for(int i = 0; i < 16*100; i++) {
+      int n;
+      pthread_t id;
+      out >> n >> id;
+      CPPUNIT_ASSERT_EQUAL(M[id], n);
+      M[id]++;
+    }
+    for(int i = 0; i < 16; i++) CPPUNIT_ASSERT_EQUAL(100, M[T[i]]);
+  }
+
+  void test_reopen() {
+    char path[64];
+    sprintf(path, "/tmp/CppUnitAccumulator_%d.log", getpid());
+    std::string rotated = std::string(path) + ".1";
+    remove(path);
+    remove(rotated.c_str());
+
+    Accumulator* A = new StaticFileAccumulator(path);
+
+    // Des threads journalisent pendant les demandes de réouverture, comme lors d'un rechargement du serveur
+    pthread_t T[8];
+    for(int i = 0; i < 8; i++)
+      pthread_create(&T[i], NULL, fill_accumulator, (void*) A);
+    for(int i = 0; i < 50; i++) A->reopen();
+    for(int i = 0; i < 8; i++)
+      pthread_join(T[i], 0);
+
+    // Une réouverture écrit d'abord les messages déjà publiés
+    A->reopen();
+
+    // Rotation externe : les messages écrits après la réouverture vont dans le nouveau fichier
+    rename(path, rotated.c_str());
+    A->reopen();
+    A->addMessage("after\n");
+
+    A->stop();
+    A->destroy();
+    delete A;
+
+    std::ifstream oldFile(rotated.c_str());
+    int lines = 0;
+    std::string line;
+    while (std::getline(oldFile, line)) lines++;
+    CPPUNIT_ASSERT_EQUAL(8*100, lines);
+
+    std::ifstream newFile(path);
+    std::getline(newFile, line);
+    CPPUNIT_ASSERT_EQUAL(std::string("after"), line);
+
+    remove(path);
+    remove(rotated.c_str());
+  }
+
   void test_rollingfile() {
     Accumulator* A = new RollingFileAccumulator("bubu",3600);
     fill_accumulator((void*) A);
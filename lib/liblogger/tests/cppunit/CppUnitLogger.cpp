@@ -57,8 +57,9 @@ protected:
         Logger::setAccumulator ( DEBUG, acc );
 
         for ( int i = 0; i < 200; i++ ) LOGGER ( DEBUG ) << i << std::endl;
-        //Logger::setAccumulator ( DEBUG, 0 );
         Logger::stopLogger();
+        // L'arrêt de l'accumulateur garantit que tous les messages sont écrits
+        acc->stop();
 
         for ( int i = 0; i < 200; i++ ) {
             std::string s1, s2;
@@ -66,6 +67,9 @@ protected:
             out >> s1 >> s2 >> n;
             CPPUNIT_ASSERT_EQUAL ( i, n );
         }
+
+        acc->destroy();
+        Logger::setAccumulator ( DEBUG, 0 );
     }
 
 };
@@ -47,7 +47,13 @@
 #include "Image.h"
 #include "Format.h"
 #include "FileImage.h"
+#include "FileContext.h"
+#include "UringFileContext.h"
+#include "Rok4Image.h"
+#include "TiffNodataManager.h"
 #include "Logger.h"
+#include "Utils.h"
+#include <pthread.h>
 #include <cstdlib>
 #include <cmath>
 #include <iostream>
@@ -84,6 +90,20 @@ uint32_t height;
 /** \~french Compression de l'image de sortie */
 Compression::eCompression compression = Compression::NONE;
 
+/** \~french Largeur des tuiles de la dalle ROK4 en sortie. Si la taille des tuiles est précisée, l'image (et le masque) en sortie sont directement écrits au format ROK4, sans image de travail */
+int tileWidth = 0;
+/** \~french Hauteur des tuiles de la dalle ROK4 en sortie */
+int tileHeight = 0;
+/** \~french Option de cropage de la dalle ROK4 en sortie, pour la compression JPEG (voir work2cache) */
+bool crop = false;
+/** \~french Contexte de stockage des dalles ROK4 en sortie */
+FileContext* outputContext = NULL;
+
+/** \~french Presque blanc, en RGBA. Utilisé pour supprimer le blanc pur des données quand l'option "crop" est active */
+int fastWhite[4] = {254,254,254,255};
+/** \~french Blanc, en RGBA. Utilisé pour supprimer le blanc pur des données quand l'option "crop" est active */
+int white[4] = {255,255,255,255};
+
 /** \~french A-t-on précisé le format en sortie, c'est à dire les 3 informations samplesperpixel, bitspersample et sampleformat */
 bool outputProvided = false;
 /** \~french Nombre de canaux par pixel, pour l'image en sortie */
@@ -99,12 +119,15 @@ Photometric::ePhotometric photometric;
 /** \~french Activation du niveau de log debug. Faux par défaut */
 bool debugLogger=false;
 
+/** \~french Table de gamma (cas entier) : pour nbData pixels de somme s, la valeur est mergeLut[nbData * 1021 + s] */
+uint8_t mergeLut[5 * 1021];
+
 /** \~french Message d'usage de la commande merge4tiff */
 std::string help = std::string("\ncache2work version ") + std::string(ROK4_VERSION) + "\n\n"
 
     "Four images subsampling, formed a square, might use a background and data masks\n\n"
 
-    "Usage: merge4tiff [-g <VAL>] -n <VAL> [-c <VAL>] [-iX <FILE> [-mX<FILE>]] -io <FILE> [-mo <FILE>]\n\n"
+    "Usage: merge4tiff [-g <VAL>] -n <VAL> [-c <VAL>] [-iX <FILE> [-mX<FILE>]] -io <FILE> [-mo <FILE>] [-t <VAL> <VAL> [-crop]]\n\n"
 
     "Parameters:\n"
     "     -g gamma float value, to dark (0 < g < 1) or brighten (1 < g) 8-bit integer images' subsampling\n"
@@ -117,7 +140,10 @@ std::string help = std::string("\ncache2work version ") + std::string(ROK4_VERSI
     "             jpg     Jpeg encoding\n"
     "             lzw     Lempel-Ziv & Welch encoding\n"
     "             pkb     PackBits encoding\n"
-    "             zip     Deflate encoding\n\n"
+    "             zip     Deflate encoding\n"
+    "             png     Non-official TIFF compression, each tile is an independant PNG image (only with -t)\n"
+    "     -t tile size : widthwise and heightwise. Output image and mask are then directly written as ROK4 slabs (tiled, with a fixed size header), without work image\n"
+    "     -crop : with -t and JPEG compression, blocks which contain a white pixel are filled with white (as work2cache does)\n\n"
 
     "     -io output image\n"
     "     -mo output mask (optionnal)\n\n"
@@ -189,6 +215,11 @@ int parseCommandLine ( int argc, char* argv[] ) {
     outputMask = 0;
 
     for ( int i = 1; i < argc; i++ ) {
+        if ( !strcmp ( argv[i],"-crop" ) ) {
+            crop = true;
+            continue;
+        }
+
         if ( argv[i][0] == '-' ) {
             switch ( argv[i][1] ) {
             case 'h': // help
@@ -226,12 +257,26 @@ int parseCommandLine ( int argc, char* argv[] ) {
                 else if ( strncmp ( argv[i], "pkb",3 ) == 0 ) compression = Compression::PACKBITS;
                 else if ( strncmp ( argv[i], "jpg",3 ) == 0 ) compression = Compression::JPEG;
                 else if ( strncmp ( argv[i], "lzw",3 ) == 0 ) compression = Compression::LZW;
+                else if ( strncmp ( argv[i], "png",3 ) == 0 ) compression = Compression::PNG;
                 else {
                     LOGGER_ERROR ( "Unknown value for option -c : " << argv[i] );
                     return -1;
                 }
                 break;
 
+            case 't': // taille des tuiles, pour une sortie au format ROK4
+                if ( i+2 >= argc ) {
+                    LOGGER_ERROR ( "Error in option -t" );
+                    return -1;
+                }
+                tileWidth = atoi ( argv[++i] );
+                tileHeight = atoi ( argv[++i] );
+                if ( tileWidth <= 0 || tileHeight <= 0 ) {
+                    LOGGER_ERROR ( "Unvalid values for option -t : tile size have to be positive" );
+                    return -1;
+                }
+                break;
+
             case 'i': // images
                 if ( ++i == argc ) {
                     LOGGER_ERROR ( "Error in option -i" );
@@ -352,6 +397,16 @@ int parseCommandLine ( int argc, char* argv[] ) {
         return -1;
     }
 
+    if ( compression == Compression::PNG && tileWidth == 0 ) {
+        LOGGER_ERROR ( "PNG compression is only available for a ROK4 output (option -t)" );
+        return -1;
+    }
+
+    if ( crop && ( tileWidth == 0 || compression != Compression::JPEG ) ) {
+        LOGGER_WARN ( "Crop option is reserved for a ROK4 output (option -t) with JPEG compression" );
+        crop = false;
+    }
+
     return 0;
 }
 
@@ -449,10 +504,11 @@ int checkComponents ( FileImage* image, FileImage* mask) {
  * \details Crée les objets TIFF, contrôle la cohérence des caractéristiques des images en entrée, ouvre les flux de lecture et écriture. Les éventuels masques associés sont ajoutés aux objets FileImage.
  * \param[in] INPUTI images en entrée
  * \param[in] BGI image de fond en entrée
- * \param[in] OUTPUTI image en sortie
+ * \param[in] OUTPUTI image en sortie, une image de travail (FileImage) ou une dalle ROK4 (Rok4Image) si la taille des tuiles est précisée
+ * \param[in] OUTPUTM éventuel masque en sortie, du même type que l'image
  * \return code de retour, 0 si réussi, -1 sinon
  */
-int checkImages ( FileImage* INPUTI[2][2], FileImage*& BGI, FileImage*& OUTPUTI, FileImage*& OUTPUTM) {
+int checkImages ( FileImage* INPUTI[2][2], FileImage*& BGI, Image*& OUTPUTI, Image*& OUTPUTM) {
     width = 0;
     FileImageFactory FIF;
 
@@ -529,16 +585,35 @@ int checkImages ( FileImage* INPUTI[2][2], FileImage*& BGI, FileImage*& OUTPUTI,
     OUTPUTI = NULL;
     OUTPUTM = NULL;
 
-    OUTPUTI = FIF.createImageToWrite(outputImage, BoundingBox<double>(0,0,0,0), -1, -1, width, height,
-                                     samplesperpixel, sampleformat, bitspersample, photometric, compression);
+    Rok4ImageFactory R4IF;
+    if ( tileWidth != 0 ) {
+        // La sortie est directement une dalle ROK4 : pas d'image de travail
+        outputContext = new UringFileContext ( "" );
+        if ( ! outputContext->connection() ) {
+            LOGGER_ERROR ( "Unable to connect output context" );
+            return -1;
+        }
+        OUTPUTI = R4IF.createRok4ImageToWrite(outputImage, BoundingBox<double>(0,0,0,0), -1, -1, width, height,
+                                              samplesperpixel, sampleformat, bitspersample, photometric, compression,
+                                              tileWidth, tileHeight, outputContext);
+    } else {
+        OUTPUTI = FIF.createImageToWrite(outputImage, BoundingBox<double>(0,0,0,0), -1, -1, width, height,
+                                         samplesperpixel, sampleformat, bitspersample, photometric, compression);
+    }
     if ( OUTPUTI == NULL ) {
         LOGGER_ERROR ( "Unable to open output image: " + std::string ( outputImage ) );
         return -1;
     }
 
     if ( outputMask ) {
-        OUTPUTM = FIF.createImageToWrite(outputMask, BoundingBox<double>(0,0,0,0), -1, -1, width, height,
-                                                   1, SampleFormat::UINT, 8, Photometric::MASK, Compression::DEFLATE);
+        if ( tileWidth != 0 ) {
+            OUTPUTM = R4IF.createRok4ImageToWrite(outputMask, BoundingBox<double>(0,0,0,0), -1, -1, width, height,
+                                                  1, SampleFormat::UINT, 8, Photometric::MASK, Compression::DEFLATE,
+                                                  tileWidth, tileHeight, outputContext);
+        } else {
+            OUTPUTM = FIF.createImageToWrite(outputMask, BoundingBox<double>(0,0,0,0), -1, -1, width, height,
+                                             1, SampleFormat::UINT, 8, Photometric::MASK, Compression::DEFLATE);
+        }
         if ( OUTPUTM == NULL ) {
             LOGGER_ERROR ( "Unable to open output mask: " + std::string ( outputMask ) );
             return -1;
@@ -580,39 +655,250 @@ int fillBgLine ( FileImage* BGI, T* image, uint8_t* mask, int line, T* nodata )
     return 0;
 }
 
+/**
+ * \~french
+ * \brief Lecture complète d'une image en entrée et de son éventuel masque, destinée à être exécutée dans un thread
+ * \details Les pixels sans donnée (selon le masque) sont mis à 0, afin de pouvoir être sommés directement. En l'absence de masque, celui-ci est rempli avec 255.
+ */
+template <typename T>
+struct ReadingJob {
+    /** \~french Image à lire, avec son masque éventuellement associé */
+    FileImage* image;
+    /** \~french Buffer recevant l'ensemble des lignes de l'image */
+    T* data;
+    /** \~french Buffer recevant l'ensemble des lignes du masque */
+    uint8_t* mask;
+    /** \~french Code de retour de la lecture, 0 si réussie, -1 sinon */
+    int status;
+};
+
+/**
+ * \~french
+ * \brief Fonction de thread lisant une image en entrée dans son intégralité
+ * \param[in,out] arg lecture à réaliser, de type ReadingJob
+ */
+template <typename T>
+void* readImage ( void* arg ) {
+    ReadingJob<T>* job = ( ReadingJob<T>* ) arg;
+    int nbsamples = width * samplesperpixel;
+
+    job->status = -1;
+
+    for ( uint32_t l = 0; l < height; l++ ) {
+        if ( job->image->getline( job->data + l * nbsamples, l ) == 0 ) return NULL;
+    }
+
+    if ( job->image->getMask() ) {
+        for ( uint32_t l = 0; l < height; l++ ) {
+            if ( job->image->getMask()->getline( job->mask + l * width, l ) == 0 ) return NULL;
+        }
+        for ( uint32_t p = 0; p < width * height; p++ ) {
+            if ( job->mask[p] == 0 ) memset ( job->data + p * samplesperpixel, 0, samplesperpixel * sizeof ( T ) );
+        }
+    } else {
+        memset ( job->mask, 255, width * height );
+    }
+
+    job->status = 0;
+    return NULL;
+}
+
+/**
+ * \~french
+ * \brief Calcule un pixel en sortie à partir des sommes verticales de ses deux colonnes sources (cas entier)
+ * \details La table de gamma #mergeLut est indexée par le nombre de pixels contenant de la donnée et par leur somme : la division est précalculée
+ * \param[out] out pixel en sortie
+ * \param[in] sumA somme verticale de la colonne de gauche
+ * \param[in] sumB somme verticale de la colonne de droite
+ * \param[in] nbData nombre de pixels sources contenant de la donnée (2, 3 ou 4)
+ */
+inline void mergePixel ( uint8_t* out, const uint16_t* sumA, const uint16_t* sumB, int nbData ) {
+    const uint8_t* l = mergeLut + nbData * 1021;
+    for ( int c = 0; c < samplesperpixel; c++ ) out[c] = l[sumA[c] + sumB[c]];
+}
+
+/**
+ * \~french
+ * \brief Calcule un pixel en sortie à partir des sommes verticales de ses deux colonnes sources (cas flottant)
+ * \details Simple moyenne des pixels contenant de la donnée, la table de gamma n'est pas utilisée
+ * \param[out] out pixel en sortie
+ * \param[in] sumA somme verticale de la colonne de gauche
+ * \param[in] sumB somme verticale de la colonne de droite
+ * \param[in] nbData nombre de pixels sources contenant de la donnée (2, 3 ou 4)
+ */
+inline void mergePixel ( float* out, const float* sumA, const float* sumB, int nbData ) {
+    for ( int c = 0; c < samplesperpixel; c++ ) out[c] = ( sumA[c] + sumB[c] ) / ( float ) nbData;
+}
+
+/**
+ * \~french
+ * \brief Enregistre une ligne de l'image (et du masque) en sortie
+ * \details Dans le cas d'une sortie au format de travail, la ligne est directement écrite. Dans le cas d'une sortie ROK4, elle est stockée dans l'image entière en mémoire, tuilée et compressée à la fin.
+ * \param[in] OUTPUTI image en sortie
+ * \param[in] OUTPUTM éventuel masque en sortie
+ * \param[in] slabI image entière, NULL si la sortie n'est pas une dalle ROK4
+ * \param[in] slabM masque entier, NULL si la sortie n'est pas une dalle ROK4
+ * \param[in] lineI ligne de l'image à enregistrer
+ * \param[in] lineM ligne du masque à enregistrer
+ * \param[in] line indice de la ligne
+ * \return code de retour, 0 si réussi, -1 sinon
+ */
+template <typename T>
+int storeLine ( Image* OUTPUTI, Image* OUTPUTM, T* slabI, uint8_t* slabM, T* lineI, uint8_t* lineM, int line ) {
+    if ( slabI ) {
+        memcpy ( slabI + line * width * samplesperpixel, lineI, width * samplesperpixel * sizeof ( T ) );
+        memcpy ( slabM + line * width, lineM, width );
+        return 0;
+    }
+
+    if ( ( ( FileImage* ) OUTPUTI )->writeLine ( lineI, line ) == -1 ) {
+        LOGGER_ERROR ( "Unable to write image's line " << line );
+        return -1;
+    }
+    if ( OUTPUTM && ( ( FileImage* ) OUTPUTM )->writeLine ( lineM, line ) == -1 ) {
+        LOGGER_ERROR ( "Unable to write mask's line " << line );
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * \~french
+ * \brief Écrit la dalle ROK4 en sortie, à partir de l'image entière (cas entier)
+ * \details Avec l'option crop, le blanc pur des données est d'abord remplacé par du presque blanc, comme le fait work2cache sur l'image de travail.
+ * \param[in] OUTPUTI dalle ROK4 en sortie
+ * \param[in] slabI image entière
+ * \return code de retour, 0 si réussi, -1 sinon
+ */
+int writeSlab ( Rok4Image* OUTPUTI, uint8_t* slabI ) {
+    if ( crop ) {
+        TiffNodataManager<uint8_t> TNM ( samplesperpixel, white, true, fastWhite, white );
+        if ( ! TNM.treatNodata ( slabI, width, height, samplesperpixel ) ) {
+            LOGGER_ERROR ( "Unable to treat white pixels in the output image" );
+            return -1;
+        }
+    }
+    return OUTPUTI->writeImage ( slabI, crop );
+}
+
+/**
+ * \~french
+ * \brief Écrit la dalle ROK4 en sortie, à partir de l'image entière (cas flottant)
+ * \param[in] OUTPUTI dalle ROK4 en sortie
+ * \param[in] slabI image entière
+ * \return code de retour, 0 si réussi, -1 sinon
+ */
+int writeSlab ( Rok4Image* OUTPUTI, float* slabI ) {
+    return OUTPUTI->writeImage ( slabI );
+}
+
+/**
+ * \~french
+ * \brief Buffers de travail de la fusion
+ * \details Ils sont tous libérés à la destruction, quelle que soit l'issue de la fusion
+ */
+template <typename T, typename S>
+struct MergeBuffers {
+    /** \~french Ligne de l'image de fond */
+    T* line_bgI;
+    /** \~french Ligne du masque de fond */
+    uint8_t* line_bgM;
+    /** \~french Ligne de l'image en sortie */
+    T* line_outI;
+    /** \~french Ligne du masque en sortie */
+    uint8_t* line_outM;
+    /** \~french Sommes verticales des deux lignes sources */
+    S* sums;
+    /** \~french Nombre de pixels de donnée par colonne des deux lignes sources */
+    uint8_t* counts;
+    /** \~french Image entière en sortie, NULL si la sortie n'est pas une dalle ROK4 */
+    T* slabI;
+    /** \~french Masque entier en sortie, NULL si la sortie n'est pas une dalle ROK4 */
+    uint8_t* slabM;
+    /** \~french Lectures des deux images d'une moitié */
+    ReadingJob<T> jobs[2];
+
+    MergeBuffers ( int nbsamples, bool wholeSlab ) {
+        line_bgI = new T[nbsamples];
+        line_bgM = new uint8_t[width];
+        line_outI = new T[nbsamples];
+        line_outM = new uint8_t[width];
+        sums = new S[nbsamples];
+        counts = new uint8_t[width];
+
+        slabI = NULL;
+        slabM = NULL;
+        if ( wholeSlab ) {
+            slabI = new T[nbsamples * height];
+            slabM = new uint8_t[width * height];
+        }
+
+        for ( int x = 0; x < 2; x++ ) {
+            jobs[x].data = new T[nbsamples * height];
+            jobs[x].mask = new uint8_t[width * height];
+        }
+    }
+
+    ~MergeBuffers() {
+        for ( int x = 0; x < 2; x++ ) {
+            delete[] jobs[x].data;
+            delete[] jobs[x].mask;
+        }
+        delete[] slabI;
+        delete[] slabM;
+        delete[] sums;
+        delete[] counts;
+        delete[] line_bgI;
+        delete[] line_bgM;
+        delete[] line_outI;
+        delete[] line_outM;
+    }
+};
+
 /**
  * \~french
  * \brief Fusionne les 4 images en entrée et le masque de fond dans l'image de sortie
  * \details Dans le cas entier, lors de la moyenne des 4 pixels, on utilise une valeur de gamma qui éclaircit (si supérieure à 1.0) ou fonce (si inférieure à 1.0) le résultat. Si gamma vaut 1, le résultat est une moyenne classique. Les masques sont déjà associé aux objets FileImage, sauf pour l'image de sortie.
+ *
+ * Dans le cas d'une sortie ROK4, l'image en sortie est constituée entièrement en mémoire, puis tuilée et compressée, sans passer par une image de travail.
+ *
+ * Les deux images d'une même moitié (haute puis basse) de l'image de sortie sont lues intégralement et en parallèle, chacune dans son thread. Les deux lignes sources sont ensuite sommées verticalement (instructions SSE2), avant la réduction horizontale par paires de pixels.
+ *
  * \param[in] BGI image de fond en entrée
  * \param[in] INPUTI images en entrée
  * \param[in] OUTPUTI image en sortie
  * \param[in] OUTPUTI éventuel masque en sortie
+ * \param[in] nodata valeur de nodata
  * \return code de retour, 0 si réussi, -1 sinon
  */
-template <typename T>
-int merge ( FileImage* BGI, FileImage* INPUTI[2][2], FileImage* OUTPUTI, FileImage* OUTPUTM, T* nodata ) {
-    
-    uint8 MERGE[1024];
-    for ( int i = 0; i <= 1020; i++ ) MERGE[i] = 255 - ( uint8 ) round ( pow ( double ( 1020 - i ) /1020., gammaM4t ) * 255. );
-
-    int nbsamples = width * samplesperpixel;
-    int left,right;
-
-    T line_bgI[nbsamples];
-    uint8_t line_bgM[width];
-
-    int nbData;
-    float pix[samplesperpixel];
+template <typename T, typename S>
+int merge ( FileImage* BGI, FileImage* INPUTI[2][2], Image* OUTPUTI, Image* OUTPUTM, T* nodata ) {
 
-    T line_1I[2*nbsamples];
-    uint8_t line_1M[2*width];
+    // Table de gamma : pour nbData pixels de somme s, la valeur est mergeLut[nbData * 1021 + s]
+    uint8_t MERGE[1024];
+    for ( int i = 0; i <= 1020; i++ ) MERGE[i] = 255 - ( uint8 ) round ( pow ( double ( 1020 - i ) /1020., gammaM4t ) * 255. );
 
-    T line_2I[2*nbsamples];
-    uint8_t line_2M[2*width];
+    memset ( mergeLut, 0, 5 * 1021 );
+    for ( int n = 2; n <= 4; n++ ) {
+        for ( int s = 0; s <= 255 * n; s++ ) mergeLut[n * 1021 + s] = MERGE[s * 4 / n];
+    }
 
-    T line_outI[nbsamples];
-    uint8_t line_outM[width];
+    int nbsamples = width * samplesperpixel;
+    int halfWidth = width / 2;
+
+    // Sortie ROK4 : l'image et le masque entiers sont constitués en mémoire
+    MergeBuffers<T, S> buffers ( nbsamples, tileWidth != 0 );
+    T* line_bgI = buffers.line_bgI;
+    uint8_t* line_bgM = buffers.line_bgM;
+    T* line_outI = buffers.line_outI;
+    uint8_t* line_outM = buffers.line_outM;
+    S* sums = buffers.sums;
+    uint8_t* counts = buffers.counts;
+    T* slabI = buffers.slabI;
+    uint8_t* slabM = buffers.slabM;
+    ReadingJob<T>* jobs = buffers.jobs;
+    pthread_t threads[2];
 
     // ----------- initialisation du fond -----------
     for ( int i = 0; i < nbsamples ; i++ )
@@ -621,10 +907,33 @@ int merge ( FileImage* BGI, FileImage* INPUTI[2][2], FileImage* OUTPUTI, FileIma
     memset ( line_bgM,0,width );
 
     for ( int y = 0; y < 2; y++ ) {
-        if ( INPUTI[y][0] ) left = 0;
-        else left = width;
-        if ( INPUTI[y][1] ) right = 2*width;
-        else right = width;
+
+        // ------- lecture parallèle des images --------
+        // ------- et de leurs éventuels masques --------
+        // Les threads lancés sont toujours attendus, même en cas d'échec, avant la libération des buffers
+        bool started[2] = {false, false};
+        bool readOk = true;
+        for ( int x = 0; x < 2; x++ ) {
+            if ( ! INPUTI[y][x] ) continue;
+            jobs[x].image = INPUTI[y][x];
+            if ( pthread_create ( & ( threads[x] ), NULL, readImage<T>, ( void* ) & ( jobs[x] ) ) != 0 ) {
+                LOGGER_ERROR ( "Unable to create reading thread" );
+                readOk = false;
+                break;
+            }
+            started[x] = true;
+        }
+        for ( int x = 0; x < 2; x++ ) {
+            if ( ! started[x] ) continue;
+            if ( pthread_join ( threads[x], NULL ) != 0 ) {
+                LOGGER_ERROR ( "Unable to join reading thread" );
+                readOk = false;
+            } else if ( jobs[x].status != 0 ) {
+                LOGGER_ERROR ( "Unable to read data from " << INPUTI[y][x]->getFilename() );
+                readOk = false;
+            }
+        }
+        if ( ! readOk ) return -1;
 
         for ( uint32 h = 0; h < height/2; h++ ) {
 
@@ -637,17 +946,11 @@ int merge ( FileImage* BGI, FileImage* INPUTI[2][2], FileImage* OUTPUTI, FileIma
                     return -1;
                 }
 
-            if ( left == right ) {
+            if ( ! INPUTI[y][0] && ! INPUTI[y][1] ) {
                 // On n'a pas d'image en entrée pour cette ligne, on stocke le fond et on passe à la suivante
-                if ( OUTPUTI->writeLine( line_bgI, line ) == -1 ) {
-                    LOGGER_ERROR ( "Unable to write image's line " << line );
+                if ( storeLine ( OUTPUTI, OUTPUTM, slabI, slabM, line_bgI, line_bgM, line ) < 0 ) {
                     return -1;
                 }
-                if ( OUTPUTM )
-                    if ( OUTPUTM->writeLine( line_bgM, line ) == -1 ) {
-                        LOGGER_ERROR ( "Unable to write mask's line " << line );
-                        return -1;
-                    }
 
                 continue;
             }
@@ -655,104 +958,44 @@ int merge ( FileImage* BGI, FileImage* INPUTI[2][2], FileImage* OUTPUTI, FileIma
             // -- initialisation de la sortie avec le fond --
             memcpy ( line_outI,line_bgI,nbsamples*sizeof ( T ) );
             memcpy ( line_outM,line_bgM,width );
-            
-            memset ( line_1M,255,2*width );
-            memset ( line_2M,255,2*width );
-
-            // ----------------- les images -----------------
-            // ------ et les éventuels masques --------------
-            if ( INPUTI[y][0] ) {
-                if ( INPUTI[y][0]->getline( line_1I, 2*h ) == 0 ) {
-                    LOGGER_ERROR ( "Unable to read data line" );
-                    return -1;
-                }
-                if ( INPUTI[y][0]->getline( line_2I, 2*h+1 ) == 0 ) {
-                    LOGGER_ERROR ( "Unable to read data line" );
-                    return -1;
-                }
-
-                if ( INPUTI[y][0]->getMask() ) {
-                    if ( INPUTI[y][0]->getMask()->getline( line_1M, 2*h ) == 0 ) {
-                        LOGGER_ERROR ( "Unable to read data line" );
-                        return -1;
-                    }
-                    if ( INPUTI[y][0]->getMask()->getline( line_2M, 2*h+1 ) == 0 ) {
-                        LOGGER_ERROR ( "Unable to read data line" );
-                        return -1;
-                    }
-                }
-            }
-
-
-            if ( INPUTI[y][1] ) {
-                if ( INPUTI[y][1]->getline( line_1I + nbsamples, 2*h ) == 0 ) {
-                    LOGGER_ERROR ( "Unable to read data line" );
-                    return -1;
-                }
-                if ( INPUTI[y][1]->getline( line_2I + nbsamples, 2*h+1 ) == 0 ) {
-                    LOGGER_ERROR ( "Unable to read data line" );
-                    return -1;
-                }
-
-                if ( INPUTI[y][1]->getMask() ) {
-                    if ( INPUTI[y][1]->getMask()->getline( line_1M + width, 2*h ) == 0 ) {
-                        LOGGER_ERROR ( "Unable to read data line" );
-                        return -1;
-                    }
-                    if ( INPUTI[y][1]->getMask()->getline( line_2M + width, 2*h+1 ) == 0 ) {
-                        LOGGER_ERROR ( "Unable to read data line" );
-                        return -1;
-                    }
-                }
-            }
 
             // ----------------- la moyenne ----------------
-            for ( int pixIn = left, sampleIn = left * samplesperpixel; pixIn < right;
-                    pixIn += 2, sampleIn += 2*samplesperpixel ) {
-
-                memset ( pix,0,samplesperpixel*sizeof ( float ) );
-                nbData = 0;
-
-                if ( line_1M[pixIn] ) {
-                    nbData++;
-                    for ( int c = 0; c < samplesperpixel; c++ ) pix[c] += line_1I[sampleIn+c];
-                }
-
-                if ( line_1M[pixIn+1] ) {
-                    nbData++;
-                    for ( int c = 0; c < samplesperpixel; c++ ) pix[c] += line_1I[sampleIn+samplesperpixel+c];
-                }
-
-                if ( line_2M[pixIn] ) {
-                    nbData++;
-                    for ( int c = 0; c < samplesperpixel; c++ ) pix[c] += line_2I[sampleIn+c];
-                }
-
-                if ( line_2M[pixIn+1] ) {
-                    nbData++;
-                    for ( int c = 0; c < samplesperpixel; c++ ) pix[c] += line_2I[sampleIn+samplesperpixel+c];
-                }
-
-                if ( nbData > 1 ) {
-                    line_outM[pixIn/2] = 255;
-                    if ( sizeof ( T ) == 1 ) {
-                        // Cas entier : utilisation d'un gamma
-                        for ( int c = 0; c < samplesperpixel; c++ ) line_outI[sampleIn/2+c] = MERGE[ ( int ) pix[c]*4/nbData];
-                    } else if ( sizeof ( T ) == 4 ) {
-                        for ( int c = 0; c < samplesperpixel; c++ ) line_outI[sampleIn/2+c] = pix[c]/ ( float ) nbData;
+            for ( int x = 0; x < 2; x++ ) {
+                if ( ! INPUTI[y][x] ) continue;
+
+                T* line_1I = jobs[x].data + 2*h*nbsamples;
+                uint8_t* line_1M = jobs[x].mask + 2*h*width;
+
+                // Somme verticale des deux lignes sources et décompte des pixels de donnée
+                add_lines ( sums, line_1I, line_1I + nbsamples, nbsamples );
+                count_masks ( counts, line_1M, line_1M + width, width );
+
+                // Réduction horizontale, par paire de colonnes
+                for ( int p = 0; p < halfWidth; p++ ) {
+                    int nbData = counts[2*p] + counts[2*p+1];
+                    if ( nbData > 1 ) {
+                        int pixOut = x*halfWidth + p;
+                        line_outM[pixOut] = 255;
+                        mergePixel ( line_outI + pixOut*samplesperpixel, sums + 2*p*samplesperpixel,
+                                     sums + ( 2*p+1 ) *samplesperpixel, nbData );
                     }
                 }
             }
 
-            if ( OUTPUTI->writeLine( line_outI, line ) == -1 ) {
-                LOGGER_ERROR ( "Unable to write image" );
+            if ( storeLine ( OUTPUTI, OUTPUTM, slabI, slabM, line_outI, line_outM, line ) < 0 ) {
                 return -1;
             }
-            if ( OUTPUTM )
-                if ( OUTPUTM->writeLine( line_outM, line ) == -1 ) {
-                    LOGGER_ERROR ( "Unable to write mask" );
-                    return -1;
-                }
+        }
+    }
+
+    if ( slabI ) {
+        if ( writeSlab ( ( Rok4Image* ) OUTPUTI, slabI ) < 0 ) {
+            LOGGER_ERROR ( "Unable to write the ROK4 image" );
+            return -1;
+        }
+        if ( OUTPUTM && ( ( Rok4Image* ) OUTPUTM )->writeImage ( slabM ) < 0 ) {
+            LOGGER_ERROR ( "Unable to write the ROK4 mask" );
+            return -1;
         }
     }
 
@@ -775,8 +1018,8 @@ int merge ( FileImage* BGI, FileImage* INPUTI[2][2], FileImage* OUTPUTI, FileIma
 int main ( int argc, char* argv[] ) {
     FileImage* INPUTI[2][2];
     FileImage* BGI;
-    FileImage* OUTPUTI;
-    FileImage* OUTPUTM;
+    Image* OUTPUTI;
+    Image* OUTPUTM;
 
     /* Initialisation des Loggers */
     Logger::setOutput ( STANDARD_OUTPUT_STREAM_FOR_ERRORS );
@@ -838,14 +1081,14 @@ int main ( int argc, char* argv[] ) {
         LOGGER_DEBUG ( "Merge images (float)" );
         float nodata[samplesperpixel];
         for ( int i = 0; i < samplesperpixel; i++ ) nodata[i] = ( float ) nodataInt[i];
-        if ( merge<float> ( BGI, INPUTI, OUTPUTI, OUTPUTM, nodata ) < 0 ) error ( "Unable to merge float images",-1 );
+        if ( merge<float, float> ( BGI, INPUTI, OUTPUTI, OUTPUTM, nodata ) < 0 ) error ( "Unable to merge float images",-1 );
     }
     // Cas images
     else if ( bitspersample == 8 && sampleformat == SampleFormat::UINT ) {
         LOGGER_DEBUG ( "Merge images (uint8_t)" );
         uint8_t nodata[samplesperpixel];
         for ( int i = 0; i < samplesperpixel; i++ ) nodata[i] = ( uint8_t ) nodataInt[i];
-        if ( merge ( BGI, INPUTI, OUTPUTI, OUTPUTM, nodata ) < 0 ) error ( "Unable to merge integer images",-1 );
+        if ( merge<uint8_t, uint16_t> ( BGI, INPUTI, OUTPUTI, OUTPUTM, nodata ) < 0 ) error ( "Unable to merge integer images",-1 );
     } else {
         error ( "Unhandled sample's format",-1 );
     }
@@ -860,6 +1103,7 @@ int main ( int argc, char* argv[] ) {
     }
 
     delete OUTPUTI;
+    delete outputContext;
 
     // Suppression du nettoyage du logger jusqu'à sa refonte
     // Logger::stopLogger();
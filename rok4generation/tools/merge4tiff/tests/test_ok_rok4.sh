@@ -0,0 +1,8 @@
+#!/bin/bash
+echo "test ok rok4"
+merge4tiff -c jpg -n 255,255,255 -i1 inputs/01.jpg -i2 inputs/02.jpg -i3 inputs/03.jpg -m3 inputs/03m.tif -io outputs/test_ok_rok4_i.tif -mo outputs/test_ok_rok4_m.tif -t 100 100 -crop
+if [ $? != 0 ] ; then 
+    exit 1
+else
+    exit 0
+fi
@@ -66,6 +66,10 @@
 #include "Logger.h"
 
 #include "FileImage.h"
+#include "FileContext.h"
+#include "UringFileContext.h"
+#include "Rok4Image.h"
+#include "TiffNodataManager.h"
 #include "ResampledImage.h"
 #include "ReprojectedImage.h"
 #include "ExtendedCompoundImage.h"
@@ -107,6 +111,21 @@ Photometric::ePhotometric photometric;
 
 /** \~french Compression de l'image de sortie */
 Compression::eCompression compression = Compression::NONE;
+
+/** \~french Largeur des tuiles de la dalle ROK4 en sortie. Si la taille des tuiles est précisée, l'image (et le masque) en sortie sont directement écrits au format ROK4, sans image de travail */
+int tileWidth = 0;
+/** \~french Hauteur des tuiles de la dalle ROK4 en sortie */
+int tileHeight = 0;
+/** \~french Option de cropage de la dalle ROK4 en sortie, pour la compression JPEG (voir work2cache) */
+bool crop = false;
+/** \~french Contexte de stockage des dalles ROK4 en sortie */
+FileContext* outputContext = NULL;
+
+/** \~french Presque blanc, en RGBA. Utilisé pour supprimer le blanc pur des données quand l'option "crop" est active */
+int fastWhite[4] = {254,254,254,255};
+/** \~french Blanc, en RGBA. Utilisé pour supprimer le blanc pur des données quand l'option "crop" est active */
+int white[4] = {255,255,255,255};
+
 /** \~french Interpolation utilisée pour le réechantillonnage ou la reprojection */
 Interpolation::KernelType interpolation = Interpolation::CUBIC;
 
@@ -118,7 +137,7 @@ std::string help = std::string("\nmergeNtiff version ") + std::string(ROK4_VERSI
 
     "Create one georeferenced TIFF image from several georeferenced TIFF images.\n\n"
 
-    "Usage: mergeNtiff -f <FILE> [-r <DIR>] -c <VAL> -i <VAL> -n <VAL> [-a <VAL> -s <VAL> -b <VAL>]\n"
+    "Usage: mergeNtiff -f <FILE> [-r <DIR>] -c <VAL> -i <VAL> -n <VAL> [-a <VAL> -s <VAL> -b <VAL>] [-t <VAL> <VAL> [-crop]]\n"
 
     "Parameters:\n"
     "    -f configuration file : list of output and source images and masks\n"
@@ -130,6 +149,9 @@ std::string help = std::string("\nmergeNtiff version ") + std::string(ROK4_VERSI
     "            lzw     Lempel-Ziv & Welch encoding\n"
     "            pkb     PackBits encoding\n"
     "            zip     Deflate encoding\n"
+    "            png     Non-official TIFF compression, each tile is an independant PNG image (only with -t)\n"
+    "    -t tile size : widthwise and heightwise. Output image and mask are then directly written as ROK4 slabs (tiled, with a fixed size header), without work image\n"
+    "    -crop : with -t and JPEG compression, blocks which contain a white pixel are filled with white (as work2cache does)\n"
     "    -i interpolation : used for resampling :\n"
     "            nn nearest neighbor\n"
     "            linear\n"
@@ -184,6 +206,11 @@ void error ( std::string message, int errorCode ) {
 int parseCommandLine ( int argc, char** argv ) {
 
     for ( int i = 1; i < argc; i++ ) {
+        if ( !strcmp ( argv[i],"-crop" ) ) {
+            crop = true;
+            continue;
+        }
+
         if ( argv[i][0] == '-' ) {
             switch ( argv[i][1] ) {
             case 'h': // help
@@ -238,11 +265,24 @@ int parseCommandLine ( int argc, char** argv ) {
                 else if ( strncmp ( argv[i], "pkb",3 ) == 0 ) compression = Compression::PACKBITS;
                 else if ( strncmp ( argv[i], "jpg",3 ) == 0 ) compression = Compression::JPEG;
                 else if ( strncmp ( argv[i], "lzw",3 ) == 0 ) compression = Compression::LZW;
+                else if ( strncmp ( argv[i], "png",3 ) == 0 ) compression = Compression::PNG;
                 else {
                     LOGGER_ERROR ( "Unknown value for option -c : " << argv[i] );
                     return -1;
                 }
                 break;
+            case 't': // taille des tuiles, pour une sortie au format ROK4
+                if ( i+2 >= argc ) {
+                    LOGGER_ERROR ( "Error in option -t" );
+                    return -1;
+                }
+                tileWidth = atoi ( argv[++i] );
+                tileHeight = atoi ( argv[++i] );
+                if ( tileWidth <= 0 || tileHeight <= 0 ) {
+                    LOGGER_ERROR ( "Unvalid values for option -t : tile size have to be positive" );
+                    return -1;
+                }
+                break;
 
             /****************** OPTIONNEL, POUR FORCER DES CONVERSIONS **********************/
             case 's': // samplesperpixel
@@ -292,6 +332,16 @@ int parseCommandLine ( int argc, char** argv ) {
         }
     }
 
+    if ( compression == Compression::PNG && tileWidth == 0 ) {
+        LOGGER_ERROR ( "PNG compression is only available for a ROK4 output (option -t)" );
+        return -1;
+    }
+
+    if ( crop && ( tileWidth == 0 || compression != Compression::JPEG ) ) {
+        LOGGER_WARN ( "Crop option is reserved for a ROK4 output (option -t) with JPEG compression" );
+        crop = false;
+    }
+
     LOGGER_DEBUG ( "mergeNtiff -f " << imageListFilename );
 
     return 0;
@@ -408,12 +458,12 @@ bool loadConfiguration (
  * \details On va récupérer toutes les informations de toutes les images et masques présents dans le fichier de configuration et créer les objets FileImage correspondant. Toutes les images ici manipulées sont de vraies images (physiques) dans ce sens où elles sont des fichiers soit lus, soit qui seront écrits.
  *
  * Le chemin vers le fichier de configuration est stocké dans la variables globale imageListFilename et outImagesRoot va être concaténer au chemin vers les fichiers de sortie.
- * \param[out] ppImageOut image résultante de l'outil
+ * \param[out] ppImageOut image résultante de l'outil, une image de travail (FileImage) ou une dalle ROK4 (Rok4Image) si la taille des tuiles est précisée
  * \param[out] ppMaskOut masque résultat de l'outil, si demandé
  * \param[out] pImageIn ensemble des images en entrée
  * \return code de retour, 0 si réussi, -1 sinon
  */
-int loadImages ( FileImage** ppImageOut, FileImage** ppMaskOut, std::vector<FileImage*>* pImageIn ) {
+int loadImages ( Image** ppImageOut, Image** ppMaskOut, std::vector<FileImage*>* pImageIn ) {
 
 
     std::vector<bool> masks;
@@ -548,10 +598,26 @@ int loadImages ( FileImage** ppImageOut, FileImage** ppMaskOut, std::vector<File
     int width = lround ( ( bboxes.at(0).xmax - bboxes.at(0).xmin ) / ( resxs.at(0) ) );
     int height = lround ( ( bboxes.at(0).ymax - bboxes.at(0).ymin ) / ( resys.at(0) ) );
 
-    *ppImageOut = factory.createImageToWrite (
-        paths.at(0), bboxes.at(0), resxs.at(0), resys.at(0), width, height,
-        samplesperpixel, sampleformat, bitspersample, photometric, compression
-    );
+    if ( tileWidth != 0 ) {
+        // La sortie est directement une dalle ROK4 : pas d'image de travail
+        outputContext = new UringFileContext ( "" );
+        if ( ! outputContext->connection() ) {
+            LOGGER_ERROR ( "Unable to connect output context" );
+            return -1;
+        }
+
+        Rok4ImageFactory R4IF;
+        *ppImageOut = R4IF.createRok4ImageToWrite (
+            paths.at(0), bboxes.at(0), resxs.at(0), resys.at(0), width, height,
+            samplesperpixel, sampleformat, bitspersample, photometric, compression,
+            tileWidth, tileHeight, outputContext
+        );
+    } else {
+        *ppImageOut = factory.createImageToWrite (
+            paths.at(0), bboxes.at(0), resxs.at(0), resys.at(0), width, height,
+            samplesperpixel, sampleformat, bitspersample, photometric, compression
+        );
+    }
 
     if ( *ppImageOut == NULL ) {
         LOGGER_ERROR ( "Impossible de creer l'image " << paths.at(0) );
@@ -563,10 +629,19 @@ int loadImages ( FileImage** ppImageOut, FileImage** ppMaskOut, std::vector<File
 
     if ( firstInput == 2 ) {
 
-        *ppMaskOut = factory.createImageToWrite (
-            paths.at(1), bboxes.at(0), resxs.at(0), resys.at(0), width, height,
-            1, SampleFormat::UINT, 8, Photometric::MASK, Compression::DEFLATE
-        );
+        if ( tileWidth != 0 ) {
+            Rok4ImageFactory R4IF;
+            *ppMaskOut = R4IF.createRok4ImageToWrite (
+                paths.at(1), bboxes.at(0), resxs.at(0), resys.at(0), width, height,
+                1, SampleFormat::UINT, 8, Photometric::MASK, Compression::DEFLATE,
+                tileWidth, tileHeight, outputContext
+            );
+        } else {
+            *ppMaskOut = factory.createImageToWrite (
+                paths.at(1), bboxes.at(0), resxs.at(0), resys.at(0), width, height,
+                1, SampleFormat::UINT, 8, Photometric::MASK, Compression::DEFLATE
+            );
+        }
 
         if ( *ppMaskOut == NULL ) {
             LOGGER_ERROR ( "Impossible de creer le masque " << paths.at(1) );
@@ -736,7 +811,7 @@ void makePhase ( Image* pImage, BoundingBox<double> *bbox ) {
  * \param[in] ppRImage image réechantillonnée
  * \return VRAI si succès, FAUX sinon
  */
-bool resampleImages ( FileImage* pImageOut, ExtendedCompoundImage* pECI, ResampledImage** ppRImage ) {
+bool resampleImages ( Image* pImageOut, ExtendedCompoundImage* pECI, ResampledImage** ppRImage ) {
 
     double resx_dst = pImageOut->getResX(), resy_dst = pImageOut->getResY();
 
@@ -816,7 +891,7 @@ bool resampleImages ( FileImage* pImageOut, ExtendedCompoundImage* pECI, Resampl
  * \param[in] ppRImage image reprojetée
  * \return VRAI si succès, FAUX sinon
  */
-bool reprojectImages ( FileImage* pImageOut, ExtendedCompoundImage* pECI, ReprojectedImage** ppRImage ) {
+bool reprojectImages ( Image* pImageOut, ExtendedCompoundImage* pECI, ReprojectedImage** ppRImage ) {
 
     double resx_dst = pImageOut->getResX(), resy_dst = pImageOut->getResY();
     double resx_src = pECI->getResX(), resy_src = pECI->getResY();
@@ -979,7 +1054,7 @@ bool reprojectImages ( FileImage* pImageOut, ExtendedCompoundImage* pECI, Reproj
  * \param[in] nodata valeur de non-donnée
  * \return 0 en cas de succès, -1 en cas d'erreur
  */
-int mergeTabImages ( FileImage* pImageOut, // Sortie
+int mergeTabImages ( Image* pImageOut, // Sortie
                      std::vector<std::vector<Image*> >& TabImageIn, // Entrée
                      ExtendedCompoundImage** ppECIout, // Résultat du merge
                      int* nodata ) {
@@ -1071,6 +1146,78 @@ int mergeTabImages ( FileImage* pImageOut, // Sortie
     return 0;
 }
 
+/**
+ * \~french
+ * \brief Enregistre l'image fusionnée et son éventuel masque
+ * \details Si la taille des tuiles est précisée, la sortie est directement écrite au format ROK4 (tuilée, compressée), sans passer par une image de travail et work2cache. Avec l'option crop, le blanc pur des données est remplacé par du presque blanc sur l'image chargée en mémoire, comme le fait work2cache sur l'image de travail.
+ * \param[in] pImageOut image de sortie
+ * \param[in] pMaskOut masque de sortie, NULL si non demandé
+ * \param[in] pECI image fusionnée, source des données
+ * \return code de retour, 0 si réussi, -1 sinon
+ */
+int saveImages ( Image* pImageOut, Image* pMaskOut, ExtendedCompoundImage* pECI ) {
+
+    if ( tileWidth == 0 ) {
+        // Sortie au format de travail
+        if ( ( ( FileImage* ) pImageOut )->writeImage ( pECI ) < 0 ) {
+            LOGGER_ERROR ( "Cannot write the output image" );
+            return -1;
+        }
+        if ( pMaskOut != NULL && ( ( FileImage* ) pMaskOut )->writeImage ( pECI->Image::getMask() ) < 0 ) {
+            LOGGER_ERROR ( "Cannot write the output mask" );
+            return -1;
+        }
+        return 0;
+    }
+
+    Rok4Image* pRok4ImageOut = ( Rok4Image* ) pImageOut;
+
+    if ( crop && bitspersample == 8 && sampleformat == SampleFormat::UINT ) {
+        // Le traitement du blanc nécessite l'image entière en mémoire
+        int width = pImageOut->getWidth();
+        int height = pImageOut->getHeight();
+        int lineSize = width * samplesperpixel;
+        uint8_t* buffer = new uint8_t[height * lineSize];
+
+        for ( int l = 0; l < height; l++ ) {
+            if ( pECI->getline ( buffer + l * lineSize, l ) == 0 ) {
+                LOGGER_ERROR ( "Cannot read line " << l << " of the merged image" );
+                delete[] buffer;
+                return -1;
+            }
+        }
+
+        TiffNodataManager<uint8_t> TNM ( samplesperpixel, white, true, fastWhite, white );
+        if ( ! TNM.treatNodata ( buffer, width, height, samplesperpixel ) ) {
+            LOGGER_ERROR ( "Unable to treat white pixels in the merged image" );
+            delete[] buffer;
+            return -1;
+        }
+
+        int ret = pRok4ImageOut->writeImage ( buffer, true );
+        delete[] buffer;
+        if ( ret < 0 ) {
+            LOGGER_ERROR ( "Cannot write the output ROK4 image" );
+            return -1;
+        }
+    } else {
+        if ( crop ) {
+            LOGGER_WARN ( "White pixels are not treated (only for 8-bit integer images)" );
+        }
+        if ( pRok4ImageOut->writeImage ( pECI, crop ) < 0 ) {
+            LOGGER_ERROR ( "Cannot write the output ROK4 image" );
+            return -1;
+        }
+    }
+
+    if ( pMaskOut != NULL && ( ( Rok4Image* ) pMaskOut )->writeImage ( pECI->Image::getMask(), false ) < 0 ) {
+        LOGGER_ERROR ( "Cannot write the output ROK4 mask" );
+        return -1;
+    }
+
+    return 0;
+}
+
 /**
  ** \~french
  * \brief Fonction principale de l'outil mergeNtiff
@@ -1085,8 +1232,8 @@ int mergeTabImages ( FileImage* pImageOut, // Sortie
  */
 int main ( int argc, char **argv ) {
 
-    FileImage* pImageOut ;
-    FileImage* pMaskOut = NULL;
+    Image* pImageOut ;
+    Image* pMaskOut = NULL;
     std::vector<FileImage*> ImageIn;
     std::vector<std::vector<Image*> > TabImageIn;
     ExtendedCompoundImage* pECI;
@@ -1166,19 +1313,11 @@ int main ( int argc, char **argv ) {
     }
 
     LOGGER_DEBUG ( "Save image" );
-    // Enregistrement de l'image fusionnée
-    if ( pImageOut->writeImage ( pECI ) < 0 ) {
+    // Enregistrement de l'image fusionnée et du masque, si demandé
+    if ( saveImages ( pImageOut, pMaskOut, pECI ) < 0 ) {
         error ( "Echec enregistrement de l image finale",-1 );
     }
 
-    if ( pMaskOut != NULL ) {
-        LOGGER_DEBUG ( "Save mask" );
-        // Enregistrement du masque fusionné, si demandé
-        if ( pMaskOut->writeImage ( pECI->Image::getMask() ) < 0 ) {
-            error ( "Echec enregistrement du masque final",-1 );
-        }
-    }
-
     LOGGER_DEBUG ( "Clean" );
     // Nettoyage
     pj_clear_initcache();
@@ -1190,6 +1329,7 @@ int main ( int argc, char **argv ) {
     delete pECI;
     delete pImageOut;
     delete pMaskOut;
+    delete outputContext;
 
     return 0;
 }
@@ -52,6 +52,9 @@
 #include "FileImage.h"
 #include "CurlPool.h"
 #include "Rok4Image.h"
+#include "ThreadPool.h"
+#include <fstream>
+#include <sstream>
 #include "../../../rok4version.h"
 
 #if BUILD_OBJECT
@@ -65,12 +68,16 @@ std::string help = std::string("\npbf2cache version ") + std::string(ROK4_VERSIO
 
     "Make image tiled and compressed, in TIFF format, respecting ROK4 specifications.\n\n"
 
-    "Usage: pbf2cache -r <DIRECTORY> -t <VAL> <VAL> -ultile <VAL> <VAL> <OUTPUT FILE/OBJECT> [-d]\n\n"
+    "Usage: pbf2cache -r <DIRECTORY> -t <VAL> <VAL> -ultile <VAL> <VAL> <OUTPUT FILE/OBJECT> [-c <VAL>] [-j <VAL>] [-d]\n"
+    "       pbf2cache -r <DIRECTORY> -t <VAL> <VAL> -l <LIST FILE> [-c <VAL>] [-j <VAL>] [-d]\n\n"
 
     "Parameters:\n"
     "     -r directory containing the PBF tiles : tile I,J is stored to path <DIRECTORY>/I/J.pbf\n"
     "     -t number of tiles in the slab : widthwise and heightwise.\n"
     "     -ultile upper left tile indices\n"
+    "     -l list of slabs to write, one per line : <OUTPUT FILE/OBJECT> <UL TILE COLUMN> <UL TILE ROW>. Replaces -ultile and the output\n"
+    "     -c tiles compression in the slab : none (default) or gzip. Gzip slabs belong to a TIFF_PBF_GZIP_MVT pyramid\n"
+    "     -j number of threads reading PBF tiles concurrently (default 8, 0 for a sequential read)\n"
     "     -pool Ceph pool where data is. INPUT FILE is interpreted as a Ceph object (ONLY IF OBJECT COMPILATION)\n"
     "     -container Swift container where data is. Then OUTPUT FILE is interpreted as a Swift object name (ONLY IF OBJECT COMPILATION)\n"
     "     -ks in Swift storage case, activate keystone authentication (ONLY IF OBJECT COMPILATION)\n"
@@ -113,8 +120,10 @@ void error ( std::string message, int errorCode ) {
  */
 int main ( int argc, char **argv ) {
 
-    char* output = 0, *rootDirectory = 0;
+    char* output = 0, *rootDirectory = 0, *listFile = 0;
     int tilePerWidth = 16, tilePerHeight = 16;
+    int readThreads = 8;
+    bool gzip = false;
     int ulCol = -1;
     int ulRow = -1;
 
@@ -199,6 +208,21 @@ int main ( int argc, char **argv ) {
                     tilePerWidth = atoi ( argv[++i] );
                     tilePerHeight = atoi ( argv[++i] );
                     break;
+                case 'l': // list of slabs
+                    if ( ++i == argc ) { error("Error in -l option", -1 ); }
+                    listFile = argv[i];
+                    break;
+                case 'c': // tiles compression
+                    if ( ++i == argc ) { error("Error in -c option", -1 ); }
+                    if ( strcmp ( argv[i], "gzip" ) == 0 ) gzip = true;
+                    else if ( strcmp ( argv[i], "none" ) == 0 ) gzip = false;
+                    else { error ( "Unknown compression : " + std::string(argv[i]) + " (none or gzip)", -1 ); }
+                    break;
+                case 'j': // reading threads
+                    if ( ++i == argc ) { error("Error in -j option", -1 ); }
+                    readThreads = atoi ( argv[i] );
+                    if ( readThreads < 0 ) { error("Error in -j option : threads number must be positive", -1 ); }
+                    break;
 
                 default:
                     error ( "Unknown option : " + std::string(argv[i]) ,-1 );
@@ -217,15 +241,49 @@ int main ( int argc, char **argv ) {
         logd.setf ( std::ios::fixed,std::ios::floatfield );
     }
 
-    if ( rootDirectory == 0 || output == 0 ) {
-        error ("Argument must specify one output file/object and one root directory", -1);
+    if ( rootDirectory == 0 ) {
+        error ("Argument must specify one root directory", -1);
     }
 
-    LOGGER_DEBUG("Output : " << output);
     LOGGER_DEBUG("PBF root directory : " << rootDirectory);
 
-    if ( ulRow == -1 || ulCol == -1 ) {
-        error ("Upper left tile indices have to be provided (with option -ultile)", -1);
+    // Dalles à écrire : une seule, ou toutes celles de la liste
+    std::vector<std::string> outputs;
+    std::vector<int> ulCols, ulRows;
+
+    if ( listFile != 0 ) {
+        if ( output != 0 ) {
+            error ("Output file/object and list file (option -l) cannot be both provided", -1);
+        }
+        std::ifstream list ( listFile );
+        if ( ! list.is_open() ) {
+            error ( "Cannot open the list file " + std::string(listFile), -1 );
+        }
+        std::string line;
+        while ( std::getline ( list, line ) ) {
+            if ( line.empty() ) continue;
+            std::istringstream iss ( line );
+            std::string slab;
+            int col, row;
+            if ( ! ( iss >> slab >> col >> row ) ) {
+                error ( "Unvalid line in the list file : " + line, -1 );
+            }
+            outputs.push_back ( slab );
+            ulCols.push_back ( col );
+            ulRows.push_back ( row );
+        }
+        LOGGER_DEBUG("Slabs list : " << listFile << " (" << outputs.size() << " slabs)");
+    } else {
+        if ( output == 0 ) {
+            error ("Argument must specify one output file/object or a list file (option -l)", -1);
+        }
+        if ( ulRow == -1 || ulCol == -1 ) {
+            error ("Upper left tile indices have to be provided (with option -ultile)", -1);
+        }
+        LOGGER_DEBUG("Output : " << output);
+        outputs.push_back ( output );
+        ulCols.push_back ( ulCol );
+        ulRows.push_back ( ulRow );
     }
 
     Context* context;
@@ -268,23 +326,35 @@ int main ( int argc, char **argv ) {
     }
 
 
-    Rok4ImageFactory R4IF;
-    Rok4Image* rok4Image = R4IF.createRok4ImageToWrite( output, tilePerWidth, tilePerHeight, context );
-    
-    if (rok4Image == NULL) {
-        error("Cannot create the ROK4 image to write", -1);
+    // Les fichiers PBF d'une dalle sont lus en parallèle, les dalles sont écrites l'une après l'autre
+    ThreadPool* pool = NULL;
+    if ( readThreads > 0 ) {
+        pool = new ThreadPool ( readThreads );
     }
 
-    if (debugLogger) {
-        rok4Image->print();
-    }
+    Rok4ImageFactory R4IF;
+    for ( unsigned int i = 0; i < outputs.size(); i++ ) {
+        Rok4Image* rok4Image = R4IF.createRok4ImageToWrite( outputs.at(i), tilePerWidth, tilePerHeight, context );
 
-    LOGGER_DEBUG ( "Write" );
+        if (rok4Image == NULL) {
+            error("Cannot create the ROK4 image to write " + outputs.at(i), -1);
+        }
 
-    if (rok4Image->writePbfTiles(ulCol, ulRow, rootDirectory) < 0) {
-        error("Cannot write ROK4 image from PBF tiles", -1);
+        if (debugLogger) {
+            rok4Image->print();
+        }
+
+        LOGGER_DEBUG ( "Write " << outputs.at(i) );
+
+        if (rok4Image->writePbfTiles(ulCols.at(i), ulRows.at(i), rootDirectory, pool, gzip) < 0) {
+            error("Cannot write ROK4 image from PBF tiles : " + outputs.at(i), -1);
+        }
+
+        delete rok4Image;
     }
 
+    delete pool;
+
 #if BUILD_OBJECT
     if (onSwift || onS3) {
         // Un environnement CURL a été créé et utilisé, il faut le nettoyer
@@ -300,7 +370,6 @@ int main ( int argc, char **argv ) {
     // if ( acc ) {
     //     delete acc;
     // }
-    delete rok4Image;
     delete context;
 
     return 0;
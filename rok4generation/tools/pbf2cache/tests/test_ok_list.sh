@@ -0,0 +1,19 @@
+#!/bin/bash
+echo "test ok list"
+TMPDIR=$(mktemp -d)
+trap "rm -rf $TMPDIR" EXIT
+
+# Dalles de référence, écrites une par une
+pbf2cache -r inputs/pbfs/ -t 3 3 -ultile 258 175 $TMPDIR/single_full.tif || exit 1
+pbf2cache -r inputs/pbfs/ -t 3 3 -ultile 257 174 $TMPDIR/single_hole.tif || exit 1
+
+# Les mêmes dalles, écrites depuis une liste, avec lecture séquentielle puis parallèle des tuiles
+for threads in 0 4 ; do
+    echo "$TMPDIR/list_j${threads}_full.tif 258 175" > $TMPDIR/list_j${threads}.txt
+    echo "$TMPDIR/list_j${threads}_hole.tif 257 174" >> $TMPDIR/list_j${threads}.txt
+    pbf2cache -r inputs/pbfs/ -t 3 3 -l $TMPDIR/list_j${threads}.txt -j $threads || exit 1
+    cmp -s $TMPDIR/single_full.tif $TMPDIR/list_j${threads}_full.tif || exit 1
+    cmp -s $TMPDIR/single_hole.tif $TMPDIR/list_j${threads}_hole.tif || exit 1
+done
+
+exit 0
@@ -0,0 +1,949 @@
+/*
+ * Copyright © (2011) Institut national de l'information
+ *                    géographique et forestière
+ *
+ * Géoportail SAV <geop_services@geoportail.fr>
+ *
+ * This software is a computer program whose purpose is to publish geographic
+ * data using OGC WMS and WMTS protocol.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL-C
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ *
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ */
+
+/**
+ * \file qtree2cache.cpp
+ * \author Institut national de l'information géographique et forestière
+ * \~french \brief Génération des niveaux supérieurs d'une pyramide QTree, en mémoire, à partir des dalles du niveau le mieux résolu
+ * \~english \brief Generate upper levels of a QTree pyramid, in memory, from the best resolution level's slabs
+ * \~french \details Toutes les dalles à générer sont organisées en arbre (une dalle a au plus 4 dalles filles au niveau inférieur). Une dalle est calculée dès que ses filles le sont, par une tâche soumise à un pool de threads à vol de tâches. Les images intermédiaires restent en mémoire, jusqu'à ce que la dalle mère soit calculée : aucune image de travail n'est écrite. Chaque dalle calculée est écrite au format ROK4 (Rok4Image), ainsi que son masque si la pyramide en possède.
+ *
+ * Le sous-échantillonnage est le même que celui de merge4tiff : moyenne des pixels 4 par 4, avec prise en compte des masques et d'un gamma pour les canaux entiers.
+ *
+ * Le niveau de base doit déjà exister : sa génération (réechantillonnage des images sources, planifiée par COMMON::NNGraph) reste assurée par mergeNtiff.
+ */
+
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "Format.h"
+#include "Logger.h"
+#include "Image.h"
+#include "FileContext.h"
+#include "UringFileContext.h"
+#include "Rok4Image.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+#include "../../../rok4version.h"
+
+/* Paramètres de la ligne de commande */
+/** \~french Dossier racine des données de la pyramide (contenant les dossiers IMAGE et MASK) */
+char* rootDirectory = 0;
+/** \~french Identifiants des niveaux, du niveau de base (existant) au plus haut niveau à générer, séparés par des virgules */
+char* strLevels = 0;
+/** \~french Fichier listant les indices (colonne et ligne) des dalles existantes au niveau de base */
+char* slabsList = 0;
+/** \~french Valeur de nodata sous forme de chaîne de caractère (passée en paramètre de la commande) */
+char* strnodata = 0;
+/** \~french Profondeur de l'arborescence des dalles */
+int pathDepth = 2;
+/** \~french Valeur de gamma, pour foncer ou éclaircir des images en entier */
+double gammaQt = 1.;
+/** \~french Nombre de threads de calcul */
+int nbThreads = 1;
+/** \~french La pyramide possède-t-elle des masques */
+bool withMasks = false;
+/** \~french Activation du niveau de log debug. Faux par défaut */
+bool debugLogger = false;
+
+/* Caractéristiques des dalles, lues dans une dalle du niveau de base */
+/** \~french Largeur des dalles */
+int width;
+/** \~french Hauteur des dalles */
+int height;
+/** \~french Nombre de canaux par pixel */
+int samplesperpixel;
+/** \~french Nombre de bits occupé par un canal */
+int bitspersample;
+/** \~french Format du canal (entier ou flottant) */
+SampleFormat::eSampleFormat sampleformat;
+/** \~french Photométrie des données */
+Photometric::ePhotometric photometric;
+/** \~french Compression des dalles */
+Compression::eCompression compression;
+/** \~french Largeur des tuiles */
+int tileWidth;
+/** \~french Hauteur des tuiles */
+int tileHeight;
+
+/** \~french Identifiants des niveaux, du niveau de base au plus haut */
+std::vector<std::string> levels;
+/** \~french Valeur de nodata, sous forme d'entiers */
+std::vector<int> nodataInt;
+/** \~french Table de gamma, pour nbData pixels de somme s : gammaLut[nbData * 1021 + s] */
+uint8_t gammaLut[5 * 1021];
+
+/** \~french Une erreur a-t-elle été rencontrée par une tâche. Accès atomiques uniquement, le drapeau étant écrit par les threads du pool */
+bool failed = false;
+/** \~french Verrou protégeant les compteurs de dépendances des noeuds, ainsi que #liveNodes et #activeTasks */
+pthread_mutex_t nodesMutex = PTHREAD_MUTEX_INITIALIZER;
+/** \~french Signalé à chaque libération de dalle ou fin de tâche, pour le programme principal qui alimente le pool */
+pthread_cond_t nodesCond = PTHREAD_COND_INITIALIZER;
+/** \~french Nombre de dalles dont les pixels sont en mémoire */
+int liveNodes = 0;
+/** \~french Nombre de tâches soumises et pas encore terminées */
+int activeTasks = 0;
+/** \~french Nombre maximal de dalles en mémoire avant que le programme principal ne suspende la soumission des dalles du niveau de base */
+int maxLiveNodes = 0;
+
+/** \~french Message d'usage de la commande qtree2cache */
+std::string help = std::string("\nqtree2cache version ") + std::string(ROK4_VERSION) + "\n\n"
+
+    "Generate upper levels of a QTree pyramid from its base level, in memory, and write them as ROK4 slabs\n\n"
+
+    "Usage: qtree2cache -r <DIRECTORY> -l <LEVEL>,<LEVEL>,... -f <FILE> -n <VAL> [-p <VAL>] [-g <VAL>] [-j <VAL>] [-mask] [-d]\n\n"
+
+    "Parameters:\n"
+    "     -r pyramid's data root directory, containing IMAGE (and MASK) directories\n"
+    "     -l levels' identifiers, separated with comma, from the base level (already generated) to the top level\n"
+    "     -f base level's slabs list file : one slab per line, column and row indices separated by a space\n"
+    "     -n nodata value, one interger per sample, seperated with comma. Examples\n"
+    "             -99999 for DTM\n"
+    "             255,255,255 for orthophotography\n"
+    "     -p slabs' tree depth (default : 2)\n"
+    "     -g gamma float value, to dark (0 < g < 1) or brighten (1 < g) 8-bit integer images' subsampling\n"
+    "     -j computation threads number (default : 1)\n"
+    "     -mask pyramid owns masks : base level's masks are read and upper level's masks are written\n"
+    "     -d debug logger activation\n\n"
+
+    "Slabs' format (size, tiles, channels, compression) is read from the first base level's slab.\n\n"
+
+    "Example\n"
+    "     qtree2cache -r /pyramids/ORTHO -l 19,18,17,16 -f /tmp/base_slabs.txt -n 255,255,255 -p 2 -j 8 -mask\n\n";
+
+/**
+ * \~french
+ * \brief Affiche l'utilisation et les différentes options de la commande qtree2cache #help
+ * \details L'affichage se fait dans le niveau de logger INFO
+ */
+void usage() {
+    LOGGER_INFO ( help );
+}
+
+/**
+ * \~french
+ * \brief Affiche un message d'erreur, l'utilisation de la commande et sort en erreur
+ * \param[in] message message d'erreur
+ * \param[in] errorCode code de retour
+ */
+void error ( std::string message, int errorCode ) {
+    LOGGER_ERROR ( message );
+    usage();
+    sleep ( 1 );
+    exit ( errorCode );
+}
+
+/**
+ * \~french
+ * \brief Récupère les valeurs passées en paramètres de la commande, et les stocke dans les variables globales
+ * \param[in] argc nombre de paramètres
+ * \param[in] argv tableau des paramètres
+ * \return code de retour, 0 si réussi, -1 sinon
+ */
+int parseCommandLine ( int argc, char* argv[] ) {
+
+    for ( int i = 1; i < argc; i++ ) {
+        if ( !strcmp ( argv[i],"-mask" ) ) {
+            withMasks = true;
+            continue;
+        }
+
+        if ( argv[i][0] == '-' ) {
+            switch ( argv[i][1] ) {
+            case 'h': // help
+                usage();
+                exit ( 0 );
+            case 'd': // debug logs
+                debugLogger = true;
+                break;
+            case 'r': // pyramid's root
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in option -r" );
+                    return -1;
+                }
+                rootDirectory = argv[i];
+                break;
+            case 'l': // levels
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in option -l" );
+                    return -1;
+                }
+                strLevels = argv[i];
+                break;
+            case 'f': // base slabs list
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in option -f" );
+                    return -1;
+                }
+                slabsList = argv[i];
+                break;
+            case 'n': // nodata
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in option -n" );
+                    return -1;
+                }
+                strnodata = argv[i];
+                break;
+            case 'p': // depth
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in option -p" );
+                    return -1;
+                }
+                pathDepth = atoi ( argv[i] );
+                if ( pathDepth < 0 ) {
+                    LOGGER_ERROR ( "Unvalid parameter in -p argument, have to be positive or null" );
+                    return -1;
+                }
+                break;
+            case 'g': // gamma
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in option -g" );
+                    return -1;
+                }
+                gammaQt = atof ( argv[i] );
+                if ( gammaQt <= 0. ) {
+                    LOGGER_ERROR ( "Unvalid parameter in -g argument, have to be positive" );
+                    return -1;
+                }
+                break;
+            case 'j': // threads
+                if ( ++i == argc ) {
+                    LOGGER_ERROR ( "Error in option -j" );
+                    return -1;
+                }
+                nbThreads = atoi ( argv[i] );
+                if ( nbThreads < 1 ) {
+                    LOGGER_ERROR ( "Unvalid parameter in -j argument, have to be positive" );
+                    return -1;
+                }
+                break;
+            default:
+                LOGGER_ERROR ( "Unknown option : " << argv[i] );
+                return -1;
+            }
+        }
+    }
+
+    if ( rootDirectory == 0 ) {
+        LOGGER_ERROR ( "Missing pyramid's root directory" );
+        return -1;
+    }
+    if ( strLevels == 0 ) {
+        LOGGER_ERROR ( "Missing levels" );
+        return -1;
+    }
+    if ( slabsList == 0 ) {
+        LOGGER_ERROR ( "Missing base level's slabs list" );
+        return -1;
+    }
+    if ( strnodata == 0 ) {
+        LOGGER_ERROR ( "Missing nodata value" );
+        return -1;
+    }
+
+    std::stringstream ss ( strLevels );
+    std::string level;
+    while ( std::getline ( ss, level, ',' ) ) {
+        if ( level.empty() ) continue;
+        levels.push_back ( level );
+    }
+    if ( levels.size() < 2 ) {
+        LOGGER_ERROR ( "At least two levels have to be provided (the base one and one to generate)" );
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * \~french
+ * \brief Calcule le chemin d'une dalle dans la pyramide
+ * \details Les indices sont convertis en base 36 et entrelacés, avec pathDepth dossiers : racine/TYPE/NIVEAU/X1Y1X2Y2/../XnYn.tif
+ * \param[in] type type de dalle, IMAGE ou MASK
+ * \param[in] level identifiant du niveau
+ * \param[in] col indice de colonne de la dalle
+ * \param[in] row indice de ligne de la dalle
+ * \return chemin complet de la dalle
+ */
+std::string getSlabPath ( std::string type, std::string level, int col, int row ) {
+    static const char* Base36 = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+    std::string xb36, yb36;
+    do {
+        xb36.insert ( xb36.begin(), Base36[col % 36] );
+        col /= 36;
+    } while ( col );
+    do {
+        yb36.insert ( yb36.begin(), Base36[row % 36] );
+        row /= 36;
+    } while ( row );
+
+    size_t maxLength = pathDepth + 1;
+    if ( xb36.size() > maxLength ) maxLength = xb36.size();
+    if ( yb36.size() > maxLength ) maxLength = yb36.size();
+    xb36.insert ( 0, maxLength - xb36.size(), '0' );
+    yb36.insert ( 0, maxLength - yb36.size(), '0' );
+
+    std::string path;
+    int nbSlash = pathDepth;
+    for ( int i = maxLength - 1; i >= 0; i-- ) {
+        path.insert ( 0, 1, yb36[i] );
+        path.insert ( 0, 1, xb36[i] );
+        if ( nbSlash > 0 ) {
+            path.insert ( 0, 1, '/' );
+            nbSlash--;
+        }
+    }
+
+    return std::string ( rootDirectory ) + "/" + type + "/" + level + "/" + path + ".tif";
+}
+
+/**
+ * \~french
+ * \brief Crée les dossiers parents d'un fichier, s'ils n'existent pas
+ * \param[in] path chemin du fichier
+ */
+void createParentDirectories ( std::string path ) {
+    size_t pos = path.find ( '/', 1 );
+    while ( pos != std::string::npos ) {
+        mkdir ( path.substr ( 0, pos ).c_str(), ACCESSPERMS );
+        pos = path.find ( '/', pos + 1 );
+    }
+}
+
+/**
+ * \~french
+ * \brief Dalle de l'arbre à générer
+ * \details Les dalles du niveau de base sont lues, celles des niveaux supérieurs sont calculées à partir de leurs (au plus) 4 filles.
+ */
+struct Node {
+    /** \~french Indice du niveau dans #levels */
+    int level;
+    /** \~french Indice de colonne de la dalle */
+    int col;
+    /** \~french Indice de ligne de la dalle */
+    int row;
+    /** \~french Dalle mère, NULL pour le plus haut niveau */
+    Node* parent;
+    /** \~french Dalles filles, indexées par [ligne][colonne] */
+    Node* children[2][2];
+    /** \~french Nombre de dalles filles pas encore disponibles */
+    int pendingChildren;
+    /** \~french Pixels de la dalle, les pixels sans donnée valent 0 une fois la dalle disponible pour sa mère */
+    uint8_t* data;
+    /** \~french Masque de la dalle */
+    uint8_t* mask;
+};
+
+/**
+ * \~french
+ * \brief Lit une dalle du niveau de base (et son masque) dans les buffers du noeud
+ * \param[in] node noeud à lire
+ * \return 0 en cas de succès, -1 sinon
+ */
+template <typename T>
+int loadNode ( Node* node ) {
+    int nbsamples = width * samplesperpixel;
+    T* data = ( T* ) node->data;
+
+    FileContext context ( "" );
+    context.connection();
+    Rok4ImageFactory R4IF;
+
+    std::string imagePath = getSlabPath ( "IMAGE", levels.at ( node->level ), node->col, node->row );
+    Rok4Image* image = R4IF.createRok4ImageToRead ( imagePath, BoundingBox<double> ( 0.,0.,0.,0. ), 0., 0., &context );
+    if ( image == NULL ) {
+        LOGGER_ERROR ( "Cannot read the base slab " << imagePath );
+        return -1;
+    }
+    for ( int l = 0; l < height; l++ ) {
+        if ( image->getline ( data + l * nbsamples, l ) == 0 ) {
+            LOGGER_ERROR ( "Cannot read line " << l << " of the base slab " << imagePath );
+            delete image;
+            return -1;
+        }
+    }
+    delete image;
+
+    if ( ! withMasks ) {
+        memset ( node->mask, 255, width * height );
+        return 0;
+    }
+
+    std::string maskPath = getSlabPath ( "MASK", levels.at ( node->level ), node->col, node->row );
+    if ( ! context.exists ( maskPath ) ) {
+        // Pas de masque : toute la dalle contient de la donnée
+        memset ( node->mask, 255, width * height );
+        return 0;
+    }
+
+    Rok4Image* mask = R4IF.createRok4ImageToRead ( maskPath, BoundingBox<double> ( 0.,0.,0.,0. ), 0., 0., &context );
+    if ( mask == NULL ) {
+        LOGGER_ERROR ( "Cannot read the base mask " << maskPath );
+        return -1;
+    }
+    for ( int l = 0; l < height; l++ ) {
+        if ( mask->getline ( node->mask + l * width, l ) == 0 ) {
+            LOGGER_ERROR ( "Cannot read line " << l << " of the base mask " << maskPath );
+            delete mask;
+            return -1;
+        }
+    }
+    delete mask;
+
+    return 0;
+}
+
+/**
+ * \~french
+ * \brief Calcule un pixel à partir des sommes verticales de ses deux colonnes sources (cas entier)
+ * \param[out] out pixel en sortie
+ * \param[in] sumA somme verticale de la colonne de gauche
+ * \param[in] sumB somme verticale de la colonne de droite
+ * \param[in] nbData nombre de pixels sources contenant de la donnée (2, 3 ou 4)
+ */
+inline void mergePixel ( uint8_t* out, const uint16_t* sumA, const uint16_t* sumB, int nbData ) {
+    const uint8_t* l = gammaLut + nbData * 1021;
+    for ( int c = 0; c < samplesperpixel; c++ ) out[c] = l[sumA[c] + sumB[c]];
+}
+
+/**
+ * \~french
+ * \brief Calcule un pixel à partir des sommes verticales de ses deux colonnes sources (cas flottant)
+ * \param[out] out pixel en sortie
+ * \param[in] sumA somme verticale de la colonne de gauche
+ * \param[in] sumB somme verticale de la colonne de droite
+ * \param[in] nbData nombre de pixels sources contenant de la donnée (2, 3 ou 4)
+ */
+inline void mergePixel ( float* out, const float* sumA, const float* sumB, int nbData ) {
+    for ( int c = 0; c < samplesperpixel; c++ ) out[c] = ( sumA[c] + sumB[c] ) / ( float ) nbData;
+}
+
+/**
+ * \~french
+ * \brief Calcule une dalle à partir de ses dalles filles, par sous-échantillonnage 2x2
+ * \details Les filles absentes laissent la zone correspondante à nodata, sans donnée dans le masque.
+ * \param[in] node noeud à calculer
+ * \param[in] nodata valeur de nodata
+ */
+template <typename T, typename S>
+void reduceNode ( Node* node, T* nodata ) {
+    int nbsamples = width * samplesperpixel;
+    int halfWidth = width / 2;
+    T* out = ( T* ) node->data;
+
+    for ( int i = 0; i < nbsamples * height; i++ ) out[i] = nodata[i % samplesperpixel];
+    memset ( node->mask, 0, width * height );
+
+    S* sums = new S[nbsamples];
+    uint8_t* counts = new uint8_t[width];
+
+    for ( int y = 0; y < 2; y++ ) {
+        for ( int x = 0; x < 2; x++ ) {
+            Node* child = node->children[y][x];
+            if ( child == NULL ) continue;
+
+            T* childData = ( T* ) child->data;
+
+            for ( int h = 0; h < height / 2; h++ ) {
+                // Somme verticale des deux lignes sources et décompte des pixels de donnée
+                add_lines ( sums, childData + 2*h*nbsamples, childData + ( 2*h+1 ) *nbsamples, nbsamples );
+                count_masks ( counts, child->mask + 2*h*width, child->mask + ( 2*h+1 ) *width, width );
+
+                T* lineOut = out + ( y*height/2 + h ) * nbsamples;
+                uint8_t* lineOutM = node->mask + ( y*height/2 + h ) * width;
+
+                // Réduction horizontale, par paire de colonnes
+                for ( int p = 0; p < halfWidth; p++ ) {
+                    int nbData = counts[2*p] + counts[2*p+1];
+                    if ( nbData > 1 ) {
+                        int pixOut = x*halfWidth + p;
+                        lineOutM[pixOut] = 255;
+                        mergePixel ( lineOut + pixOut*samplesperpixel, sums + 2*p*samplesperpixel,
+                                     sums + ( 2*p+1 ) *samplesperpixel, nbData );
+                    }
+                }
+            }
+        }
+    }
+
+    delete[] sums;
+    delete[] counts;
+}
+
+/**
+ * \~french
+ * \brief Écrit une dalle calculée (et son éventuel masque) au format ROK4
+ * \param[in] node noeud à écrire
+ * \return 0 en cas de succès, -1 sinon
+ */
+template <typename T>
+int writeNode ( Node* node ) {
+    Rok4ImageFactory R4IF;
+
+    std::string imagePath = getSlabPath ( "IMAGE", levels.at ( node->level ), node->col, node->row );
+    createParentDirectories ( imagePath );
+
+    UringFileContext imageContext ( "" );
+    imageContext.connection();
+    Rok4Image* image = R4IF.createRok4ImageToWrite (
+        imagePath, BoundingBox<double> ( 0.,0.,0.,0. ), -1, -1, width, height, samplesperpixel,
+        sampleformat, bitspersample, photometric, compression, tileWidth, tileHeight, &imageContext
+    );
+    if ( image == NULL ) {
+        LOGGER_ERROR ( "Cannot create the ROK4 image to write " << imagePath );
+        return -1;
+    }
+    if ( image->writeImage ( ( T* ) node->data ) < 0 ) {
+        LOGGER_ERROR ( "Cannot write the ROK4 image " << imagePath );
+        delete image;
+        return -1;
+    }
+    delete image;
+
+    if ( ! withMasks ) return 0;
+
+    std::string maskPath = getSlabPath ( "MASK", levels.at ( node->level ), node->col, node->row );
+    createParentDirectories ( maskPath );
+
+    UringFileContext maskContext ( "" );
+    maskContext.connection();
+    Rok4Image* mask = R4IF.createRok4ImageToWrite (
+        maskPath, BoundingBox<double> ( 0.,0.,0.,0. ), -1, -1, width, height, 1,
+        SampleFormat::UINT, 8, Photometric::MASK, Compression::DEFLATE, tileWidth, tileHeight, &maskContext
+    );
+    if ( mask == NULL ) {
+        LOGGER_ERROR ( "Cannot create the ROK4 mask to write " << maskPath );
+        return -1;
+    }
+    if ( mask->writeImage ( node->mask ) < 0 ) {
+        LOGGER_ERROR ( "Cannot write the ROK4 mask " << maskPath );
+        delete mask;
+        return -1;
+    }
+    delete mask;
+
+    return 0;
+}
+
+/**
+ * \~french
+ * \brief Met à 0 les pixels sans donnée, pour qu'ils puissent être sommés directement par la dalle mère
+ * \param[in] node noeud à traiter
+ */
+template <typename T>
+void zeroNodata ( Node* node ) {
+    T* data = ( T* ) node->data;
+    for ( int p = 0; p < width * height; p++ ) {
+        if ( node->mask[p] == 0 ) memset ( data + p * samplesperpixel, 0, samplesperpixel * sizeof ( T ) );
+    }
+}
+
+/**
+ * \~french
+ * \brief Libère les buffers d'un noeud
+ * \param[in] node noeud à vider
+ */
+void releaseNode ( Node* node ) {
+    if ( node->data == NULL ) return;
+
+    delete[] node->data;
+    delete[] node->mask;
+    node->data = NULL;
+    node->mask = NULL;
+
+    pthread_mutex_lock ( &nodesMutex );
+    liveNodes--;
+    pthread_cond_signal ( &nodesCond );
+    pthread_mutex_unlock ( &nodesMutex );
+}
+
+/**
+ * \~french
+ * \brief Traitement d'une dalle de l'arbre
+ * \details Lit (niveau de base) ou calcule et écrit (niveaux supérieurs) la dalle, libère les dalles filles, puis soumet la dalle mère si c'était sa dernière fille attendue.
+ */
+template <typename T, typename S>
+class NodeTask : public Task {
+private:
+    /** \~french Dalle à traiter */
+    Node* node;
+    /** \~french Pool auquel soumettre la dalle mère */
+    ThreadPool* pool;
+    /** \~french Valeur de nodata */
+    T* nodata;
+
+public:
+    NodeTask ( Node* node, ThreadPool* pool, T* nodata ) : node ( node ), pool ( pool ), nodata ( nodata ) {}
+
+    void run() {
+        int pixelSize = samplesperpixel * sizeof ( T );
+
+        if ( ! __atomic_load_n ( &failed, __ATOMIC_RELAXED ) ) {
+            node->data = new uint8_t[width * height * pixelSize];
+            node->mask = new uint8_t[width * height];
+
+            pthread_mutex_lock ( &nodesMutex );
+            liveNodes++;
+            pthread_mutex_unlock ( &nodesMutex );
+
+            int ret;
+            if ( node->level == 0 ) {
+                ret = loadNode<T> ( node );
+            } else {
+                reduceNode<T, S> ( node, nodata );
+                ret = writeNode<T> ( node );
+                if ( ret >= 0 ) {
+                    LOGGER_DEBUG ( "Slab " << levels.at ( node->level ) << " / " << node->col << "," << node->row << " written" );
+                }
+            }
+
+            if ( ret < 0 ) __atomic_store_n ( &failed, true, __ATOMIC_RELAXED );
+            else zeroNodata<T> ( node );
+        }
+
+        for ( int y = 0; y < 2; y++ ) {
+            for ( int x = 0; x < 2; x++ ) {
+                if ( node->children[y][x] ) releaseNode ( node->children[y][x] );
+            }
+        }
+
+        if ( node->parent == NULL ) {
+            releaseNode ( node );
+            finish ( false );
+            return;
+        }
+
+        pthread_mutex_lock ( &nodesMutex );
+        bool ready = ( --node->parent->pendingChildren == 0 );
+        pthread_mutex_unlock ( &nodesMutex );
+
+        finish ( ready );
+    }
+
+    /**
+     * \~french
+     * \brief Soumet éventuellement la dalle mère, puis décompte la tâche comme terminée
+     * \details La mère est comptée comme active avant la fin de cette tâche : le programme principal ne peut pas voir un pool à l'arrêt entre les deux
+     * \param[in] submitParent la dalle mère est-elle prête à être calculée
+     */
+    void finish ( bool submitParent ) {
+        if ( submitParent ) {
+            pthread_mutex_lock ( &nodesMutex );
+            activeTasks++;
+            pthread_mutex_unlock ( &nodesMutex );
+            pool->submit ( new NodeTask<T, S> ( node->parent, pool, nodata ) );
+        }
+
+        pthread_mutex_lock ( &nodesMutex );
+        activeTasks--;
+        pthread_cond_signal ( &nodesCond );
+        pthread_mutex_unlock ( &nodesMutex );
+    }
+};
+
+/**
+ * \~french
+ * \brief Construit l'arbre des dalles à partir de la liste des dalles du niveau de base
+ * \param[out] nodes ensemble des noeuds, par niveau, indexés par (colonne, ligne)
+ * \return 0 en cas de succès, -1 sinon
+ */
+int buildTree ( std::vector<std::map<std::pair<int,int>, Node*> >& nodes ) {
+    nodes.resize ( levels.size() );
+
+    std::ifstream file ( slabsList );
+    if ( ! file ) {
+        LOGGER_ERROR ( "Cannot open the base level's slabs list " << slabsList );
+        return -1;
+    }
+
+    std::string line;
+    while ( std::getline ( file, line ) ) {
+        if ( line.empty() ) continue;
+        std::istringstream iss ( line );
+        int col, row;
+        if ( ! ( iss >> col >> row ) || col < 0 || row < 0 ) {
+            LOGGER_ERROR ( "Unvalid line in the slabs list : " << line );
+            return -1;
+        }
+
+        // On remonte l'arbre en créant les noeuds manquants
+        Node* child = NULL;
+        for ( int l = 0; l < levels.size(); l++ ) {
+            std::pair<int,int> key ( col, row );
+            std::map<std::pair<int,int>, Node*>::iterator it = nodes.at ( l ).find ( key );
+            bool created = ( it == nodes.at ( l ).end() );
+
+            Node* node;
+            if ( created ) {
+                node = new Node;
+                node->level = l;
+                node->col = col;
+                node->row = row;
+                node->parent = NULL;
+                memset ( node->children, 0, sizeof ( node->children ) );
+                node->pendingChildren = 0;
+                node->data = NULL;
+                node->mask = NULL;
+                nodes.at ( l ).insert ( std::make_pair ( key, node ) );
+            } else {
+                node = it->second;
+                if ( l == 0 ) break; // Dalle listée deux fois
+            }
+
+            if ( child != NULL ) {
+                node->children[child->row % 2][child->col % 2] = child;
+                node->pendingChildren++;
+                child->parent = node;
+            }
+
+            // Le reste de l'arbre existe déjà
+            if ( ! created ) break;
+
+            child = node;
+            col /= 2;
+            row /= 2;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * \~french
+ * \brief Calcule le code de Morton (ordre en Z) d'une dalle, en entrelaçant les bits de ses indices
+ * \details Trier les dalles selon ce code rend contiguës les 4 filles de chaque dalle mère, à tous les niveaux
+ * \param[in] col indice de colonne
+ * \param[in] row indice de ligne
+ * \return code de Morton
+ */
+uint64_t mortonCode ( uint32_t col, uint32_t row ) {
+    uint64_t code = 0;
+    for ( int b = 0; b < 32; b++ ) {
+        code |= ( ( uint64_t ) ( ( col >> b ) & 1 ) ) << ( 2 * b );
+        code |= ( ( uint64_t ) ( ( row >> b ) & 1 ) ) << ( 2 * b + 1 );
+    }
+    return code;
+}
+
+/**
+ * \~french
+ * \brief Ordonne deux dalles selon leur code de Morton
+ */
+bool mortonLess ( Node* a, Node* b ) {
+    return mortonCode ( a->col, a->row ) < mortonCode ( b->col, b->row );
+}
+
+/**
+ * \~french
+ * \brief Lance la génération sur le pool, pour un type de canal
+ * \details Les dalles du niveau de base sont soumises dans l'ordre en Z, pour que les 4 filles d'une dalle mère soient calculées à peu près en même temps et libérées rapidement. La soumission est suspendue tant que #maxLiveNodes dalles sont en mémoire et que des tâches sont en cours : la mémoire utilisée est ainsi bornée. Si plus aucune tâche n'est en cours, les dalles en mémoire attendent toutes des sœurs pas encore soumises, et la soumission reprend.
+ * \param[in] nodes arbre des dalles
+ * \return 0 en cas de succès, -1 sinon
+ */
+template <typename T, typename S>
+int generate ( std::vector<std::map<std::pair<int,int>, Node*> >& nodes ) {
+    T* nodata = new T[samplesperpixel];
+    for ( int i = 0; i < samplesperpixel; i++ ) nodata[i] = ( T ) nodataInt.at ( i );
+
+    std::vector<Node*> baseNodes;
+    baseNodes.reserve ( nodes.at ( 0 ).size() );
+    std::map<std::pair<int,int>, Node*>::iterator it;
+    for ( it = nodes.at ( 0 ).begin(); it != nodes.at ( 0 ).end(); ++it ) {
+        baseNodes.push_back ( it->second );
+    }
+    std::sort ( baseNodes.begin(), baseNodes.end(), mortonLess );
+
+    // Chaque thread peut tenir une dalle et ses 4 filles, et chaque niveau au plus 3 dalles en attente de leur dernière sœur
+    maxLiveNodes = 5 * nbThreads + 3 * levels.size();
+
+    ThreadPool* pool = new ThreadPool ( nbThreads );
+
+    for ( int i = 0; i < baseNodes.size(); i++ ) {
+        pthread_mutex_lock ( &nodesMutex );
+        while ( liveNodes >= maxLiveNodes && activeTasks > 0 ) {
+            pthread_cond_wait ( &nodesCond, &nodesMutex );
+        }
+        activeTasks++;
+        pthread_mutex_unlock ( &nodesMutex );
+
+        if ( __atomic_load_n ( &failed, __ATOMIC_RELAXED ) ) {
+            pthread_mutex_lock ( &nodesMutex );
+            activeTasks--;
+            pthread_mutex_unlock ( &nodesMutex );
+            break;
+        }
+
+        pool->submit ( new NodeTask<T, S> ( baseNodes.at ( i ), pool, nodata ) );
+    }
+
+    // Les tâches des niveaux supérieurs sont soumises au fil des dépendances résolues
+    pool->wait();
+    delete pool;
+    delete[] nodata;
+
+    return __atomic_load_n ( &failed, __ATOMIC_RELAXED ) ? -1 : 0;
+}
+
+/**
+ ** \~french
+ * \brief Fonction principale de l'outil qtree2cache
+ * \param[in] argc nombre de paramètres
+ * \param[in] argv tableau des paramètres
+ * \return 0 en cas de succès, -1 sinon
+ ** \~english
+ * \brief Main function for tool qtree2cache
+ * \param[in] argc parameters number
+ * \param[in] argv parameters array
+ * \return 0 if success, -1 otherwise
+ */
+int main ( int argc, char* argv[] ) {
+
+    /* Initialisation des Loggers */
+    Logger::setOutput ( STANDARD_OUTPUT_STREAM_FOR_ERRORS );
+
+    Accumulator* acc = new StreamAccumulator();
+    Logger::setAccumulator ( INFO , acc );
+    Logger::setAccumulator ( WARN , acc );
+    Logger::setAccumulator ( ERROR, acc );
+    Logger::setAccumulator ( FATAL, acc );
+
+    std::ostream &logw = LOGGER ( WARN );
+    logw.precision ( 16 );
+    logw.setf ( std::ios::fixed,std::ios::floatfield );
+
+    if ( parseCommandLine ( argc, argv ) < 0 ) {
+        error ( "Echec lecture ligne de commande",-1 );
+    }
+
+    if ( debugLogger ) {
+        Logger::setAccumulator ( DEBUG, acc );
+        std::ostream &logd = LOGGER ( DEBUG );
+        logd.precision ( 16 );
+        logd.setf ( std::ios::fixed,std::ios::floatfield );
+    }
+
+    LOGGER_DEBUG ( "Build tree" );
+    std::vector<std::map<std::pair<int,int>, Node*> > nodes;
+    if ( buildTree ( nodes ) < 0 ) {
+        error ( "Cannot build the slabs tree", -1 );
+    }
+    if ( nodes.at ( 0 ).empty() ) {
+        error ( "No base level's slab in the list", -1 );
+    }
+
+    LOGGER_DEBUG ( "Read slabs' format" );
+    // Le format des dalles est lu dans la première dalle du niveau de base
+    FileContext context ( "" );
+    context.connection();
+    Node* first = nodes.at ( 0 ).begin()->second;
+    std::string firstPath = getSlabPath ( "IMAGE", levels.at ( 0 ), first->col, first->row );
+    Rok4ImageFactory R4IF;
+    Rok4Image* firstImage = R4IF.createRok4ImageToRead ( firstPath, BoundingBox<double> ( 0.,0.,0.,0. ), 0., 0., &context );
+    if ( firstImage == NULL ) {
+        error ( "Cannot read the base slab " + firstPath, -1 );
+    }
+    width = firstImage->getWidth();
+    height = firstImage->getHeight();
+    samplesperpixel = firstImage->getChannels();
+    bitspersample = firstImage->getBitsPerSample();
+    sampleformat = firstImage->getSampleFormat();
+    photometric = firstImage->getPhotometric();
+    compression = firstImage->getCompression();
+    tileWidth = firstImage->getTileWidth();
+    tileHeight = firstImage->getTileHeight();
+    delete firstImage;
+
+    if ( width % 2 || height % 2 ) {
+        error ( "Sorry : only even dimensions for slabs are supported", -1 );
+    }
+
+    LOGGER_DEBUG ( "Nodata interpretation" );
+    std::stringstream ss ( strnodata );
+    std::string value;
+    while ( std::getline ( ss, value, ',' ) ) nodataInt.push_back ( atoi ( value.c_str() ) );
+    if ( nodataInt.size() < samplesperpixel ) {
+        error ( "Error with option -n : a value for nodata is missing", -1 );
+    }
+
+    // Table de gamma, la division par le nombre de pixels de donnée est précalculée
+    uint8_t MERGE[1024];
+    for ( int i = 0; i <= 1020; i++ ) MERGE[i] = 255 - ( uint8_t ) round ( pow ( double ( 1020 - i ) /1020., gammaQt ) * 255. );
+    memset ( gammaLut, 0, sizeof ( gammaLut ) );
+    for ( int n = 2; n <= 4; n++ ) {
+        for ( int s = 0; s <= 255 * n; s++ ) gammaLut[n * 1021 + s] = MERGE[s * 4 / n];
+    }
+
+    int ret;
+    if ( bitspersample == 32 && sampleformat == SampleFormat::FLOAT ) {
+        LOGGER_DEBUG ( "Generate (float)" );
+        ret = generate<float, float> ( nodes );
+    } else if ( bitspersample == 8 && sampleformat == SampleFormat::UINT ) {
+        LOGGER_DEBUG ( "Generate (uint8_t)" );
+        ret = generate<uint8_t, uint16_t> ( nodes );
+    } else {
+        error ( "Unhandled sample's format", -1 );
+    }
+
+    if ( ret < 0 ) {
+        error ( "Generation failed", -1 );
+    }
+
+    LOGGER_DEBUG ( "Clean" );
+    for ( int l = 0; l < nodes.size(); l++ ) {
+        std::map<std::pair<int,int>, Node*>::iterator it;
+        for ( it = nodes.at ( l ).begin(); it != nodes.at ( l ).end(); ++it ) delete it->second;
+    }
+
+    // Suppression du nettoyage du logger jusqu'à sa refonte
+    // Logger::stopLogger();
+    // if ( acc ) {
+    //     delete acc;
+    // }
+
+    return 0;
+}
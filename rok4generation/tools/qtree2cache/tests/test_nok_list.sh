@@ -0,0 +1,14 @@
+#!/bin/bash
+
+echo "test nok list"
+rm -rf outputs/list_pyramid
+mkdir -p outputs
+cp -r inputs/pyramid outputs/list_pyramid
+qtree2cache -r outputs/list_pyramid -l 2,1,0 -f inputs/missing_slabs.txt -n 255,0,0 -p 1 -j 2 2>/dev/null
+if [ $? != 0 ] ; then 
+    rm -rf outputs/list_pyramid
+    exit 0
+else
+    rm -rf outputs/list_pyramid
+    exit 1
+fi
@@ -0,0 +1,9 @@
+#!/bin/bash
+
+echo "test nok param"
+qtree2cache -r outputs/pyramid -l 12 -f inputs/slabs.txt -n 255,255,255 2>/dev/null
+if [ $? != 0 ] ; then 
+    exit 0
+else
+    exit 1
+fi
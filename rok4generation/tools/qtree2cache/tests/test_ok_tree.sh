@@ -0,0 +1,24 @@
+#!/bin/bash
+
+echo "test ok tree"
+for threads in 1 4 ; do
+    rm -rf outputs/tree_pyramid
+    mkdir -p outputs
+    cp -r inputs/pyramid outputs/tree_pyramid
+    qtree2cache -r outputs/tree_pyramid -l 2,1,0 -f inputs/slabs.txt -n 255,0,0 -p 1 -j $threads -mask
+    if [ $? != 0 ] ; then 
+        exit 1
+    fi
+
+    # Les dalles des niveaux supérieurs doivent être identiques à celles de référence, quel que soit le nombre de threads
+    for expected in $(cd inputs/expected && find . -name "*.tif") ; do
+        cmp -s inputs/expected/$expected outputs/tree_pyramid/$expected
+        if [ $? != 0 ] ; then 
+            echo "$expected differs from the expected slab (with $threads threads)"
+            exit 1
+        fi
+    done
+done
+
+rm -rf outputs/tree_pyramid
+exit 0
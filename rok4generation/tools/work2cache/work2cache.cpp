@@ -52,6 +52,7 @@
 #include "Format.h"
 #include "Logger.h"
 #include "FileContext.h"
+#include "UringFileContext.h"
 #include "FileImage.h"
 #include "CurlPool.h"
 #include "Rok4Image.h"
@@ -330,7 +331,7 @@ int main ( int argc, char **argv ) {
 #endif
 
         LOGGER_DEBUG("Output is a file in a file system");
-        context = new FileContext("");
+        context = new UringFileContext("");
 
 #if BUILD_OBJECT
     }  
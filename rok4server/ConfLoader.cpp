@@ -58,6 +58,72 @@
 #include <sys/stat.h>
 
 #include "ConfLoader.h"
+#include "ThreadPool.h"
+
+/**********************************************************************************************************/
+/******************************************* PARALLEL LOADING *********************************************/
+/**********************************************************************************************************/
+
+/**
+ * \~french \brief Tâche de chargement d'un style, le résultat est écrit dans un emplacement réservé
+ * \~english \brief Style loading task, result is written in a reserved slot
+ */
+class StyleLoadingTask : public Task {
+private:
+    std::string fileName;
+    ServicesXML* servicesXML;
+    Style** slot;
+public:
+    StyleLoadingTask ( std::string fileName, ServicesXML* servicesXML, Style** slot ) :
+        fileName ( fileName ), servicesXML ( servicesXML ), slot ( slot ) {}
+    void run() {
+        *slot = ConfLoader::buildStyle ( fileName, servicesXML );
+    }
+};
+
+/**
+ * \~french \brief Tâche de chargement d'un TMS, le résultat est écrit dans un emplacement réservé
+ * \~english \brief TMS loading task, result is written in a reserved slot
+ */
+class TMSLoadingTask : public Task {
+private:
+    std::string fileName;
+    TileMatrixSet** slot;
+public:
+    TMSLoadingTask ( std::string fileName, TileMatrixSet** slot ) : fileName ( fileName ), slot ( slot ) {}
+    void run() {
+        *slot = ConfLoader::buildTileMatrixSet ( fileName );
+    }
+};
+
+/**
+ * \~french
+ * \brief Tâche de chargement d'une couche, le résultat est écrit dans un emplacement réservé
+ * \details Les TMS et les styles doivent être déjà chargés : ils ne sont ensuite que consultés.
+ * \~english
+ * \brief Layer loading task, result is written in a reserved slot
+ * \details TMS and styles have to be already loaded : they are only read.
+ */
+class LayerLoadingTask : public Task {
+private:
+    std::string fileName;
+    ServerXML* serverXML;
+    ServicesXML* servicesXML;
+    Layer** slot;
+public:
+    LayerLoadingTask ( std::string fileName, ServerXML* serverXML, ServicesXML* servicesXML, Layer** slot ) :
+        fileName ( fileName ), serverXML ( serverXML ), servicesXML ( servicesXML ), slot ( slot ) {}
+    void run() {
+        *slot = ConfLoader::buildLayer ( fileName, serverXML, servicesXML );
+    }
+};
+
+int ConfLoader::getLoadingThreads ( ServerXML* serverXML, int nbFiles ) {
+    int nbThreads = serverXML->getNbThreads();
+    if ( nbThreads > nbFiles ) nbThreads = nbFiles;
+    if ( nbThreads < 1 ) nbThreads = 1;
+    return nbThreads;
+}
 
 /**********************************************************************************************************/
 /***************************************** SERVER & SERVICES **********************************************/
@@ -105,14 +171,23 @@ bool ConfLoader::buildStylesList ( ServerXML* serverXML, ServicesXML* servicesXM
         return false;
     }
 
-    // generer les styles decrits par les fichiers.
+    // generer les styles decrits par les fichiers, en parallèle
+    std::vector<Style*> styles ( styleFiles.size(), NULL );
+    ThreadPool* pool = new ThreadPool ( getLoadingThreads ( serverXML, styleFiles.size() ) );
     for ( unsigned int i=0; i<styleFiles.size(); i++ ) {
-        Style * style;
-        style = buildStyle ( styleFiles[i], servicesXML );
-        if ( style ) {
-            serverXML->addStyle ( style );
-        } else {
+        pool->submit ( new StyleLoadingTask ( styleFiles[i], servicesXML, & ( styles[i] ) ) );
+    }
+    delete pool;
+
+    // l'enregistrement reste séquentiel, dans l'ordre des fichiers
+    for ( unsigned int i=0; i<styleFiles.size(); i++ ) {
+        if ( ! styles[i] ) {
             LOGGER_ERROR ( _ ( "Ne peut charger le style: " ) << styleFiles[i] );
+        } else if ( serverXML->getStyle ( styles[i]->getId() ) ) {
+            LOGGER_WARN ( _ ( "Style deja defini, ignore: " ) << styleFiles[i] );
+            delete styles[i];
+        } else {
+            serverXML->addStyle ( styles[i] );
         }
     }
 
@@ -171,14 +246,23 @@ bool ConfLoader::buildTMSList ( ServerXML* serverXML ) {
         return false;
     }
 
-    // generer les TMS decrits par les fichiers.
+    // generer les TMS decrits par les fichiers, en parallèle
+    std::vector<TileMatrixSet*> tmss ( tmsFiles.size(), NULL );
+    ThreadPool* pool = new ThreadPool ( getLoadingThreads ( serverXML, tmsFiles.size() ) );
     for ( unsigned int i=0; i<tmsFiles.size(); i++ ) {
-        TileMatrixSet * tms;
-        tms = buildTileMatrixSet ( tmsFiles[i] );
-        if ( tms ) {
-            serverXML->addTMS ( tms );
-        } else {
+        pool->submit ( new TMSLoadingTask ( tmsFiles[i], & ( tmss[i] ) ) );
+    }
+    delete pool;
+
+    // l'enregistrement reste séquentiel, dans l'ordre des fichiers
+    for ( unsigned int i=0; i<tmsFiles.size(); i++ ) {
+        if ( ! tmss[i] ) {
             LOGGER_ERROR ( _ ( "Ne peut charger le tms: " ) << tmsFiles[i] );
+        } else if ( serverXML->getTMS ( tmss[i]->getId() ) ) {
+            LOGGER_WARN ( _ ( "TMS deja defini, ignore: " ) << tmsFiles[i] );
+            delete tmss[i];
+        } else {
+            serverXML->addTMS ( tmss[i] );
         }
     }
 
@@ -233,14 +317,25 @@ bool ConfLoader::buildLayersList ( ServerXML* serverXML, ServicesXML* servicesXM
         //return false;
     }
 
-    // generer les Layers decrits par les fichiers.
+    // generer les Layers decrits par les fichiers, en parallèle
+    std::vector<Layer*> layers ( layerFiles.size(), NULL );
+    if ( ! layerFiles.empty() ) {
+        ThreadPool* pool = new ThreadPool ( getLoadingThreads ( serverXML, layerFiles.size() ) );
+        for ( unsigned int i=0; i<layerFiles.size(); i++ ) {
+            pool->submit ( new LayerLoadingTask ( layerFiles[i], serverXML, servicesXML, & ( layers[i] ) ) );
+        }
+        delete pool;
+    }
+
+    // l'enregistrement reste séquentiel, dans l'ordre des fichiers
     for ( unsigned int i=0; i<layerFiles.size(); i++ ) {
-        Layer * layer;
-        layer = buildLayer ( layerFiles[i], serverXML, servicesXML );
-        if ( layer ) {
-            serverXML->addLayer ( layer );
-        } else {
+        if ( ! layers[i] ) {
             LOGGER_ERROR ( _ ( "Ne peut charger le layer: " ) << layerFiles[i] );
+        } else if ( serverXML->getLayer ( layers[i]->getId() ) ) {
+            LOGGER_WARN ( _ ( "Layer deja defini, ignore: " ) << layerFiles[i] );
+            delete layers[i];
+        } else {
+            serverXML->addLayer ( layers[i] );
         }
     }
 
@@ -195,6 +195,20 @@ public:
      */
     static Layer * buildLayer (std::string fileName, ServerXML* serverXML, ServicesXML* servicesXML );
 
+    /**
+     * \~french
+     * \brief Nombre de threads utilisés pour charger une liste de fichiers de configuration
+     * \details On reprend le nombre de threads du serveur, sans dépasser le nombre de fichiers.
+     * \param[in] serverXML configuration du serveur
+     * \param[in] nbFiles nombre de fichiers à charger
+     * \~english
+     * \brief Threads number used to load a configuration files list
+     * \details Server's threads number is used, without exceeding files number.
+     * \param[in] serverXML server configuration
+     * \param[in] nbFiles files number to load
+     */
+    static int getLoadingThreads ( ServerXML* serverXML, int nbFiles );
+
 
     /**
      * \~french
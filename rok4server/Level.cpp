@@ -49,9 +49,12 @@
 #include "Logger.h"
 #include "Kernel.h"
 #include <vector>
+#include <map>
+#include <sstream>
 #include "Pyramid.h"
 #include "Context.h"
 #include "FileContext.h"
+#include "UringFileContext.h"
 #include "PaletteDataSource.h"
 #include "Format.h"
 #include "intl.h"
@@ -62,6 +65,8 @@
 // GREG
 #include "Message.h"
 #include "Rok4Image.h"
+#include "DecodedTilePool.h"
+#include "RequestTileSet.h"
 // GREG
 
 
@@ -163,7 +168,11 @@ Level::Level ( Level* obj, ServerXML* sxml, TileMatrixSet* tms) {
     if (obj->context != NULL) {
         switch ( obj->context->getType() ) {
             case FILECONTEXT :
-                context = new FileContext("");
+                if ( sxml->getIoUring() ) {
+                    context = new UringFileContext("");
+                } else {
+                    context = new FileContext("");
+                }
                 if (! context->connection() ) {
                     LOGGER_ERROR("Impossible de se connecter aux donnees.");
                     tm == NULL;
@@ -401,10 +410,21 @@ Image* Level::getwindow ( ServicesXML* servicesConf, BoundingBox< int64_t > bbox
     memset ( bottom, 0, nby*sizeof ( int ) );
     bottom[nby- 1] = tm->getTileH() - euclideanDivisionRemainder ( bbox.ymax -1,tm->getTileH() ) - 1;
 
+    // Toutes les tuiles de la fenêtre, lues de manière groupée
+    std::vector<int> cols ( nbx * nby );
+    std::vector<int> rows ( nbx * nby );
+    for ( int y = 0; y < nby; y++ ) {
+        for ( int x = 0; x < nbx; x++ ) {
+            cols[y * nbx + x] = tile_xmin + x;
+            rows[y * nbx + x] = tile_ymin + y;
+        }
+    }
+    std::vector<DataSource*> decTiles = getDecodedTiles ( cols, rows );
+
     std::vector<std::vector<Image*> > T ( nby, std::vector<Image*> ( nbx ) );
     for ( int y = 0; y < nby; y++ ) {
         for ( int x = 0; x < nbx; x++ ) {
-            T[y][x] = getTile ( tile_xmin + x, tile_ymin + y, left[x], top[y], right[x], bottom[y] );
+            T[y][x] = getTile ( decTiles[y * nbx + x], tile_xmin + x, tile_ymin + y, left[x], top[y], right[x], bottom[y] );
         }
     }
 
@@ -412,6 +432,57 @@ Image* Level::getwindow ( ServicesXML* servicesConf, BoundingBox< int64_t > bbox
     else return new CompoundImage ( T );
 }
 
+void Level::getPoints ( std::vector<double>& xs, std::vector<double>& ys, float* values ) {
+
+    int tileW = tm->getTileW();
+    int tileH = tm->getTileH();
+
+    // On regroupe les points par tuile, pour ne lire et décoder chaque tuile qu'une fois
+    std::map<std::pair<int, int>, std::vector<int> > pointsByTile;
+
+    for ( unsigned int i = 0; i < xs.size(); i++ ) {
+        int64_t col = floor ( ( xs[i] - tm->getX0() ) / tm->getRes() );
+        int64_t row = floor ( ( tm->getY0() - ys[i] ) / tm->getRes() );
+        int tileCol = euclideanDivisionQuotient ( col, tileW );
+        int tileRow = euclideanDivisionQuotient ( row, tileH );
+
+        if ( tileCol < 0 || tileRow < 0 || tileCol < minTileCol || tileCol > maxTileCol || tileRow < minTileRow || tileRow > maxTileRow ) {
+            // Point hors du niveau
+            for ( int c = 0; c < channels; c++ ) values[i * channels + c] = nodataValue[c];
+            continue;
+        }
+
+        pointsByTile[std::make_pair ( tileCol, tileRow )].push_back ( i );
+    }
+
+    // Lecture groupée des tuiles concernées
+    std::vector<int> cols;
+    std::vector<int> rows;
+    std::map<std::pair<int, int>, std::vector<int> >::iterator it;
+    for ( it = pointsByTile.begin(); it != pointsByTile.end(); it++ ) {
+        cols.push_back ( it->first.first );
+        rows.push_back ( it->first.second );
+    }
+    std::vector<DataSource*> decTiles = getDecodedTiles ( cols, rows );
+
+    int t = 0;
+    for ( it = pointsByTile.begin(); it != pointsByTile.end(); it++, t++ ) {
+        int tileCol = it->first.first;
+        int tileRow = it->first.second;
+        Image* tile = getTile ( decTiles[t], tileCol, tileRow, 0, 0, 0, 0 );
+
+        for ( unsigned int k = 0; k < it->second.size(); k++ ) {
+            int i = it->second[k];
+            int64_t col = floor ( ( xs[i] - tm->getX0() ) / tm->getRes() );
+            int64_t row = floor ( ( tm->getY0() - ys[i] ) / tm->getRes() );
+            tile->getBlock ( values + i * channels,
+                             euclideanDivisionRemainder ( col, tileW ), euclideanDivisionRemainder ( row, tileH ), 1, 1 );
+        }
+
+        delete tile;
+    }
+}
+
 /*
  * Tableau statique des caractères Base36 (pour systeme de fichier non case-sensitive)
  */
@@ -523,7 +594,7 @@ int Level::createDirPath (std::string path) {
 /*
  * @return la tuile d'indice (x,y) du niveau
  */
-DataSource* Level::getEncodedTile ( int x, int y ) { // TODO: return 0 sur des cas d'erreur..
+StoreDataSource* Level::getEncodedTile ( int x, int y ) { // TODO: return 0 sur des cas d'erreur..
 
     //on stocke une dalle
     // Index de la tuile (cf. ordre de rangement des tuiles)
@@ -535,9 +606,60 @@ DataSource* Level::getEncodedTile ( int x, int y ) { // TODO: return 0 sur des c
     return new StoreDataSource ( path, posoff, possize, ROK4_IMAGE_HEADER_SIZE + 2*4*tilesPerWidth*tilesPerHeight, Rok4Format::toMimeType ( format ), context, Rok4Format::toEncoding( format ) );
 }
 
+std::string Level::getTileKey ( int x, int y ) {
+    int n = ( y%tilesPerHeight ) *tilesPerWidth + ( x%tilesPerWidth );
+    std::ostringstream key;
+    key << context->getTypeStr() << ":" << context->getTray() << "/" << getPath ( x, y, tilesPerWidth, tilesPerHeight ) << "#" << n;
+    return key.str();
+}
+
 DataSource* Level::getDecodedTile ( int x, int y ) {
+    if ( ! DecodedTilePool::isEnabled() ) return getDecodedTile ( getEncodedTile ( x, y ) );
+
+    std::string key = getTileKey ( x, y );
+    DataSource* cached = DecodedTilePool::get ( key );
+    if ( cached ) return cached;
+    return DecodedTilePool::wrap ( key, getDecodedTile ( getEncodedTile ( x, y ) ) );
+}
+
+std::vector<DataSource*> Level::getDecodedTiles ( std::vector<int>& cols, std::vector<int>& rows ) {
+
+    std::vector<DataSource*> decTiles ( cols.size(), NULL );
+    std::vector<std::string> keys ( cols.size() );
+
+    // Seules les tuiles absentes du cache, et pas encore lues par une autre chaîne de la requête, sont lues
+    bool shared = RequestTileSet::isActive();
+    std::vector<StoreDataSource*> encTiles;
+    std::vector<int> missing;
+    for ( unsigned int i = 0; i < cols.size(); i++ ) {
+        if ( DecodedTilePool::isEnabled() || shared ) {
+            keys[i] = getTileKey ( cols[i], rows[i] );
+        }
+        if ( shared && RequestTileSet::get ( keys[i], decTiles[i] ) ) continue;
+        if ( DecodedTilePool::isEnabled() ) {
+            decTiles[i] = DecodedTilePool::get ( keys[i] );
+            if ( decTiles[i] ) {
+                if ( shared ) decTiles[i] = RequestTileSet::add ( keys[i], decTiles[i] );
+                continue;
+            }
+        }
+        encTiles.push_back ( getEncodedTile ( cols[i], rows[i] ) );
+        missing.push_back ( i );
+    }
+    StoreDataSource::prefetch ( encTiles );
+
+    for ( unsigned int m = 0; m < missing.size(); m++ ) {
+        int i = missing[m];
+        DataSource* decoded = getDecodedTile ( encTiles[m] );
+        if ( DecodedTilePool::isEnabled() ) decoded = DecodedTilePool::wrap ( keys[i], decoded );
+        decTiles[i] = ( shared ) ? RequestTileSet::add ( keys[i], decoded ) : decoded;
+    }
+
+    return decTiles;
+}
+
+DataSource* Level::getDecodedTile ( DataSource* encData ) {
 
-    DataSource* encData = getEncodedTile ( x, y );
     if (encData == NULL) return 0;
 
     size_t size;
@@ -585,13 +707,15 @@ DataSource* Level::getTile (int x, int y) {
 }
 
 Image* Level::getTile ( int x, int y, int left, int top, int right, int bottom ) {
+    return getTile ( getDecodedTile ( x,y ), x, y, left, top, right, bottom );
+}
+
+Image* Level::getTile ( DataSource* ds, int x, int y, int left, int top, int right, int bottom ) {
     int pixel_size=1;
     LOGGER_DEBUG ( _ ( "GetTile Image" ) );
     if ( format==Rok4Format::TIFF_RAW_FLOAT32 || format == Rok4Format::TIFF_LZW_FLOAT32 || format == Rok4Format::TIFF_ZIP_FLOAT32 || format == Rok4Format::TIFF_PKB_FLOAT32 )
         pixel_size=4;
 
-    DataSource* ds = getDecodedTile ( x,y );
-
     BoundingBox<double> bb ( 
         tm->getX0() + x * tm->getTileW() * tm->getRes() + left * tm->getRes(),
         tm->getY0() - ( y+1 ) * tm->getTileH() * tm->getRes() + bottom * tm->getRes(),
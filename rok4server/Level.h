@@ -90,8 +90,19 @@ private:
     int* nodataValue;
 
 
-    DataSource* getEncodedTile ( int x, int y );
+    StoreDataSource* getEncodedTile ( int x, int y );
     DataSource* getDecodedTile ( int x, int y );
+    DataSource* getDecodedTile ( DataSource* encData );
+    /**
+     * Renvoie les tuiles décodées d'indices (cols[i], rows[i]), depuis le cache des tuiles décodées si elles y sont,
+     * les autres étant lues de manière groupée puis mises en cache lors de leur décodage.
+     */
+    std::vector<DataSource*> getDecodedTiles ( std::vector<int>& cols, std::vector<int>& rows );
+    /**
+     * Clé identifiant la tuile d'indice (x,y) dans le cache des tuiles décodées
+     */
+    std::string getTileKey ( int x, int y );
+    Image* getTile ( DataSource* ds, int x, int y, int left, int top, int right, int bottom );
 
 protected:
     /**
@@ -132,6 +143,15 @@ public:
     Image* getbbox ( ServicesXML* servicesConf, BoundingBox<double> bbox, int width, int height, Interpolation::KernelType interpolation, int& error );
 
     Image* getbbox ( ServicesXML* servicesConf, BoundingBox<double> bbox, int width, int height, CRS src_crs, CRS dst_crs, Interpolation::KernelType interpolation, int& error );
+
+    /**
+     * Renvoie les valeurs brutes des pixels contenant les points (xs[i], ys[i]), exprimés dans le CRS du niveau.
+     *
+     * Seules les tuiles contenant des points sont lues et décodées, une seule fois chacune, sans construire d'image
+     * de la zone. values doit contenir channels valeurs par point. Un point hors des limites du niveau ou dans une
+     * tuile absente reçoit la valeur de non-donnée.
+     */
+    void getPoints ( std::vector<double>& xs, std::vector<double>& ys, float* values );
     /**
      * Renvoie la tuile x, y numéroté depuis l'origine.
      * Le coin haut gauche de la tuile (0,0) est (Xorigin, Yorigin)
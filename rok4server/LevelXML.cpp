@@ -38,6 +38,7 @@
 #include "LevelXML.h"
 
 #include "FileContext.h"
+#include "UringFileContext.h"
 
 #if BUILD_OBJECT
 #include "CephPoolContext.h"
@@ -105,7 +106,11 @@ LevelXML::LevelXML( TiXmlElement* levelElement, std::string path, ServerXML* ser
             return;
         }
 
-        context = new FileContext("");
+        if ( serverXML->getIoUring() ) {
+            context = new UringFileContext("");
+        } else {
+            context = new FileContext("");
+        }
         if (! context->connection() ) {
             LOGGER_ERROR("Impossible de se connecter aux donnees.");
             return;
@@ -54,6 +54,7 @@
 #include "intl.h"
 #include "config.h"
 #include "EmptyImage.h"
+#include "RequestTrace.h"
 
 ComparatorLevel compLevelDesc =
     [](std::pair<std::string, Level*> elem1 ,std::pair<std::string, Level*> elem2)
@@ -195,6 +196,8 @@ std::string Pyramid::best_level ( double resolution_x, double resolution_y, bool
 
 Image* Pyramid::getbbox ( ServicesXML* servicesXML, BoundingBox<double> bbox, int width, int height, CRS dst_crs, Interpolation::KernelType interpolation, int dpi, int& error ) {
 
+    TraceScope scope ( TraceStage::LEVEL );
+
     // On calcule la résolution de la requete dans le crs source selon une diagonale de l'image
     double resolution_x, resolution_y;
 
@@ -243,6 +246,47 @@ Image* Pyramid::getbbox ( ServicesXML* servicesXML, BoundingBox<double> bbox, in
 
 }
 
+bool Pyramid::getPoints ( ServicesXML* servicesXML, std::vector<BoundingBox<double> >& pixels, CRS dst_crs, float* values, int& error ) {
+
+    TraceScope scope ( TraceStage::LEVEL );
+
+    error = 0;
+    if ( pixels.empty() ) return true;
+
+    bool sameCrs = ( tms->getCrs() == dst_crs || servicesXML->are_the_two_CRS_equal( tms->getCrs().getProj4Code(), dst_crs.getProj4Code() ) );
+
+    std::vector<double> xs ( pixels.size() );
+    std::vector<double> ys ( pixels.size() );
+    double resolution_x = 0, resolution_y = 0;
+
+    for ( unsigned int i = 0; i < pixels.size(); i++ ) {
+        BoundingBox<double> px = pixels[i];
+        // Un pixel est petit : quelques points par côté suffisent à le reprojeter
+        if ( ! sameCrs && px.reproject ( dst_crs.getProj4Code(), tms->getCrs().getProj4Code(), 4 ) != 0 ) {
+            error = 1;
+            return false;
+        }
+        if ( i == 0 ) {
+            resolution_x = px.xmax - px.xmin;
+            resolution_y = px.ymax - px.ymin;
+        }
+        xs[i] = ( px.xmin + px.xmax ) / 2.;
+        ys[i] = ( px.ymin + px.ymax ) / 2.;
+    }
+
+    std::string l = best_level ( resolution_x, resolution_y, false );
+    Level* level = levels[l];
+    if ( level->isOnDemand() || level->isOnFly() ) {
+        // Les tuiles ne sont pas forcément stockées : il faut passer par l'image complète
+        return false;
+    }
+
+    LOGGER_DEBUG ( _ ( "best_level=" ) << l << _ ( " requete ponctuelle sur " ) << pixels.size() << _ ( " pixel(s)" ) );
+    level->getPoints ( xs, ys, values );
+
+    return true;
+}
+
 Image * Pyramid::createReprojectedImage(std::string l, BoundingBox<double> bbox, CRS dst_crs, ServicesXML* servicesXML, int width, int height, Interpolation::KernelType interpolation, int error) {
 
     if ( dst_crs.validateBBox ( bbox ) ) {
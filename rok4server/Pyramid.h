@@ -347,6 +347,28 @@ public:
      */
     Image* getbbox (ServicesXML* servicesConf, BoundingBox<double> bbox, int width, int height, CRS dst_crs, Interpolation::KernelType interpolation, int dpi, int& error );
 
+    /**
+     * \~french \brief Récupère les valeurs brutes des pixels de la pyramide sous des pixels de requête
+     * \details Le niveau est choisi selon la résolution du premier pixel, puis chaque pixel est ramené à son centre,
+     * exprimé dans le CRS de la pyramide. Seules les tuiles contenant ces points sont lues, sans construire d'image.
+     * \param[in] servicesConf configuration des services
+     * \param[in] pixels emprises des pixels interrogés, dans dst_crs
+     * \param[in] dst_crs système de coordonnées des pixels
+     * \param[out] values valeurs des pixels, getChannels() par pixel
+     * \param[out] error 1 si un pixel n'est pas reprojetable, 0 sinon
+     * \return faux si la requête ne peut pas être traitée ainsi (niveau à la demande, erreur), vrai sinon
+     * \~english \brief Get raw pyramid values under request pixels
+     * \details Level is chosen with the first pixel's resolution, then each pixel is reduced to its center,
+     * expressed in the pyramid's CRS. Only tiles containing these points are read, no image is built.
+     * \param[in] servicesConf services configuration
+     * \param[in] pixels queried pixels' extents, in dst_crs
+     * \param[in] dst_crs pixels' coordinate system
+     * \param[out] values pixels' values, getChannels() per pixel
+     * \param[out] error 1 if a pixel cannot be reprojected, 0 otherwise
+     * \return false if the request cannot be processed this way (on demand level, error), true otherwise
+     */
+    bool getPoints (ServicesXML* servicesConf, std::vector<BoundingBox<double> >& pixels, CRS dst_crs, float* values, int& error );
+
     /**
      * \~french \brief Créé une image reprojetée
      * \~english \brief Create a reprojected image
@@ -54,6 +54,7 @@
 #include "tinyxml.h"
 #include "config.h"
 #include <algorithm>
+#include <sstream>
 #include "intl.h"
 
 
@@ -762,7 +763,7 @@ void Request::determineServiceAndRequest() {
 }
 
 Request::Request ( char* strquery, char* hostName, char* path, char* https ) : 
-    hostName ( hostName ),path ( path ), service(ServiceType::SERVICE_MISSING), request(RequestType::REQUEST_MISSING)
+    hostName ( hostName ),path ( path ), service(ServiceType::SERVICE_MISSING), request(RequestType::REQUEST_MISSING), acceptGzip ( false ), varyEncoding ( false )
 {
     LOGGER_DEBUG ( "QUERY="<<strquery );
     if ( https && (strcmp ( https,"on" ) == 0 || strcmp ( https,"ON" ) ==0) ){
@@ -791,7 +792,7 @@ Request::Request ( char* strquery, char* hostName, char* path, char* https ) :
 
 
 Request::Request ( char* strquery, char* hostName, char* path, char* https, std::string postContent ) : 
-    hostName ( hostName ),path ( path ), service(ServiceType::SERVICE_MISSING), request(RequestType::REQUEST_MISSING)
+    hostName ( hostName ),path ( path ), service(ServiceType::SERVICE_MISSING), request(RequestType::REQUEST_MISSING), acceptGzip ( false ), varyEncoding ( false )
 {
     LOGGER_DEBUG ( "QUERY="<<strquery );
     if ( https && (strcmp ( https,"on" ) == 0 || strcmp ( https,"ON" ) ==0) ){
@@ -826,4 +827,31 @@ std::string Request::getParam ( std::string paramName ) {
     }
     return it->second;
 }
+
+void Request::setAcceptEncoding ( const char* acceptEncoding ) {
+    acceptGzip = false;
+    if ( ! acceptEncoding ) return;
+
+    // Liste de codages séparés par des virgules, chacun éventuellement suivi de ";q=<poids>"
+    // Un poids nul refuse le codage, une mention explicite de gzip prime sur "*"
+    std::string header ( acceptEncoding );
+    std::transform ( header.begin(), header.end(), header.begin(), ::tolower );
+    double gzipQ = -1., anyQ = -1.;
+    std::stringstream ss ( header );
+    std::string coding;
+    while ( std::getline ( ss, coding, ',' ) ) {
+        std::string name = coding.substr ( 0, coding.find ( ';' ) );
+        name.erase ( 0, name.find_first_not_of ( " \t" ) );
+        name.erase ( name.find_last_not_of ( " \t" ) + 1 );
+
+        double q = 1.;
+        size_t qPos = coding.find ( "q=" );
+        if ( qPos != std::string::npos ) q = atof ( coding.c_str() + qPos + 2 );
+
+        if ( name == "gzip" || name == "x-gzip" ) gzipQ = q;
+        else if ( name == "*" ) anyQ = q;
+    }
+    acceptGzip = ( gzipQ >= 0. ) ? ( gzipQ > 0. ) : ( anyQ > 0. );
+}
+
     
\ No newline at end of file
@@ -213,6 +213,16 @@ public:
      */
     std::string getParam ( std::string paramName );
 
+    /**
+     * \~french
+     * \brief Analyse l'en-tête Accept-Encoding de la requête
+     * \param[in] acceptEncoding valeur de l'en-tête, éventuellement NULL
+     * \~english
+     * \brief Parse the request's Accept-Encoding header
+     * \param[in] acceptEncoding header value, possibly NULL
+     */
+    void setAcceptEncoding ( const char* acceptEncoding );
+
     /**
      * \~french \brief Nom de domaine de la requête
      * \~english \brief Request domain name
@@ -245,6 +255,20 @@ public:
      */
     std::map<std::string, std::string> params;
 
+    /**
+     * \~french \brief Le client accepte une réponse compressée en gzip
+     * \~english \brief Client accepts a gzip compressed response
+     */
+    bool acceptGzip;
+
+    /**
+     * \~french \brief La réponse dépend-elle de l'en-tête Accept-Encoding (format compressible à la demande, ou stocké compressé)
+     * \details Renseigné lors du traitement de la requête, pour envoyer Vary: Accept-Encoding avec toutes les variantes, compressée ou non
+     * \~english \brief Does the response depend on the Accept-Encoding header (format compressible on demand, or stored compressed)
+     * \details Set while processing the request, to send Vary: Accept-Encoding with all variants, compressed or not
+     */
+    bool varyEncoding;
+
     void print() {
         LOGGER_INFO("hostName = " << hostName);
         LOGGER_INFO("path = " << path);
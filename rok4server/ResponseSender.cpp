@@ -48,11 +48,55 @@
 #include "Message.h"
 #include <iostream>
 #include "Logger.h"
+#include "Metrics.h"
+#include "RequestTrace.h"
 #include <stdio.h>
 #include <string.h> // pour strlen
 #include <sstream> // pour les stringstream
 #include "intl.h"
 #include "config.h"
+#include <pthread.h>
+#include <map>
+
+/**
+ * \~french \brief Clé du cache, propre à chaque thread, des histogrammes d'envoi par type MIME
+ * \~english \brief Key of each thread's own cache of sending histograms by MIME type
+ */
+static pthread_key_t streamMetricsKey;
+static pthread_once_t streamMetricsOnce = PTHREAD_ONCE_INIT;
+
+static void deleteStreamMetrics ( void* cache ) {
+    if ( cache ) delete ( std::map<std::string, MetricHistogram*>* ) cache;
+}
+
+static void createStreamMetricsKey() {
+    pthread_key_create ( &streamMetricsKey, deleteStreamMetrics );
+}
+
+/**
+ * \~french
+ * \brief Histogramme des durées d'envoi en flux d'un type MIME
+ * \details Le registre des métriques n'est consulté qu'au premier envoi de ce type par le thread, le cache étant ensuite lu sans verrou
+ * \~english
+ * \brief Streamed sending duration histogram of a MIME type
+ * \details The metrics registry is only queried on the thread's first sending of this type, the cache being then read without lock
+ */
+static MetricHistogram* getStreamMetrics ( std::string& type ) {
+    pthread_once ( &streamMetricsOnce, createStreamMetricsKey );
+    std::map<std::string, MetricHistogram*>* cache = ( std::map<std::string, MetricHistogram*>* ) pthread_getspecific ( streamMetricsKey );
+    if ( cache == NULL ) {
+        cache = new std::map<std::string, MetricHistogram*>();
+        pthread_setspecific ( streamMetricsKey, cache );
+    }
+
+    std::map<std::string, MetricHistogram*>::iterator it = cache->find ( type );
+    if ( it != cache->end() ) return it->second;
+
+    MetricHistogram* histogram = Metrics::getHistogram ( "rok4_response_stream_seconds", "Durée d'encodage et d'envoi des réponses en flux", Metrics::label ( "type", type ) );
+    cache->insert ( std::pair<std::string, MetricHistogram*> ( type, histogram ) );
+    return histogram;
+}
+
 /**
  * \~french
  * \brief Méthode commune pour générer l'en-tête HTTP en fonction du status code HTTP
@@ -124,7 +168,24 @@ void displayFCGIError ( int error ) {
         LOGGER_ERROR ( _ ( "Erreur inconnue" ) );
 }
 
-int ResponseSender::sendresponse ( DataSource* source, FCGX_Request* request ) {
+/**
+ * \~french
+ * \brief Écrit l'en-tête Server-Timing si le suivi de la requête le demande
+ * \details Les étapes d'encodage et d'envoi, qui ont lieu après les en-têtes, n'y figurent pas
+ * \param[in] request requête FCGI
+ * \~english
+ * \brief Write the Server-Timing header if the request's tracking asks for it
+ * \details Encoding and sending stages, which occur after headers, are not included
+ * \param[in] request FCGI request
+ */
+void putServerTiming ( FCGX_Request* request ) {
+    std::string timing = RequestTrace::getServerTiming();
+    if ( timing.empty() ) return;
+    FCGX_PutStr ( "\r\nServer-Timing: ",17,request->out );
+    FCGX_PutStr ( timing.data(), timing.size(), request->out );
+}
+
+int ResponseSender::sendresponse ( DataSource* source, FCGX_Request* request, bool varyEncoding ) {
     // Creation de l'en-tete
     std::string statusHeader = genStatusHeader ( source->getHttpStatus() );
     std::string filename = genFileName ( source->getType() );
@@ -136,6 +197,10 @@ int ResponseSender::sendresponse ( DataSource* source, FCGX_Request* request ) {
         FCGX_PutStr ( "\r\nContent-Encoding: ",20,request->out );
         FCGX_PutStr ( source->getEncoding().c_str(), strlen ( source->getEncoding().c_str() ),request->out );
     }
+    // Les variantes compressée et non compressée portent toutes deux Vary, pour que les caches les distinguent
+    if ( varyEncoding || !source->getEncoding().empty() ){
+        FCGX_PutStr ( "\r\nVary: Accept-Encoding",23,request->out );
+    }
     if ( source->getLength() != 0 ){
         std::stringstream ss;
         ss << source->getLength();
@@ -146,11 +211,17 @@ int ResponseSender::sendresponse ( DataSource* source, FCGX_Request* request ) {
     FCGX_PutStr ( "\r\nContent-Disposition: filename=\"",33,request->out );
     FCGX_PutStr ( filename.data(),filename.size(), request->out );
     FCGX_PutStr ( "\"",1,request->out );
+    putServerTiming ( request );
     FCGX_PutStr ( "\r\n\r\n",4,request->out );
 
     // Copie dans le flux de sortie
     size_t buffer_size;
-    const uint8_t *buffer = source->getData ( buffer_size );
+    const uint8_t *buffer;
+    {
+        TraceScope scope ( TraceStage::ENCODE );
+        buffer = source->getData ( buffer_size );
+    }
+    TraceScope sendScope ( TraceStage::SEND );
     int wr = 0;
     // Ecriture iterative de la source de donnees dans le flux de sortie
     while ( wr < buffer_size ) {
@@ -170,7 +241,7 @@ int ResponseSender::sendresponse ( DataSource* source, FCGX_Request* request ) {
     return 0;
 }
 
-int ResponseSender::sendresponse ( DataStream* stream, FCGX_Request* request ) {
+int ResponseSender::sendresponse ( DataStream* stream, FCGX_Request* request, bool varyEncoding ) {
     // Creation de l'en-tete
     std::string statusHeader= genStatusHeader ( stream->getHttpStatus() );
     std::string filename = genFileName ( stream->getType() );
@@ -178,6 +249,14 @@ int ResponseSender::sendresponse ( DataStream* stream, FCGX_Request* request ) {
     FCGX_PutStr ( statusHeader.data(),statusHeader.size(),request->out );
     FCGX_PutStr ( "Content-Type: ",14,request->out );
     FCGX_PutStr ( stream->getType().c_str(), strlen ( stream->getType().c_str() ),request->out );
+    if ( !stream->getEncoding().empty() ){
+        FCGX_PutStr ( "\r\nContent-Encoding: ",20,request->out );
+        FCGX_PutStr ( stream->getEncoding().c_str(), strlen ( stream->getEncoding().c_str() ),request->out );
+    }
+    // Les variantes compressée et non compressée portent toutes deux Vary, pour que les caches les distinguent
+    if ( varyEncoding || !stream->getEncoding().empty() ){
+        FCGX_PutStr ( "\r\nVary: Accept-Encoding",23,request->out );
+    }
     if ( stream->getLength() != 0 ){
         std::stringstream ss;
         ss << stream->getLength();
@@ -188,8 +267,11 @@ int ResponseSender::sendresponse ( DataStream* stream, FCGX_Request* request ) {
     FCGX_PutStr ( "\r\nContent-Disposition: filename=\"",33,request->out );
     FCGX_PutStr ( filename.data(),filename.size(), request->out );
     FCGX_PutStr ( "\"",1,request->out );
+    putServerTiming ( request );
     FCGX_PutStr ( "\r\n\r\n",4,request->out );
-    // Copie dans le flux de sortie
+    // Copie dans le flux de sortie, l'encodage se faisant au fil de la lecture du flux
+    std::string type = stream->getType();
+    double start = Metrics::now();
     uint8_t *buffer = new uint8_t[2 << 20];
     size_t size_to_read = 2 << 20;
     int pos = 0;
@@ -198,9 +280,14 @@ int ResponseSender::sendresponse ( DataStream* stream, FCGX_Request* request ) {
     while ( true ) {
         // Recuperation d'une portion du flux d'entree
 
-        size_t read_size = stream->read ( buffer, size_to_read );
+        size_t read_size;
+        {
+            TraceScope scope ( TraceStage::ENCODE );
+            read_size = stream->read ( buffer, size_to_read );
+        }
         if ( read_size==0 )
             break;
+        TraceScope sendScope ( TraceStage::SEND );
         int wr = 0;
         // Ecriture iterative de la portion du flux d'entree dans le flux de sortie
         while ( wr < read_size ) {
@@ -231,6 +318,7 @@ int ResponseSender::sendresponse ( DataStream* stream, FCGX_Request* request ) {
     if ( buffer ) {
         delete[] buffer;
     }
+    getStreamMetrics ( type )->observe ( Metrics::now() - start );
     LOGGER_DEBUG ( _ ( "End of Response" ) );
     return 0;
 }
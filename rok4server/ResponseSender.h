@@ -61,21 +61,25 @@ public:
     /**
      * \~french
      * \brief Copie d'une source de données dans le flux de sortie de l'objet request de type FCGX_Request
+     * \param[in] varyEncoding la réponse dépend de l'en-tête Accept-Encoding, même non compressée
      * \return -1 en cas de problème, 0 sinon
      * \~english
      * \brief Copy a data source in the FCGX_Request output stream
+     * \param[in] varyEncoding the response depends on the Accept-Encoding header, even if not compressed
      * \return -1 if error, else 0
      */
-    int sendresponse ( DataSource* response, FCGX_Request* request );
+    int sendresponse ( DataSource* response, FCGX_Request* request, bool varyEncoding = false );
     /**
      * \~french
      * \brief Copie d'un flux d'entree dans le flux de sortie de l'objet request de type FCGX_Request
+     * \param[in] varyEncoding la réponse dépend de l'en-tête Accept-Encoding, même non compressée
      * \return -1 en cas de problème, 0 sinon
      * \~english
      * \brief Copy a data stream in the FCGX_Request output stream
+     * \param[in] varyEncoding the response depends on the Accept-Encoding header, even if not compressed
      * \return -1 if error, else 0
      */
-    int sendresponse ( DataStream* response, FCGX_Request* request );
+    int sendresponse ( DataStream* response, FCGX_Request* request, bool varyEncoding = false );
 };
 
 
@@ -68,6 +68,8 @@
 #include <libintl.h>
 #include "ServerXML.h"
 #include "ServicesXML.h"
+#include "MappedFilePool.h"
+#include "DecodedTilePool.h"
 
 static bool loggerInitialised = false;
 
@@ -120,6 +122,12 @@ Rok4Server* rok4InitServer ( const char* serverConfigFile ) {
         LOGGER_INFO ( _ ( "*** NOUVEAU CLIENT DU LOGGER ***" ) );
     }
 
+    // Projection mémoire des dalles fichier
+    MappedFilePool::setMaxFiles ( serverXML->getMappedFilesCacheSize() );
+
+    // Cache des tuiles décodées
+    DecodedTilePool::setMaxSize ( serverXML->getDecodedTilesCacheSize() );
+
     // Construction des parametres de service
     ServicesXML* servicesXML = ConfLoader::buildServicesConf ( serverXML->getServicesConfigFile() );
     if ( ! servicesXML->isOk() ) {
@@ -502,7 +510,8 @@ void rok4KillLogger() {
 }
 
 /**
- * \brief Fermeture des descripteurs de fichiers
+ * \brief Réouverture des fichiers de log
+ * \details Les fichiers sont fermés et rouverts par le thread d'écriture de l'accumulateur, les threads de traitement pouvant continuer à journaliser pendant le rechargement
  */
 void rok4ReloadLogger() {
     Accumulator* acc = NULL;
@@ -512,7 +521,7 @@ void rok4ReloadLogger() {
             break;
         }
     if ( acc ) {
-        acc->close();
+        acc->reopen();
     }
 }
 
@@ -72,7 +72,9 @@
 #include "PNGEncoder.h"
 #include "JPEGEncoder.h"
 #include "BilEncoder.h"
+#include "Decoder.h"
 #include "AscEncoder.h"
+#include "GzipDataStream.h"
 #include "Format.h"
 #include "Message.h"
 #include "StyledImage.h"
@@ -84,15 +86,37 @@
 #include "PaletteDataSource.h"
 #include "EstompageImage.h"
 #include "MergeImage.h"
+#include "BandImage.h"
+#include "StripImage.h"
+#include "RequestTileSet.h"
 #include "ProcessFactory.h"
 #include "Rok4Image.h"
 #include "EmptyImage.h"
 #include "FileContext.h"
+#include "UringFileContext.h"
 #include "PenteImage.h"
 #include "Pente.h"
 #include "AspectImage.h"
 #include "Aspect.h"
 #include "ConvertedChannelsImage.h"
+#include "RequestArena.h"
+#include "Metrics.h"
+#include "RequestTrace.h"
+#include "DecodedTilePool.h"
+#include "MappedFilePool.h"
+#if BUILD_OBJECT
+#include "SwiftToken.h"
+#endif
+
+/**
+ * \~french \brief Histogrammes des durées de traitement d'une couche, par service et type de requête
+ * \details Les pointeurs sont renseignés à la première requête correspondante puis réutilisés sans passer par le registre
+ * \~english \brief Processing duration histograms of a layer, by service and request type
+ * \details Pointers are filled on the first matching request, then reused without going through the registry
+ */
+struct RequestMetrics {
+    MetricHistogram* seconds[ServiceType::TMS + 1][RequestType::GETVERSION + 1];
+};
 
 void hangleSIGALARM(int id) {
     if(id==SIGALRM) {
@@ -101,20 +125,47 @@ void hangleSIGALARM(int id) {
     signal(SIGALRM, hangleSIGALARM) ;
 }
 
+volatile bool Rok4Server::running = false;
+Rok4Server* Rok4Server::current = NULL;
+pthread_mutex_t Rok4Server::generationMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t Rok4Server::generationCond = PTHREAD_COND_INITIALIZER;
+uint64_t Rok4Server::tracedRequests = 0;
+
+Rok4Server* Rok4Server::acquireCurrent() {
+    pthread_mutex_lock ( &generationMutex );
+    Rok4Server* server = current;
+    server->users++;
+    pthread_mutex_unlock ( &generationMutex );
+    return server;
+}
+
+void Rok4Server::releaseCurrent ( Rok4Server* server ) {
+    pthread_mutex_lock ( &generationMutex );
+    server->users--;
+    if ( server != current && server->users == 0 ) {
+        // Dernière requête d'une génération retirée
+        pthread_cond_broadcast ( &generationCond );
+    }
+    pthread_mutex_unlock ( &generationMutex );
+}
+
 void* Rok4Server::thread_loop ( void* arg ) {
-    Rok4Server* server = ( Rok4Server* ) ( arg );
+    // Seul le socket est pris dans le serveur ayant lancé le thread : chaque requête utilise la génération publiée
+    Rok4Server* host = ( Rok4Server* ) ( arg );
     FCGX_Request fcgxRequest;
-    if ( FCGX_InitRequest ( &fcgxRequest, server->sock, FCGI_FAIL_ACCEPT_ON_INTR ) != 0 ) {
+    MetricGauge* busyThreads = Metrics::getGauge ( "rok4_threads_busy", "Nombre de threads traitant une requete" );
+    if ( FCGX_InitRequest ( &fcgxRequest, host->sock, FCGI_FAIL_ACCEPT_ON_INTR ) != 0 ) {
         LOGGER_FATAL ( _ ( "Le listener FCGI ne peut etre initialise" ) );
     }
 
-    while ( server->isRunning() ) {
+    while ( running ) {
         std::string content;
 
         int rc;
         if ( ( rc=FCGX_Accept_r ( &fcgxRequest ) ) < 0 ) {
-            if ( rc == -4 ) { // Cas du redémarrage
-                LOGGER_DEBUG ( _ ( "Redémarrage : FCGX_InitRequest renvoie le code d'erreur " ) << rc );
+            if ( rc == -4 ) { // Cas de l'extinction
+                LOGGER_DEBUG ( _ ( "Interruption : FCGX_InitRequest renvoie le code d'erreur " ) << rc );
+                if ( running ) continue;
             } else {
                 LOGGER_ERROR ( _ ( "FCGX_InitRequest renvoie le code d'erreur " ) << rc );
                 std::cerr <<"FCGX_InitRequest renvoie le code d'erreur " << rc << std::endl;
@@ -125,6 +176,15 @@ void* Rok4Server::thread_loop ( void* arg ) {
 
         LOGGER_DEBUG("Thread " << pthread_self() << " traite une requete");
 
+        Rok4Server* server = acquireCurrent();
+
+        // Suivi de la requête : identifiant repris de l'en-tête X-Request-Id s'il est fourni et sûr (il est recopié dans les logs et les en-têtes), durées des étapes si demandé
+        char* requestId = FCGX_GetParam ( "HTTP_X_REQUEST_ID", fcgxRequest.envp );
+        int sampling = server->serverConf->getTraceSampling();
+        bool traceLogged = ( sampling > 0 && __atomic_fetch_add ( &tracedRequests, 1, __ATOMIC_RELAXED ) % sampling == 0 );
+        RequestTrace::begin ( RequestTrace::isValidId ( requestId ) ? std::string ( requestId ) : RequestTrace::newId(), server->serverConf->getServerTiming(), traceLogged );
+        double parseStart = Metrics::now();
+
         bool postRequest = false;
         if (server->servicesConf->isPostEnabled() && strcmp ( FCGX_GetParam ( "REQUEST_METHOD",fcgxRequest.envp ),"POST" ) == 0) {
             postRequest = true;
@@ -159,9 +219,20 @@ void* Rok4Server::thread_loop ( void* arg ) {
                 FCGX_GetParam ( "HTTPS", fcgxRequest.envp )
             );
         }
+        request->setAcceptEncoding ( FCGX_GetParam ( "HTTP_ACCEPT_ENCODING", fcgxRequest.envp ) );
+
+        RequestTrace::add ( TraceStage::PARSE, Metrics::now() - parseStart );
 
+        // Les tampons de travail de la requête sont pris dans l'arène du thread, remise à zéro en fin de requête
+        RequestArena::begin();
+        busyThreads->add ( 1 );
+        double start = Metrics::now();
         server->processRequest ( request, fcgxRequest );
+        server->countRequest ( request, Metrics::now() - start );
+        busyThreads->add ( -1 );
         delete request;
+        RequestArena::end();
+        RequestTrace::end();
 
         FCGX_Finish_r ( &fcgxRequest );
         FCGX_Free ( &fcgxRequest,1 );
@@ -170,6 +241,7 @@ void* Rok4Server::thread_loop ( void* arg ) {
 
         server->parallelProcess->checkCurrentPid();
 
+        releaseCurrent ( server );
     }
 
     LOGGER_DEBUG ( _ ( "Extinction du thread" ) );
@@ -178,30 +250,6 @@ void* Rok4Server::thread_loop ( void* arg ) {
 }
 
 
-#if BUILD_OBJECT
-void* Rok4Server::thread_reconnection_loop ( void* arg ) {
-    Rok4Server* server = ( Rok4Server* ) ( arg );
-
-    while ( server->isRunning() ) {
-
-        sleep(server->getServerConf()->getReconnectionFrequency() * 60);
-
-        if (server->getSwiftBook()) {
-            LOGGER_INFO("Reconnexion des contextes Swift");
-            if (! server->getSwiftBook()->reconnectAllContext()) {
-                LOGGER_FATAL ( "Impossible de reconnecter un contexte swift (recuperer un nouveau token)" );
-            }
-        } else {
-            LOGGER_INFO("Pas d'annuaire Swift");
-        }
-    }
-
-    LOGGER_DEBUG ( _ ( "Extinction du thread de reconnection des contextes" ) );
-    Logger::stopLogger();
-    return 0;
-}
-#endif
-
 Rok4Server::Rok4Server (  ServerXML* serverXML, ServicesXML* servicesXML) {
     
 
@@ -211,7 +259,7 @@ Rok4Server::Rok4Server (  ServerXML* serverXML, ServicesXML* servicesXML) {
 
     threads = std::vector<pthread_t>(serverConf->getNbThreads());
 
-    running = false;
+    users = 0;
 
     if ( serverConf->supportWMS ) {
         LOGGER_DEBUG ( _ ( "Build WMS Capabilities 1.3.0" ) );
@@ -237,6 +285,23 @@ Rok4Server::Rok4Server (  ServerXML* serverXML, ServicesXML* servicesXML) {
         serverConf->nbProcess = DEFAULT_NB_PROCESS;
     }
     parallelProcess = new ProcessFactory(serverConf->nbProcess, "", serverConf->timeKill);
+
+    // Une entrée par couche configurée : les requêtes n'ont plus qu'à indexer les pointeurs d'histogrammes
+    requestMetrics.insert ( std::pair<std::string, RequestMetrics*> ( "", new RequestMetrics() ) );
+    for ( std::map<std::string, Layer*>::iterator it = serverConf->layersList.begin(); it != serverConf->layersList.end(); it++ ) {
+        requestMetrics.insert ( std::pair<std::string, RequestMetrics*> ( it->first, new RequestMetrics() ) );
+    }
+
+    renderPool = NULL;
+    if ( serverConf->getRenderThreads() > 0 ) {
+        renderPool = new ThreadPool ( serverConf->getRenderThreads() );
+    }
+
+#if BUILD_OBJECT
+    // Les tokens Swift sont renouvelés avant leur expiration : la fréquence de reconnexion ne sert plus
+    // que de durée de vie par défaut, lorsque le serveur d'authentification ne la précise pas
+    SwiftToken::setDefaultLifetime ( serverConf->getReconnectionFrequency() * 60 );
+#endif
 }
 
 Rok4Server::~Rok4Server() {
@@ -246,6 +311,13 @@ Rok4Server::~Rok4Server() {
 
     delete parallelProcess;
     parallelProcess = NULL;
+
+    if ( renderPool ) delete renderPool;
+
+    // Les histogrammes appartiennent au registre des métriques, seules les tables de pointeurs sont libérées
+    for ( std::map<std::string, RequestMetrics*>::iterator it = requestMetrics.begin(); it != requestMetrics.end(); it++ ) {
+        delete it->second;
+    }
 }
 
 void Rok4Server::initFCGI() {
@@ -256,38 +328,57 @@ void Rok4Server::initFCGI() {
     }
 }
 
-void Rok4Server::run(sig_atomic_t signal_pending) {
+void Rok4Server::run() {
+    pthread_mutex_lock ( &generationMutex );
+    current = this;
+    pthread_mutex_unlock ( &generationMutex );
+
     running = true;
 
+    // SIGHUP (rechargement) est réservé au programme principal : les threads le bloquent
+    sigset_t hup, previous;
+    sigemptyset ( &hup );
+    sigaddset ( &hup, SIGHUP );
+    pthread_sigmask ( SIG_BLOCK, &hup, &previous );
+
+    Metrics::getGauge ( "rok4_threads", "Nombre de threads de traitement" )->set ( threads.size() );
     for ( int i = 0; i < threads.size(); i++ ) {
         pthread_create ( & ( threads[i] ), NULL, Rok4Server::thread_loop, ( void* ) this );
     }
-#if BUILD_OBJECT
-    pthread_create ( & reco_thread, NULL, Rok4Server::thread_reconnection_loop, ( void* ) this );
-#endif
-    
-    if (signal_pending != 0 ) {
-        raise( signal_pending );
-    }
-    
+
+    pthread_sigmask ( SIG_SETMASK, &previous, NULL );
+}
+
+void Rok4Server::join() {
     for ( int i = 0; i < threads.size(); i++ )
         pthread_join ( threads[i], NULL );
+}
 
-#if BUILD_OBJECT
-    pthread_join ( reco_thread, NULL );
-#endif
+void Rok4Server::replaceBy ( Rok4Server* newServer ) {
+    // Le nombre de threads n'est pas modifiable à chaud : le nouveau serveur reprend ceux en cours
+    if ( newServer->serverConf->getNbThreads() != ( int ) threads.size() ) {
+        LOGGER_WARN ( _ ( "Le nombre de threads ne peut etre modifie par un rechargement, il reste de " ) << threads.size() );
+    }
+    newServer->threads = threads;
+    newServer->sock = sock;
+
+    pthread_mutex_lock ( &generationMutex );
+    current = newServer;
+    // Attente de la fin des requêtes utilisant encore l'ancienne génération
+    while ( users > 0 ) {
+        pthread_cond_wait ( &generationCond, &generationMutex );
+    }
+    pthread_mutex_unlock ( &generationMutex );
 }
 
 void Rok4Server::terminate() {
+    // Doit être appelé sur la génération publiée, qui possède les threads
     running = false;
 
     // Terminate FCGI Thread
     for ( int i = 0; i < threads.size(); i++ ) {
         pthread_kill ( threads[i], SIGQUIT );
     }
-#if BUILD_OBJECT
-    pthread_kill ( reco_thread, SIGQUIT );
-#endif
 
     CurlPool::cleanCurlPool();
 }
@@ -301,18 +392,73 @@ DataStream* Rok4Server::getMap ( Request* request ) {
     std::string format;
     std::vector<Style*> styles;
     std::map <std::string, std::string > format_option;
-    std::vector<Image*> images;
 
 
     // Récupération des paramètres
+    double parseStart = Metrics::now();
     DataStream* errorResp = getMapParamWMS ( request, layers, bbox, width, height, crs, format ,styles, format_option, dpi );
+    RequestTrace::add ( TraceStage::PARSE, Metrics::now() - parseStart );
     if ( errorResp ) {
         LOGGER_ERROR ( _ ( "Probleme dans les parametres de la requete getMap" ) );
         return errorResp;
     }
 
-    int error;
+    // Une grande image est calculée par bandes, en parallèle, sur des chaînes de traitement identiques.
+    // Les chaînes partagent les tuiles lues : chacune n'est lue et décodée qu'une fois pour toute la requête
+    int chainCount = getStripChainCount ( height );
+    if ( chainCount > 1 ) RequestTileSet::begin();
+
+    Rok4Format::eformat_data pyrType;
     Image* image;
+    errorResp = getMapImage ( layers, styles, bbox, width, height, crs, dpi, format, pyrType, image );
+    if ( errorResp ) {
+        RequestTileSet::end();
+        return errorResp;
+    }
+
+    if ( chainCount > 1 ) {
+        std::vector<Image*> chains;
+        chains.push_back ( image );
+        for ( int i = 1; i < chainCount; i++ ) {
+            Rok4Format::eformat_data chainType;
+            Image* chain;
+            errorResp = getMapImage ( layers, styles, bbox, width, height, crs, dpi, format, chainType, chain );
+            if ( errorResp ) {
+                delete errorResp;
+                break;
+            }
+            chains.push_back ( chain );
+        }
+        RequestTileSet::end();
+
+        StripImageFactory SIF;
+        StripImage* stripImage = SIF.createStripImage ( chains, renderPool );
+        if ( stripImage ) {
+            image = stripImage;
+        } else {
+            for ( unsigned int i = 1; i < chains.size(); i++ ) delete chains.at ( i );
+        }
+    }
+
+    Style* style = styles.at(0);
+    DataStream * stream = formatImage(image, format, pyrType, format_option, layers.size(), style, request->acceptGzip);
+    // BIL et ASC sont compressés en gzip pour les clients qui l'acceptent
+    request->varyEncoding = ( format == "image/x-bil;bits=32" || format == "text/asc" );
+
+    // Un TIFF est compressé en entier avant l'envoi de l'en-tête HTTP : un échec de compression donne un flux vide
+    if ( ( format == "image/tiff" || format == "image/geotiff" ) && stream->getLength() == 0 ) {
+        LOGGER_ERROR ( _ ( "Echec de la compression de l'image TIFF" ) );
+        delete stream;
+        return new SERDataStream ( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wms" ) );
+    }
+
+    return stream;
+}
+
+DataStream* Rok4Server::getMapImage ( std::vector<Layer*>& layers, std::vector<Style*>& styles, BoundingBox<double> bbox, int width, int height, CRS crs, int dpi,
+                                      std::string format, Rok4Format::eformat_data& pyrType, Image*& image ) {
+    int error;
+    std::vector<Image*> images;
     for ( int i = 0 ; i < layers.size(); i ++ ) {
 
             Image* curImage = layers.at ( i )->getbbox ( servicesConf, bbox, width, height, crs, dpi, error );
@@ -349,15 +495,25 @@ DataStream* Rok4Server::getMap ( Request* request ) {
     }
 
 
+    // Les couches sont calculées en parallèle, par bandes, avant d'être fusionnées
+    if ( images.size() > 1 && renderPool ) {
+        BandImageFactory BIF;
+        BIF.createBandImages ( images, renderPool );
+    }
+
     //Use background image format.
-    Rok4Format::eformat_data pyrType = layers.at ( 0 )->getDataPyramid()->getFormat();
+    pyrType = layers.at ( 0 )->getDataPyramid()->getFormat();
     Style* style = styles.at(0);
 
     image = mergeImages(images, pyrType, style, crs, bbox);
+    return NULL;
+}
 
-    DataStream * stream = formatImage(image, format, pyrType, format_option, layers.size(), style);
-
-    return stream;
+int Rok4Server::getStripChainCount ( int height ) {
+    if ( ! renderPool ) return 1;
+    int chainCount = ( height + STRIP_HEIGHT - 1 ) / STRIP_HEIGHT;
+    if ( chainCount > serverConf->getStripsPerRequest() ) chainCount = serverConf->getStripsPerRequest();
+    return ( chainCount < 1 ) ? 1 : chainCount;
 }
 
 Image *Rok4Server::styleImage(Image *curImage, Rok4Format::eformat_data pyrType, Style *style, std::string format, int size, Pyramid* pyr) {
@@ -597,7 +753,7 @@ Image * Rok4Server::mergeImages(std::vector<Image*> images, Rok4Format::eformat_
 
 DataStream * Rok4Server::formatImage(Image *image, std::string format, Rok4Format::eformat_data pyrType,
                                      std::map <std::string, std::string > format_option,
-                                     int size, Style *style) {
+                                     int size, Style *style, bool gzip) {
 
     if ( format=="image/png" ) {
         if ( size == 1 ) {
@@ -616,57 +772,59 @@ DataStream * Rok4Server::formatImage(Image *image, std::string format, Rok4Forma
         case Rok4Format::TIFF_LZW_FLOAT32 :
         case Rok4Format::TIFF_PKB_FLOAT32 :
             if ( getParam ( format_option,"compression" ).compare ( "lzw" ) ==0 ) {
-                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_LZW_FLOAT32, isGeoTiff );
+                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_LZW_FLOAT32, isGeoTiff, renderPool );
             }
             if ( getParam ( format_option,"compression" ).compare ( "deflate" ) ==0 ) {
-                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_ZIP_FLOAT32, isGeoTiff );
+                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_ZIP_FLOAT32, isGeoTiff, renderPool );
             }
             if ( getParam ( format_option,"compression" ).compare ( "raw" ) ==0 ) {
-                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_RAW_FLOAT32, isGeoTiff );
+                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_RAW_FLOAT32, isGeoTiff, renderPool );
             }
             if ( getParam ( format_option,"compression" ).compare ( "packbits" ) ==0 ) {
-                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_PKB_FLOAT32, isGeoTiff );
+                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_PKB_FLOAT32, isGeoTiff, renderPool );
             }
-            return TiffEncoder::getTiffEncoder ( image, pyrType, isGeoTiff );
+            return TiffEncoder::getTiffEncoder ( image, pyrType, isGeoTiff, renderPool );
         case Rok4Format::TIFF_RAW_INT8 :
         case Rok4Format::TIFF_ZIP_INT8 :
         case Rok4Format::TIFF_LZW_INT8 :
         case Rok4Format::TIFF_PKB_INT8 :
             if ( getParam ( format_option,"compression" ).compare ( "lzw" ) ==0 ) {
-                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_LZW_INT8, isGeoTiff );
+                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_LZW_INT8, isGeoTiff, renderPool );
             }
             if ( getParam ( format_option,"compression" ).compare ( "deflate" ) ==0 ) {
-                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_ZIP_INT8, isGeoTiff );
+                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_ZIP_INT8, isGeoTiff, renderPool );
             }
             if ( getParam ( format_option,"compression" ).compare ( "raw" ) ==0 ) {
-                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_RAW_INT8, isGeoTiff );
+                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_RAW_INT8, isGeoTiff, renderPool );
             }
             if ( getParam ( format_option,"compression" ).compare ( "packbits" ) ==0 ) {
-                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_PKB_INT8, isGeoTiff );
+                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_PKB_INT8, isGeoTiff, renderPool );
             }
-            return TiffEncoder::getTiffEncoder ( image, pyrType, isGeoTiff );
+            return TiffEncoder::getTiffEncoder ( image, pyrType, isGeoTiff, renderPool );
         default:
             if ( getParam ( format_option,"compression" ).compare ( "lzw" ) ==0 ) {
-                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_LZW_INT8, isGeoTiff );
+                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_LZW_INT8, isGeoTiff, renderPool );
             }
             if ( getParam ( format_option,"compression" ).compare ( "deflate" ) ==0 ) {
-                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_ZIP_INT8, isGeoTiff );
+                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_ZIP_INT8, isGeoTiff, renderPool );
             }
             if ( getParam ( format_option,"compression" ).compare ( "packbits" ) ==0 ) {
-                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_PKB_INT8, isGeoTiff );
+                return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_PKB_INT8, isGeoTiff, renderPool );
             }
-            return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_RAW_INT8, isGeoTiff );
+            return TiffEncoder::getTiffEncoder ( image, Rok4Format::TIFF_RAW_INT8, isGeoTiff, renderPool );
         }
     } else if ( format == "image/jpeg" ) {
         return new JPEGEncoder ( image );
     } else if ( format == "image/x-bil;bits=32" ) {
-        return new BilEncoder ( image );
+        DataStream* bilStream = new BilEncoder ( image );
+        return gzip ? new GzipDataStream ( bilStream ) : bilStream;
     } else if ( format == "text/asc" ) {
         // On ne traite le format asc que sur les image à un seul channel
         if (image->getChannels() != 1){
             LOGGER_ERROR ( "Le format "<<format<<" ne concerne que les images à 1 canal" );
         }else{
-            return new AscEncoder ( image );
+            DataStream* ascStream = new AscEncoder ( image );
+            return gzip ? new GzipDataStream ( ascStream ) : ascStream;
         }
     }
 
@@ -683,6 +841,7 @@ DataSource* Rok4Server::getTile ( Request* request ) {
     Style* style=0;
 
     // Récupération des parametres de la requete
+    double parseStart = Metrics::now();
     DataSource* errorResp;
     if (request->service == ServiceType::WMTS) {
         errorResp = getTileParamWMTS ( request, L, tileMatrix, tileCol, tileRow, format, style );
@@ -690,12 +849,14 @@ DataSource* Rok4Server::getTile ( Request* request ) {
         // TMS
         errorResp = getTileParamTMS ( request, L, tileMatrix, tileCol, tileRow, format, style );
     }
+    RequestTrace::add ( TraceStage::PARSE, Metrics::now() - parseStart );
 
     if ( errorResp ) {
         return errorResp;
     }
     errorResp = NULL;
 
+    TraceScope scope ( TraceStage::LEVEL );
     Level* level = L->getDataPyramid()->getLevel(tileMatrix);
     if (level == NULL) {
         // On est hors niveau -> erreur
@@ -720,6 +881,14 @@ DataSource* Rok4Server::getTile ( Request* request ) {
         tileSource = getTileUsual(L, tileMatrix, tileCol, tileRow, style, format) ;
     }
 
+    // Tuiles stockées compressées (PBF en gzip) : servies telles quelles si le client l'accepte, décompressées sinon
+    if ( tileSource->getEncoding() == "gzip" ) {
+        request->varyEncoding = true;
+        if ( ! request->acceptGzip ) {
+            tileSource = new DataSourceDecoder<GzipDecoder> ( tileSource, tileSource->getType() );
+        }
+    }
+
     return tileSource;
 
 }
@@ -876,7 +1045,9 @@ DataSource *Rok4Server::getTileOnDemand(Layer* L, std::string tileMatrix, int ti
     DataStream *tileSource = formatImage(mergeImage, format, pyrType, format_option, bSize, style);
     DataSource *tile;
 
-    if (tileSource == NULL) {
+    // Un TIFF dont la compression a échoué est vide
+    if (tileSource == NULL || ( ( format == "image/tiff" || format == "image/geotiff" ) && tileSource->getLength() == 0 ) ) {
+        if ( tileSource ) delete tileSource;
         LOGGER_ERROR("Impossible de générer la tuile car l'opération de formattage n'a pas fonctionné");
         return new SERDataSource( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ),"wmts" ) );
     } else {
@@ -1049,55 +1220,24 @@ DataSource *Rok4Server::getTileOnFly(Layer* L, std::string tileMatrix, int tileC
 
 }
 
-int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format, std::string path) {
+Image* Rok4Server::createSlabImage ( Layer* L, Level* lev, BoundingBox<double> bbox, int width, int height, Style* style, std::string format ) {
 
-    //Variables utilisees
     std::vector<Image*> images;
     Image *curImage;
     Image *image;
     Image *mergeImage;
     Image *lastImage;
     std::string bLevel;
-    int width, height, error, tileH,tileW;
+    int error = 0;
     Rok4Format::eformat_data pyrType = Rok4Format::UNKNOWN;
     Style * bStyle;
     std::vector<Source*> bSources;
-    int state = 0;
-    struct stat buffer;
     int bSize = 0;
 
-    //On cree la dalle sous forme d'image
-    LOGGER_INFO("Create Slab on Fly");
-    //Calcul des paramètres nécessaires
-    LOGGER_DEBUG("Compute parameters");
-    //la correspondance est assurée par les vérifications qui ont eu lieu dans getTile()
-    std::string level = tileMatrix;
     Pyramid * pyr = L->getDataPyramid();
     CRS dst_crs = pyr->getTms()->getCrs();
-    error = 0;
     Interpolation::KernelType interpolation = L->getResampling();
 
-
-    //---- on va créer la bbox associée à la dalle
-    LOGGER_DEBUG("Compute BBOX");
-    Level* lev = pyr->getLevel(tileMatrix);
-
-    BoundingBox<double> bbox = lev->tileIndicesToSlabBbox(tileCol,tileRow) ;
-    bbox.print();
-    //---- bbox creee
-
-    //width and height
-    LOGGER_DEBUG("Compute width and height");
-    width = lev->getSlabWidth();
-    height = lev->getSlabHeight();
-    tileW = lev->getTm()->getTileW();
-    tileH = lev->getTm()->getTileH();
-
-
-    //--------------------------------------------------------------------------------------------------------
-    //CREATION DE L'IMAGE
-    LOGGER_DEBUG("Create Image");
-
     bSources = lev->getSources();
     bSize = bSources.size();
 
@@ -1123,17 +1263,15 @@ int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, i
                 image = styleImage(curImage, pyrType, bStyle, format, bSize, bPyr);
                 if (!image) {
                      LOGGER_ERROR("Impossible d'appliquer le style");
-                     state = 1;
-                     return state;
+                     return NULL;
                 } else {
                     LOGGER_DEBUG("Apply style");
                     images.push_back ( image );
                 }
             } else {
                 LOGGER_ERROR("Impossible de générer la dalle car l'une des basedPyramid du layer "+L->getTitle()+" ne renvoit pas de tuile");
-                state = 1;
                 delete bStyle;
-                return state;
+                return NULL;
             }
 
             delete bStyle;
@@ -1152,8 +1290,7 @@ int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, i
                     images.push_back(image);
                 } else {
                     LOGGER_ERROR("Impossible de generer la tuile car l'un des WebServices du layer "+L->getTitle()+" ne renvoit pas de tuile");
-                    state = 1;
-                    return state;
+                    return NULL;
                 }
 
             }
@@ -1170,8 +1307,7 @@ int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, i
         LOGGER_DEBUG("Merged differents basedImages");
         if (mergeImage == NULL) {
             LOGGER_ERROR("Impossible de générer la dalle car l'opération de merge n'a pas fonctionné");
-            state = 1;
-            return state;
+            return NULL;
         }
 
         if (images.size() == 1 && pyr->getChannels() != mergeImage->getChannels()) {
@@ -1182,11 +1318,85 @@ int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, i
 
     } else {
         LOGGER_ERROR("Impossible de générer la dalle car aucune image n'a été récupérée");
+        return NULL;
+    }
+
+    return lastImage;
+}
+
+int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format, std::string path) {
+
+    //Variables utilisees
+    Image *lastImage;
+    int width, height, tileH,tileW;
+    int state = 0;
+    struct stat buffer;
+
+    //On cree la dalle sous forme d'image
+    LOGGER_INFO("Create Slab on Fly");
+    //Calcul des paramètres nécessaires
+    LOGGER_DEBUG("Compute parameters");
+    //la correspondance est assurée par les vérifications qui ont eu lieu dans getTile()
+    std::string level = tileMatrix;
+    Pyramid * pyr = L->getDataPyramid();
+
+
+    //---- on va créer la bbox associée à la dalle
+    LOGGER_DEBUG("Compute BBOX");
+    Level* lev = pyr->getLevel(tileMatrix);
+
+    BoundingBox<double> bbox = lev->tileIndicesToSlabBbox(tileCol,tileRow) ;
+    bbox.print();
+    //---- bbox creee
+
+    //width and height
+    LOGGER_DEBUG("Compute width and height");
+    width = lev->getSlabWidth();
+    height = lev->getSlabHeight();
+    tileW = lev->getTm()->getTileW();
+    tileH = lev->getTm()->getTileH();
+
+
+    //--------------------------------------------------------------------------------------------------------
+    //CREATION DE L'IMAGE
+    LOGGER_DEBUG("Create Image");
+
+    // Une grande dalle est calculée par bandes, en parallèle, sur des chaînes de traitement identiques, qui partagent les tuiles lues.
+    // Nous sommes dans un processus fils : les threads du serveur n'y existent pas, un pool est créé pour la dalle
+    ThreadPool* stripPool = NULL;
+    int chainCount = getStripChainCount ( height );
+    if ( chainCount > 1 ) RequestTileSet::begin();
+
+    lastImage = createSlabImage ( L, lev, bbox, width, height, style, format );
+    if ( lastImage == NULL ) {
+        RequestTileSet::end();
         state = 1;
         return state;
     }
 
+    if ( chainCount > 1 ) {
+        std::vector<Image*> chains;
+        chains.push_back ( lastImage );
+        for ( int i = 1; i < chainCount; i++ ) {
+            Image* chain = createSlabImage ( L, lev, bbox, width, height, style, format );
+            if ( chain == NULL ) break;
+            chains.push_back ( chain );
+        }
+        RequestTileSet::end();
+
+        if ( chains.size() > 1 ) {
+            stripPool = new ThreadPool ( chains.size() - 1 );
+            StripImageFactory SIF;
+            StripImage* stripImage = SIF.createStripImage ( chains, stripPool );
+            if ( stripImage ) {
+                lastImage = stripImage;
+            } else {
+                for ( unsigned int i = 1; i < chains.size(); i++ ) delete chains.at ( i );
+            }
+        }
+    }
 
+    //--------------------------------------------------------------------------------------------------------
     //IMAGE CREEE
     //-------------------------------------------------------------------------------------------------------
 
@@ -1199,7 +1409,12 @@ int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, i
     char * pathToWrite = (char *)path.c_str();
     LOGGER_DEBUG("Create Rok4Image");
 
-    FileContext* fc = new FileContext("");
+    FileContext* fc;
+    if ( serverConf->getIoUring() ) {
+        fc = new UringFileContext("");
+    } else {
+        fc = new FileContext("");
+    }
     fc->connection();
 
     Rok4Image * finalImage = R4IF.createRok4ImageToWrite(
@@ -1219,6 +1434,7 @@ int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, i
             state = 1;
             delete lastImage;
             delete finalImage;
+            if ( stripPool ) delete stripPool;
             return state;
         } else {
             LOGGER_DEBUG("Written");
@@ -1228,11 +1444,13 @@ int Rok4Server::createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, i
         state = 1;
         delete lastImage;
         delete finalImage;
+        if ( stripPool ) delete stripPool;
         return state;
     }
 
     delete lastImage;
     delete finalImage;
+    if ( stripPool ) delete stripPool;
 
     //IMAGE ECRITE
     //------------------------------------------------------------------------------------------------------
@@ -1306,65 +1524,73 @@ DataStream* Rok4Server::CommonGetFeatureInfo ( std::string service, Layer* layer
         pxBbox.ymax = bbox.ymax - (bbox.ymax-bbox.ymin)/double (height)*double (Y);
         pxBbox.ymin = pxBbox.ymax - (bbox.ymax-bbox.ymin)/double (height);
         
-        int error;
-        Image* image;
-        image = layer->getbbox ( servicesConf, pxBbox, 1, 1, crs, 0, error );
-        if ( image == 0 ) {
-           switch ( error ) {
-             case 1: {
-               return new SERDataStream ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "bbox invalide" ), service ) );
-             }
-             case 2: {
-               return new SERDataStream ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "bbox trop grande" ), service ) );
-             }
-             default : {
-               return new SERDataStream ( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ), service ) );
-             }
-           }
-        }
-
-        std::vector<std::string> strData;
+        bool isInteger;
         Rok4Format::eformat_data pyrType = layer->getDataPyramid()->getFormat();
-        int n = image->getChannels();
         switch ( pyrType ) {
             case Rok4Format::TIFF_RAW_INT8 :
             case Rok4Format::TIFF_JPG_INT8 :
             case Rok4Format::TIFF_PNG_INT8 :
             case Rok4Format::TIFF_LZW_INT8 :
             case Rok4Format::TIFF_ZIP_INT8 :
-            case Rok4Format::TIFF_PKB_INT8 : {
-                uint8_t* intbuffer = new uint8_t[n*sizeof(uint8_t)];
-                image->getline(intbuffer,0);
-                for ( int i = 0 ; i < n; i ++ ) {
-                  std::stringstream ss;
-                  ss << (int) intbuffer[i];
-                  strData.push_back( ss.str() );
-                }
+            case Rok4Format::TIFF_PKB_INT8 :
+                isInteger = true;
                 break;
-            }
             case Rok4Format::TIFF_RAW_FLOAT32 :
             case Rok4Format::TIFF_LZW_FLOAT32 :
             case Rok4Format::TIFF_ZIP_FLOAT32 :
-            case Rok4Format::TIFF_PKB_FLOAT32 : {
-                float* floatbuffer = new float[n*sizeof(float)];
-                image->getline(floatbuffer,0);
-                for ( int i = 0 ; i < n; i ++ ) {
-                  std::stringstream ss;
-                  ss << (float) floatbuffer[i];
-                  strData.push_back( ss.str() );
-                }
-                delete[] floatbuffer;
+            case Rok4Format::TIFF_PKB_FLOAT32 :
+                isInteger = false;
                 break;
-            }
             default:
               return new SERDataStream ( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Erreur interne."), service ) );
         }
+
+        int n = layer->getDataPyramid()->getChannels();
+        float* values = new float[n];
+
+        // Chemin rapide : lecture directe du pixel dans la tuile qui le contient
+        int error = 0;
+        std::vector<BoundingBox<double> > pixels ( 1, pxBbox );
+        if ( ! layer->getDataPyramid()->getPoints ( servicesConf, pixels, crs, values, error ) ) {
+            if ( error == 1 ) {
+                delete[] values;
+                return new SERDataStream ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "bbox invalide" ), service ) );
+            }
+
+            // Niveau non adapté à la lecture ponctuelle : on passe par l'image
+            Image* image = layer->getbbox ( servicesConf, pxBbox, 1, 1, crs, 0, error );
+            if ( image == 0 ) {
+               delete[] values;
+               switch ( error ) {
+                 case 1: {
+                   return new SERDataStream ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "bbox invalide" ), service ) );
+                 }
+                 case 2: {
+                   return new SERDataStream ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "bbox trop grande" ), service ) );
+                 }
+                 default : {
+                   return new SERDataStream ( new ServiceException ( "",OWS_NOAPPLICABLE_CODE,_ ( "Impossible de repondre a la requete" ), service ) );
+                 }
+               }
+            }
+            image->getline ( values, 0 );
+            delete image;
+        }
+
+        std::vector<std::string> strData;
+        for ( int i = 0 ; i < n; i ++ ) {
+          std::stringstream ss;
+          if ( isInteger ) ss << (int) values[i];
+          else ss << values[i];
+          strData.push_back( ss.str() );
+        }
+        delete[] values;
+
         GetFeatureInfoEncoder gfiEncoder(strData, info_format);
         DataStream* responseDS = gfiEncoder.getDataStream();
         if (responseDS == NULL){
             return new SERDataStream ( new ServiceException ( "",OWS_INVALID_PARAMETER_VALUE,_ ( "Info_format non ") +info_format+ _( " supporté par la couche ") + layer->getId() , service ) );
         }
-        delete image;
         return responseDS;
         
     } else if ( getFeatureInfoType.compare( "EXTERNALWMS" ) == 0 ) {
@@ -1438,7 +1664,9 @@ void Rok4Server::processWMTS ( Request* request, FCGX_Request&  fcgxRequest ) {
     if ( request->request == RequestType::GETCAPABILITIES ) {
         S.sendresponse ( WMTSGetCapabilities ( request ),&fcgxRequest );
     } else if ( request->request == RequestType::GETTILE ) {
-        S.sendresponse ( getTile ( request ), &fcgxRequest );
+        // Évalué avant l'envoi : le traitement renseigne varyEncoding
+        DataSource* response = getTile ( request );
+        S.sendresponse ( response, &fcgxRequest, request->varyEncoding );
     } else if ( request->request == RequestType::GETFEATUREINFO) {
         S.sendresponse ( WMTSGetFeatureInfo ( request ), &fcgxRequest );
     } else if ( request->request == RequestType::GETVERSION ) {
@@ -1458,7 +1686,9 @@ void Rok4Server::processTMS ( Request* request, FCGX_Request&  fcgxRequest ) {
     } else if ( request->request == RequestType::GETSERVICES ) {
         S.sendresponse ( TMSGetServices ( request ),&fcgxRequest );
     } else if ( request->request == RequestType::GETTILE ) {
-        S.sendresponse ( getTile ( request ), &fcgxRequest );
+        // Évalué avant l'envoi : le traitement renseigne varyEncoding
+        DataSource* response = getTile ( request );
+        S.sendresponse ( response, &fcgxRequest, request->varyEncoding );
     } else if ( request->request == RequestType::GETLAYER ) {
         S.sendresponse ( TMSGetLayer ( request ), &fcgxRequest );
     } else if ( request->request == RequestType::GETLAYERMETADATA ) {
@@ -1473,7 +1703,9 @@ void Rok4Server::processWMS ( Request* request, FCGX_Request&  fcgxRequest ) {
     if ( request->request == RequestType::GETCAPABILITIES) {
         S.sendresponse ( WMSGetCapabilities ( request ),&fcgxRequest );
     } else if ( request->request == RequestType::GETMAP) {
-        S.sendresponse ( getMap ( request ), &fcgxRequest );
+        // Évalué avant l'envoi : le traitement renseigne varyEncoding
+        DataStream* response = getMap ( request );
+        S.sendresponse ( response, &fcgxRequest, request->varyEncoding );
     } else if ( request->request == RequestType::GETFEATUREINFO) {
         S.sendresponse ( WMSGetFeatureInfo ( request ), &fcgxRequest );
     } else if ( request->request == RequestType::GETVERSION ) {
@@ -1487,7 +1719,10 @@ void Rok4Server::processWMS ( Request* request, FCGX_Request&  fcgxRequest ) {
 
 void Rok4Server::processRequest ( Request * request, FCGX_Request&  fcgxRequest ) {
 
-    if ( serverConf->supportWMTS && request->service == ServiceType::WMTS) {
+    if ( ! serverConf->getMetricsPath().empty() && request->path == serverConf->getMetricsPath() ) {
+        S.sendresponse ( getMetrics(), &fcgxRequest );
+    }
+    else if ( serverConf->supportWMTS && request->service == ServiceType::WMTS) {
         processWMTS ( request, fcgxRequest );
     }
     else if ( serverConf->supportWMS && request->service == ServiceType::WMS ) {
@@ -1509,6 +1744,41 @@ void Rok4Server::processRequest ( Request * request, FCGX_Request&  fcgxRequest
 ServicesXML* Rok4Server::getServicesConf() { return servicesConf; }
 ServerXML* Rok4Server::getServerConf() { return serverConf; }
 std::map<std::string, Layer*>& Rok4Server::getLayerList() { return serverConf->layersList; }
+
+void Rok4Server::countRequest ( Request* request, double duration ) {
+    // Seules les couches configurées servent d'étiquette, pour ne pas créer une série par valeur demandée
+    std::string layer = request->getParam ( "layer" );
+    if ( layer.empty() ) layer = request->getParam ( "layers" );
+    if ( layer.empty() ) layer = request->getParam ( "query_layers" );
+    std::map<std::string, RequestMetrics*>::iterator it = requestMetrics.find ( layer );
+    if ( it == requestMetrics.end() ) {
+        layer = "";
+        it = requestMetrics.find ( layer );
+    }
+
+    // Deux threads peuvent résoudre le même histogramme en même temps : le registre leur rend le même pointeur
+    MetricHistogram** slot = &it->second->seconds[request->service][request->request];
+    MetricHistogram* histogram = __atomic_load_n ( slot, __ATOMIC_ACQUIRE );
+    if ( histogram == NULL ) {
+        std::string labels = Metrics::label ( "service", ServiceType::toString ( request->service ) ) + "," +
+                             Metrics::label ( "request", RequestType::toString ( request->request ) ) + "," +
+                             Metrics::label ( "layer", layer );
+        histogram = Metrics::getHistogram ( "rok4_request_seconds", "Durée de traitement des requêtes", labels );
+        __atomic_store_n ( slot, histogram, __ATOMIC_RELEASE );
+    }
+    histogram->observe ( duration );
+}
+
+DataSource* Rok4Server::getMetrics () {
+    // Les compteurs tenus par les caches sont recopiés au moment de l'export
+    Metrics::getCounter ( "rok4_decoded_tiles_cache_hits_total", "Tuiles trouvées dans le cache des tuiles décodées" )->set ( DecodedTilePool::getHits() );
+    Metrics::getCounter ( "rok4_decoded_tiles_cache_misses_total", "Tuiles absentes du cache des tuiles décodées" )->set ( DecodedTilePool::getMisses() );
+    Metrics::getGauge ( "rok4_decoded_tiles_cache_bytes", "Taille des tuiles du cache des tuiles décodées" )->set ( DecodedTilePool::getSize() );
+    Metrics::getGauge ( "rok4_decoded_tiles_cache_tiles", "Nombre de tuiles du cache des tuiles décodées" )->set ( DecodedTilePool::getNbTiles() );
+    Metrics::getGauge ( "rok4_mapped_files", "Nombre de dalles projetées en mémoire" )->set ( MappedFilePool::getNbFiles() );
+
+    return new MessageDataSource ( Metrics::toPrometheus(), "text/plain; version=0.0.4" );
+}
 std::map<std::string, TileMatrixSet*>& Rok4Server::getTmsList() { return serverConf->tmsList; }
 std::map<std::string, Style*>& Rok4Server::getStylesList() { return serverConf->stylesList; }
 std::map<std::string,std::vector<std::string> >& Rok4Server::getWmsCapaFrag() { return wmsCapaFrag; }
@@ -58,16 +58,24 @@
 #include "TileMatrixSet.h"
 #include "DocumentXML.h"
 #include "ProcessFactory.h"
+#include "ThreadPool.h"
 #include "fcgiapp.h"
 #include <csignal>
 #include "ServerXML.h"
 #include "ServicesXML.h"
 #include "GetFeatureInfoEncoder.h"
+#include "Metrics.h"
 
 #if BUILD_OBJECT
 #include "ContextBook.h"
 #endif
 
+/**
+ * \~french \brief Histogrammes des durées de traitement d'une couche, défini dans Rok4Server.cpp (Request.h, qui inclut indirectement cet en-tête, n'est pas encore complet ici)
+ * \~english \brief Processing duration histograms of a layer, defined in Rok4Server.cpp (Request.h, which indirectly includes this header, is not complete yet here)
+ */
+struct RequestMetrics;
+
 /**
  * \author Institut national de l'information géographique et forestière
  * \~french
@@ -87,14 +95,6 @@ private:
      */
     std::vector<pthread_t> threads;
 
-#if BUILD_OBJECT
-    /**
-     * \~french \brief Thread de reconnexion des contextes
-     * \~english \brief Contexts reconnection thread
-     */
-    pthread_t reco_thread;
-#endif
-
     /**
      * \~french \brief Connecteur sur le flux FCGI
      * \~english \brief FCGI stream connector
@@ -103,9 +103,41 @@ private:
 
     /**
      * \~french \brief Défini si le serveur est en cours d'éxécution
+     * \details Partagé par les générations successives de configuration, les threads survivant aux rechargements
      * \~english \brief Define whether the server is running
+     * \details Shared by successive configuration generations, threads surviving reloads
+     */
+    static volatile bool running;
+
+    /**
+     * \~french \brief Génération de configuration publiée, utilisée par les nouvelles requêtes
+     * \~english \brief Published configuration generation, used by new requests
+     */
+    static Rok4Server* current;
+
+    /**
+     * \~french \brief Verrou protégeant la publication et les compteurs d'utilisation des générations
+     * \~english \brief Mutex protecting publication and generations' usage counters
+     */
+    static pthread_mutex_t generationMutex;
+
+    /**
+     * \~french \brief Signalé quand une génération retirée n'est plus utilisée
+     * \~english \brief Signaled when a retired generation is not used anymore
+     */
+    static pthread_cond_t generationCond;
+
+    /**
+     * \~french \brief Nombre de requêtes reçues, pour l'échantillonnage des traces écrites dans les logs
+     * \~english \brief Number of received requests, for sampling traces written in logs
+     */
+    static uint64_t tracedRequests;
+
+    /**
+     * \~french \brief Nombre de requêtes en cours utilisant cette génération
+     * \~english \brief Number of requests in progress using this generation
      */
-    volatile bool running;
+    int users;
 
     /**
      * \~french \brief Identifiant du socket
@@ -125,6 +157,12 @@ private:
      */
     ServerXML* serverConf;
 
+    /**
+     * \~french \brief Threads calculant en parallèle les couches et les bandes des images, NULL si le calcul est séquentiel
+     * \~english \brief Threads computing concurrently images' layers and strips, NULL if computing is sequential
+     */
+    ThreadPool* renderPool;
+
     /**
      * \~french \brief Liste des fragments invariants de capabilities prets à être concaténés avec les infos de la requête.
      * \~english \brief Invariant GetCapabilities fragments ready to be concatained with request informations
@@ -135,6 +173,14 @@ private:
      * \~english \brief Invariant GetCapabilities fragments ready to be concatained with request informations
      */
     std::vector<std::string> wmtsCapaFrag;
+
+    /**
+     * \~french \brief Histogrammes des durées de traitement, par couche configurée
+     * \details Construit au chargement de la configuration, la clé vide regroupant les requêtes sans couche connue. Il n'est plus modifié ensuite et est donc lu sans verrou.
+     * \~english \brief Processing duration histograms, by configured layer
+     * \details Built when the configuration is loaded, the empty key gathering requests without a known layer. It is not modified afterwards, so it is read without lock.
+     */
+    std::map<std::string, RequestMetrics*> requestMetrics;
     /**
      * \~french \brief Liste des fragments invariants de capabilities prets à être concaténés avec les infos de la requête.
      * \~english \brief Invariant GetCapabilities fragments ready to be concatained with request informations
@@ -160,20 +206,6 @@ private:
      */
     static void* thread_loop ( void* arg );
 
-
-#if BUILD_OBJECT
-    /**
-     * \~french
-     * \brief Boucle principale exécutée par le thread de reconnexion des contextes de lecture #reco_thread
-     * \param[in] arg pointeur vers l'instance de Rok4Server
-     * \return true si présent
-     * \~english
-     * \brief Main event loop executed by reconnection thread #reco_thread
-     * \param[in] arg pointer to the Rok4Server instance
-     * \return true if present
-     */
-    static void* thread_reconnection_loop ( void* arg );
-#endif
     
     /**
      * \~french
@@ -349,6 +381,7 @@ private:
      * \param[in] format_option contient des spécifications sur le format
      * \param[in] size nombre d'images concerné par le processus global où est appelé cette fonction
      * \param[in] style style demandé par le client
+     * \param[in] gzip compression gzip à la volée des formats non compressés (BIL, ASC)
      * \return image demandé ou un message d'erreur sous forme de stream
      * \~english
      * \brief Apply a format to an image
@@ -358,9 +391,10 @@ private:
      * \param[in] format_option contain specifications on the format
      * \param[in] size number of images used in the global process where this function is called
      * \param[in] style asked style by the client
+     * \param[in] gzip on the fly gzip compression of uncompressed formats (BIL, ASC)
      * \return requested image or an error message by a stream
      */
-    DataStream *formatImage(Image *image, std::string format, Rok4Format::eformat_data pyrType, std::map<std::string, std::string> format_option, int size, Style *style);
+    DataStream *formatImage(Image *image, std::string format, Rok4Format::eformat_data pyrType, std::map<std::string, std::string> format_option, int size, Style *style, bool gzip = false);
     /**
      * \~french
      * \brief Renvoit une tuile déjà pré-calculée
@@ -452,6 +486,30 @@ private:
      */
     int createSlabOnFly(Layer* L, std::string tileMatrix, int tileCol, int tileRow, Style *style, std::string format, std::string path);
 
+    /**
+     * \~french
+     * \brief Construit la chaîne de traitement d'une dalle générée à la volée : images des sources, stylées et fusionnées
+     * \param[in] L couche de la requête
+     * \param[in] lev niveau de la dalle
+     * \param[in] bbox emprise de la dalle
+     * \param[in] width largeur de la dalle
+     * \param[in] height hauteur de la dalle
+     * \param[in] style style de la requête
+     * \param[in] format format de la requête
+     * \return l'image de la dalle, NULL en cas d'erreur
+     * \~english
+     * \brief Build an on the fly slab's processing chain : sources' images, styled and merged
+     * \param[in] L layer of the request
+     * \param[in] lev slab's level
+     * \param[in] bbox slab's bbox
+     * \param[in] width slab's width
+     * \param[in] height slab's height
+     * \param[in] style style of the request
+     * \param[in] format format of the request
+     * \return slab's image, NULL if error
+     */
+    Image* createSlabImage ( Layer* L, Level* lev, BoundingBox<double> bbox, int width, int height, Style* style, std::string format );
+
 
     /**
      * \~french
@@ -533,6 +591,33 @@ private:
      */
     DataStream* getMap ( Request* request );
 
+    /**
+     * \~french
+     * \brief Construit la chaîne de traitement d'un GetMap : images des couches, stylées et fusionnées
+     * \param[out] pyrType format des tuiles à utiliser pour l'encodage
+     * \param[out] image image demandée
+     * \return un message d'erreur, NULL si l'image a été construite
+     * \~english
+     * \brief Build a GetMap's processing chain : layers' images, styled and merged
+     * \param[out] pyrType tiles' format to use to encode
+     * \param[out] image requested image
+     * \return an error message, NULL if the image has been built
+     */
+    DataStream* getMapImage ( std::vector<Layer*>& layers, std::vector<Style*>& styles, BoundingBox<double> bbox, int width, int height, CRS crs, int dpi,
+                              std::string format, Rok4Format::eformat_data& pyrType, Image*& image );
+
+    /**
+     * \~french
+     * \brief Nombre de chaînes de traitement identiques calculant en parallèle les bandes d'une image
+     * \param[in] height hauteur de l'image
+     * \return 1 si l'image est calculée d'un seul tenant
+     * \~english
+     * \brief Number of identical processing chains computing concurrently an image's strips
+     * \param[in] height image's height
+     * \return 1 if image is computed as a whole
+     */
+    int getStripChainCount ( int height );
+
     /**
      * \~french
      * \brief Traitement d'une requête GetTile
@@ -590,6 +675,16 @@ private:
      * \~english Route WMS and WMTS request
      */
     void processRequest ( Request *request, FCGX_Request&  fcgxRequest );
+    /**
+     * \~french Comptabilise une requête traitée dans les métriques, par service, type de requête et couche
+     * \~english Count a processed request in metrics, by service, request type and layer
+     */
+    void countRequest ( Request *request, double duration );
+    /**
+     * \~french Exporte les métriques au format texte Prometheus
+     * \~english Export metrics with Prometheus text format
+     */
+    DataSource* getMetrics ();
 
     /**
      * \~french
@@ -730,11 +825,49 @@ public:
 
     /**
      * \~french
-     * \brief Lancement des threads du serveur
+     * \brief Publie le serveur et lance ses threads
+     * \details Rend la main immédiatement, l'attente de la fin des threads se fait avec #join
+     * \~english
+     * \brief Publish the server and start its threads
+     * \details Returns immediately, waiting for threads' end is done with #join
+     */
+    void run();
+
+    /**
+     * \~french
+     * \brief Attend la fin des threads du serveur, après #terminate
+     * \~english
+     * \brief Wait for server's threads end, after #terminate
+     */
+    void join();
+
+    /**
+     * \~french
+     * \brief Remplace ce serveur par une nouvelle génération de configuration, sans interruption du service
+     * \details Le nouveau serveur reprend les threads et le socket FastCGI, puis est publié : les requêtes suivantes l'utilisent. La fonction rend la main quand plus aucune requête n'utilise ce serveur, qui peut alors être supprimé.
+     * \param[in] newServer serveur construit avec la nouvelle configuration
+     * \~english
+     * \brief Replace this server with a new configuration generation, without service interruption
+     * \details New server takes over threads and FastCGI socket, then is published : following requests use it. Function returns when no request uses this server anymore, which can be deleted.
+     * \param[in] newServer server built with the new configuration
+     */
+    void replaceBy ( Rok4Server* newServer );
+
+    /**
+     * \~french
+     * \brief Retourne la génération publiée, réservée jusqu'à l'appel à #releaseCurrent
+     * \~english
+     * \brief Return the published generation, reserved until #releaseCurrent call
+     */
+    static Rok4Server* acquireCurrent();
+
+    /**
+     * \~french
+     * \brief Libère une génération obtenue avec #acquireCurrent
      * \~english
-     * \brief Start server's thread
+     * \brief Release a generation got with #acquireCurrent
      */
-    void run(sig_atomic_t signal_pending = 0);
+    static void releaseCurrent ( Rok4Server* server );
     /**
      * \~french
      * \brief Initialise le socket FastCGI
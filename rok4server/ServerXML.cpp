@@ -310,6 +310,87 @@ ServerXML::ServerXML(std::string path ) : DocumentXML(path) {
         backlog = 0;
     }
 
+    pElem=hRoot.FirstChild ( "mappedFilesCacheSize" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas d'element <mappedFilesCacheSize> valeur par defaut : " ) << DEFAULT_MAPPED_FILES_CACHE_SIZE <<std::endl;
+        mappedFilesCacheSize = DEFAULT_MAPPED_FILES_CACHE_SIZE;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&mappedFilesCacheSize ) || mappedFilesCacheSize < 0 )  {
+        std::cerr<<_ ( "Le mappedFilesCacheSize [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "decodedTilesCacheSize" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas d'element <decodedTilesCacheSize> valeur par defaut : " ) << DEFAULT_DECODED_TILES_CACHE_SIZE <<std::endl;
+        decodedTilesCacheSize = DEFAULT_DECODED_TILES_CACHE_SIZE;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&decodedTilesCacheSize ) || decodedTilesCacheSize < 0 )  {
+        std::cerr<<_ ( "Le decodedTilesCacheSize [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "renderThreads" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas d'element <renderThreads> valeur par defaut : " ) << DEFAULT_RENDER_THREADS <<std::endl;
+        renderThreads = DEFAULT_RENDER_THREADS;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&renderThreads ) || renderThreads < 0 )  {
+        std::cerr<<_ ( "Le renderThreads [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "stripsPerRequest" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas d'element <stripsPerRequest> valeur par defaut : " ) << DEFAULT_STRIPS_PER_REQUEST <<std::endl;
+        stripsPerRequest = DEFAULT_STRIPS_PER_REQUEST;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&stripsPerRequest ) || stripsPerRequest < 1 )  {
+        std::cerr<<_ ( "Le stripsPerRequest [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a strictly positive integer." ) <<std::endl;
+        return;
+    }
+
+    pElem=hRoot.FirstChild ( "ioUring" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas d'element <ioUring> => ioUring = false" ) <<std::endl;
+        ioUring = false;
+    } else {
+        std::string strIoUring ( pElem->GetText() );
+        if ( strIoUring=="true" ) ioUring=true;
+        else if ( strIoUring=="false" ) ioUring=false;
+        else {
+            std::cerr<<_ ( "Le ioUring [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] n'est pas un booleen." ) <<std::endl;
+            return;
+        }
+    }
+
+    pElem=hRoot.FirstChild ( "metricsPath" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas d'element <metricsPath> => les métriques ne sont pas servies" ) <<std::endl;
+        metricsPath = "";
+    } else {
+        metricsPath = DocumentXML::getTextStrFromElem(pElem);
+    }
+
+    pElem=hRoot.FirstChild ( "serverTiming" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas d'element <serverTiming> => serverTiming = false" ) <<std::endl;
+        serverTiming = false;
+    } else {
+        std::string strServerTiming ( pElem->GetText() );
+        if ( strServerTiming=="true" ) serverTiming=true;
+        else if ( strServerTiming=="false" ) serverTiming=false;
+        else {
+            std::cerr<<_ ( "Le serverTiming [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] n'est pas un booleen." ) <<std::endl;
+            return;
+        }
+    }
+
+    pElem=hRoot.FirstChild ( "traceSampling" ).Element();
+    if ( !pElem || ! ( pElem->GetText() ) ) {
+        std::clog<<_ ( "Pas d'element <traceSampling> => les traces des requêtes ne sont pas écrites" ) <<std::endl;
+        traceSampling = 0;
+    } else if ( !sscanf ( pElem->GetText(),"%d",&traceSampling ) || traceSampling < 0 )  {
+        std::cerr<<_ ( "Le traceSampling [" ) << DocumentXML::getTextStrFromElem(pElem) <<_ ( "] is not a positive integer." ) <<std::endl;
+        return;
+    }
+
 #if BUILD_OBJECT
 
     /************************************ PARTIE OBJET ************************************/
@@ -638,6 +719,16 @@ bool ServerXML::getSupportWMTS() {return supportWMTS;}
 bool ServerXML::getSupportTMS() {return supportTMS;}
 bool ServerXML::getSupportWMS() {return supportWMS;}
 int ServerXML::getBacklog() {return backlog;}
+
+int ServerXML::getMappedFilesCacheSize() {return mappedFilesCacheSize;}
+int ServerXML::getDecodedTilesCacheSize() {return decodedTilesCacheSize;}
+int ServerXML::getRenderThreads() {return renderThreads;}
+int ServerXML::getStripsPerRequest() {return stripsPerRequest;}
+
+bool ServerXML::getIoUring() {return ioUring;}
+std::string ServerXML::getMetricsPath() {return metricsPath;}
+bool ServerXML::getServerTiming() {return serverTiming;}
+int ServerXML::getTraceSampling() {return traceSampling;}
 Proxy ServerXML::getProxy() {return proxy;}
 int ServerXML::getTimeKill() {return timeKill;}
 bool ServerXML::getReprojectionCapability() { return reprojectionCapability; }
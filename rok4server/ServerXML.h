@@ -118,6 +118,14 @@ class ServerXML : public DocumentXML
         bool getSupportWMS() ;
         bool getReprojectionCapability() ;
         int getBacklog() ;
+        int getMappedFilesCacheSize() ;
+        int getDecodedTilesCacheSize() ;
+        int getRenderThreads() ;
+        int getStripsPerRequest() ;
+        bool getIoUring() ;
+        std::string getMetricsPath() ;
+        bool getServerTiming() ;
+        int getTraceSampling() ;
         Proxy getProxy() ;
         int getTimeKill() ;
 
@@ -183,6 +191,46 @@ class ServerXML : public DocumentXML
          * \~english \brief Socket listen queue depth
          */
         int backlog;
+        /**
+         * \~french \brief Nombre maximal de dalles fichier projetées en mémoire (0 : lectures classiques)
+         * \~english \brief Maximal number of memory mapped file slabs (0 : classic reads)
+         */
+        int mappedFilesCacheSize;
+        /**
+         * \~french \brief Taille maximale du cache des tuiles décodées, en Mo (0 : pas de cache)
+         * \~english \brief Decoded tiles cache's maximal size, in MB (0 : no cache)
+         */
+        int decodedTilesCacheSize;
+        /**
+         * \~french \brief Nombre de threads partagés calculant en parallèle les couches et les bandes des images (0 : calcul séquentiel)
+         * \~english \brief Number of shared threads computing concurrently images' layers and strips (0 : sequential computing)
+         */
+        int renderThreads;
+        /**
+         * \~french \brief Nombre maximal de bandes d'une même image calculées en parallèle
+         * \~english \brief Maximal number of strips of the same image computed concurrently
+         */
+        int stripsPerRequest;
+        /**
+         * \~french \brief Les pyramides fichier utilisent-elles io_uring (UringFileContext)
+         * \~english \brief Do file pyramids use io_uring (UringFileContext)
+         */
+        bool ioUring;
+        /**
+         * \~french \brief Chemin (SCRIPT_NAME) auquel les métriques sont servies, vide pour ne pas les servir
+         * \~english \brief Path (SCRIPT_NAME) where metrics are served, empty not to serve them
+         */
+        std::string metricsPath;
+        /**
+         * \~french \brief Les durées des étapes de traitement sont-elles renvoyées dans l'en-tête Server-Timing
+         * \~english \brief Are processing stages' durations sent back in the Server-Timing header
+         */
+        bool serverTiming;
+        /**
+         * \~french \brief Une requête sur traceSampling voit les durées de ses étapes écrites dans les logs, 0 pour aucune
+         * \~english \brief One request out of traceSampling has its stages' durations written in logs, 0 for none
+         */
+        int traceSampling;
 
         int timeKill;
 
@@ -76,24 +76,18 @@
 #include <limits>
 #include "config.h"
 #include "curl/curl.h"
+#include "MappedFilePool.h"
+#include "DecodedTilePool.h"
 #include <time.h>
 /* Usage de la ligne de commande */
 
 Rok4Server* W;
-Rok4Server* Wtmp;
-bool reload;
 
 std::string serverConfigFile;
 time_t lastReload;
 
-// Minimum time between two signal to be defered.
-// Earlier signal would be ignored.
-// in microseconds
-static const double signal_defering_min_time = 1000000LL;
-
-volatile sig_atomic_t signal_pending = 0;
-volatile sig_atomic_t defer_signal;
-volatile timeval signal_timestamp;
+volatile sig_atomic_t reload_pending = 0;
+volatile sig_atomic_t shutdown_pending = 0;
 
 /**
  * \~french
@@ -107,51 +101,24 @@ void usage() {
 
 /**
  * \~french
- * \brief Force le rechargement de la configuration
+ * \brief Demande le rechargement de la configuration
+ * \details Le rechargement est fait par le programme principal, les threads continuant à traiter les requêtes
  * \~english
- * \brief Force configuration reload
+ * \brief Ask for configuration reload
+ * \details Reload is done by the main program, threads keeping on processing requests
  */
 void reloadConfig ( int signum ) {
-    if ( defer_signal ) {
-        timeval now;
-        gettimeofday ( &now, NULL );
-        double delta = ( now.tv_sec - signal_timestamp.tv_sec ) *1000000LL + ( now.tv_usec - signal_timestamp.tv_usec );
-        if ( delta > signal_defering_min_time ) {
-            signal_pending = signum;
-        }
-    } else {
-        defer_signal++;
-        signal_pending = 0;
-        timeval begin;
-        gettimeofday ( &begin, NULL );
-        signal_timestamp.tv_sec = begin.tv_sec;
-        signal_timestamp.tv_usec = begin.tv_usec;
-        reload = true;
-        std::cout<< _ ( "Rechargement du serveur rok4" ) << "["<< getpid() <<"]" <<std::endl;
-        time_t tmpTime = time(NULL);
-        Wtmp = rok4ReloadServer ( serverConfigFile.c_str(), W, lastReload );
-        if ( !Wtmp ){
-            std::cout<< _ ( "Erreur lors du rechargement du serveur rok4" ) << "["<< getpid() <<"]" <<std::endl;
-            return;
-        }
-        lastReload = tmpTime;
-        W->terminate();
-    }
+    reload_pending = 1;
 }
 /**
  * \~french
- * \brief Force le serveur à s'éteindre
+ * \brief Demande l'extinction du serveur
  * \~english
- * \brief Force server shutdown
+ * \brief Ask for server shutdown
  */
 void shutdownServer ( int signum ) {
-    if ( defer_signal ) {
-        // Do nothing because rok4 is going to shutdown...
-    } else {
-        defer_signal++;
-        reload = false;
-        W->terminate();
-    }
+    // Les threads sont aussi interrompus par SIGQUIT lors de l'extinction
+    shutdown_pending = 1;
 }
 
 /**
@@ -183,10 +150,6 @@ std::string getlocalepath() {
  */
 int main ( int argc, char** argv ) {
 
-    bool firstStart = true;
-    int sock = 0;
-    reload = true;
-    defer_signal = 1;
     /* install Signal Handler for Conf Reloadind and Server Shutdown*/
     struct sigaction sa;
     sigemptyset ( &sa.sa_mask );
@@ -241,53 +204,69 @@ int main ( int argc, char** argv ) {
     }
 
     // Demarrage du serveur
-    while ( reload ) {
-        reload = false;
-        std::cout<< _ ( "Lancement du serveur rok4" ) << "["<< getpid() <<"]" <<std::endl;
-       
-        if ( firstStart ) {
-            lastReload = time(NULL);
-            W = rok4InitServer ( serverConfigFile.c_str() );
-            if ( !W ) {
-                return 1;
-            }
-            W->initFCGI();
-            firstStart = false;
-        } else {
-            std::cout<< _ ( "Mise a jour de la configuration" ) << "["<< getpid() <<"]" <<std::endl;
-            if ( Wtmp ) {
-                std::cout<< _ ( "Bascule des serveurs" ) << "["<< getpid() <<"]" <<std::endl;
-                W = Wtmp;
-                Wtmp = 0;
-            }
-            W->setFCGISocket ( sock );
-        }
+    std::cout<< _ ( "Lancement du serveur rok4" ) << "["<< getpid() <<"]" <<std::endl;
+    lastReload = time(NULL);
+    W = rok4InitServer ( serverConfigFile.c_str() );
+    if ( !W ) {
+        return 1;
+    }
+    W->initFCGI();
 #if BUILD_OBJECT
-        rok4ConnectObjectContext(W);
+    rok4ConnectObjectContext(W);
 #endif
+    W->run();
 
-        // Remove Event Lock
-        defer_signal--;
-        
-        W->run(signal_pending);
+    while ( ! shutdown_pending ) {
+        // Les signaux peuvent être reçus par n'importe quel thread : on les scrute régulièrement
+        sleep ( 1 );
+        if ( ! reload_pending || shutdown_pending ) continue;
+        reload_pending = 0;
 
-        // Extinction du serveur
-        if ( reload ) {
-            LOGGER_INFO ( _ ( "Rechargement de la configuration" ) );
-            sock = W->getFCGISocket();
-        } else {
-            LOGGER_INFO ( _ ( "Extinction du serveur ROK4" ) );
+        // La nouvelle configuration est construite pendant que l'ancienne continue à servir les requêtes
+        std::cout<< _ ( "Rechargement du serveur rok4" ) << "["<< getpid() <<"]" <<std::endl;
+        time_t tmpTime = time(NULL);
+        Rok4Server* Wtmp = rok4ReloadServer ( serverConfigFile.c_str(), W, lastReload );
+        if ( !Wtmp ){
+            std::cout<< _ ( "Erreur lors du rechargement du serveur rok4" ) << "["<< getpid() <<"]" <<std::endl;
+            continue;
         }
+        lastReload = tmpTime;
+#if BUILD_OBJECT
+        rok4ConnectObjectContext(Wtmp);
+#endif
+
+        std::cout<< _ ( "Bascule des serveurs" ) << "["<< getpid() <<"]" <<std::endl;
+        Rok4Server* Wold = W;
+        W = Wtmp;
+        // Publication de la nouvelle configuration, puis attente de la fin des requêtes en cours sur l'ancienne
+        Wold->replaceBy ( W );
+
+        LOGGER_INFO ( _ ( "Rechargement de la configuration" ) );
 #if BUILD_OBJECT
-        rok4DisconnectObjectContext(W);
+        rok4DisconnectObjectContext(Wold);
 #endif
-        rok4KillServer ( W );
+        rok4KillServer ( Wold );
         rok4ReloadLogger();
     }
 
+    // Extinction du serveur
+    LOGGER_INFO ( _ ( "Extinction du serveur ROK4" ) );
+    W->terminate();
+    W->join();
+#if BUILD_OBJECT
+    rok4DisconnectObjectContext(W);
+#endif
+    rok4KillServer ( W );
+
     //CURL clean - one time for the whole program
     curl_global_cleanup();
 
+    // Libération des dalles projetées en mémoire
+    MappedFilePool::cleanMappedFilePool();
+
+    // Libération des tuiles décodées en cache
+    DecodedTilePool::cleanDecodedTilePool();
+
     rok4KillLogger();
     return 0;
 }
@@ -58,6 +58,7 @@ class CppUnitRequest : public CPPUNIT_NS::TestFixture {
     CPPUNIT_TEST ( testremoveNameSpace );
     CPPUNIT_TEST ( testhasParam );
     CPPUNIT_TEST ( testgetParam );
+    CPPUNIT_TEST ( testsetAcceptEncoding );
     CPPUNIT_TEST ( testgetCapWMSParam );
     CPPUNIT_TEST ( testgetCapWMTSParam );
     CPPUNIT_TEST_SUITE_END();
@@ -126,6 +127,7 @@ protected:
     void testremoveNameSpace();
     void testhasParam();
     void testgetParam();
+    void testsetAcceptEncoding();
     void testgetCapWMSParam();
     void testgetCapWMTSParam();
 };
@@ -329,6 +331,29 @@ void CppUnitRequest::testgetParam() {
     delete marequete;
 }
 
+void CppUnitRequest::testsetAcceptEncoding() {
+    char hostName[] = "127.0.0.1";
+    char path[] = "/chemin/chemin2";
+    char strquery[] = "www.marequete.com/adresse";
+    Request* marequete = new Request ( strquery,hostName,path,NULL );
+    CPPUNIT_ASSERT_MESSAGE ( "acceptGzip par defaut :\n", marequete->acceptGzip == false );
+
+    marequete->setAcceptEncoding ( "gzip, deflate, br" );
+    CPPUNIT_ASSERT_MESSAGE ( "setAcceptEncoding gzip :\n", marequete->acceptGzip == true );
+    marequete->setAcceptEncoding ( NULL );
+    CPPUNIT_ASSERT_MESSAGE ( "setAcceptEncoding NULL :\n", marequete->acceptGzip == false );
+    marequete->setAcceptEncoding ( "deflate, GZIP;q=0.5" );
+    CPPUNIT_ASSERT_MESSAGE ( "setAcceptEncoding q=0.5 :\n", marequete->acceptGzip == true );
+    marequete->setAcceptEncoding ( "gzip;q=0, *" );
+    CPPUNIT_ASSERT_MESSAGE ( "setAcceptEncoding q=0 :\n", marequete->acceptGzip == false );
+    marequete->setAcceptEncoding ( "*;q=0.1" );
+    CPPUNIT_ASSERT_MESSAGE ( "setAcceptEncoding * :\n", marequete->acceptGzip == true );
+    marequete->setAcceptEncoding ( "identity, br" );
+    CPPUNIT_ASSERT_MESSAGE ( "setAcceptEncoding identity :\n", marequete->acceptGzip == false );
+
+    delete marequete;
+}
+
 void CppUnitRequest::testgetCapWMSParam() {
     // Create request
     std::string strquerystring ( "www.marequete.com/adresse" );